@@ -0,0 +1,892 @@
+/*
+**  FILENAME            SerialBasicPort.h
+**
+**  PURPOSE             Header-only port whose notification, frame decoding, buffer
+**                      memory and device access are template parameters. With
+**                      inline policies the path from the read to the consumer is
+**                      compiled into the I/O thread's loop, without virtual calls,
+**                      function pointers or a receive ring between them. The default
+**                      policies decide at runtime as CSerialPort does.
+**
+**  CREATION DATE       16-10-2026
+**  LAST MODIFICATION   16-10-2026
+*/
+
+#ifndef SERIAL_BASIC_PORT_H
+#define SERIAL_BASIC_PORT_H
+
+#ifndef _WIN32
+#include "SerialPortPosix.h"
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/eventfd.h>
+#endif
+#endif
+#include "SerialFramer.h"
+#include "SerialMetrics.h"
+#include <assert.h>
+#include <atomic>
+#include <new>
+#include <thread>
+
+#define SERIAL_BASIC_READ_SIZE      4096UL                  /* default bytes per read */
+#define SERIAL_BASIC_WAIT_MS        100                     /* the I/O thread looks at Close() this often */
+
+/*
+** Notifier: void OnFrame( const BYTE *pFrame, UINT nLength, UINT64 qwTimestamp ) on the
+** I/O thread with each frame, or each read when the framer passes them through. The
+** frame is only valid until it returns, qwTimestamp is the SerialMetricsNow() of the read.
+*/
+class CSerialCallbackNotifier
+{
+    public:
+        CSerialCallbackNotifier()
+        {
+            m_pfnCallback = NULL;
+            m_pContext = NULL;
+        }
+
+        // before Open()
+        void                SetCallback( SERIAL_FRAME_CALLBACK pfnCallback, void *pContext )
+        {
+            m_pfnCallback = pfnCallback;
+            m_pContext = pContext;
+        }
+
+        void                OnFrame( const BYTE *pFrame, UINT nLength, UINT64 qwTimestamp )
+        {
+            ( void )qwTimestamp;
+
+            if ( m_pfnCallback != NULL )
+            {
+                m_pfnCallback( m_pContext, pFrame, nLength );
+            }
+        }
+
+    private:
+        SERIAL_FRAME_CALLBACK m_pfnCallback;
+        void                *m_pContext;
+};
+
+/*
+** Framer: Attach( BYTE *pFrame, UINT nMaxFrame ) hands it the storage for a frame which
+** spans reads, Bind( Sink *pSink ) the notifier, Feed( pData, nLength, qwTimestamp, Sink )
+** decodes a read into Sink.OnFrame() calls and Reset() forgets a partial frame. Bind()
+** and Feed() are templates on the notifier.
+*/
+class CSerialRawFramer
+{
+    public:
+        void                Attach( BYTE *pFrame, UINT nMaxFrame )
+        {
+            ( void )pFrame;
+            ( void )nMaxFrame;
+        }
+
+        template < class Sink >
+        void                Bind( Sink *pSink )
+        {
+            ( void )pSink;
+        }
+
+        template < class Sink >
+        void                Feed( const BYTE *pData, UINT nLength, UINT64 qwTimestamp, Sink &Notifier )
+        {
+            Notifier.OnFrame( pData, nLength, qwTimestamp );
+        }
+
+        void                Reset()
+        {
+        }
+};
+
+/*
+** Frames terminated by cDelimiter, as CSerialLineFramer without the base class: a line
+** which came in one read goes out from the read buffer, only one spanning reads is
+** gathered in the attached storage. Lines above the maximum frame size are dropped.
+*/
+template < BYTE cDelimiter = '\n', bool bStripCR = true >
+class CSerialDelimiterFramer
+{
+    public:
+        CSerialDelimiterFramer()
+        {
+            m_pFrame = NULL;
+            m_nMaxFrame = 0;
+            m_nUsed = 0;
+            m_bDiscarding = FALSE;
+            m_qwFrames = 0;
+            m_qwOversize = 0;
+        }
+
+        void                Attach( BYTE *pFrame, UINT nMaxFrame )
+        {
+            m_pFrame = pFrame;
+            m_nMaxFrame = nMaxFrame;
+        }
+
+        template < class Sink >
+        void                Bind( Sink *pSink )
+        {
+            ( void )pSink;
+        }
+
+        template < class Sink >
+        void                Feed( const BYTE *pData, UINT nLength, UINT64 qwTimestamp, Sink &Notifier )
+        {
+            while ( nLength > 0 )
+            {
+                const BYTE *pEnd = SerialFindByte( pData, nLength, cDelimiter );
+                UINT nChunk = ( pEnd != NULL ) ? ( UINT )( pEnd - pData ) : nLength;
+
+                if ( pEnd == NULL )
+                {
+                    Append( pData, nChunk );
+                    return;
+                }
+
+                if ( ( m_nUsed == 0 ) && !m_bDiscarding && ( nChunk <= m_nMaxFrame ) )
+                {
+                    Deliver( pData, nChunk, qwTimestamp, Notifier );
+                }
+                else
+                {
+                    Append( pData, nChunk );
+
+                    if ( !m_bDiscarding )
+                    {
+                        Deliver( m_pFrame, m_nUsed, qwTimestamp, Notifier );
+                    }
+
+                    m_nUsed = 0;
+                    m_bDiscarding = FALSE;
+                }
+
+                pData += nChunk + 1;
+                nLength -= nChunk + 1;
+            }
+        }
+
+        void                Reset()
+        {
+            m_nUsed = 0;
+            m_bDiscarding = FALSE;
+        }
+
+        // any thread
+        UINT64              GetFrames() const
+        {
+            return m_qwFrames.load( std::memory_order_relaxed );
+        }
+        UINT64              GetOversize() const
+        {
+            return m_qwOversize.load( std::memory_order_relaxed );
+        }
+
+    private:
+        void                Append( const BYTE *pData, UINT nLength )
+        {
+            if ( m_bDiscarding )
+            {
+                return;
+            }
+
+            if ( nLength > m_nMaxFrame - m_nUsed )
+            {
+                // the rest of the line is skipped up to its delimiter
+                m_bDiscarding = TRUE;
+                m_nUsed = 0;
+                m_qwOversize.store( m_qwOversize.load( std::memory_order_relaxed ) + 1, std::memory_order_relaxed );
+                return;
+            }
+
+            memcpy( m_pFrame + m_nUsed, pData, nLength );
+            m_nUsed += nLength;
+        }
+
+        template < class Sink >
+        void                Deliver( const BYTE *pFrame, UINT nLength, UINT64 qwTimestamp, Sink &Notifier )
+        {
+            if ( bStripCR && ( nLength > 0 ) && ( pFrame[nLength - 1] == '\r' ) )
+            {
+                nLength--;
+            }
+
+            m_qwFrames.store( m_qwFrames.load( std::memory_order_relaxed ) + 1, std::memory_order_relaxed );
+            Notifier.OnFrame( pFrame, nLength, qwTimestamp );
+        }
+
+        BYTE                *m_pFrame;
+        UINT                m_nMaxFrame;
+        UINT                m_nUsed;
+        BOOL                m_bDiscarding;
+        std::atomic<UINT64> m_qwFrames;         // written by the I/O thread only
+        std::atomic<UINT64> m_qwOversize;
+};
+
+/*
+** Any CSerialFramer of SerialFramer.h behind its virtual Input() and frame callback,
+** which Bind() takes over; reads pass through without one. Decoders which act on
+** silence (CSerialGapFramer) need CSerialPort, this port has no idle deadline.
+*/
+class CSerialRuntimeFramer
+{
+    public:
+        CSerialRuntimeFramer()
+        {
+            m_pFramer = NULL;
+            m_pSink = NULL;
+        }
+
+        // before Open()
+        void                SetFramer( CSerialFramer *pFramer )
+        {
+            m_pFramer = pFramer;
+        }
+
+        void                Attach( BYTE *pFrame, UINT nMaxFrame )
+        {
+            // the framer keeps a frame spanning reads itself
+            ( void )pFrame;
+
+            if ( m_pFramer != NULL )
+            {
+                m_pFramer->SetMaxFrameSize( nMaxFrame );
+            }
+        }
+
+        template < class Sink >
+        void                Bind( Sink *pSink )
+        {
+            m_pSink = pSink;
+
+            if ( m_pFramer != NULL )
+            {
+                m_pFramer->SetCallback( OnFrame< Sink >, this );
+            }
+        }
+
+        template < class Sink >
+        void                Feed( const BYTE *pData, UINT nLength, UINT64 qwTimestamp, Sink &Notifier )
+        {
+            if ( m_pFramer != NULL )
+            {
+                m_pFramer->Feed( pData, nLength, qwTimestamp );
+            }
+            else
+            {
+                Notifier.OnFrame( pData, nLength, qwTimestamp );
+            }
+        }
+
+        void                Reset()
+        {
+            if ( m_pFramer != NULL )
+            {
+                m_pFramer->Reset();
+            }
+        }
+
+    private:
+        template < class Sink >
+        static void         OnFrame( void *pContext, const BYTE *pFrame, UINT nLength )
+        {
+            CSerialRuntimeFramer *pThis = ( CSerialRuntimeFramer * )pContext;
+            ( ( Sink * )pThis->m_pSink )->OnFrame( pFrame, nLength, pThis->m_pFramer->GetFrameTime() );
+        }
+
+        CSerialFramer       *m_pFramer;
+        void                *m_pSink;
+};
+
+/*
+** Allocator: BYTE *Allocate( UINT nSize ) and void Free( BYTE *pData ) for the read
+** buffer and the frame storage, Open() takes both and Close() gives both back.
+*/
+class CSerialHeapAllocator
+{
+    public:
+        BYTE                *Allocate( UINT nSize )
+        {
+            return new ( std::nothrow ) BYTE[nSize];
+        }
+
+        void                Free( BYTE *pData )
+        {
+            delete[] pData;
+        }
+};
+
+// the buffers inside the port object, nSize has to hold the read size and the maximum frame
+template < UINT nSize >
+class CSerialStaticAllocator
+{
+    public:
+        CSerialStaticAllocator()
+        {
+            m_nUsed = 0;
+            m_nAllocated = 0;
+        }
+
+        BYTE                *Allocate( UINT nBytes )
+        {
+            // cache line aligned, the arena starts over once everything was freed
+            UINT nRounded = ( nBytes + 63 ) & ~63U;
+
+            if ( nRounded > nSize - m_nUsed )
+            {
+                return NULL;
+            }
+
+            m_nUsed += nRounded;
+            m_nAllocated++;
+            return m_Arena + m_nUsed - nRounded;
+        }
+
+        void                Free( BYTE *pData )
+        {
+            if ( ( pData != NULL ) && ( --m_nAllocated == 0 ) )
+            {
+                m_nUsed = 0;
+            }
+        }
+
+    private:
+        alignas( 64 ) BYTE  m_Arena[nSize];
+        UINT                m_nUsed;
+        UINT                m_nAllocated;
+};
+
+/*
+** Backend: Open( szPort, nBaud, nParity, nDataBits, nStopBits ) and Close(); Read( pData,
+** nSize, dwTimeout ) waits up to dwTimeout ms or until Wake() and returns the bytes read,
+** 0 for none and -1 when the device failed; Write( pData, nSize ) returns once the driver
+** took all of it, one writer at a time; GetError() is the errno or Win32 error of the
+** last failure.
+*/
+#ifndef _WIN32
+
+class CSerialPosixBackend
+{
+    public:
+        CSerialPosixBackend()
+        {
+            m_hComm = -1;
+            m_nWakeFd[0] = -1;
+            m_nWakeFd[1] = -1;
+            m_dwError = 0;
+        }
+
+        ~CSerialPosixBackend()
+        {
+            Close();
+        }
+
+        BOOL                Open( const char *szPort, UINT nBaud, BYTE nParity, BYTE nDataBits, BYTE nStopBits )
+        {
+            struct termios tio;
+            speed_t speed;
+
+            if ( !SerialBaudToSpeed( nBaud, &speed ) || ( nParity > EVENPARITY ) || ( nDataBits < 5 ) || ( nDataBits > 8 ) )
+            {
+                m_dwError = EINVAL;
+                return FALSE;
+            }
+
+            m_hComm = open( szPort, O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC );
+#ifdef __linux__
+            m_nWakeFd[0] = eventfd( 0, EFD_NONBLOCK | EFD_CLOEXEC );
+            m_nWakeFd[1] = m_nWakeFd[0];
+#else
+            if ( pipe( m_nWakeFd ) == 0 )
+            {
+                fcntl( m_nWakeFd[0], F_SETFL, O_NONBLOCK );
+                fcntl( m_nWakeFd[1], F_SETFL, O_NONBLOCK );
+            }
+#endif
+
+            if ( ( m_hComm < 0 ) || ( m_nWakeFd[0] < 0 ) || ( tcgetattr( m_hComm, &tio ) != 0 ) )
+            {
+                m_dwError = errno;
+                Close();
+                return FALSE;
+            }
+
+            // raw, without flow control, as CSerialPort::ApplyDCB() with a default DCB
+            cfmakeraw( &tio );
+            tio.c_cflag &= ~( CSIZE | PARENB | PARODD | CSTOPB );
+            tio.c_cflag |= CREAD | CLOCAL;
+            tio.c_cflag |= ( nDataBits == 5 ) ? CS5 : ( nDataBits == 6 ) ? CS6 : ( nDataBits == 7 ) ? CS7 : CS8;
+            tio.c_cflag |= ( nParity == ODDPARITY ) ? ( PARENB | PARODD ) : ( nParity == EVENPARITY ) ? PARENB : 0;
+            tio.c_cflag |= ( nStopBits != ONESTOPBIT ) ? CSTOPB : 0;
+            tio.c_cc[VMIN] = 0;
+            tio.c_cc[VTIME] = 0;
+
+            if ( ( cfsetispeed( &tio, speed ) != 0 ) || ( cfsetospeed( &tio, speed ) != 0 ) ||
+                 ( tcsetattr( m_hComm, TCSANOW, &tio ) != 0 ) )
+            {
+                m_dwError = errno;
+                Close();
+                return FALSE;
+            }
+
+            return TRUE;
+        }
+
+        void                Close()
+        {
+            if ( m_nWakeFd[1] != m_nWakeFd[0] )
+            {
+                close( m_nWakeFd[1] );
+            }
+
+            if ( m_nWakeFd[0] >= 0 )
+            {
+                close( m_nWakeFd[0] );
+            }
+
+            if ( m_hComm >= 0 )
+            {
+                close( m_hComm );
+            }
+
+            m_hComm = -1;
+            m_nWakeFd[0] = -1;
+            m_nWakeFd[1] = -1;
+        }
+
+        int                 Read( BYTE *pData, UINT nSize, DWORD dwTimeout )
+        {
+            struct pollfd Fds[2];
+            UINT64 qwWake;
+            ssize_t n;
+
+            Fds[0].fd = m_hComm;
+            Fds[0].events = POLLIN;
+            Fds[0].revents = 0;
+            Fds[1].fd = m_nWakeFd[0];
+            Fds[1].events = POLLIN;
+            Fds[1].revents = 0;
+
+            if ( poll( Fds, 2, ( int )dwTimeout ) <= 0 )
+            {
+                return 0;
+            }
+
+            if ( ( Fds[1].revents & POLLIN ) && ( read( m_nWakeFd[0], &qwWake, sizeof( qwWake ) ) < 0 ) )
+            {
+                // drained by an earlier read
+            }
+
+            if ( Fds[0].revents & ( POLLIN | POLLERR | POLLHUP | POLLNVAL ) )
+            {
+                n = read( m_hComm, pData, nSize );
+
+                if ( n > 0 )
+                {
+                    return ( int )n;
+                }
+
+                // a hung up pty reads EIO, a removed adapter 0 while readable
+                if ( ( n == 0 ) || ( ( errno != EAGAIN ) && ( errno != EINTR ) ) )
+                {
+                    m_dwError = ( n == 0 ) ? EIO : errno;
+                    return -1;
+                }
+            }
+
+            return 0;
+        }
+
+        BOOL                Write( const void *pData, UINT nSize )
+        {
+            const BYTE *p = ( const BYTE * )pData;
+
+            while ( nSize > 0 )
+            {
+                ssize_t n = write( m_hComm, p, nSize );
+
+                if ( n > 0 )
+                {
+                    p += n;
+                    nSize -= ( UINT )n;
+                }
+                else if ( ( n < 0 ) && ( errno == EAGAIN ) )
+                {
+                    struct pollfd Fd;
+                    Fd.fd = m_hComm;
+                    Fd.events = POLLOUT;
+                    Fd.revents = 0;
+                    poll( &Fd, 1, SERIAL_BASIC_WAIT_MS );
+                }
+                else if ( ( n < 0 ) && ( errno != EINTR ) )
+                {
+                    m_dwError = errno;
+                    return FALSE;
+                }
+            }
+
+            return TRUE;
+        }
+
+        void                Wake()
+        {
+            UINT64 qwOne = 1;
+
+            if ( write( m_nWakeFd[1], &qwOne, sizeof( qwOne ) ) < 0 )
+            {
+                // a wake-up is pending already
+            }
+        }
+
+        DWORD               GetError()
+        {
+            return m_dwError;
+        }
+
+    private:
+        int                 m_hComm;
+        int                 m_nWakeFd[2];           // one eventfd in both slots on Linux
+        std::atomic<DWORD>  m_dwError;
+};
+
+typedef CSerialPosixBackend CSerialDeviceBackend;
+
+#else
+
+class CSerialWin32Backend
+{
+    public:
+        CSerialWin32Backend()
+        {
+            m_hComm = INVALID_HANDLE_VALUE;
+            m_hWake = NULL;
+            m_hReadEvent = NULL;
+            m_hWriteEvent = NULL;
+            m_dwError = 0;
+        }
+
+        ~CSerialWin32Backend()
+        {
+            Close();
+        }
+
+        BOOL                Open( const char *szPort, UINT nBaud, BYTE nParity, BYTE nDataBits, BYTE nStopBits )
+        {
+            // a read waits up to SERIAL_BASIC_WAIT_MS for the first byte and returns with what is there
+            COMMTIMEOUTS Timeouts = { MAXDWORD, MAXDWORD, SERIAL_BASIC_WAIT_MS, 0, 0 };
+            char szDevice[MAX_PATH];
+            DCB dcb;
+
+            _snprintf_s( szDevice, sizeof( szDevice ), _TRUNCATE, ( strncmp( szPort, "\\\\.\\", 4 ) == 0 ) ? "%s" : "\\\\.\\%s", szPort );
+            m_hComm = CreateFileA( szDevice, GENERIC_READ | GENERIC_WRITE, 0, NULL, OPEN_EXISTING, FILE_FLAG_OVERLAPPED, NULL );
+            m_hWake = CreateEvent( NULL, FALSE, FALSE, NULL );
+            m_hReadEvent = CreateEvent( NULL, TRUE, FALSE, NULL );
+            m_hWriteEvent = CreateEvent( NULL, TRUE, FALSE, NULL );
+            memset( &dcb, 0, sizeof( dcb ) );
+            dcb.DCBlength = sizeof( dcb );
+
+            if ( ( m_hComm == INVALID_HANDLE_VALUE ) || ( m_hWake == NULL ) || ( m_hReadEvent == NULL ) ||
+                 ( m_hWriteEvent == NULL ) || !GetCommState( m_hComm, &dcb ) )
+            {
+                m_dwError = GetLastError();
+                Close();
+                return FALSE;
+            }
+
+            dcb.BaudRate = nBaud;
+            dcb.ByteSize = nDataBits;
+            dcb.Parity = nParity;
+            dcb.StopBits = nStopBits;
+            dcb.fBinary = TRUE;
+            dcb.fParity = ( nParity != NOPARITY );
+            dcb.fOutxCtsFlow = FALSE;
+            dcb.fOutxDsrFlow = FALSE;
+            dcb.fOutX = FALSE;
+            dcb.fInX = FALSE;
+            dcb.fDtrControl = DTR_CONTROL_ENABLE;
+            dcb.fRtsControl = RTS_CONTROL_ENABLE;
+
+            if ( !SetCommState( m_hComm, &dcb ) || !SetCommTimeouts( m_hComm, &Timeouts ) )
+            {
+                m_dwError = GetLastError();
+                Close();
+                return FALSE;
+            }
+
+            return TRUE;
+        }
+
+        void                Close()
+        {
+            HANDLE *pHandles[] = { &m_hWake, &m_hReadEvent, &m_hWriteEvent };
+
+            if ( m_hComm != INVALID_HANDLE_VALUE )
+            {
+                CloseHandle( m_hComm );
+                m_hComm = INVALID_HANDLE_VALUE;
+            }
+
+            for ( int i = 0; i < 3; i++ )
+            {
+                if ( *pHandles[i] != NULL )
+                {
+                    CloseHandle( *pHandles[i] );
+                    *pHandles[i] = NULL;
+                }
+            }
+        }
+
+        int                 Read( BYTE *pData, UINT nSize, DWORD dwTimeout )
+        {
+            HANDLE hEvents[2] = { m_hReadEvent, m_hWake };
+            OVERLAPPED Overlapped;
+            DWORD dwRead = 0;
+
+            memset( &Overlapped, 0, sizeof( Overlapped ) );
+            Overlapped.hEvent = m_hReadEvent;
+
+            if ( !ReadFile( m_hComm, pData, nSize, &dwRead, &Overlapped ) )
+            {
+                if ( GetLastError() != ERROR_IO_PENDING )
+                {
+                    m_dwError = GetLastError();
+                    return -1;
+                }
+
+                // the buffer belongs to the read until it completed or was cancelled
+                if ( WaitForMultipleObjects( 2, hEvents, FALSE, dwTimeout ) != WAIT_OBJECT_0 )
+                {
+                    CancelIo( m_hComm );
+                }
+
+                if ( !GetOverlappedResult( m_hComm, &Overlapped, &dwRead, TRUE ) && ( GetLastError() != ERROR_OPERATION_ABORTED ) )
+                {
+                    m_dwError = GetLastError();
+                    return -1;
+                }
+            }
+
+            return ( int )dwRead;
+        }
+
+        BOOL                Write( const void *pData, UINT nSize )
+        {
+            OVERLAPPED Overlapped;
+            DWORD dwWritten = 0;
+
+            memset( &Overlapped, 0, sizeof( Overlapped ) );
+            Overlapped.hEvent = m_hWriteEvent;
+
+            if ( ( !WriteFile( m_hComm, pData, nSize, &dwWritten, &Overlapped ) && ( GetLastError() != ERROR_IO_PENDING ) ) ||
+                 !GetOverlappedResult( m_hComm, &Overlapped, &dwWritten, TRUE ) || ( dwWritten != nSize ) )
+            {
+                m_dwError = GetLastError();
+                return FALSE;
+            }
+
+            return TRUE;
+        }
+
+        void                Wake()
+        {
+            SetEvent( m_hWake );
+        }
+
+        DWORD               GetError()
+        {
+            return m_dwError;
+        }
+
+    private:
+        HANDLE              m_hComm;
+        HANDLE              m_hWake;                // auto reset, Close()
+        HANDLE              m_hReadEvent;
+        HANDLE              m_hWriteEvent;
+        std::atomic<DWORD>  m_dwError;
+};
+
+typedef CSerialWin32Backend CSerialDeviceBackend;
+
+#endif
+
+/*
+** One I/O thread reads into the read buffer and feeds the framer, which calls the
+** notifier; nothing is queued between them. Write() hands the data to the driver on
+** the calling thread. Set up the policies through the accessors before Open().
+*/
+template < class Notifier = CSerialCallbackNotifier, class Framer = CSerialRuntimeFramer,
+           class Allocator = CSerialHeapAllocator, class Backend = CSerialDeviceBackend >
+class CBasicSerialPort
+{
+    public:
+        CBasicSerialPort()
+        {
+            m_nReadSize = SERIAL_BASIC_READ_SIZE;
+            m_nMaxFrame = SERIAL_FRAME_MAX_SIZE;
+            m_pRead = NULL;
+            m_pFrame = NULL;
+            m_bOpen = FALSE;
+            m_bStop = false;
+            m_qwRxBytes = 0;
+            m_qwRxReads = 0;
+        }
+
+        ~CBasicSerialPort()
+        {
+            Close();
+        }
+
+        Notifier            &GetNotifier()
+        {
+            return m_Notifier;
+        }
+        Framer              &GetFramer()
+        {
+            return m_Framer;
+        }
+        Allocator           &GetAllocator()
+        {
+            return m_Allocator;
+        }
+        Backend             &GetBackend()
+        {
+            return m_Backend;
+        }
+
+        // before Open()
+        void                SetReadSize( UINT nSize )
+        {
+            assert( !m_bOpen && ( nSize > 0 ) );
+            m_nReadSize = nSize;
+        }
+        void                SetMaxFrameSize( UINT nSize )
+        {
+            assert( !m_bOpen && ( nSize > 0 ) );
+            m_nMaxFrame = nSize;
+        }
+
+        BOOL                OpenDevice( const char *szPort, UINT baud = 9600, BYTE parity = NOPARITY,
+                                        BYTE databits = 8, BYTE stopbits = ONESTOPBIT )
+        {
+            assert( !m_bOpen );
+
+            m_pRead = m_Allocator.Allocate( m_nReadSize );
+            m_pFrame = m_Allocator.Allocate( m_nMaxFrame );
+
+            if ( ( m_pRead == NULL ) || ( m_pFrame == NULL ) || !m_Backend.Open( szPort, baud, parity, databits, stopbits ) )
+            {
+                FreeBuffers();
+                return FALSE;
+            }
+
+            m_Framer.Attach( m_pFrame, m_nMaxFrame );
+            m_Framer.Bind( &m_Notifier );
+            m_Framer.Reset();
+            m_qwRxBytes = 0;
+            m_qwRxReads = 0;
+            m_bStop = false;
+            m_Thread = std::thread( &CBasicSerialPort::Run, this );
+            m_bOpen = TRUE;
+            return TRUE;
+        }
+
+        BOOL                Write( const void *Buffer, UINT nSize )
+        {
+            return m_bOpen && m_Backend.Write( Buffer, nSize );
+        }
+
+        void                Close()
+        {
+            if ( !m_bOpen )
+            {
+                return;
+            }
+
+            m_bStop = true;
+            m_Backend.Wake();
+            m_Thread.join();
+            m_Backend.Close();
+            FreeBuffers();
+            m_bOpen = FALSE;
+        }
+
+        BOOL                IsOpen()
+        {
+            return m_bOpen;
+        }
+
+        // any thread
+        UINT64              GetRxBytes()
+        {
+            return m_qwRxBytes.load( std::memory_order_relaxed );
+        }
+        UINT64              GetRxReads()
+        {
+            return m_qwRxReads.load( std::memory_order_relaxed );
+        }
+        // the device failed when not 0, the I/O thread ended then
+        DWORD               GetError()
+        {
+            return m_Backend.GetError();
+        }
+
+    private:
+        CBasicSerialPort( const CBasicSerialPort & );
+        CBasicSerialPort    &operator=( const CBasicSerialPort & );
+
+        void                Run()
+        {
+            while ( !m_bStop.load( std::memory_order_relaxed ) )
+            {
+                int n = m_Backend.Read( m_pRead, m_nReadSize, SERIAL_BASIC_WAIT_MS );
+
+                if ( n > 0 )
+                {
+                    m_Framer.Feed( m_pRead, ( UINT )n, SerialMetricsNow(), m_Notifier );
+                    m_qwRxBytes.store( m_qwRxBytes.load( std::memory_order_relaxed ) + ( UINT )n, std::memory_order_relaxed );
+                    m_qwRxReads.store( m_qwRxReads.load( std::memory_order_relaxed ) + 1, std::memory_order_relaxed );
+                }
+                else if ( n < 0 )
+                {
+                    break;
+                }
+            }
+        }
+
+        void                FreeBuffers()
+        {
+            if ( m_pFrame != NULL )
+            {
+                m_Allocator.Free( m_pFrame );
+                m_pFrame = NULL;
+            }
+
+            if ( m_pRead != NULL )
+            {
+                m_Allocator.Free( m_pRead );
+                m_pRead = NULL;
+            }
+        }
+
+        Notifier            m_Notifier;
+        Framer              m_Framer;
+        Allocator           m_Allocator;
+        Backend             m_Backend;
+        UINT                m_nReadSize;
+        UINT                m_nMaxFrame;
+        BYTE                *m_pRead;
+        BYTE                *m_pFrame;
+        BOOL                m_bOpen;
+        std::atomic<bool>   m_bStop;
+        std::thread         m_Thread;
+        std::atomic<UINT64> m_qwRxBytes;            // written by the I/O thread only
+        std::atomic<UINT64> m_qwRxReads;
+};
+
+// the choices CSerialPort makes at runtime: a callback, any CSerialFramer, heap buffers and the device of the platform
+typedef CBasicSerialPort<> CSerialRuntimePort;
+
+#endif // SERIAL_BASIC_PORT_H
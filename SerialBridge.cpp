@@ -0,0 +1,943 @@
+/*
+**  FILENAME            SerialBridge.cpp
+**
+**  PURPOSE             Forwards ports to TCP listeners or UDP peers.
+**
+**  CREATION DATE       16-10-2026
+**  LAST MODIFICATION   16-10-2026
+*/
+
+#ifdef _WIN32
+#include "stdafx.h"
+#endif
+#include "SerialBridge.h"
+
+#ifdef SERIAL_PORT_REACTOR
+
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+
+static BOOL MakeAddress( const char *pszAddress, WORD nPort, struct sockaddr_in *pAddress )
+{
+    memset( pAddress, 0, sizeof( *pAddress ) );
+    pAddress->sin_family = AF_INET;
+    pAddress->sin_port = htons( nPort );
+
+    if ( pszAddress == NULL )
+    {
+        pAddress->sin_addr.s_addr = htonl( INADDR_ANY );
+        return TRUE;
+    }
+
+    return inet_pton( AF_INET, pszAddress, &pAddress->sin_addr ) == 1;
+}
+
+static void CloseFd( int *pnFd )
+{
+    if ( *pnFd >= 0 )
+    {
+        close( *pnFd );
+        *pnFd = -1;
+    }
+}
+
+CSerialBridge::CSerialBridge()
+{
+    m_nEpoll = -1;
+    m_nEvent = -1;
+    m_bThreadStarted = FALSE;
+    m_bStop = FALSE;
+    m_nLoopError = 0;
+}
+
+CSerialBridge::~CSerialBridge()
+{
+    Stop();
+}
+
+BOOL CSerialBridge::Start()
+{
+    struct epoll_event ev;
+    assert( m_nEpoll < 0 );
+
+    m_bStop = FALSE;
+    m_nLoopError = 0;
+    m_nEpoll = epoll_create1( EPOLL_CLOEXEC );
+    m_nEvent = eventfd( 0, EFD_NONBLOCK | EFD_CLOEXEC );
+
+    if ( ( m_nEpoll < 0 ) || ( m_nEvent < 0 ) )
+    {
+        Stop();
+        return FALSE;
+    }
+
+    // the eventfd has no tag
+    memset( &ev, 0, sizeof( ev ) );
+    ev.events = EPOLLIN;
+    ev.data.ptr = NULL;
+
+    if ( ( epoll_ctl( m_nEpoll, EPOLL_CTL_ADD, m_nEvent, &ev ) != 0 ) ||
+         ( pthread_create( &m_Thread, NULL, LoopThread, this ) != 0 ) )
+    {
+        Stop();
+        return FALSE;
+    }
+
+    m_bThreadStarted = TRUE;
+    return TRUE;
+}
+
+void CSerialBridge::Stop()
+{
+    UINT64 qwOne = 1;
+
+    if ( m_bThreadStarted )
+    {
+        m_bStop = TRUE;
+        // a full counter already has a wakeup pending
+        ( void )write( m_nEvent, &qwOne, sizeof( qwOne ) );
+
+        pthread_join( m_Thread, NULL );
+        m_bThreadStarted = FALSE;
+    }
+
+    std::lock_guard<std::mutex> Lock( m_Lock );
+
+    for ( size_t i = 0; i < m_Sessions.size(); i++ )
+    {
+        // the port would call into the session
+        assert( !m_Sessions[i]->pPort->IsOpen() );
+        Destroy( m_Sessions[i] );
+    }
+
+    m_Sessions.clear();
+    CloseFd( &m_nEvent );
+    CloseFd( &m_nEpoll );
+}
+
+int CSerialBridge::ListenTcp( CSerialPort *pPort, const char *pszAddress, WORD nPort, DWORD dwFlags )
+{
+    struct sockaddr_in Address;
+    socklen_t nLength = sizeof( Address );
+    SESSION *pSession;
+    int nOn = 1;
+
+    if ( !MakeAddress( pszAddress, nPort, &Address ) )
+    {
+        errno = EINVAL;
+        return -1;
+    }
+
+    pSession = NewSession( pPort, TRUE, dwFlags );
+    pSession->nListen = socket( AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0 );
+
+    if ( ( pSession->nListen < 0 ) ||
+         ( setsockopt( pSession->nListen, SOL_SOCKET, SO_REUSEADDR, &nOn, sizeof( nOn ) ) != 0 ) ||
+         ( bind( pSession->nListen, ( struct sockaddr * )&Address, sizeof( Address ) ) != 0 ) ||
+         ( listen( pSession->nListen, 1 ) != 0 ) ||
+         ( getsockname( pSession->nListen, ( struct sockaddr * )&Address, &nLength ) != 0 ) )
+    {
+        Destroy( pSession );
+        return -1;
+    }
+
+    pSession->nLocalPort = ntohs( Address.sin_port );
+
+    if ( dwFlags & SERIAL_BRIDGE_SPLICE )
+    {
+        if ( pipe2( pSession->nPipe, O_NONBLOCK | O_CLOEXEC ) == 0 )
+        {
+            // a smaller pipe only means more splices
+            fcntl( pSession->nPipe[1], F_SETPIPE_SZ, SERIAL_BRIDGE_PIPE_SIZE );
+        }
+        else
+        {
+            pSession->nPipe[0] = -1;
+            pSession->nPipe[1] = -1;
+            pSession->dwFlags &= ~SERIAL_BRIDGE_SPLICE;
+        }
+    }
+
+    return Add( pSession );
+}
+
+int CSerialBridge::ConnectUdp( CSerialPort *pPort, const char *pszAddress, WORD nPort, const char *pszPeer, WORD nPeerPort )
+{
+    struct sockaddr_in Address;
+    socklen_t nLength = sizeof( Address );
+    SESSION *pSession;
+
+    if ( !MakeAddress( pszAddress, nPort, &Address ) )
+    {
+        errno = EINVAL;
+        return -1;
+    }
+
+    // datagrams are copied, a pipe would split them
+    pSession = NewSession( pPort, FALSE, 0 );
+
+    if ( ( pszPeer != NULL ) && !MakeAddress( pszPeer, nPeerPort, &pSession->Peer ) )
+    {
+        Destroy( pSession );
+        errno = EINVAL;
+        return -1;
+    }
+
+    pSession->bPeer = ( pszPeer != NULL );
+    pSession->bFixedPeer = pSession->bPeer;
+    pSession->nSocket = socket( AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0 );
+
+    if ( ( pSession->nSocket < 0 ) ||
+         ( bind( pSession->nSocket, ( struct sockaddr * )&Address, sizeof( Address ) ) != 0 ) ||
+         ( getsockname( pSession->nSocket, ( struct sockaddr * )&Address, &nLength ) != 0 ) )
+    {
+        Destroy( pSession );
+        return -1;
+    }
+
+    pSession->nLocalPort = ntohs( Address.sin_port );
+    return Add( pSession );
+}
+
+WORD CSerialBridge::GetLocalPort( int nSession )
+{
+    std::lock_guard<std::mutex> Lock( m_Lock );
+    assert( ( nSession >= 0 ) && ( ( size_t )nSession < m_Sessions.size() ) );
+
+    return m_Sessions[nSession]->nLocalPort;
+}
+
+UINT CSerialBridge::GetSessionCount()
+{
+    std::lock_guard<std::mutex> Lock( m_Lock );
+
+    return ( UINT )m_Sessions.size();
+}
+
+void CSerialBridge::GetStats( int nSession, SERIAL_BRIDGE_STATS *pStats, BOOL bReset )
+{
+    SESSION *pSession;
+
+    {
+        std::lock_guard<std::mutex> Lock( m_Lock );
+        assert( ( nSession >= 0 ) && ( ( size_t )nSession < m_Sessions.size() ) );
+        pSession = m_Sessions[nSession];
+    }
+
+    std::lock_guard<std::mutex> Lock( pSession->Lock );
+
+    pStats->qwToSocket = pSession->qwToSocket;
+    pStats->qwToPort = pSession->qwToPort;
+    pStats->qwSpliced = pSession->qwSpliced;
+    pStats->qwDropped = pSession->qwDropped;
+    pStats->qwConnections = pSession->qwConnections;
+    pStats->nSocketBacklog = pSession->nBacklog;
+    pStats->nPortBacklog = pSession->nTxQueued + pSession->nPipeBytes;
+    pStats->bConnected = pSession->bTcp ? ( pSession->nSocket >= 0 ) : pSession->bPeer;
+    pSession->ToSocket.Snapshot( &pStats->ToSocket, bReset );
+    pSession->ToPort.Snapshot( &pStats->ToPort, bReset );
+
+    if ( bReset )
+    {
+        pSession->qwToSocket = 0;
+        pSession->qwToPort = 0;
+        pSession->qwSpliced = 0;
+        pSession->qwDropped = 0;
+        pSession->qwConnections = 0;
+    }
+}
+
+void *CSerialBridge::LoopThread( void *pParam )
+{
+    ( ( CSerialBridge * )pParam )->Run();
+    return NULL;
+}
+
+void CSerialBridge::Run()
+{
+    struct epoll_event Events[SERIAL_BRIDGE_MAX_EVENTS];
+
+    while ( !m_bStop )
+    {
+        int nEvents = epoll_wait( m_nEpoll, Events, SERIAL_BRIDGE_MAX_EVENTS, -1 );
+
+        if ( nEvents < 0 )
+        {
+            if ( errno == EINTR )
+            {
+                continue;
+            }
+
+            Exit( errno );
+            break;
+        }
+
+        for ( int i = 0; i < nEvents; i++ )
+        {
+            TAG *pTag = ( TAG * )Events[i].data.ptr;
+            UINT nFlags = Events[i].events;
+
+            if ( pTag == NULL )
+            {
+                // Stop()
+                continue;
+            }
+
+            SESSION *pSession = pTag->pSession;
+
+            switch ( pTag->Source )
+            {
+                case SOURCE_LISTEN:
+                    Accept( pSession );
+                    break;
+
+                case SOURCE_PORT:
+                    // the driver has room again, the socket is read once the pipe is empty
+                    FlushPipe( pSession );
+                    break;
+
+                case SOURCE_SOCKET:
+                    if ( nFlags & EPOLLOUT )
+                    {
+                        std::lock_guard<std::mutex> Lock( pSession->Lock );
+                        Flush( pSession );
+                    }
+
+                    if ( nFlags & ( EPOLLIN | EPOLLRDHUP ) )
+                    {
+                        ToPort( pSession );
+                    }
+                    else if ( ( nFlags & ( EPOLLHUP | EPOLLERR ) ) && pSession->bTcp )
+                    {
+                        Disconnect( pSession );
+                    }
+                    else if ( nFlags & EPOLLERR )
+                    {
+                        // an ICMP error of an earlier datagram, it is not reported again
+                        int nError;
+                        socklen_t nLength = sizeof( nError );
+                        getsockopt( pSession->nSocket, SOL_SOCKET, SO_ERROR, &nError, &nLength );
+                    }
+                    break;
+            }
+        }
+    }
+}
+
+// nothing forwards the sessions any more, their ports and GetLoopError() tell why
+void CSerialBridge::Exit( int nError )
+{
+    std::vector<SESSION *> Sessions;
+
+    {
+        std::lock_guard<std::mutex> Lock( m_Lock );
+        m_nLoopError = nError;
+        Sessions = m_Sessions;
+    }
+
+    // sessions are only destroyed by Stop(), after this thread ended; the owner of a
+    // port may call the bridge from the report
+    for ( size_t i = 0; i < Sessions.size(); i++ )
+    {
+        if ( Sessions[i]->pPort->IsOpen() )
+        {
+            errno = nError;
+            Sessions[i]->pPort->ProcessErrorMessage( "epoll_wait()" );
+        }
+    }
+}
+
+int CSerialBridge::GetLoopError()
+{
+    std::lock_guard<std::mutex> Lock( m_Lock );
+    return m_nLoopError;
+}
+
+CSerialBridge::SESSION *CSerialBridge::NewSession( CSerialPort *pPort, BOOL bTcp, DWORD dwFlags )
+{
+    SESSION *pSession = new SESSION;
+    assert( ( pPort != NULL ) && !pPort->IsOpen() );
+    assert( m_nEpoll >= 0 );
+
+    pSession->pBridge = this;
+    pSession->pPort = pPort;
+    pSession->bTcp = bTcp;
+    pSession->dwFlags = dwFlags;
+    pSession->nListen = -1;
+    pSession->nSocket = -1;
+    pSession->nPipe[0] = -1;
+    pSession->nPipe[1] = -1;
+    pSession->nLocalPort = 0;
+
+    for ( int i = SOURCE_LISTEN; i <= SOURCE_PORT; i++ )
+    {
+        pSession->Tags[i].pSession = pSession;
+        pSession->Tags[i].Source = ( SOURCE )i;
+    }
+
+    pSession->nPipeBytes = 0;
+    pSession->qwPipeSince = 0;
+    pSession->bPortOut = FALSE;
+    memset( &pSession->Peer, 0, sizeof( pSession->Peer ) );
+    pSession->bPeer = FALSE;
+    pSession->bFixedPeer = FALSE;
+    pSession->bPaused = FALSE;
+    pSession->nEvents = 0;
+    pSession->nOffset = 0;
+    pSession->nBacklog = 0;
+    pSession->nTxQueued = 0;
+    pSession->qwToSocket = 0;
+    pSession->qwToPort = 0;
+    pSession->qwSpliced = 0;
+    pSession->qwDropped = 0;
+    pSession->qwConnections = 0;
+
+    return pSession;
+}
+
+int CSerialBridge::Add( SESSION *pSession )
+{
+    struct epoll_event ev;
+
+    memset( &ev, 0, sizeof( ev ) );
+    ev.events = EPOLLIN;
+    ev.data.ptr = &pSession->Tags[pSession->bTcp ? SOURCE_LISTEN : SOURCE_SOCKET];
+
+    // a loop which ended would never serve the session
+    if ( ( GetLoopError() != 0 ) ||
+         ( epoll_ctl( m_nEpoll, EPOLL_CTL_ADD, pSession->bTcp ? pSession->nListen : pSession->nSocket, &ev ) != 0 ) )
+    {
+        Destroy( pSession );
+        return -1;
+    }
+
+    pSession->nEvents = pSession->bTcp ? 0 : ev.events;
+    pSession->pPort->SetRxCallback( OnRx, pSession );
+
+    std::lock_guard<std::mutex> Lock( m_Lock );
+    m_Sessions.push_back( pSession );
+
+    return ( int )m_Sessions.size() - 1;
+}
+
+void CSerialBridge::Destroy( SESSION *pSession )
+{
+    {
+        std::lock_guard<std::mutex> Lock( pSession->Lock );
+        ClearBacklog( pSession );
+    }
+
+    CloseFd( &pSession->nListen );
+    CloseFd( &pSession->nSocket );
+    CloseFd( &pSession->nPipe[0] );
+    CloseFd( &pSession->nPipe[1] );
+    delete pSession;
+}
+
+void CSerialBridge::OnRx( void *pContext, const BYTE *pData, UINT nLength, UINT64 qwTimestamp )
+{
+    SESSION *pSession = ( SESSION * )pContext;
+    std::lock_guard<std::mutex> Lock( pSession->Lock );
+
+    pSession->pBridge->Send( pSession, pData, nLength, qwTimestamp );
+}
+
+void CSerialBridge::OnTxDone( void *pContext, DWORD dwBytesWritten, BOOL bSuccess )
+{
+    SESSION *pSession = ( SESSION * )pContext;
+    std::lock_guard<std::mutex> Lock( pSession->Lock );
+    assert( !pSession->TxRequests.empty() );
+
+    TX_REQUEST Request = pSession->TxRequests.front();
+    pSession->TxRequests.pop_front();
+    pSession->nTxQueued -= Request.nSize;
+    pSession->qwToPort += dwBytesWritten;
+
+    if ( bSuccess )
+    {
+        pSession->ToPort.Record( SerialMetricsNow() - Request.qwReceived );
+    }
+
+    // with half the limit left the socket is read again
+    if ( pSession->bPaused && ( pSession->nTxQueued < SERIAL_BRIDGE_MAX_QUEUED / 2 ) )
+    {
+        pSession->bPaused = FALSE;
+        pSession->pBridge->UpdateEvents( pSession );
+    }
+}
+
+void CSerialBridge::Accept( SESSION *pSession )
+{
+    struct epoll_event ev;
+    int nOn = 1;
+    int nSocket = accept4( pSession->nListen, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC );
+
+    if ( nSocket < 0 )
+    {
+        return;
+    }
+
+    std::lock_guard<std::mutex> Lock( pSession->Lock );
+
+    if ( pSession->nSocket >= 0 )
+    {
+        // one client per port
+        close( nSocket );
+        return;
+    }
+
+    setsockopt( nSocket, IPPROTO_TCP, TCP_NODELAY, &nOn, sizeof( nOn ) );
+    memset( &ev, 0, sizeof( ev ) );
+    // not read before the pipe of a former client is emptied
+    ev.events = pSession->bPaused ? 0 : ( EPOLLIN | EPOLLRDHUP );
+    ev.data.ptr = &pSession->Tags[SOURCE_SOCKET];
+
+    if ( epoll_ctl( m_nEpoll, EPOLL_CTL_ADD, nSocket, &ev ) != 0 )
+    {
+        close( nSocket );
+        return;
+    }
+
+    pSession->nSocket = nSocket;
+    pSession->nEvents = ev.events;
+    pSession->qwConnections++;
+}
+
+void CSerialBridge::Disconnect( SESSION *pSession )
+{
+    std::lock_guard<std::mutex> Lock( pSession->Lock );
+
+    if ( !pSession->bTcp || ( pSession->nSocket < 0 ) )
+    {
+        return;
+    }
+
+    // the pipe and the transmit queue still go to the port, only data for the client is lost
+    epoll_ctl( m_nEpoll, EPOLL_CTL_DEL, pSession->nSocket, NULL );
+    CloseFd( &pSession->nSocket );
+    pSession->nEvents = 0;
+    ClearBacklog( pSession );
+}
+
+void CSerialBridge::ToPort( SESSION *pSession )
+{
+    BOOL bConnected;
+
+    // only this thread changes nSocket
+    if ( pSession->nSocket < 0 )
+    {
+        return;
+    }
+
+    if ( pSession->dwFlags & SERIAL_BRIDGE_SPLICE )
+    {
+        bConnected = ToPortSplice( pSession );
+    }
+    else
+    {
+        bConnected = ToPortCopy( pSession );
+    }
+
+    if ( !bConnected )
+    {
+        Disconnect( pSession );
+    }
+}
+
+BOOL CSerialBridge::ToPortSplice( SESSION *pSession )
+{
+    ssize_t n;
+
+    // what an earlier read left in the pipe goes first
+    if ( ( pSession->nPipeBytes > 0 ) && !FlushPipe( pSession ) )
+    {
+        return TRUE;
+    }
+
+    n = splice( pSession->nSocket, NULL, pSession->nPipe[1], NULL, SERIAL_BRIDGE_PIPE_SIZE, SPLICE_F_MOVE | SPLICE_F_NONBLOCK );
+
+    if ( n == 0 )
+    {
+        return FALSE;
+    }
+
+    if ( n < 0 )
+    {
+        if ( ( errno == EAGAIN ) || ( errno == EINTR ) )
+        {
+            return TRUE;
+        }
+
+        if ( errno == EINVAL )
+        {
+            // the socket cannot be spliced, the session copies from now on
+            pSession->dwFlags &= ~SERIAL_BRIDGE_SPLICE;
+            return ToPortCopy( pSession );
+        }
+
+        return FALSE;
+    }
+
+    {
+        std::lock_guard<std::mutex> Lock( pSession->Lock );
+        pSession->qwPipeSince = ( pSession->nPipeBytes == 0 ) ? SerialMetricsNow() : pSession->qwPipeSince;
+        pSession->nPipeBytes += ( UINT )n;
+    }
+
+    FlushPipe( pSession );
+    return TRUE;
+}
+
+BOOL CSerialBridge::FlushPipe( SESSION *pSession )
+{
+    struct epoll_event ev;
+
+    while ( pSession->nPipeBytes > 0 )
+    {
+        ssize_t n = splice( pSession->nPipe[0], NULL, pSession->pPort->m_hComm, NULL, pSession->nPipeBytes,
+                            SPLICE_F_MOVE | SPLICE_F_NONBLOCK );
+
+        if ( n > 0 )
+        {
+            std::lock_guard<std::mutex> Lock( pSession->Lock );
+            pSession->nPipeBytes -= ( UINT )n;
+            pSession->qwToPort += ( UINT64 )n;
+            pSession->qwSpliced += ( UINT64 )n;
+
+            if ( pSession->nPipeBytes == 0 )
+            {
+                pSession->ToPort.Record( SerialMetricsNow() - pSession->qwPipeSince );
+            }
+
+            continue;
+        }
+
+        if ( ( n < 0 ) && ( errno == EINTR ) )
+        {
+            continue;
+        }
+
+        if ( ( n < 0 ) && ( errno == EAGAIN ) )
+        {
+            // the driver is full, the socket is not read until it took the pipe
+            if ( !pSession->bPortOut )
+            {
+                memset( &ev, 0, sizeof( ev ) );
+                ev.events = EPOLLOUT;
+                ev.data.ptr = &pSession->Tags[SOURCE_PORT];
+                pSession->bPortOut = ( epoll_ctl( m_nEpoll, EPOLL_CTL_ADD, pSession->pPort->m_hComm, &ev ) == 0 );
+            }
+
+            std::lock_guard<std::mutex> Lock( pSession->Lock );
+            pSession->bPaused = TRUE;
+            UpdateEvents( pSession );
+            return FALSE;
+        }
+
+        // the driver takes no splice, the pipe goes through the transmit queue and the session copies from now on
+        pSession->dwFlags &= ~SERIAL_BRIDGE_SPLICE;
+
+        while ( pSession->nPipeBytes > 0 )
+        {
+            SERIAL_BUFFER *pBuffer = pSession->pPort->GetBufferPool()->Alloc( SERIAL_BRIDGE_CHUNK );
+
+            if ( pBuffer == NULL )
+            {
+                break;
+            }
+
+            n = read( pSession->nPipe[0], pBuffer->pData, SERIAL_BRIDGE_CHUNK );
+
+            if ( n <= 0 )
+            {
+                SerialBufferRelease( pBuffer );
+                break;
+            }
+
+            pBuffer->nSize = ( UINT )n;
+            pBuffer->qwTimestamp = pSession->qwPipeSince;
+            QueueToPort( pSession, pBuffer );
+            SerialBufferRelease( pBuffer );
+
+            std::lock_guard<std::mutex> Lock( pSession->Lock );
+            pSession->nPipeBytes -= ( UINT )n;
+        }
+
+        std::lock_guard<std::mutex> Lock( pSession->Lock );
+        // what could not be moved is lost with the pipe
+        pSession->qwDropped += pSession->nPipeBytes;
+        pSession->nPipeBytes = 0;
+        CloseFd( &pSession->nPipe[0] );
+        CloseFd( &pSession->nPipe[1] );
+        break;
+    }
+
+    if ( pSession->bPortOut )
+    {
+        epoll_ctl( m_nEpoll, EPOLL_CTL_DEL, pSession->pPort->m_hComm, NULL );
+        pSession->bPortOut = FALSE;
+    }
+
+    std::lock_guard<std::mutex> Lock( pSession->Lock );
+
+    if ( pSession->bPaused && ( pSession->nTxQueued < SERIAL_BRIDGE_MAX_QUEUED ) )
+    {
+        pSession->bPaused = FALSE;
+        UpdateEvents( pSession );
+    }
+
+    return TRUE;
+}
+
+BOOL CSerialBridge::ToPortCopy( SESSION *pSession )
+{
+    struct sockaddr_in From;
+    socklen_t nFrom = sizeof( From );
+    SERIAL_BUFFER *pBuffer;
+    int nSize = SERIAL_BRIDGE_CHUNK;
+    ssize_t n;
+
+    {
+        std::lock_guard<std::mutex> Lock( pSession->Lock );
+
+        // the transmit queue is behind, OnTxDone() reads on
+        if ( pSession->nTxQueued >= SERIAL_BRIDGE_MAX_QUEUED )
+        {
+            pSession->bPaused = TRUE;
+            UpdateEvents( pSession );
+            return TRUE;
+        }
+    }
+
+    // a datagram in one buffer of its size
+    if ( !pSession->bTcp && ( ( ioctl( pSession->nSocket, FIONREAD, &nSize ) != 0 ) || ( nSize <= 0 ) ) )
+    {
+        nSize = 1;
+    }
+
+    pBuffer = pSession->pPort->GetBufferPool()->Alloc( ( UINT )nSize );
+
+    if ( pBuffer == NULL )
+    {
+        // the pool is at its limit, the socket stays readable
+        return TRUE;
+    }
+
+    n = recvfrom( pSession->nSocket, pBuffer->pData, ( size_t )nSize, 0, ( struct sockaddr * )&From, &nFrom );
+
+    if ( n <= 0 )
+    {
+        SerialBufferRelease( pBuffer );
+
+        if ( !pSession->bTcp )
+        {
+            // an empty datagram, or the error of an earlier one
+            return TRUE;
+        }
+
+        return ( n < 0 ) && ( ( errno == EAGAIN ) || ( errno == EINTR ) );
+    }
+
+    pBuffer->nSize = ( UINT )n;
+    pBuffer->qwTimestamp = SerialMetricsNow();
+
+    if ( !pSession->bTcp && !pSession->bFixedPeer )
+    {
+        std::lock_guard<std::mutex> Lock( pSession->Lock );
+        pSession->Peer = From;
+        pSession->bPeer = TRUE;
+    }
+
+    QueueToPort( pSession, pBuffer );
+    SerialBufferRelease( pBuffer );
+    return TRUE;
+}
+
+void CSerialBridge::QueueToPort( SESSION *pSession, SERIAL_BUFFER *pBuffer )
+{
+    TX_REQUEST Request;
+    std::lock_guard<std::mutex> Lock( pSession->Lock );
+
+    // before the request is queued, OnTxDone() waits for the lock
+    Request.qwReceived = pBuffer->qwTimestamp;
+    Request.nSize = pBuffer->nSize;
+    pSession->TxRequests.push_back( Request );
+    pSession->nTxQueued += Request.nSize;
+
+    if ( !pSession->pPort->WriteBuffer( pBuffer, OnTxDone, pSession, 0 ) )
+    {
+        // the port is closed or its queue full
+        pSession->TxRequests.pop_back();
+        pSession->nTxQueued -= Request.nSize;
+        pSession->qwDropped += Request.nSize;
+    }
+}
+
+void CSerialBridge::Send( SESSION *pSession, const BYTE *pData, UINT nLength, UINT64 qwTimestamp )
+{
+    SERIAL_BUFFER *pBuffer;
+    UINT nSent = 0;
+
+    if ( ( pSession->nSocket < 0 ) || !( pSession->bTcp || pSession->bPeer ) )
+    {
+        pSession->qwDropped += nLength;
+        return;
+    }
+
+    // straight from the receive buffer while nothing waits ahead of the data
+    if ( pSession->Backlog.empty() )
+    {
+        ssize_t n;
+
+        if ( pSession->bTcp )
+        {
+            n = send( pSession->nSocket, pData, nLength, MSG_DONTWAIT | MSG_NOSIGNAL );
+        }
+        else
+        {
+            n = sendto( pSession->nSocket, pData, nLength, MSG_DONTWAIT | MSG_NOSIGNAL,
+                        ( struct sockaddr * )&pSession->Peer, sizeof( pSession->Peer ) );
+        }
+
+        if ( ( n < 0 ) && ( errno != EAGAIN ) && ( errno != EINTR ) )
+        {
+            // a lost TCP client is noticed by the loop
+            pSession->qwDropped += nLength;
+            return;
+        }
+
+        nSent = ( n > 0 ) ? ( UINT )n : 0;
+        pSession->qwToSocket += nSent;
+
+        if ( nSent == nLength )
+        {
+            pSession->ToSocket.Record( SerialMetricsNow() - qwTimestamp );
+            return;
+        }
+    }
+
+    // the rest waits for the socket, a datagram in one buffer
+    if ( pSession->nBacklog + ( nLength - nSent ) > SERIAL_BRIDGE_MAX_BACKLOG )
+    {
+        pSession->qwDropped += nLength - nSent;
+        return;
+    }
+
+    pBuffer = pSession->pPort->GetBufferPool()->Alloc( nLength - nSent );
+
+    if ( pBuffer == NULL )
+    {
+        pSession->qwDropped += nLength - nSent;
+        return;
+    }
+
+    memcpy( pBuffer->pData, pData + nSent, nLength - nSent );
+    pBuffer->nSize = nLength - nSent;
+    pBuffer->qwTimestamp = qwTimestamp;
+    pSession->Backlog.push_back( pBuffer );
+    pSession->nBacklog += pBuffer->nSize;
+    UpdateEvents( pSession );
+}
+
+void CSerialBridge::Flush( SESSION *pSession )
+{
+    while ( !pSession->Backlog.empty() && ( pSession->nSocket >= 0 ) )
+    {
+        SERIAL_BUFFER *pBuffer = pSession->Backlog.front();
+        UINT nLeft = pBuffer->nSize - pSession->nOffset;
+        ssize_t n;
+
+        if ( pSession->bTcp )
+        {
+            n = send( pSession->nSocket, pBuffer->pData + pSession->nOffset, nLeft, MSG_DONTWAIT | MSG_NOSIGNAL );
+        }
+        else
+        {
+            n = sendto( pSession->nSocket, pBuffer->pData, nLeft, MSG_DONTWAIT | MSG_NOSIGNAL,
+                        ( struct sockaddr * )&pSession->Peer, sizeof( pSession->Peer ) );
+        }
+
+        if ( n < 0 )
+        {
+            if ( ( errno == EAGAIN ) || ( errno == EINTR ) || pSession->bTcp )
+            {
+                break;
+            }
+
+            // the datagram is lost, the next one may get through
+            pSession->qwDropped += nLeft;
+            n = 0;
+        }
+        else
+        {
+            pSession->qwToSocket += ( UINT64 )n;
+        }
+
+        pSession->nOffset += ( UINT )n;
+        pSession->nBacklog -= ( UINT )n;
+
+        if ( ( pSession->nOffset == pBuffer->nSize ) || ( n == 0 ) )
+        {
+            if ( n > 0 )
+            {
+                pSession->ToSocket.Record( SerialMetricsNow() - pBuffer->qwTimestamp );
+            }
+            else
+            {
+                pSession->nBacklog -= nLeft;
+            }
+
+            pSession->Backlog.pop_front();
+            pSession->nOffset = 0;
+            SerialBufferRelease( pBuffer );
+        }
+    }
+
+    UpdateEvents( pSession );
+}
+
+void CSerialBridge::ClearBacklog( SESSION *pSession )
+{
+    while ( !pSession->Backlog.empty() )
+    {
+        SerialBufferRelease( pSession->Backlog.front() );
+        pSession->Backlog.pop_front();
+    }
+
+    pSession->qwDropped += pSession->nBacklog;
+    pSession->nBacklog = 0;
+    pSession->nOffset = 0;
+}
+
+void CSerialBridge::UpdateEvents( SESSION *pSession )
+{
+    struct epoll_event ev;
+    UINT nEvents = pSession->bPaused ? 0U : ( UINT )EPOLLIN | ( pSession->bTcp ? ( UINT )EPOLLRDHUP : 0U );
+
+    nEvents |= pSession->Backlog.empty() ? 0U : ( UINT )EPOLLOUT;
+
+    if ( ( pSession->nSocket < 0 ) || ( nEvents == pSession->nEvents ) )
+    {
+        return;
+    }
+
+    memset( &ev, 0, sizeof( ev ) );
+    ev.events = nEvents;
+    ev.data.ptr = &pSession->Tags[SOURCE_SOCKET];
+
+    if ( epoll_ctl( m_nEpoll, EPOLL_CTL_MOD, pSession->nSocket, &ev ) == 0 )
+    {
+        pSession->nEvents = nEvents;
+    }
+}
+
+#endif // SERIAL_PORT_REACTOR
@@ -0,0 +1,182 @@
+/*
+**  FILENAME            SerialBridge.h
+**
+**  PURPOSE             Forwards ports to TCP listeners or UDP peers in both
+**                      directions from one epoll loop. Data of a port goes to the
+**                      socket straight from the receive buffer, data of a TCP
+**                      client is moved to the port with splice() through a pipe
+**                      without passing user space, or received into a pooled
+**                      buffer the transmit queue sends without a further copy.
+**
+**  CREATION DATE       16-10-2026
+**  LAST MODIFICATION   16-10-2026
+*/
+
+#ifndef SERIAL_BRIDGE_H
+#define SERIAL_BRIDGE_H
+
+#include "SerialPort.h"
+
+#ifdef SERIAL_PORT_REACTOR
+
+#include <deque>
+#include <mutex>
+#include <vector>
+#include <netinet/in.h>
+
+#define SERIAL_BRIDGE_CHUNK         4096UL                  /* socket to port, bytes per read without splice */
+#define SERIAL_BRIDGE_PIPE_SIZE     65536                   /* socket to port, bytes per splice */
+#define SERIAL_BRIDGE_MAX_QUEUED    65536UL                 /* socket to port, the socket is not read while more wait */
+#define SERIAL_BRIDGE_MAX_BACKLOG   1048576UL               /* port to socket, held for a slow client, then dropped */
+#define SERIAL_BRIDGE_MAX_EVENTS    64
+
+#define SERIAL_BRIDGE_SPLICE        0x0001                  /* TCP to port by splice(), the session is the port's only writer */
+
+typedef struct _SERIAL_BRIDGE_STATS
+{
+    UINT64              qwToSocket;             // bytes from the port the socket took
+    UINT64              qwToPort;               // bytes from the socket the driver took
+    UINT64              qwSpliced;              // of qwToPort, never in user space
+    UINT64              qwDropped;              // from the port without a client or above SERIAL_BRIDGE_MAX_BACKLOG
+    UINT64              qwConnections;          // TCP clients accepted
+    UINT                nSocketBacklog;         // from the port, not taken by the socket yet
+    UINT                nPortBacklog;           // from the socket, not taken by the driver yet
+    BOOL                bConnected;             // a TCP client, or a UDP peer known
+    SERIAL_HISTOGRAM    ToSocket;               // read from the port until the socket took it
+    SERIAL_HISTOGRAM    ToPort;                 // read from the socket until the driver took it
+} SERIAL_BRIDGE_STATS;
+
+/*
+** Sessions are added after Start() and before their port is opened, the bridge
+** takes over the receive callback of the port. Close the ports before Stop().
+*/
+class CSerialBridge
+{
+    public:
+        CSerialBridge();
+        ~CSerialBridge();
+
+        BOOL                Start();
+        void                Stop();
+
+        /*
+        ** One TCP client at a time, another is refused while it is connected. nPort 0
+        ** picks a free one, see GetLocalPort(). Returns the session, -1 on failure.
+        */
+        int                 ListenTcp( CSerialPort *pPort, const char *pszAddress, WORD nPort,
+                                       DWORD dwFlags = SERIAL_BRIDGE_SPLICE );
+        /*
+        ** Datagrams from anyone are written to the port, each in one piece; received
+        ** data goes to the peer, without one to the sender of the last datagram.
+        */
+        int                 ConnectUdp( CSerialPort *pPort, const char *pszAddress, WORD nPort,
+                                        const char *pszPeer = NULL, WORD nPeerPort = 0 );
+
+        WORD              GetLocalPort( int nSession );
+        UINT                GetSessionCount();
+        void                GetStats( int nSession, SERIAL_BRIDGE_STATS *pStats, BOOL bReset = FALSE );
+        // errno of the failure which ended the loop, 0 while it runs; also queued to the open ports
+        int                 GetLoopError();
+
+    private:
+        enum SOURCE
+        {
+            SOURCE_LISTEN,
+            SOURCE_SOCKET,
+            SOURCE_PORT                             // the descriptor of the port, while a splice waits for room
+        };
+
+        struct _SESSION;
+        typedef struct _SESSION SESSION;
+
+        typedef struct _TX_REQUEST
+        {
+            UINT64              qwReceived;
+            UINT                nSize;
+        } TX_REQUEST;
+
+        typedef struct _TAG
+        {
+            SESSION             *pSession;
+            SOURCE              Source;
+        } TAG;
+
+        struct _SESSION
+        {
+            CSerialBridge       *pBridge;
+            CSerialPort         *pPort;
+            BOOL                bTcp;
+            DWORD               dwFlags;
+            int                 nListen;
+            int                 nSocket;            // the TCP client or the UDP socket, -1 for none
+            int                 nPipe[2];           // splice, -1 without
+            WORD              nLocalPort;
+            TAG                 Tags[3];            // epoll data of the SOURCEs
+
+            // loop thread only
+            UINT                nPipeBytes;
+            UINT64              qwPipeSince;        // the oldest byte in the pipe came in
+            BOOL                bPortOut;           // the port descriptor is in the epoll set
+
+            std::mutex          Lock;               // the rest, also taken on the I/O thread of the port
+            struct sockaddr_in  Peer;
+            BOOL                bPeer;
+            BOOL                bFixedPeer;         // given to ConnectUdp(), not the last sender
+            BOOL                bPaused;            // the socket is not read, the port is behind
+            UINT                nEvents;            // of nSocket in the epoll set
+            std::deque<SERIAL_BUFFER *> Backlog;    // to the socket, nSize - nOffset bytes left in the first
+            UINT                nOffset;
+            UINT                nBacklog;
+            std::deque<TX_REQUEST> TxRequests;      // in the transmit queue of the port, completed in order
+            UINT                nTxQueued;
+            UINT64              qwToSocket;
+            UINT64              qwToPort;
+            UINT64              qwSpliced;
+            UINT64              qwDropped;
+            UINT64              qwConnections;
+            CSerialHistogram    ToSocket;
+            CSerialHistogram    ToPort;
+        };
+
+        CSerialBridge( const CSerialBridge & );
+        CSerialBridge       &operator=( const CSerialBridge & );
+
+        static void         *LoopThread( void *pParam );
+        void                Run();
+        void                Exit( int nError );
+        SESSION             *NewSession( CSerialPort *pPort, BOOL bTcp, DWORD dwFlags );
+        int                 Add( SESSION *pSession );
+        void                Destroy( SESSION *pSession );
+
+        // the I/O thread of the port
+        static void         OnRx( void *pContext, const BYTE *pData, UINT nLength, UINT64 qwTimestamp );
+        static void         OnTxDone( void *pContext, DWORD dwBytesWritten, BOOL bSuccess );
+
+        // loop thread
+        void                Accept( SESSION *pSession );
+        void                Disconnect( SESSION *pSession );
+        void                ToPort( SESSION *pSession );
+        BOOL                ToPortSplice( SESSION *pSession );
+        BOOL                ToPortCopy( SESSION *pSession );
+        BOOL                FlushPipe( SESSION *pSession );
+        void                QueueToPort( SESSION *pSession, SERIAL_BUFFER *pBuffer );
+
+        // with the lock of the session held
+        void                Send( SESSION *pSession, const BYTE *pData, UINT nLength, UINT64 qwTimestamp );
+        void                Flush( SESSION *pSession );
+        void                ClearBacklog( SESSION *pSession );
+        void                UpdateEvents( SESSION *pSession );
+
+        int                 m_nEpoll;
+        int                 m_nEvent;               // eventfd, ends the loop
+        pthread_t           m_Thread;
+        BOOL                m_bThreadStarted;
+        volatile BOOL       m_bStop;
+        std::mutex          m_Lock;
+        int                 m_nLoopError;           // with m_Lock
+        std::vector<SESSION *> m_Sessions;
+};
+
+#endif // SERIAL_PORT_REACTOR
+
+#endif // SERIAL_BRIDGE_H
@@ -0,0 +1,416 @@
+/*
+**  FILENAME            SerialBroadcast.cpp
+**
+**  PURPOSE             Hands the received stream of one port to several consumers
+**                      at once, each behind its own cursor in one shared ring.
+**
+**  CREATION DATE       16-10-2026
+**  LAST MODIFICATION   16-10-2026
+*/
+
+#ifdef _WIN32
+#include "stdafx.h"
+#endif
+#include "SerialBroadcast.h"
+#include <assert.h>
+#include <string.h>
+#include <chrono>
+
+static void UpdateMax( std::atomic<UINT> &Max, UINT nValue )
+{
+    UINT nMax = Max.load( std::memory_order_relaxed );
+
+    while ( ( nValue > nMax ) && !Max.compare_exchange_weak( nMax, nValue, std::memory_order_relaxed ) )
+    {
+    }
+}
+
+CSerialBroadcast::CSerialBroadcast( UINT nSize )
+{
+    UINT nCapacity = 1;
+
+    while ( ( nCapacity < nSize ) && ( nCapacity < 0x80000000U ) )
+    {
+        nCapacity <<= 1;
+    }
+
+    m_pRing = new BYTE[nCapacity];
+    m_nSize = nCapacity;
+    m_nMask = nCapacity - 1;
+    m_qwHead = 0;
+    m_qwClaim = 0;
+    m_qwStamps = 0;
+    m_qwLimit = 0;
+    m_nWaiters = 0;
+    m_bProducerWaiting = FALSE;
+    m_bClosed = FALSE;
+
+    for ( UINT i = 0; i < SERIAL_BROADCAST_STAMPS; i++ )
+    {
+        m_Stamps[i].qwEnd = 0;
+        m_Stamps[i].qwTimestamp = 0;
+    }
+
+    for ( UINT i = 0; i < SERIAL_BROADCAST_SUBSCRIBERS; i++ )
+    {
+        m_Subscribers[i].qwCursor = 0;
+        m_Subscribers[i].nState = STATE_FREE;
+        m_Subscribers[i].Overflow = SERIAL_BROADCAST_BLOCK;
+        m_Subscribers[i].qwStamp = 0;
+        m_Subscribers[i].qwRead = 0;
+        m_Subscribers[i].qwDropped = 0;
+        m_Subscribers[i].qwBlockedNs = 0;
+        m_Subscribers[i].nMaxLag = 0;
+    }
+}
+
+CSerialBroadcast::~CSerialBroadcast()
+{
+    delete [] m_pRing;
+}
+
+void CSerialBroadcast::Attach( CSerialPort *pPort )
+{
+    pPort->SetRxCallback( OnRx, this );
+}
+
+void CSerialBroadcast::OnRx( void *pContext, const BYTE *pData, UINT nLength, UINT64 qwTimestamp )
+{
+    ( ( CSerialBroadcast * )pContext )->Publish( pData, nLength, qwTimestamp );
+}
+
+void CSerialBroadcast::Publish( const BYTE *pData, UINT nLength, UINT64 qwTimestamp )
+{
+    UINT64 qwHead = m_qwHead.load( std::memory_order_relaxed );
+
+    while ( ( nLength > 0 ) && !m_bClosed.load( std::memory_order_relaxed ) )
+    {
+        // the subscribers are only looked at when the room known so far is used up
+        if ( qwHead >= m_qwLimit )
+        {
+            m_qwLimit = Gate();
+
+            if ( qwHead >= m_qwLimit )
+            {
+                break;
+            }
+        }
+
+        UINT nChunk = ( m_qwLimit - qwHead < nLength ) ? ( UINT )( m_qwLimit - qwHead ) : nLength;
+        UINT nOffset = ( UINT )qwHead & m_nMask;
+        UINT nFirst = ( m_nSize - nOffset < nChunk ) ? m_nSize - nOffset : nChunk;
+
+        // announced before the oldest data is overwritten, a reader holding it sees the claim
+        m_qwClaim.store( qwHead + nChunk, std::memory_order_relaxed );
+        std::atomic_thread_fence( std::memory_order_release );
+        memcpy( m_pRing + nOffset, pData, nFirst );
+        memcpy( m_pRing, pData + nFirst, nChunk - nFirst );
+
+        qwHead += nChunk;
+        m_qwHead.store( qwHead );
+
+        UINT64 qwStamp = m_qwStamps.load( std::memory_order_relaxed );
+        STAMP &Stamp = m_Stamps[qwStamp % SERIAL_BROADCAST_STAMPS];
+        Stamp.qwEnd.store( qwHead, std::memory_order_relaxed );
+        Stamp.qwTimestamp.store( qwTimestamp, std::memory_order_relaxed );
+        m_qwStamps.store( qwStamp + 1, std::memory_order_release );
+
+        pData += nChunk;
+        nLength -= nChunk;
+    }
+
+    // the waiter counts itself before it looks at the head, no wakeup is lost
+    if ( m_nWaiters.load() > 0 )
+    {
+        std::lock_guard<std::mutex> Lock( m_Lock );
+        m_cvData.notify_all();
+    }
+}
+
+UINT64 CSerialBroadcast::Gate()
+{
+    UINT64 qwHead = m_qwHead.load( std::memory_order_relaxed );
+
+    for ( ;; )
+    {
+        UINT64 qwLimit = qwHead + m_nSize;
+        SUBSCRIBER *pFull = NULL;
+
+        for ( UINT i = 0; i < SERIAL_BROADCAST_SUBSCRIBERS; i++ )
+        {
+            SUBSCRIBER &Subscriber = m_Subscribers[i];
+
+            if ( ( Subscriber.nState.load( std::memory_order_acquire ) != STATE_ACTIVE ) ||
+                 ( Subscriber.Overflow == SERIAL_BROADCAST_DROP_OLDEST ) )
+            {
+                continue;
+            }
+
+            UINT64 qwEnd = Subscriber.qwCursor.load( std::memory_order_acquire ) + m_nSize;
+
+            if ( qwEnd > qwHead )
+            {
+                qwLimit = ( qwEnd < qwLimit ) ? qwEnd : qwLimit;
+            }
+            else if ( Subscriber.Overflow == SERIAL_BROADCAST_DETACH )
+            {
+                int nActive = STATE_ACTIVE;
+
+                if ( Subscriber.nState.compare_exchange_strong( nActive, STATE_DETACHED ) )
+                {
+                    std::lock_guard<std::mutex> Lock( m_Lock );
+                    m_cvData.notify_all();
+                }
+            }
+            else if ( pFull == NULL )
+            {
+                pFull = &Subscriber;
+            }
+        }
+
+        if ( ( pFull == NULL ) || m_bClosed )
+        {
+            return ( pFull == NULL ) ? qwLimit : qwHead;
+        }
+
+        // a blocking subscriber is a whole ring behind, Consume() wakes the producer
+        UINT64 qwStart = SerialMetricsNow();
+        {
+            std::unique_lock<std::mutex> Lock( m_Lock );
+            m_bProducerWaiting = TRUE;
+
+            if ( ( pFull->qwCursor.load() + m_nSize <= qwHead ) &&
+                 ( pFull->nState.load() == STATE_ACTIVE ) && !m_bClosed )
+            {
+                m_cvSpace.wait_for( Lock, std::chrono::milliseconds( 10 ) );
+            }
+
+            m_bProducerWaiting = FALSE;
+        }
+        pFull->qwBlockedNs.fetch_add( SerialMetricsNow() - qwStart, std::memory_order_relaxed );
+    }
+}
+
+void CSerialBroadcast::WakeProducer()
+{
+    std::lock_guard<std::mutex> Lock( m_Lock );
+    m_cvSpace.notify_all();
+}
+
+void CSerialBroadcast::Close()
+{
+    std::lock_guard<std::mutex> Lock( m_Lock );
+    m_bClosed = TRUE;
+    m_cvData.notify_all();
+    m_cvSpace.notify_all();
+}
+
+int CSerialBroadcast::Subscribe( SERIAL_BROADCAST_OVERFLOW Overflow )
+{
+    SERIAL_HISTOGRAM Discard;
+    std::lock_guard<std::mutex> Lock( m_Lock );
+
+    for ( UINT i = 0; i < SERIAL_BROADCAST_SUBSCRIBERS; i++ )
+    {
+        SUBSCRIBER &Subscriber = m_Subscribers[i];
+
+        if ( Subscriber.nState.load() != STATE_FREE )
+        {
+            continue;
+        }
+
+        // at the published end, the producer never has more room than a ring ahead of it
+        Subscriber.qwCursor.store( m_qwHead.load() );
+        Subscriber.Overflow = Overflow;
+        Subscriber.qwStamp = m_qwStamps.load();
+        Subscriber.qwRead = 0;
+        Subscriber.qwDropped = 0;
+        Subscriber.qwBlockedNs = 0;
+        Subscriber.nMaxLag = 0;
+        Subscriber.Age.Snapshot( &Discard, TRUE );
+        Subscriber.nState.store( STATE_ACTIVE, std::memory_order_release );
+        return ( int )i;
+    }
+
+    return -1;
+}
+
+void CSerialBroadcast::Unsubscribe( int nSubscriber )
+{
+    assert( ( nSubscriber >= 0 ) && ( nSubscriber < SERIAL_BROADCAST_SUBSCRIBERS ) );
+    std::lock_guard<std::mutex> Lock( m_Lock );
+    m_Subscribers[nSubscriber].nState.store( STATE_FREE );
+    m_cvSpace.notify_all();
+}
+
+UINT CSerialBroadcast::Peek( int nSubscriber, const BYTE **ppData, UINT64 *pqwPosition )
+{
+    SUBSCRIBER &Subscriber = m_Subscribers[nSubscriber];
+    UINT64 qwCursor = Subscriber.qwCursor.load( std::memory_order_relaxed );
+    UINT64 qwHead = m_qwHead.load( std::memory_order_acquire );
+
+    if ( Subscriber.nState.load( std::memory_order_acquire ) != STATE_ACTIVE )
+    {
+        return 0;
+    }
+
+    if ( Subscriber.Overflow == SERIAL_BROADCAST_DROP_OLDEST )
+    {
+        // what the producer has overwritten or is about to is skipped
+        UINT64 qwClaim = m_qwClaim.load( std::memory_order_acquire );
+
+        if ( qwClaim > qwCursor + m_nSize )
+        {
+            Subscriber.qwDropped.fetch_add( qwClaim - m_nSize - qwCursor, std::memory_order_relaxed );
+            qwCursor = qwClaim - m_nSize;
+            Subscriber.qwCursor.store( qwCursor );
+        }
+    }
+
+    if ( qwCursor >= qwHead )
+    {
+        return 0;
+    }
+
+    UINT nOffset = ( UINT )qwCursor & m_nMask;
+    UINT nSpan = ( qwHead - qwCursor < m_nSize - nOffset ) ? ( UINT )( qwHead - qwCursor ) : m_nSize - nOffset;
+
+    *ppData = m_pRing + nOffset;
+
+    if ( pqwPosition != NULL )
+    {
+        *pqwPosition = qwCursor;
+    }
+
+    return nSpan;
+}
+
+BOOL CSerialBroadcast::Consume( int nSubscriber, UINT nSize )
+{
+    SUBSCRIBER &Subscriber = m_Subscribers[nSubscriber];
+    UINT64 qwCursor = Subscriber.qwCursor.load( std::memory_order_relaxed );
+
+    // read after the data, the span was intact unless the producer claimed its first byte
+    std::atomic_thread_fence( std::memory_order_acquire );
+    BOOL bIntact = ( m_qwClaim.load( std::memory_order_relaxed ) <= qwCursor + m_nSize );
+    UINT64 qwHead = m_qwHead.load( std::memory_order_relaxed );
+
+    UpdateMax( Subscriber.nMaxLag, ( qwHead - qwCursor < m_nSize ) ? ( UINT )( qwHead - qwCursor ) : m_nSize );
+
+    if ( bIntact )
+    {
+        RecordAge( &Subscriber, qwCursor );
+        Subscriber.qwRead.fetch_add( nSize, std::memory_order_relaxed );
+    }
+    else
+    {
+        Subscriber.qwDropped.fetch_add( nSize, std::memory_order_relaxed );
+    }
+
+    Subscriber.qwCursor.store( qwCursor + nSize );
+
+    if ( m_bProducerWaiting.load() )
+    {
+        WakeProducer();
+    }
+
+    return bIntact;
+}
+
+void CSerialBroadcast::RecordAge( SUBSCRIBER *pSubscriber, UINT64 qwCursor )
+{
+    UINT64 qwCount = m_qwStamps.load( std::memory_order_acquire );
+
+    // a stamp is rewritten SERIAL_BROADCAST_STAMPS publishes later, older ones are gone
+    if ( pSubscriber->qwStamp + SERIAL_BROADCAST_STAMPS <= qwCount )
+    {
+        pSubscriber->qwStamp = qwCount - SERIAL_BROADCAST_STAMPS + 1;
+    }
+
+    while ( pSubscriber->qwStamp < qwCount )
+    {
+        STAMP &Stamp = m_Stamps[pSubscriber->qwStamp % SERIAL_BROADCAST_STAMPS];
+        UINT64 qwEnd = Stamp.qwEnd.load( std::memory_order_relaxed );
+        UINT64 qwTimestamp = Stamp.qwTimestamp.load( std::memory_order_relaxed );
+
+        std::atomic_thread_fence( std::memory_order_acquire );
+
+        if ( m_qwStamps.load( std::memory_order_relaxed ) >= pSubscriber->qwStamp + SERIAL_BROADCAST_STAMPS )
+        {
+            return;
+        }
+
+        // the first publish which ends after the cursor holds its byte
+        if ( qwEnd > qwCursor )
+        {
+            UINT64 qwNow = SerialMetricsNow();
+            pSubscriber->Age.Record( ( qwNow > qwTimestamp ) ? qwNow - qwTimestamp : 0 );
+            return;
+        }
+
+        pSubscriber->qwStamp++;
+    }
+}
+
+BOOL CSerialBroadcast::Wait( int nSubscriber, DWORD dwTimeout )
+{
+    SUBSCRIBER &Subscriber = m_Subscribers[nSubscriber];
+    auto Ready = [this, &Subscriber]()
+    {
+        return ( Subscriber.nState.load() != STATE_ACTIVE ) || m_bClosed.load() ||
+               ( m_qwHead.load() > Subscriber.qwCursor.load( std::memory_order_relaxed ) );
+    };
+
+    if ( !Ready() )
+    {
+        std::unique_lock<std::mutex> Lock( m_Lock );
+        m_nWaiters++;
+
+        if ( dwTimeout == INFINITE )
+        {
+            m_cvData.wait( Lock, Ready );
+        }
+        else
+        {
+            m_cvData.wait_for( Lock, std::chrono::milliseconds( dwTimeout ), Ready );
+        }
+
+        m_nWaiters--;
+    }
+
+    return ( Subscriber.nState.load() == STATE_ACTIVE ) &&
+           ( m_qwHead.load() > Subscriber.qwCursor.load( std::memory_order_relaxed ) );
+}
+
+BOOL CSerialBroadcast::IsDetached( int nSubscriber )
+{
+    return m_Subscribers[nSubscriber].nState.load() == STATE_DETACHED;
+}
+
+void CSerialBroadcast::GetStats( int nSubscriber, SERIAL_BROADCAST_STATS *pStats, BOOL bReset )
+{
+    SUBSCRIBER &Subscriber = m_Subscribers[nSubscriber];
+    UINT64 qwHead = m_qwHead.load();
+    UINT64 qwCursor = Subscriber.qwCursor.load();
+
+    pStats->qwPublished = qwHead;
+    pStats->nLag = ( qwHead <= qwCursor ) ? 0 : ( qwHead - qwCursor < m_nSize ) ? ( UINT )( qwHead - qwCursor ) : m_nSize;
+    pStats->bDetached = ( Subscriber.nState.load() == STATE_DETACHED );
+
+    if ( bReset )
+    {
+        pStats->qwRead = Subscriber.qwRead.exchange( 0, std::memory_order_relaxed );
+        pStats->qwDropped = Subscriber.qwDropped.exchange( 0, std::memory_order_relaxed );
+        pStats->qwBlockedNs = Subscriber.qwBlockedNs.exchange( 0, std::memory_order_relaxed );
+        pStats->nMaxLag = Subscriber.nMaxLag.exchange( 0, std::memory_order_relaxed );
+    }
+    else
+    {
+        pStats->qwRead = Subscriber.qwRead.load( std::memory_order_relaxed );
+        pStats->qwDropped = Subscriber.qwDropped.load( std::memory_order_relaxed );
+        pStats->qwBlockedNs = Subscriber.qwBlockedNs.load( std::memory_order_relaxed );
+        pStats->nMaxLag = Subscriber.nMaxLag.load( std::memory_order_relaxed );
+    }
+
+    Subscriber.Age.Snapshot( &pStats->Age, bReset );
+}
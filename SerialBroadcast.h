@@ -0,0 +1,140 @@
+/*
+**  FILENAME            SerialBroadcast.h
+**
+**  PURPOSE             Hands the received stream of one port to several consumers
+**                      at once, a decoder, a logger, a monitor, ... The data is
+**                      copied once into a shared ring, every subscriber reads it
+**                      in place behind its own cursor and has its own policy for
+**                      falling a whole ring behind: hold the producer, lose the
+**                      oldest data or be detached.
+**
+**  CREATION DATE       16-10-2026
+**  LAST MODIFICATION   16-10-2026
+*/
+
+#ifndef SERIAL_BROADCAST_H
+#define SERIAL_BROADCAST_H
+
+#include "SerialPort.h"
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+
+#define SERIAL_BROADCAST_SIZE       ( 1UL << 20 )           /* default ring, rounded up to a power of two */
+#define SERIAL_BROADCAST_SUBSCRIBERS 16
+#define SERIAL_BROADCAST_STAMPS     1024                    /* timestamps of the latest publishes, for the age */
+
+typedef enum _SERIAL_BROADCAST_OVERFLOW
+{
+    SERIAL_BROADCAST_BLOCK,                     // the producer waits for room, the port stops reading
+    SERIAL_BROADCAST_DROP_OLDEST,               // the producer never waits, the subscriber skips what was overwritten
+    SERIAL_BROADCAST_DETACH                     // the producer never waits, the subscriber is cut off
+} SERIAL_BROADCAST_OVERFLOW;
+
+typedef struct _SERIAL_BROADCAST_STATS
+{
+    UINT64              qwPublished;            // bytes into the ring, of the broadcast
+    UINT64              qwRead;                 // bytes consumed intact
+    UINT64              qwDropped;              // overwritten before or while they were read
+    UINT64              qwBlockedNs;            // the producer waited for this subscriber
+    UINT                nLag;                   // published, not consumed yet
+    UINT                nMaxLag;
+    BOOL                bDetached;
+    SERIAL_HISTOGRAM    Age;                    // publish until consumed, per Consume() of its oldest byte
+} SERIAL_BROADCAST_STATS;
+
+/*
+** One producer, Publish() or the I/O thread of the attached port. Each subscriber is
+** read by one thread at a time; subscribers come and go while data flows, a new one
+** starts at the current end of the stream.
+*/
+class CSerialBroadcast
+{
+    public:
+        CSerialBroadcast( UINT nSize = SERIAL_BROADCAST_SIZE );
+        ~CSerialBroadcast();
+
+        /*
+        ** Takes over the receive callback of the port, call before Open(). With a
+        ** blocking subscriber behind, the I/O thread of the port waits as well; do
+        ** not block the loop of a reactor.
+        */
+        void                Attach( CSerialPort *pPort );
+        void                Publish( const BYTE *pData, UINT nLength, UINT64 qwTimestamp );
+        // wakes every waiter and a waiting producer, the rest of the data can be read
+        void                Close();
+
+        int                 Subscribe( SERIAL_BROADCAST_OVERFLOW Overflow );   // -1 when all are taken
+        void                Unsubscribe( int nSubscriber );
+
+        /*
+        ** The contiguous data at the cursor of the subscriber, in the shared ring; 0 when
+        ** there is none or the subscriber was detached. *pqwPosition is the offset of the
+        ** first byte in the stream.
+        */
+        UINT                Peek( int nSubscriber, const BYTE **ppData, UINT64 *pqwPosition = NULL );
+        /*
+        ** Moves the cursor. FALSE when the producer overwrote the span while it was held,
+        ** with SERIAL_BROADCAST_DROP_OLDEST or after a detach: the data read is not valid.
+        */
+        BOOL                Consume( int nSubscriber, UINT nSize );
+        // until there is data; FALSE after the timeout, a detach, or Close() with nothing left
+        BOOL                Wait( int nSubscriber, DWORD dwTimeout = INFINITE );
+        BOOL                IsDetached( int nSubscriber );
+
+        void                GetStats( int nSubscriber, SERIAL_BROADCAST_STATS *pStats, BOOL bReset = FALSE );
+
+    private:
+        enum STATE
+        {
+            STATE_FREE,
+            STATE_ACTIVE,
+            STATE_DETACHED
+        };
+
+        struct STAMP
+        {
+            std::atomic<UINT64> qwEnd;              // stream offset after the publish
+            std::atomic<UINT64> qwTimestamp;
+        };
+
+        // a cache line each, the cursor is written by its consumer only
+        struct alignas( 64 ) SUBSCRIBER
+        {
+            std::atomic<UINT64> qwCursor;
+            std::atomic<int>    nState;
+            SERIAL_BROADCAST_OVERFLOW Overflow;
+            UINT64              qwStamp;            // consumer, the first stamp not behind the cursor
+            std::atomic<UINT64> qwRead;
+            std::atomic<UINT64> qwDropped;
+            std::atomic<UINT64> qwBlockedNs;
+            std::atomic<UINT>   nMaxLag;
+            CSerialHistogram    Age;
+        };
+
+        CSerialBroadcast( const CSerialBroadcast & );
+        CSerialBroadcast    &operator=( const CSerialBroadcast & );
+
+        static void         OnRx( void *pContext, const BYTE *pData, UINT nLength, UINT64 qwTimestamp );
+        UINT64              Gate();                 // producer, the end of the room the subscribers leave
+        void                WakeProducer();
+        void                RecordAge( SUBSCRIBER *pSubscriber, UINT64 qwCursor );
+
+        BYTE                *m_pRing;
+        UINT                m_nSize;
+        UINT                m_nMask;
+        STAMP               m_Stamps[SERIAL_BROADCAST_STAMPS];
+        alignas( 64 ) std::atomic<UINT64> m_qwHead;     // published
+        std::atomic<UINT64> m_qwClaim;                  // being written, ahead of m_qwHead during a copy
+        std::atomic<UINT64> m_qwStamps;
+        UINT64              m_qwLimit;                  // producer, room known without looking at the cursors
+        alignas( 64 ) std::atomic<int> m_nWaiters;
+        std::atomic<int>    m_bProducerWaiting;
+        std::atomic<int>    m_bClosed;
+        std::mutex          m_Lock;
+        std::condition_variable m_cvData;
+        std::condition_variable m_cvSpace;
+        SUBSCRIBER          m_Subscribers[SERIAL_BROADCAST_SUBSCRIBERS];
+};
+
+#endif // SERIAL_BROADCAST_H
@@ -0,0 +1,252 @@
+/*
+**  FILENAME            SerialBufferPool.cpp
+**
+**  PURPOSE             Reference counted buffers out of preallocated slabs.
+**
+**  CREATION DATE       16-10-2026
+**  LAST MODIFICATION   16-10-2026
+*/
+
+#ifdef _WIN32
+#include "stdafx.h"
+#endif
+#include "SerialBufferPool.h"
+#include "SerialThread.h"
+#include <assert.h>
+#include <new>
+
+#define BUFFER_ALIGN                64                      /* headers and data start on a cache line */
+#define BUFFER_HEADER_SIZE          ( ( sizeof( SERIAL_BUFFER ) + BUFFER_ALIGN - 1 ) & ~( size_t )( BUFFER_ALIGN - 1 ) )
+
+static UINT ClassCapacity( UINT nClass )
+{
+    return 1U << ( SERIAL_BUFFER_MIN_SHIFT + 2 * nClass );
+}
+
+static UINT ClassOf( UINT nSize )
+{
+    UINT nClass = 0;
+
+    while ( ClassCapacity( nClass ) < nSize )
+    {
+        nClass++;
+    }
+
+    return nClass;
+}
+
+void SerialBufferAddRef( SERIAL_BUFFER *pBuffer )
+{
+    pBuffer->nRefs.fetch_add( 1, std::memory_order_relaxed );
+}
+
+void SerialBufferRelease( SERIAL_BUFFER *pBuffer )
+{
+    // whatever the other owners wrote has to be visible before the buffer is reused
+    if ( pBuffer->nRefs.fetch_sub( 1, std::memory_order_acq_rel ) == 1 )
+    {
+        pBuffer->pPool->Free( pBuffer );
+    }
+}
+
+CSerialBufferPool::CSerialBufferPool( UINT64 qwMaxBytes )
+{
+    for ( UINT i = 0; i < SERIAL_BUFFER_CLASSES; i++ )
+    {
+        m_Classes[i].pFree = NULL;
+        m_Classes[i].nBuffers = 0;
+        m_Classes[i].nInUse = 0;
+        m_Classes[i].nPeakInUse = 0;
+        m_Classes[i].qwAllocs = 0;
+        m_Classes[i].qwExhausted = 0;
+        m_Classes[i].qwFailed = 0;
+    }
+
+    m_qwSlabBytes = 0;
+    m_qwMaxBytes = qwMaxBytes;
+    m_bLocked = FALSE;
+    m_qwOversize = 0;
+}
+
+CSerialBufferPool::~CSerialBufferPool()
+{
+    for ( size_t i = 0; i < m_Slabs.size(); i++ )
+    {
+        if ( m_bLocked )
+        {
+            SerialUnlockMemory( m_Slabs[i], m_SlabSizes[i] );
+        }
+
+        delete [] m_Slabs[i];
+    }
+}
+
+SERIAL_BUFFER *CSerialBufferPool::Alloc( UINT nSize )
+{
+    SERIAL_BUFFER *pBuffer;
+
+    if ( nSize > SERIAL_BUFFER_MAX_SIZE )
+    {
+        m_qwOversize.fetch_add( 1, std::memory_order_relaxed );
+        return NULL;
+    }
+
+    CLASS &Class = m_Classes[ClassOf( nSize )];
+    std::lock_guard<std::mutex> Lock( Class.Lock );
+
+    if ( Class.pFree == NULL )
+    {
+        Class.qwExhausted++;
+
+        if ( !Grow( ClassOf( nSize ) ) )
+        {
+            Class.qwFailed++;
+            return NULL;
+        }
+    }
+
+    pBuffer = Class.pFree;
+    Class.pFree = pBuffer->pNext;
+    Class.qwAllocs++;
+    Class.nInUse++;
+    Class.nPeakInUse = ( Class.nInUse > Class.nPeakInUse ) ? Class.nInUse : Class.nPeakInUse;
+
+    pBuffer->nSize = nSize;
+    pBuffer->qwTimestamp = 0;
+    pBuffer->pNext = NULL;
+    pBuffer->nRefs.store( 1, std::memory_order_relaxed );
+    return pBuffer;
+}
+
+BOOL CSerialBufferPool::Reserve( UINT nSize, UINT nCount )
+{
+    if ( nSize > SERIAL_BUFFER_MAX_SIZE )
+    {
+        return FALSE;
+    }
+
+    CLASS &Class = m_Classes[ClassOf( nSize )];
+    std::lock_guard<std::mutex> Lock( Class.Lock );
+
+    while ( Class.nBuffers - Class.nInUse < nCount )
+    {
+        if ( !Grow( ClassOf( nSize ) ) )
+        {
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+void CSerialBufferPool::GetStats( SERIAL_BUFFER_POOL_STATS *pStats )
+{
+    for ( UINT i = 0; i < SERIAL_BUFFER_CLASSES; i++ )
+    {
+        CLASS &Class = m_Classes[i];
+        std::lock_guard<std::mutex> Lock( Class.Lock );
+        pStats->Classes[i].nCapacity = ClassCapacity( i );
+        pStats->Classes[i].nBuffers = Class.nBuffers;
+        pStats->Classes[i].nInUse = Class.nInUse;
+        pStats->Classes[i].nPeakInUse = Class.nPeakInUse;
+        pStats->Classes[i].qwAllocs = Class.qwAllocs;
+        pStats->Classes[i].qwExhausted = Class.qwExhausted;
+        pStats->Classes[i].qwFailed = Class.qwFailed;
+    }
+
+    std::lock_guard<std::mutex> Lock( m_SlabLock );
+    pStats->qwSlabs = m_Slabs.size();
+    pStats->qwSlabBytes = m_qwSlabBytes;
+    pStats->qwOversize = m_qwOversize.load( std::memory_order_relaxed );
+}
+
+BOOL CSerialBufferPool::LockMemory()
+{
+    std::lock_guard<std::mutex> Lock( m_SlabLock );
+
+    if ( m_bLocked )
+    {
+        return TRUE;
+    }
+
+    for ( size_t i = 0; i < m_Slabs.size(); i++ )
+    {
+        if ( !SerialLockMemory( m_Slabs[i], m_SlabSizes[i] ) )
+        {
+            while ( i-- > 0 )
+            {
+                SerialUnlockMemory( m_Slabs[i], m_SlabSizes[i] );
+            }
+
+            return FALSE;
+        }
+    }
+
+    m_bLocked = TRUE;
+    return TRUE;
+}
+
+BOOL CSerialBufferPool::Grow( UINT nClass )
+{
+    UINT nCapacity = ClassCapacity( nClass );
+    UINT nCount = ( nCapacity < SERIAL_BUFFER_SLAB_SIZE ) ? ( UINT )( SERIAL_BUFFER_SLAB_SIZE / nCapacity ) : 1;
+    size_t nStride = BUFFER_HEADER_SIZE + nCapacity;
+    size_t nBytes = nCount * nStride + BUFFER_ALIGN - 1;
+    CLASS &Class = m_Classes[nClass];
+    BYTE *pSlab;
+
+    {
+        std::lock_guard<std::mutex> Lock( m_SlabLock );
+
+        if ( ( m_qwMaxBytes != 0 ) && ( m_qwSlabBytes + nBytes > m_qwMaxBytes ) )
+        {
+            return FALSE;
+        }
+
+        pSlab = new ( std::nothrow ) BYTE[nBytes];
+
+        if ( pSlab == NULL )
+        {
+            return FALSE;
+        }
+
+        if ( m_bLocked && !SerialLockMemory( pSlab, nBytes ) )
+        {
+            delete [] pSlab;
+            return FALSE;
+        }
+
+        m_Slabs.push_back( pSlab );
+        m_SlabSizes.push_back( nBytes );
+        m_qwSlabBytes += nBytes;
+    }
+
+    BYTE *p = ( BYTE * )( ( ( size_t )pSlab + BUFFER_ALIGN - 1 ) & ~( size_t )( BUFFER_ALIGN - 1 ) );
+
+    for ( UINT i = 0; i < nCount; i++, p += nStride )
+    {
+        SERIAL_BUFFER *pBuffer = new ( p ) SERIAL_BUFFER;
+        pBuffer->pData = p + BUFFER_HEADER_SIZE;
+        pBuffer->nSize = 0;
+        pBuffer->nCapacity = nCapacity;
+        pBuffer->qwTimestamp = 0;
+        pBuffer->nRefs.store( 0, std::memory_order_relaxed );
+        pBuffer->nClass = nClass;
+        pBuffer->pPool = this;
+        pBuffer->pNext = Class.pFree;
+        Class.pFree = pBuffer;
+    }
+
+    Class.nBuffers += nCount;
+    return TRUE;
+}
+
+void CSerialBufferPool::Free( SERIAL_BUFFER *pBuffer )
+{
+    CLASS &Class = m_Classes[pBuffer->nClass];
+    std::lock_guard<std::mutex> Lock( Class.Lock );
+    assert( Class.nInUse > 0 );
+    pBuffer->pNext = Class.pFree;
+    Class.pFree = pBuffer;
+    Class.nInUse--;
+}
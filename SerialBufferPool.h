@@ -0,0 +1,117 @@
+/*
+**  FILENAME            SerialBufferPool.h
+**
+**  PURPOSE             Reference counted buffers out of preallocated slabs, in size
+**                      classes from 64 bytes to 64 KB. The ports use them for queued
+**                      transmit data, received chunks and decoded frames, so a
+**                      consumer can keep one past its callback without a copy and
+**                      the steady state never touches the heap.
+**
+**  CREATION DATE       16-10-2026
+**  LAST MODIFICATION   16-10-2026
+*/
+
+#ifndef SERIAL_BUFFER_POOL_H
+#define SERIAL_BUFFER_POOL_H
+
+#ifndef _WIN32
+#include "SerialPortPosix.h"
+#endif
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+#define SERIAL_BUFFER_MIN_SHIFT     6                       /* 64 bytes, each class four times the previous */
+#define SERIAL_BUFFER_CLASSES       6
+#define SERIAL_BUFFER_MAX_SIZE      ( 1UL << ( SERIAL_BUFFER_MIN_SHIFT + 2 * ( SERIAL_BUFFER_CLASSES - 1 ) ) )
+#define SERIAL_BUFFER_SLAB_SIZE     65536UL                 /* data bytes added to a class at once, one buffer at least */
+
+class CSerialBufferPool;
+
+typedef struct _SERIAL_BUFFER
+{
+    BYTE                *pData;                 // nCapacity bytes
+    UINT                nSize;                  // bytes in use, set by whoever fills it
+    UINT                nCapacity;
+    UINT64              qwTimestamp;            // SerialMetricsNow() of the read or frame on the receive side
+    std::atomic<UINT>   nRefs;
+    UINT                nClass;
+    CSerialBufferPool   *pPool;
+    struct _SERIAL_BUFFER *pNext;               // free list of the class
+} SERIAL_BUFFER;
+
+typedef struct _SERIAL_BUFFER_CLASS_STATS
+{
+    UINT                nCapacity;
+    UINT                nBuffers;               // in the slabs of the class
+    UINT                nInUse;
+    UINT                nPeakInUse;
+    UINT64              qwAllocs;
+    UINT64              qwExhausted;            // the free list was empty, a slab was added
+    UINT64              qwFailed;               // empty and the pool at its limit, Alloc() returned NULL
+} SERIAL_BUFFER_CLASS_STATS;
+
+typedef struct _SERIAL_BUFFER_POOL_STATS
+{
+    SERIAL_BUFFER_CLASS_STATS Classes[SERIAL_BUFFER_CLASSES];
+    UINT64              qwSlabs;                // heap allocations made by the pool
+    UINT64              qwSlabBytes;
+    UINT64              qwOversize;             // requests above SERIAL_BUFFER_MAX_SIZE
+} SERIAL_BUFFER_POOL_STATS;
+
+// any thread; the last release returns the buffer to its pool
+void        SerialBufferAddRef( SERIAL_BUFFER *pBuffer );
+void        SerialBufferRelease( SERIAL_BUFFER *pBuffer );
+
+/*
+** One free list per size class, each behind its own short lock. A class grows by a
+** slab when its list is empty, until the pool holds nMaxBytes (0 is no limit). The
+** pool has to outlive every buffer taken from it.
+*/
+class CSerialBufferPool
+{
+    public:
+        CSerialBufferPool( UINT64 qwMaxBytes = 0 );
+        ~CSerialBufferPool();
+
+        // one reference, nSize is set; NULL above SERIAL_BUFFER_MAX_SIZE or the limit
+        SERIAL_BUFFER       *Alloc( UINT nSize );
+        // makes nCount buffers of nSize ready, e.g. before a latency sensitive run
+        BOOL                Reserve( UINT nSize, UINT nCount );
+        void                GetStats( SERIAL_BUFFER_POOL_STATS *pStats );
+        // the slabs so far and every later one stay resident
+        BOOL                LockMemory();
+
+    private:
+        // a cache line each, the classes are locked by different threads
+        struct alignas( 64 ) CLASS
+        {
+            std::mutex          Lock;
+            SERIAL_BUFFER       *pFree;
+            UINT                nBuffers;
+            UINT                nInUse;
+            UINT                nPeakInUse;
+            UINT64              qwAllocs;
+            UINT64              qwExhausted;
+            UINT64              qwFailed;
+        };
+
+        friend void         SerialBufferRelease( SERIAL_BUFFER *pBuffer );
+
+        CSerialBufferPool( const CSerialBufferPool & );
+        CSerialBufferPool   &operator=( const CSerialBufferPool & );
+
+        BOOL                Grow( UINT nClass );    // with the lock of the class
+        void                Free( SERIAL_BUFFER *pBuffer );
+
+        CLASS               m_Classes[SERIAL_BUFFER_CLASSES];
+        std::mutex          m_SlabLock;
+        std::vector<BYTE *> m_Slabs;
+        std::vector<size_t> m_SlabSizes;
+        UINT64              m_qwSlabBytes;
+        UINT64              m_qwMaxBytes;
+        BOOL                m_bLocked;
+        std::atomic<UINT64> m_qwOversize;
+};
+
+#endif // SERIAL_BUFFER_POOL_H
@@ -0,0 +1,630 @@
+/*
+**  FILENAME            SerialCapture.cpp
+**
+**  PURPOSE             Memory-mapped capture log of the port traffic and its replay.
+**
+**  CREATION DATE       16-10-2026
+**  LAST MODIFICATION   16-10-2026
+*/
+
+#ifdef _WIN32
+#include "stdafx.h"
+#endif
+#include "SerialCapture.h"
+#include "SerialMetrics.h"
+#include <stdio.h>
+#include <string.h>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+#include <chrono>
+#include <thread>
+
+static inline UINT64 RecordSize( UINT nLength )
+{
+    return sizeof( SERIAL_CAPTURE_RECORD ) + ( ( ( UINT64 )nLength + SERIAL_CAPTURE_ALIGN - 1 ) & ~( UINT64 )( SERIAL_CAPTURE_ALIGN - 1 ) );
+}
+
+static std::string SegmentPath( const std::string &strPath, UINT nSegment )
+{
+    char szSuffix[16];
+    snprintf( szSuffix, sizeof( szSuffix ), ".%04u", nSegment );
+    return strPath + szSuffix;
+}
+
+static void CommitRecord( BYTE *pRecord, UINT nPort, BYTE nType, UINT64 qwTimestamp, UINT nLength )
+{
+    SERIAL_CAPTURE_RECORD *pHeader = ( SERIAL_CAPTURE_RECORD * )pRecord;
+
+    pHeader->qwTimestamp = qwTimestamp;
+    pHeader->wPort = ( UINT16 )nPort;
+    pHeader->nType = nType;
+    pHeader->nReserved = 0;
+
+    // a reader of a live or crashed log stops at a zero length, so it goes in last
+    std::atomic_thread_fence( std::memory_order_release );
+    pHeader->nLength = nLength;
+}
+
+CSerialCapture::CSerialCapture()
+{
+    m_bOpen = FALSE;
+    m_qwSegmentSize = SERIAL_CAPTURE_SEGMENT_SIZE;
+    m_nSegment = 0;
+    m_pBase = NULL;
+    m_qwUsed = 0;
+#ifdef _WIN32
+    m_hFile = INVALID_HANDLE_VALUE;
+    m_hMapping = NULL;
+#else
+    m_nFile = -1;
+#endif
+    m_qwRecords = 0;
+    m_qwBytes = 0;
+    m_qwSegments = 0;
+    m_qwDropped = 0;
+}
+
+CSerialCapture::~CSerialCapture()
+{
+    Close();
+}
+
+BOOL CSerialCapture::Open( const char *szPath, UINT64 qwSegmentSize )
+{
+    std::lock_guard<std::mutex> Lock( m_Lock );
+
+    if ( m_bOpen )
+    {
+        return FALSE;
+    }
+
+    m_strPath = szPath;
+    m_qwSegmentSize = ( qwSegmentSize < 65536 ) ? 65536 : qwSegmentSize;
+    m_nSegment = 0;
+    m_qwRecords = 0;
+    m_qwBytes = 0;
+    m_qwSegments = 0;
+    m_qwDropped = 0;
+
+    if ( !StartSegment() )
+    {
+        return FALSE;
+    }
+
+    m_bOpen = TRUE;
+    return TRUE;
+}
+
+void CSerialCapture::Close()
+{
+    std::lock_guard<std::mutex> Lock( m_Lock );
+
+    if ( m_pBase != NULL )
+    {
+        FinishSegment();
+    }
+
+    m_bOpen = FALSE;
+}
+
+BOOL CSerialCapture::IsOpen()
+{
+    std::lock_guard<std::mutex> Lock( m_Lock );
+    return m_bOpen;
+}
+
+void CSerialCapture::GetStats( SERIAL_CAPTURE_STATS *pStats )
+{
+    pStats->qwRecords = m_qwRecords.load( std::memory_order_relaxed );
+    pStats->qwBytes = m_qwBytes.load( std::memory_order_relaxed );
+    pStats->qwSegments = m_qwSegments.load( std::memory_order_relaxed );
+    pStats->qwDropped = m_qwDropped.load( std::memory_order_relaxed );
+}
+
+BOOL CSerialCapture::StartSegment()
+{
+    std::string strFile = SegmentPath( m_strPath, m_nSegment );
+    SERIAL_CAPTURE_HEADER *pHeader;
+
+#ifdef _WIN32
+    m_hFile = CreateFileA( strFile.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL );
+
+    if ( m_hFile == INVALID_HANDLE_VALUE )
+    {
+        return FALSE;
+    }
+
+    // the mapping extends the file to the full segment
+    m_hMapping = CreateFileMapping( m_hFile, NULL, PAGE_READWRITE, ( DWORD )( m_qwSegmentSize >> 32 ), ( DWORD )m_qwSegmentSize, NULL );
+    m_pBase = ( m_hMapping != NULL ) ? ( BYTE * )MapViewOfFile( m_hMapping, FILE_MAP_WRITE, 0, 0, ( SIZE_T )m_qwSegmentSize ) : NULL;
+
+    if ( m_pBase == NULL )
+    {
+        if ( m_hMapping != NULL )
+        {
+            CloseHandle( m_hMapping );
+            m_hMapping = NULL;
+        }
+
+        CloseHandle( m_hFile );
+        m_hFile = INVALID_HANDLE_VALUE;
+        return FALSE;
+    }
+#else
+    void *pMapping;
+    int nFlags = MAP_SHARED;
+
+    m_nFile = open( strFile.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644 );
+
+    if ( m_nFile < 0 )
+    {
+        return FALSE;
+    }
+
+    // allocated up front, a full disk fails here and not with SIGBUS on a store into the mapping
+#ifdef __linux__
+    if ( posix_fallocate( m_nFile, 0, ( off_t )m_qwSegmentSize ) != 0 )
+#endif
+    {
+        if ( ftruncate( m_nFile, ( off_t )m_qwSegmentSize ) != 0 )
+        {
+            close( m_nFile );
+            m_nFile = -1;
+            return FALSE;
+        }
+    }
+
+#ifdef MAP_POPULATE
+    // the page faults are taken here, once per segment, rather than by the records
+    nFlags |= MAP_POPULATE;
+#endif
+    pMapping = mmap( NULL, ( size_t )m_qwSegmentSize, PROT_READ | PROT_WRITE, nFlags, m_nFile, 0 );
+
+    if ( pMapping == MAP_FAILED )
+    {
+        close( m_nFile );
+        m_nFile = -1;
+        return FALSE;
+    }
+
+    m_pBase = ( BYTE * )pMapping;
+#endif
+
+    pHeader = ( SERIAL_CAPTURE_HEADER * )m_pBase;
+    memcpy( pHeader->szMagic, SERIAL_CAPTURE_MAGIC, sizeof( pHeader->szMagic ) );
+    pHeader->dwHeaderSize = sizeof( SERIAL_CAPTURE_HEADER );
+    pHeader->dwSegment = m_nSegment;
+    pHeader->qwReserved = 0;
+    m_qwUsed = sizeof( SERIAL_CAPTURE_HEADER );
+    m_qwSegments++;
+    return TRUE;
+}
+
+void CSerialCapture::FinishSegment()
+{
+#ifdef _WIN32
+    LARGE_INTEGER liSize;
+
+    UnmapViewOfFile( m_pBase );
+    CloseHandle( m_hMapping );
+    liSize.QuadPart = ( LONGLONG )m_qwUsed;
+
+    if ( SetFilePointerEx( m_hFile, liSize, NULL, FILE_BEGIN ) )
+    {
+        SetEndOfFile( m_hFile );
+    }
+
+    CloseHandle( m_hFile );
+    m_hMapping = NULL;
+    m_hFile = INVALID_HANDLE_VALUE;
+#else
+    munmap( m_pBase, ( size_t )m_qwSegmentSize );
+    ( void )ftruncate( m_nFile, ( off_t )m_qwUsed );
+    close( m_nFile );
+    m_nFile = -1;
+#endif
+    m_pBase = NULL;
+    m_nSegment++;
+}
+
+BYTE *CSerialCapture::Reserve( UINT nLength )
+{
+    UINT64 qwSize = RecordSize( nLength );
+    BYTE *pRecord;
+
+    if ( !m_bOpen || ( sizeof( SERIAL_CAPTURE_HEADER ) + qwSize > m_qwSegmentSize ) )
+    {
+        return NULL;
+    }
+
+    if ( ( m_pBase == NULL ) || ( m_qwUsed + qwSize > m_qwSegmentSize ) )
+    {
+        if ( m_pBase != NULL )
+        {
+            FinishSegment();
+        }
+
+        if ( !StartSegment() )
+        {
+            return NULL;
+        }
+    }
+
+    pRecord = m_pBase + m_qwUsed;
+    m_qwUsed += qwSize;
+    return pRecord;
+}
+
+void CSerialCapture::Record( UINT nPort, BYTE nType, UINT64 qwTimestamp, const BYTE *pData, UINT nLength )
+{
+    std::lock_guard<std::mutex> Lock( m_Lock );
+    BYTE *pRecord;
+
+    if ( nLength == 0 )
+    {
+        return;
+    }
+
+    if ( ( pRecord = Reserve( nLength ) ) == NULL )
+    {
+        m_qwDropped.fetch_add( 1, std::memory_order_relaxed );
+        return;
+    }
+
+    memcpy( pRecord + sizeof( SERIAL_CAPTURE_RECORD ), pData, nLength );
+    CommitRecord( pRecord, nPort, nType, qwTimestamp, nLength );
+    m_qwRecords.fetch_add( 1, std::memory_order_relaxed );
+    m_qwBytes.fetch_add( nLength, std::memory_order_relaxed );
+}
+
+void CSerialCapture::Record( UINT nPort, BYTE nType, UINT64 qwTimestamp, const SERIAL_TX_SPAN *pSpans, UINT nSpans, UINT nLength )
+{
+    std::lock_guard<std::mutex> Lock( m_Lock );
+    BYTE *pRecord;
+    UINT nDone = 0;
+
+    if ( nLength == 0 )
+    {
+        return;
+    }
+
+    if ( ( pRecord = Reserve( nLength ) ) == NULL )
+    {
+        m_qwDropped.fetch_add( 1, std::memory_order_relaxed );
+        return;
+    }
+
+    for ( UINT i = 0; ( i < nSpans ) && ( nDone < nLength ); i++ )
+    {
+        UINT nTake = ( pSpans[i].nSize < nLength - nDone ) ? pSpans[i].nSize : nLength - nDone;
+        memcpy( pRecord + sizeof( SERIAL_CAPTURE_RECORD ) + nDone, pSpans[i].pData, nTake );
+        nDone += nTake;
+    }
+
+    CommitRecord( pRecord, nPort, nType, qwTimestamp, nDone );
+    m_qwRecords.fetch_add( 1, std::memory_order_relaxed );
+    m_qwBytes.fetch_add( nDone, std::memory_order_relaxed );
+}
+
+CSerialReplay::CSerialReplay()
+{
+    m_nSegment = 0;
+    m_pBase = NULL;
+    m_qwSize = 0;
+    m_qwOffset = 0;
+    m_bDamaged = FALSE;
+#ifdef _WIN32
+    m_hFile = INVALID_HANDLE_VALUE;
+    m_hMapping = NULL;
+#else
+    m_nFile = -1;
+#endif
+    m_pfnCallback = NULL;
+    m_pContext = NULL;
+    m_pFramer = NULL;
+    m_nPort = SERIAL_CAPTURE_ANY_PORT;
+    m_nType = SERIAL_CAPTURE_RX;
+}
+
+CSerialReplay::~CSerialReplay()
+{
+    Close();
+}
+
+BOOL CSerialReplay::Open( const char *szPath )
+{
+    Close();
+    m_strPath = szPath;
+    m_bDamaged = FALSE;
+    return MapSegment( 0 );
+}
+
+void CSerialReplay::Close()
+{
+    UnmapSegment();
+}
+
+void CSerialReplay::Rewind()
+{
+    UnmapSegment();
+    m_bDamaged = FALSE;
+    MapSegment( 0 );
+}
+
+BOOL CSerialReplay::IsDamaged()
+{
+    return m_bDamaged;
+}
+
+void CSerialReplay::SetCallback( SERIAL_REPLAY_CALLBACK pfnCallback, void *pContext )
+{
+    m_pfnCallback = pfnCallback;
+    m_pContext = pContext;
+}
+
+void CSerialReplay::SetFramer( CSerialFramer *pFramer )
+{
+    m_pFramer = pFramer;
+}
+
+void CSerialReplay::SetFilter( UINT nPort, BYTE nType )
+{
+    m_nPort = nPort;
+    m_nType = nType;
+}
+
+BOOL CSerialReplay::MapSegment( UINT nSegment )
+{
+    std::string strFile = SegmentPath( m_strPath, nSegment );
+    const SERIAL_CAPTURE_HEADER *pHeader;
+
+    m_nSegment = nSegment;
+
+#ifdef _WIN32
+    LARGE_INTEGER liSize;
+
+    // shared for writing too, a capture still being recorded can be read
+    m_hFile = CreateFileA( strFile.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL );
+
+    if ( m_hFile == INVALID_HANDLE_VALUE )
+    {
+        return FALSE;
+    }
+
+    if ( !GetFileSizeEx( m_hFile, &liSize ) || ( liSize.QuadPart < ( LONGLONG )sizeof( SERIAL_CAPTURE_HEADER ) ) )
+    {
+        CloseHandle( m_hFile );
+        m_hFile = INVALID_HANDLE_VALUE;
+        m_bDamaged = TRUE;
+        return FALSE;
+    }
+
+    m_qwSize = ( UINT64 )liSize.QuadPart;
+    m_hMapping = CreateFileMapping( m_hFile, NULL, PAGE_READONLY, 0, 0, NULL );
+    m_pBase = ( m_hMapping != NULL ) ? ( const BYTE * )MapViewOfFile( m_hMapping, FILE_MAP_READ, 0, 0, 0 ) : NULL;
+
+    if ( m_pBase == NULL )
+    {
+        UnmapSegment();
+        m_bDamaged = TRUE;
+        return FALSE;
+    }
+#else
+    struct stat st;
+    void *pMapping;
+
+    m_nFile = open( strFile.c_str(), O_RDONLY | O_CLOEXEC );
+
+    if ( m_nFile < 0 )
+    {
+        return FALSE;
+    }
+
+    if ( ( fstat( m_nFile, &st ) != 0 ) || ( st.st_size < ( off_t )sizeof( SERIAL_CAPTURE_HEADER ) ) )
+    {
+        UnmapSegment();
+        m_bDamaged = TRUE;
+        return FALSE;
+    }
+
+    m_qwSize = ( UINT64 )st.st_size;
+    pMapping = mmap( NULL, ( size_t )m_qwSize, PROT_READ, MAP_SHARED, m_nFile, 0 );
+
+    if ( pMapping == MAP_FAILED )
+    {
+        UnmapSegment();
+        m_bDamaged = TRUE;
+        return FALSE;
+    }
+
+    // read once front to back, the kernel reads ahead and drops what was played
+    madvise( pMapping, ( size_t )m_qwSize, MADV_SEQUENTIAL );
+    m_pBase = ( const BYTE * )pMapping;
+#endif
+
+    pHeader = ( const SERIAL_CAPTURE_HEADER * )m_pBase;
+
+    if ( ( memcmp( pHeader->szMagic, SERIAL_CAPTURE_MAGIC, sizeof( pHeader->szMagic ) ) != 0 ) ||
+         ( pHeader->dwHeaderSize < sizeof( SERIAL_CAPTURE_HEADER ) ) || ( pHeader->dwHeaderSize > m_qwSize ) )
+    {
+        UnmapSegment();
+        m_bDamaged = TRUE;
+        return FALSE;
+    }
+
+    m_qwOffset = pHeader->dwHeaderSize;
+    return TRUE;
+}
+
+void CSerialReplay::UnmapSegment()
+{
+#ifdef _WIN32
+    if ( m_pBase != NULL )
+    {
+        UnmapViewOfFile( m_pBase );
+    }
+
+    if ( m_hMapping != NULL )
+    {
+        CloseHandle( m_hMapping );
+    }
+
+    if ( m_hFile != INVALID_HANDLE_VALUE )
+    {
+        CloseHandle( m_hFile );
+    }
+
+    m_hMapping = NULL;
+    m_hFile = INVALID_HANDLE_VALUE;
+#else
+    if ( m_pBase != NULL )
+    {
+        munmap( ( void * )m_pBase, ( size_t )m_qwSize );
+    }
+
+    if ( m_nFile >= 0 )
+    {
+        close( m_nFile );
+    }
+
+    m_nFile = -1;
+#endif
+    m_pBase = NULL;
+    m_qwSize = 0;
+    m_qwOffset = 0;
+}
+
+BOOL CSerialReplay::Next( SERIAL_CAPTURE_RECORD *pRecord, const BYTE **ppData )
+{
+    while ( m_pBase != NULL )
+    {
+        if ( m_qwOffset + sizeof( SERIAL_CAPTURE_RECORD ) <= m_qwSize )
+        {
+            const SERIAL_CAPTURE_RECORD *pHeader = ( const SERIAL_CAPTURE_RECORD * )( m_pBase + m_qwOffset );
+
+            if ( pHeader->nLength != 0 )
+            {
+                if ( m_qwOffset + sizeof( SERIAL_CAPTURE_RECORD ) + pHeader->nLength > m_qwSize )
+                {
+                    m_bDamaged = TRUE;
+                    return FALSE;
+                }
+
+                *pRecord = *pHeader;
+                *ppData = m_pBase + m_qwOffset + sizeof( SERIAL_CAPTURE_RECORD );
+                m_qwOffset += RecordSize( pHeader->nLength );
+                return TRUE;
+            }
+        }
+
+        // the end of this segment, the log goes on in the next file if there is one
+        UINT nNext = m_nSegment + 1;
+        UnmapSegment();
+        MapSegment( nNext );
+    }
+
+    return FALSE;
+}
+
+// sleeps until the recorded time qwTimestamp, played from qwFirst on at qwStart
+static void WaitUntil( UINT64 qwStart, UINT64 qwFirst, UINT64 qwTimestamp, double dSpeed )
+{
+    UINT64 qwTarget = qwStart + ( UINT64 )( ( double )( qwTimestamp - qwFirst ) / dSpeed );
+    UINT64 qwNow = SerialMetricsNow();
+
+    if ( qwTarget > qwNow )
+    {
+        std::this_thread::sleep_for( std::chrono::nanoseconds( qwTarget - qwNow ) );
+    }
+}
+
+UINT64 CSerialReplay::Play( BOOL bOriginalTiming, double dSpeed )
+{
+    SERIAL_CAPTURE_RECORD Record;
+    const BYTE *pData;
+    UINT64 qwStart = SerialMetricsNow();
+    UINT64 qwFirst = 0;
+    UINT64 qwBytes = 0;
+    UINT64 qwDeadline;
+    BOOL bStarted = FALSE;
+
+    dSpeed = ( dSpeed > 0.0 ) ? dSpeed : 1.0;
+
+    while ( Next( &Record, &pData ) )
+    {
+        if ( ( m_nPort != SERIAL_CAPTURE_ANY_PORT ) && ( Record.wPort != m_nPort ) )
+        {
+            continue;
+        }
+
+        if ( Record.nType == SERIAL_CAPTURE_LINE )
+        {
+            if ( ( m_pFramer != NULL ) && ( Record.nLength >= sizeof( UINT64 ) ) )
+            {
+                UINT64 qwCharTime;
+                memcpy( &qwCharTime, pData, sizeof( qwCharTime ) );
+                m_pFramer->SetCharacterTime( qwCharTime );
+            }
+
+            continue;
+        }
+
+        if ( Record.nType != m_nType )
+        {
+            continue;
+        }
+
+        if ( !bStarted )
+        {
+            qwFirst = Record.qwTimestamp;
+            bStarted = TRUE;
+        }
+
+        // the silence the I/O thread waited for before the first byte of this record came
+        // in, at line rate before the read which returned it
+        if ( ( m_pFramer != NULL ) && ( ( qwDeadline = m_pFramer->GetDeadline() ) != 0 ) &&
+             ( qwDeadline + ( UINT64 )( Record.nLength - 1 ) * m_pFramer->GetCharacterTime() <= Record.qwTimestamp ) )
+        {
+            if ( bOriginalTiming )
+            {
+                WaitUntil( qwStart, qwFirst, qwDeadline, dSpeed );
+            }
+
+            m_pFramer->OnIdle( qwDeadline );
+        }
+
+        if ( bOriginalTiming )
+        {
+            WaitUntil( qwStart, qwFirst, Record.qwTimestamp, dSpeed );
+        }
+
+        if ( m_pfnCallback != NULL )
+        {
+            m_pfnCallback( m_pContext, pData, Record.nLength, Record.qwTimestamp );
+        }
+
+        if ( m_pFramer != NULL )
+        {
+            m_pFramer->Feed( pData, Record.nLength, Record.qwTimestamp );
+        }
+
+        qwBytes += Record.nLength;
+    }
+
+    // the line went quiet after the last record
+    if ( ( m_pFramer != NULL ) && ( ( qwDeadline = m_pFramer->GetDeadline() ) != 0 ) )
+    {
+        if ( bOriginalTiming && bStarted )
+        {
+            WaitUntil( qwStart, qwFirst, qwDeadline, dSpeed );
+        }
+
+        m_pFramer->OnIdle( qwDeadline );
+    }
+
+    return qwBytes;
+}
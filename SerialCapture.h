@@ -0,0 +1,180 @@
+/*
+**  FILENAME            SerialCapture.h
+**
+**  PURPOSE             Records what crossed one or more ports into a binary log and
+**                      plays it back. The log is a series of preallocated segment
+**                      files, each mapped into memory while it is written, so a
+**                      record is a copy into the mapping: no system call and no
+**                      allocation on the I/O threads until a segment is full.
+**
+**                      Segment file:  SERIAL_CAPTURE_HEADER, then records of a
+**                      SERIAL_CAPTURE_RECORD and nLength payload bytes, each padded
+**                      to 8 bytes. A record with nLength 0 (the zero filled rest of
+**                      a segment) or the end of the file ends the segment.
+**
+**  CREATION DATE       16-10-2026
+**  LAST MODIFICATION   16-10-2026
+*/
+
+#ifndef SERIAL_CAPTURE_H
+#define SERIAL_CAPTURE_H
+
+#ifndef _WIN32
+#include "SerialPortPosix.h"
+#endif
+#include "SerialFramer.h"
+#include "SerialTxQueue.h"
+#include <atomic>
+#include <mutex>
+#include <string>
+
+#define SERIAL_CAPTURE_SEGMENT_SIZE ( 64ULL << 20 )         /* default segment size, path.0000, path.0001, ... */
+#define SERIAL_CAPTURE_MAGIC        "SERCAP1"
+#define SERIAL_CAPTURE_ALIGN        8UL
+
+#define SERIAL_CAPTURE_RX           1                       /* bytes read from the port */
+#define SERIAL_CAPTURE_TX           2                       /* bytes the driver took */
+#define SERIAL_CAPTURE_LINE         3                       /* payload: UINT64 character time in ns, after each DCB change */
+
+#define SERIAL_CAPTURE_ANY_PORT     0xFFFFU
+
+typedef struct _SERIAL_CAPTURE_HEADER
+{
+    char                szMagic[8];             // SERIAL_CAPTURE_MAGIC
+    UINT32              dwHeaderSize;
+    UINT32              dwSegment;              // 0, 1, ... in the order written
+    UINT64              qwReserved;
+} SERIAL_CAPTURE_HEADER;
+
+typedef struct _SERIAL_CAPTURE_RECORD
+{
+    UINT64              qwTimestamp;            // SerialMetricsNow() of the read or write
+    UINT32              nLength;                // payload bytes, written last
+    UINT16              wPort;                  // the id given to CSerialPort::SetCapture()
+    BYTE                nType;                  // SERIAL_CAPTURE_RX, _TX or _LINE
+    BYTE                nReserved;
+} SERIAL_CAPTURE_RECORD;
+
+typedef struct _SERIAL_CAPTURE_STATS
+{
+    UINT64              qwRecords;
+    UINT64              qwBytes;                // payload bytes recorded
+    UINT64              qwSegments;             // segment files started
+    UINT64              qwDropped;              // records lost, no segment could be mapped
+} SERIAL_CAPTURE_STATS;
+
+/*
+** Any number of ports and threads may record into one capture, a short lock
+** orders the records. Starting the next segment (open, preallocate, map) is
+** the only part which enters the kernel, once per segment size.
+*/
+class CSerialCapture
+{
+    public:
+        CSerialCapture();
+        ~CSerialCapture();
+
+        BOOL                Open( const char *szPath, UINT64 qwSegmentSize = SERIAL_CAPTURE_SEGMENT_SIZE );
+        void                Close();                // trims the last segment to its records
+        BOOL                IsOpen();
+
+        void                Record( UINT nPort, BYTE nType, UINT64 qwTimestamp, const BYTE *pData, UINT nLength );
+        // the first nLength bytes of a gathered write
+        void                Record( UINT nPort, BYTE nType, UINT64 qwTimestamp, const SERIAL_TX_SPAN *pSpans, UINT nSpans, UINT nLength );
+
+        void                GetStats( SERIAL_CAPTURE_STATS *pStats );
+
+    private:
+        CSerialCapture( const CSerialCapture & );
+        CSerialCapture      &operator=( const CSerialCapture & );
+
+        BYTE                *Reserve( UINT nLength );
+        BOOL                StartSegment();
+        void                FinishSegment();
+
+        std::mutex          m_Lock;
+        std::string         m_strPath;
+        BOOL                m_bOpen;
+        UINT64              m_qwSegmentSize;
+        UINT                m_nSegment;
+        BYTE                *m_pBase;               // mapping of the current segment, NULL between two
+        UINT64              m_qwUsed;
+#ifdef _WIN32
+        HANDLE              m_hFile;
+        HANDLE              m_hMapping;
+#else
+        int                 m_nFile;
+#endif
+        std::atomic<UINT64> m_qwRecords;
+        std::atomic<UINT64> m_qwBytes;
+        std::atomic<UINT64> m_qwSegments;
+        std::atomic<UINT64> m_qwDropped;
+};
+
+/*
+** Called with each replayed record which passes the filter. The signature is
+** that of SERIAL_RX_STAMPED_CALLBACK, so the consumer of a port takes a replay
+** as it is.
+*/
+typedef void ( *SERIAL_REPLAY_CALLBACK )( void *pContext, const BYTE *pData, UINT nLength, UINT64 qwTimestamp );
+
+/*
+** Reads a capture segment by segment, one mapping at a time, and feeds the
+** records to a callback and/or a framer. Framers see the recorded timestamps
+** and character times either way, so a decoder which acts on silence splits
+** the same frames at full speed as it did on the line.
+*/
+class CSerialReplay
+{
+    public:
+        CSerialReplay();
+        ~CSerialReplay();
+
+        BOOL                Open( const char *szPath );
+        void                Close();
+        void                Rewind();
+
+        // the next record of any port and type, its data is valid until the next call
+        BOOL                Next( SERIAL_CAPTURE_RECORD *pRecord, const BYTE **ppData );
+        // TRUE when Next() stopped at a damaged record rather than the end of the log
+        BOOL                IsDamaged();
+
+        void                SetCallback( SERIAL_REPLAY_CALLBACK pfnCallback, void *pContext );
+        void                SetFramer( CSerialFramer *pFramer );
+        // default: the received data of every port
+        void                SetFilter( UINT nPort, BYTE nType = SERIAL_CAPTURE_RX );
+
+        /*
+        ** Plays from the current position to the end, sleeping to the recorded
+        ** timing (scaled by dSpeed) or as fast as possible with bOriginalTiming
+        ** FALSE. Returns the payload bytes delivered.
+        */
+        UINT64              Play( BOOL bOriginalTiming = FALSE, double dSpeed = 1.0 );
+
+    private:
+        CSerialReplay( const CSerialReplay & );
+        CSerialReplay       &operator=( const CSerialReplay & );
+
+        BOOL                MapSegment( UINT nSegment );
+        void                UnmapSegment();
+
+        std::string         m_strPath;
+        UINT                m_nSegment;
+        const BYTE          *m_pBase;
+        UINT64              m_qwSize;
+        UINT64              m_qwOffset;
+        BOOL                m_bDamaged;
+#ifdef _WIN32
+        HANDLE              m_hFile;
+        HANDLE              m_hMapping;
+#else
+        int                 m_nFile;
+#endif
+        SERIAL_REPLAY_CALLBACK  m_pfnCallback;
+        void                    *m_pContext;
+        CSerialFramer           *m_pFramer;
+        UINT                    m_nPort;
+        BYTE                    m_nType;
+};
+
+#endif // SERIAL_CAPTURE_H
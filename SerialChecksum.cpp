@@ -0,0 +1,360 @@
+/*
+**  FILENAME            SerialChecksum.cpp
+**
+**  PURPOSE             CRC kernels for the serial protocols. Table driven slice-by-8
+**                      for every polynomial, PCLMULQDQ folding for CRC-32 on CPUs
+**                      which have it.
+**
+**  CREATION DATE       16-10-2026
+**  LAST MODIFICATION   16-10-2026
+*/
+
+#ifdef _WIN32
+#include "stdafx.h"
+#endif
+#include "SerialChecksum.h"
+#include <assert.h>
+#include <string.h>
+
+#if defined( _M_X64 ) || defined( __x86_64__ )
+#define SERIAL_CRC_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define SERIAL_TARGET_PCLMUL
+#else
+#define SERIAL_TARGET_PCLMUL        __attribute__(( target( "pclmul,sse4.1" ) ))
+#endif
+#endif
+
+#define CRC32_POLY          0xEDB88320UL            /* reflected 0x04C11DB7 */
+#define CRC16_MODBUS_POLY   0xA001                  /* reflected 0x8005 */
+#define CRC16_XMODEM_POLY   0x1021
+#define CRC32_PCLMUL_MIN    64                      /* shorter input is faster through the tables */
+
+struct CRC_TABLES
+{
+    UINT32  Crc32[8][256];
+    UINT16  Modbus[8][256];
+    UINT16  Xmodem[8][256];
+
+    CRC_TABLES()
+    {
+        for ( UINT n = 0; n < 256; n++ )
+        {
+            UINT32 dwCrc = n;
+            UINT16 wModbus = ( UINT16 )n;
+            UINT16 wXmodem = ( UINT16 )( n << 8 );
+
+            for ( int k = 0; k < 8; k++ )
+            {
+                dwCrc = ( dwCrc & 1 ) ? ( dwCrc >> 1 ) ^ CRC32_POLY : dwCrc >> 1;
+                wModbus = ( wModbus & 1 ) ? ( UINT16 )( ( wModbus >> 1 ) ^ CRC16_MODBUS_POLY ) : ( UINT16 )( wModbus >> 1 );
+                wXmodem = ( wXmodem & 0x8000 ) ? ( UINT16 )( ( wXmodem << 1 ) ^ CRC16_XMODEM_POLY ) : ( UINT16 )( wXmodem << 1 );
+            }
+
+            Crc32[0][n] = dwCrc;
+            Modbus[0][n] = wModbus;
+            Xmodem[0][n] = wXmodem;
+        }
+
+        // table k advances a byte through k more zero bytes
+        for ( UINT n = 0; n < 256; n++ )
+        {
+            for ( int k = 1; k < 8; k++ )
+            {
+                Crc32[k][n] = ( Crc32[k - 1][n] >> 8 ) ^ Crc32[0][Crc32[k - 1][n] & 0xFF];
+                Modbus[k][n] = ( UINT16 )( ( Modbus[k - 1][n] >> 8 ) ^ Modbus[0][Modbus[k - 1][n] & 0xFF] );
+                Xmodem[k][n] = ( UINT16 )( ( Xmodem[k - 1][n] << 8 ) ^ Xmodem[0][Xmodem[k - 1][n] >> 8] );
+            }
+        }
+    }
+};
+
+static const CRC_TABLES &GetTables()
+{
+    static const CRC_TABLES s_Tables;
+    return s_Tables;
+}
+
+/* the state passed around is the raw register, CRC-32 inverts on the way in and out */
+
+static UINT32 Crc32Bytewise( const CRC_TABLES &T, UINT32 dwCrc, const BYTE *p, size_t n )
+{
+    while ( n-- > 0 )
+    {
+        dwCrc = ( dwCrc >> 8 ) ^ T.Crc32[0][( dwCrc ^ *p++ ) & 0xFF];
+    }
+
+    return dwCrc;
+}
+
+static UINT32 Crc32Slice8( const CRC_TABLES &T, UINT32 dwCrc, const BYTE *p, size_t n )
+{
+    for ( ; n >= 8; n -= 8, p += 8 )
+    {
+        dwCrc ^= ( UINT32 )p[0] | ( ( UINT32 )p[1] << 8 ) | ( ( UINT32 )p[2] << 16 ) | ( ( UINT32 )p[3] << 24 );
+        dwCrc = T.Crc32[7][dwCrc & 0xFF] ^ T.Crc32[6][( dwCrc >> 8 ) & 0xFF] ^
+                T.Crc32[5][( dwCrc >> 16 ) & 0xFF] ^ T.Crc32[4][dwCrc >> 24] ^
+                T.Crc32[3][p[4]] ^ T.Crc32[2][p[5]] ^ T.Crc32[1][p[6]] ^ T.Crc32[0][p[7]];
+    }
+
+    return Crc32Bytewise( T, dwCrc, p, n );
+}
+
+static UINT16 ModbusBytewise( const CRC_TABLES &T, UINT16 wCrc, const BYTE *p, size_t n )
+{
+    while ( n-- > 0 )
+    {
+        wCrc = ( UINT16 )( ( wCrc >> 8 ) ^ T.Modbus[0][( wCrc ^ *p++ ) & 0xFF] );
+    }
+
+    return wCrc;
+}
+
+static UINT16 ModbusSlice8( const CRC_TABLES &T, UINT16 wCrc, const BYTE *p, size_t n )
+{
+    for ( ; n >= 8; n -= 8, p += 8 )
+    {
+        UINT nFirst = wCrc ^ ( p[0] | ( p[1] << 8 ) );
+        wCrc = ( UINT16 )( T.Modbus[7][nFirst & 0xFF] ^ T.Modbus[6][nFirst >> 8] ^
+                           T.Modbus[5][p[2]] ^ T.Modbus[4][p[3]] ^ T.Modbus[3][p[4]] ^
+                           T.Modbus[2][p[5]] ^ T.Modbus[1][p[6]] ^ T.Modbus[0][p[7]] );
+    }
+
+    return ModbusBytewise( T, wCrc, p, n );
+}
+
+static UINT16 XmodemBytewise( const CRC_TABLES &T, UINT16 wCrc, const BYTE *p, size_t n )
+{
+    while ( n-- > 0 )
+    {
+        wCrc = ( UINT16 )( ( wCrc << 8 ) ^ T.Xmodem[0][( wCrc >> 8 ) ^ *p++] );
+    }
+
+    return wCrc;
+}
+
+static UINT16 XmodemSlice8( const CRC_TABLES &T, UINT16 wCrc, const BYTE *p, size_t n )
+{
+    for ( ; n >= 8; n -= 8, p += 8 )
+    {
+        wCrc = ( UINT16 )( T.Xmodem[7][p[0] ^ ( wCrc >> 8 )] ^ T.Xmodem[6][p[1] ^ ( wCrc & 0xFF )] ^
+                           T.Xmodem[5][p[2]] ^ T.Xmodem[4][p[3]] ^ T.Xmodem[3][p[4]] ^
+                           T.Xmodem[2][p[5]] ^ T.Xmodem[1][p[6]] ^ T.Xmodem[0][p[7]] );
+    }
+
+    return XmodemBytewise( T, wCrc, p, n );
+}
+
+#ifdef SERIAL_CRC_X86
+/*
+** Folds 64 bytes per step with carry-less multiplies, then reduces to 32 bits
+** (Intel, "Fast CRC Computation for Generic Polynomials Using PCLMULQDQ").
+** The constants are the bit reflected ones for the CRC-32 polynomial. nLength
+** is a multiple of 16 and at least 64.
+*/
+SERIAL_TARGET_PCLMUL static UINT32 Crc32Pclmul( UINT32 dwCrc, const BYTE *p, size_t n )
+{
+    const __m128i K1K2 = _mm_set_epi64x( 0x01c6e41596LL, 0x0154442bd4LL );
+    const __m128i K3K4 = _mm_set_epi64x( 0x00ccaa009eLL, 0x01751997d0LL );
+    const __m128i K5K0 = _mm_set_epi64x( 0, 0x0163cd6124LL );
+    const __m128i Poly = _mm_set_epi64x( 0x01f7011641LL, 0x01db710641LL );
+    const __m128i Mask32 = _mm_setr_epi32( ~0, 0, ~0, 0 );
+    __m128i x1, x2, x3, x4, x5, x6, x7, x8;
+
+    assert( ( n >= 64 ) && ( ( n & 15 ) == 0 ) );
+    x1 = _mm_loadu_si128( ( const __m128i * )( p + 0x00 ) );
+    x2 = _mm_loadu_si128( ( const __m128i * )( p + 0x10 ) );
+    x3 = _mm_loadu_si128( ( const __m128i * )( p + 0x20 ) );
+    x4 = _mm_loadu_si128( ( const __m128i * )( p + 0x30 ) );
+    x1 = _mm_xor_si128( x1, _mm_cvtsi32_si128( ( int )dwCrc ) );
+    p += 64;
+    n -= 64;
+
+    // four independent lanes of 16 bytes
+    while ( n >= 64 )
+    {
+        x5 = _mm_clmulepi64_si128( x1, K1K2, 0x00 );
+        x6 = _mm_clmulepi64_si128( x2, K1K2, 0x00 );
+        x7 = _mm_clmulepi64_si128( x3, K1K2, 0x00 );
+        x8 = _mm_clmulepi64_si128( x4, K1K2, 0x00 );
+        x1 = _mm_clmulepi64_si128( x1, K1K2, 0x11 );
+        x2 = _mm_clmulepi64_si128( x2, K1K2, 0x11 );
+        x3 = _mm_clmulepi64_si128( x3, K1K2, 0x11 );
+        x4 = _mm_clmulepi64_si128( x4, K1K2, 0x11 );
+        x1 = _mm_xor_si128( _mm_xor_si128( x1, x5 ), _mm_loadu_si128( ( const __m128i * )( p + 0x00 ) ) );
+        x2 = _mm_xor_si128( _mm_xor_si128( x2, x6 ), _mm_loadu_si128( ( const __m128i * )( p + 0x10 ) ) );
+        x3 = _mm_xor_si128( _mm_xor_si128( x3, x7 ), _mm_loadu_si128( ( const __m128i * )( p + 0x20 ) ) );
+        x4 = _mm_xor_si128( _mm_xor_si128( x4, x8 ), _mm_loadu_si128( ( const __m128i * )( p + 0x30 ) ) );
+        p += 64;
+        n -= 64;
+    }
+
+    // fold the lanes into one
+    x5 = _mm_clmulepi64_si128( x1, K3K4, 0x00 );
+    x1 = _mm_clmulepi64_si128( x1, K3K4, 0x11 );
+    x1 = _mm_xor_si128( _mm_xor_si128( x1, x2 ), x5 );
+    x5 = _mm_clmulepi64_si128( x1, K3K4, 0x00 );
+    x1 = _mm_clmulepi64_si128( x1, K3K4, 0x11 );
+    x1 = _mm_xor_si128( _mm_xor_si128( x1, x3 ), x5 );
+    x5 = _mm_clmulepi64_si128( x1, K3K4, 0x00 );
+    x1 = _mm_clmulepi64_si128( x1, K3K4, 0x11 );
+    x1 = _mm_xor_si128( _mm_xor_si128( x1, x4 ), x5 );
+
+    while ( n >= 16 )
+    {
+        x5 = _mm_clmulepi64_si128( x1, K3K4, 0x00 );
+        x1 = _mm_clmulepi64_si128( x1, K3K4, 0x11 );
+        x1 = _mm_xor_si128( _mm_xor_si128( x1, _mm_loadu_si128( ( const __m128i * )p ) ), x5 );
+        p += 16;
+        n -= 16;
+    }
+
+    // 128 to 64 bits
+    x2 = _mm_clmulepi64_si128( x1, K3K4, 0x10 );
+    x1 = _mm_xor_si128( _mm_srli_si128( x1, 8 ), x2 );
+    x2 = _mm_srli_si128( x1, 4 );
+    x1 = _mm_and_si128( x1, Mask32 );
+    x1 = _mm_clmulepi64_si128( x1, K5K0, 0x00 );
+    x1 = _mm_xor_si128( x1, x2 );
+
+    // Barrett reduction to 32 bits
+    x2 = _mm_and_si128( x1, Mask32 );
+    x2 = _mm_clmulepi64_si128( x2, Poly, 0x10 );
+    x2 = _mm_and_si128( x2, Mask32 );
+    x2 = _mm_clmulepi64_si128( x2, Poly, 0x00 );
+    x1 = _mm_xor_si128( x1, x2 );
+    return ( UINT32 )_mm_extract_epi32( x1, 1 );
+}
+
+static BOOL HasPclmul()
+{
+#ifdef _MSC_VER
+    int Regs[4];
+    __cpuid( Regs, 1 );
+    return ( ( Regs[2] & ( 1 << 1 ) ) != 0 ) && ( ( Regs[2] & ( 1 << 19 ) ) != 0 );
+#else
+    __builtin_cpu_init();
+    return ( __builtin_cpu_supports( "pclmul" ) && __builtin_cpu_supports( "sse4.1" ) ) ? TRUE : FALSE;
+#endif
+}
+#endif
+
+BOOL SerialCrcKernelAvailable( SERIAL_CHECKSUM Type, SERIAL_CRC_KERNEL Kernel )
+{
+    if ( Kernel != SERIAL_CRC_KERNEL_PCLMUL )
+    {
+        return TRUE;
+    }
+
+#ifdef SERIAL_CRC_X86
+    static const BOOL s_bPclmul = HasPclmul();
+    return ( Type == SERIAL_CHECKSUM_CRC32 ) && s_bPclmul;
+#else
+    ( void )Type;
+    return FALSE;
+#endif
+}
+
+UINT SerialChecksumSize( SERIAL_CHECKSUM Type )
+{
+    switch ( Type )
+    {
+        case SERIAL_CHECKSUM_CRC16_MODBUS:
+        case SERIAL_CHECKSUM_CRC16_XMODEM:
+            return 2;
+
+        case SERIAL_CHECKSUM_CRC32:
+            return 4;
+
+        default:
+            return 0;
+    }
+}
+
+UINT32 SerialChecksumInit( SERIAL_CHECKSUM Type )
+{
+    return ( Type == SERIAL_CHECKSUM_CRC16_MODBUS ) ? 0xFFFF : 0;
+}
+
+UINT32 SerialChecksumUpdate( SERIAL_CHECKSUM Type, UINT32 dwCrc, const void *pData, size_t nLength, SERIAL_CRC_KERNEL Kernel )
+{
+    const CRC_TABLES &T = GetTables();
+    const BYTE *p = ( const BYTE * )pData;
+
+    if ( Kernel == SERIAL_CRC_KERNEL_AUTO )
+    {
+        Kernel = SerialCrcKernelAvailable( Type, SERIAL_CRC_KERNEL_PCLMUL ) ? SERIAL_CRC_KERNEL_PCLMUL : SERIAL_CRC_KERNEL_SLICE8;
+    }
+
+    switch ( Type )
+    {
+        case SERIAL_CHECKSUM_CRC16_MODBUS:
+            return ( Kernel == SERIAL_CRC_KERNEL_BYTEWISE ) ? ModbusBytewise( T, ( UINT16 )dwCrc, p, nLength ) :
+                   ModbusSlice8( T, ( UINT16 )dwCrc, p, nLength );
+
+        case SERIAL_CHECKSUM_CRC16_XMODEM:
+            return ( Kernel == SERIAL_CRC_KERNEL_BYTEWISE ) ? XmodemBytewise( T, ( UINT16 )dwCrc, p, nLength ) :
+                   XmodemSlice8( T, ( UINT16 )dwCrc, p, nLength );
+
+        case SERIAL_CHECKSUM_CRC32:
+            dwCrc = ~dwCrc;
+#ifdef SERIAL_CRC_X86
+            if ( ( Kernel == SERIAL_CRC_KERNEL_PCLMUL ) && ( nLength >= CRC32_PCLMUL_MIN ) )
+            {
+                assert( SerialCrcKernelAvailable( Type, Kernel ) );
+                size_t nFold = nLength & ~( size_t )15;
+                dwCrc = Crc32Pclmul( dwCrc, p, nFold );
+                p += nFold;
+                nLength -= nFold;
+            }
+#endif
+            dwCrc = ( Kernel == SERIAL_CRC_KERNEL_BYTEWISE ) ? Crc32Bytewise( T, dwCrc, p, nLength ) :
+                    Crc32Slice8( T, dwCrc, p, nLength );
+            return ~dwCrc;
+
+        default:
+            return dwCrc;
+    }
+}
+
+void SerialChecksumStore( SERIAL_CHECKSUM Type, UINT32 dwCrc, BYTE *pOut )
+{
+    switch ( Type )
+    {
+        case SERIAL_CHECKSUM_CRC16_MODBUS:
+            pOut[0] = ( BYTE )dwCrc;
+            pOut[1] = ( BYTE )( dwCrc >> 8 );
+            break;
+
+        case SERIAL_CHECKSUM_CRC16_XMODEM:
+            pOut[0] = ( BYTE )( dwCrc >> 8 );
+            pOut[1] = ( BYTE )dwCrc;
+            break;
+
+        case SERIAL_CHECKSUM_CRC32:
+            pOut[0] = ( BYTE )dwCrc;
+            pOut[1] = ( BYTE )( dwCrc >> 8 );
+            pOut[2] = ( BYTE )( dwCrc >> 16 );
+            pOut[3] = ( BYTE )( dwCrc >> 24 );
+            break;
+
+        default:
+            break;
+    }
+}
+
+BOOL SerialChecksumVerify( SERIAL_CHECKSUM Type, const BYTE *pFrame, UINT nLength )
+{
+    BYTE Expected[SERIAL_CHECKSUM_MAX_SIZE];
+    UINT nSize = SerialChecksumSize( Type );
+
+    if ( nLength < nSize )
+    {
+        return FALSE;
+    }
+
+    SerialChecksumStore( Type, SerialChecksumUpdate( Type, SerialChecksumInit( Type ), pFrame, nLength - nSize ), Expected );
+    return memcmp( Expected, pFrame + nLength - nSize, nSize ) == 0;
+}
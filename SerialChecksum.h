@@ -0,0 +1,71 @@
+/*
+**  FILENAME            SerialChecksum.h
+**
+**  PURPOSE             CRC kernels for the serial protocols: CRC-16/MODBUS,
+**                      CRC-16/XMODEM (CCITT) and CRC-32. All of them update
+**                      incrementally, chunk by chunk as the data arrives.
+**
+**  CREATION DATE       16-10-2026
+**  LAST MODIFICATION   16-10-2026
+*/
+
+#ifndef SERIAL_CHECKSUM_H
+#define SERIAL_CHECKSUM_H
+
+#ifndef _WIN32
+#include "SerialPortPosix.h"
+#endif
+#include <stddef.h>
+
+#define SERIAL_CHECKSUM_MAX_SIZE    4                       /* bytes of the largest checksum */
+
+typedef enum _SERIAL_CHECKSUM
+{
+    SERIAL_CHECKSUM_NONE = 0,
+    SERIAL_CHECKSUM_CRC16_MODBUS,                           // poly 0x8005 reflected, init 0xFFFF, sent low byte first
+    SERIAL_CHECKSUM_CRC16_XMODEM,                           // poly 0x1021, init 0, sent high byte first
+    SERIAL_CHECKSUM_CRC32                                   // zlib/Ethernet, sent low byte first
+} SERIAL_CHECKSUM;
+
+typedef enum _SERIAL_CRC_KERNEL
+{
+    SERIAL_CRC_KERNEL_AUTO = 0,                             // fastest one the CPU supports
+    SERIAL_CRC_KERNEL_BYTEWISE,                             // one table lookup per byte
+    SERIAL_CRC_KERNEL_SLICE8,                               // eight tables, eight bytes per step
+    SERIAL_CRC_KERNEL_PCLMUL                                // carry-less multiply folding, CRC-32 only
+} SERIAL_CRC_KERNEL;
+
+UINT        SerialChecksumSize( SERIAL_CHECKSUM Type );
+UINT32      SerialChecksumInit( SERIAL_CHECKSUM Type );
+
+/*
+** Continues dwCrc over the next chunk, start with SerialChecksumInit(). The value
+** returned after the last chunk is the checksum, no final step is needed.
+*/
+UINT32      SerialChecksumUpdate( SERIAL_CHECKSUM Type, UINT32 dwCrc, const void *pData, size_t nLength,
+                                  SERIAL_CRC_KERNEL Kernel = SERIAL_CRC_KERNEL_AUTO );
+
+// writes the checksum in the byte order it has on the wire, SerialChecksumSize() bytes
+void        SerialChecksumStore( SERIAL_CHECKSUM Type, UINT32 dwCrc, BYTE *pOut );
+
+// TRUE when the trailing checksum of pFrame matches the bytes before it
+BOOL        SerialChecksumVerify( SERIAL_CHECKSUM Type, const BYTE *pFrame, UINT nLength );
+
+BOOL        SerialCrcKernelAvailable( SERIAL_CHECKSUM Type, SERIAL_CRC_KERNEL Kernel );
+
+static inline UINT16 SerialCrc16Modbus( const void *pData, size_t nLength, UINT16 wCrc = 0xFFFF )
+{
+    return ( UINT16 )SerialChecksumUpdate( SERIAL_CHECKSUM_CRC16_MODBUS, wCrc, pData, nLength );
+}
+
+static inline UINT16 SerialCrc16Xmodem( const void *pData, size_t nLength, UINT16 wCrc = 0 )
+{
+    return ( UINT16 )SerialChecksumUpdate( SERIAL_CHECKSUM_CRC16_XMODEM, wCrc, pData, nLength );
+}
+
+static inline UINT32 SerialCrc32( const void *pData, size_t nLength, UINT32 dwCrc = 0 )
+{
+    return SerialChecksumUpdate( SERIAL_CHECKSUM_CRC32, dwCrc, pData, nLength );
+}
+
+#endif // SERIAL_CHECKSUM_H
@@ -0,0 +1,79 @@
+/*
+**  FILENAME            SerialErrorQueue.cpp
+**
+**  PURPOSE             Bounded queue of the errors of one port.
+**
+**  CREATION DATE       16-10-2026
+**  LAST MODIFICATION   16-10-2026
+*/
+
+#ifdef _WIN32
+#include "stdafx.h"
+#endif
+#include "SerialErrorQueue.h"
+#include "SerialMetrics.h"
+#include <string.h>
+
+CSerialErrorQueue::CSerialErrorQueue()
+{
+    m_nHead = 0;
+    m_nCount = 0;
+    m_qwDropped = 0;
+}
+
+BOOL CSerialErrorQueue::Push( const char *szOperation, DWORD dwError )
+{
+    std::lock_guard<std::mutex> Lock( m_Lock );
+    BOOL bWasEmpty = ( m_nCount == 0 );
+
+    if ( m_nCount == SERIAL_ERROR_QUEUE_SIZE )
+    {
+        // a port in trouble repeats itself, the newest entries tell the most
+        m_nHead = ( m_nHead + 1 ) % SERIAL_ERROR_QUEUE_SIZE;
+        m_nCount--;
+        m_qwDropped++;
+    }
+
+    SERIAL_PORT_ERROR &Entry = m_Entries[( m_nHead + m_nCount ) % SERIAL_ERROR_QUEUE_SIZE];
+    Entry.qwTime = SerialMetricsNow();
+    Entry.dwError = dwError;
+    strncpy( Entry.szOperation, szOperation, sizeof( Entry.szOperation ) - 1 );
+    Entry.szOperation[sizeof( Entry.szOperation ) - 1] = '\0';
+    m_nCount++;
+    return bWasEmpty;
+}
+
+BOOL CSerialErrorQueue::Pop( SERIAL_PORT_ERROR *pError )
+{
+    std::lock_guard<std::mutex> Lock( m_Lock );
+
+    if ( m_nCount == 0 )
+    {
+        return FALSE;
+    }
+
+    *pError = m_Entries[m_nHead];
+    m_nHead = ( m_nHead + 1 ) % SERIAL_ERROR_QUEUE_SIZE;
+    m_nCount--;
+    return TRUE;
+}
+
+UINT CSerialErrorQueue::GetCount()
+{
+    std::lock_guard<std::mutex> Lock( m_Lock );
+    return m_nCount;
+}
+
+UINT64 CSerialErrorQueue::GetDropped()
+{
+    std::lock_guard<std::mutex> Lock( m_Lock );
+    return m_qwDropped;
+}
+
+void CSerialErrorQueue::Clear()
+{
+    std::lock_guard<std::mutex> Lock( m_Lock );
+    m_nHead = 0;
+    m_nCount = 0;
+    m_qwDropped = 0;
+}
@@ -0,0 +1,52 @@
+/*
+**  FILENAME            SerialErrorQueue.h
+**
+**  PURPOSE             Bounded queue of the errors of one port. The I/O thread
+**                      records an error and carries on, the owner takes the
+**                      entries whenever it likes.
+**
+**  CREATION DATE       16-10-2026
+**  LAST MODIFICATION   16-10-2026
+*/
+
+#ifndef SERIAL_ERROR_QUEUE_H
+#define SERIAL_ERROR_QUEUE_H
+
+#ifndef _WIN32
+#include "SerialPortPosix.h"
+#endif
+#include <mutex>
+
+#define SERIAL_ERROR_QUEUE_SIZE     16              /* the oldest entry is dropped when full */
+
+typedef struct _SERIAL_PORT_ERROR
+{
+    UINT64              qwTime;                 // SerialMetricsNow()
+    DWORD               dwError;                // GetLastError() or errno
+    char                szOperation[32];        // the call which failed, "read()", "SetCommState()", ...
+} SERIAL_PORT_ERROR;
+
+class CSerialErrorQueue
+{
+    public:
+        CSerialErrorQueue();
+
+        // TRUE when the queue was empty, i.e. the owner has to be told
+        BOOL                Push( const char *szOperation, DWORD dwError );
+        BOOL                Pop( SERIAL_PORT_ERROR *pError );
+        UINT                GetCount();
+        UINT64              GetDropped();
+        void                Clear();
+
+    private:
+        CSerialErrorQueue( const CSerialErrorQueue & );
+        CSerialErrorQueue   &operator=( const CSerialErrorQueue & );
+
+        std::mutex          m_Lock;             // held for a copy, never across a call out
+        SERIAL_PORT_ERROR   m_Entries[SERIAL_ERROR_QUEUE_SIZE];
+        UINT                m_nHead;
+        UINT                m_nCount;
+        UINT64              m_qwDropped;
+};
+
+#endif // SERIAL_ERROR_QUEUE_H
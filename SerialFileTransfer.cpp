@@ -0,0 +1,1136 @@
+/*
+**  FILENAME            SerialFileTransfer.cpp
+**
+**  PURPOSE             Windowed file transfer over a port, sender and receiver.
+**
+**  CREATION DATE       16-10-2026
+**  LAST MODIFICATION   16-10-2026
+*/
+
+#ifdef _WIN32
+#include "stdafx.h"
+#endif
+#include "SerialFileTransfer.h"
+#include "SerialChecksum.h"
+#include <assert.h>
+#include <string.h>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+#include <chrono>
+#include <vector>
+
+#define TRANSFER_READ_CHUNK         65536                   /* reading back a partial file */
+
+static inline void StoreUint32( BYTE *pOut, UINT32 dwValue )
+{
+    pOut[0] = ( BYTE )dwValue;
+    pOut[1] = ( BYTE )( dwValue >> 8 );
+    pOut[2] = ( BYTE )( dwValue >> 16 );
+    pOut[3] = ( BYTE )( dwValue >> 24 );
+}
+
+static inline UINT32 LoadUint32( const BYTE *pIn )
+{
+    return ( UINT32 )pIn[0] | ( ( UINT32 )pIn[1] << 8 ) | ( ( UINT32 )pIn[2] << 16 ) | ( ( UINT32 )pIn[3] << 24 );
+}
+
+static inline void StoreHeader( BYTE *pOut, BYTE nType, UINT32 dwOffset, UINT nLength )
+{
+    pOut[0] = nType;
+    StoreUint32( pOut + 1, dwOffset );
+    pOut[5] = ( BYTE )nLength;
+    pOut[6] = ( BYTE )( nLength >> 8 );
+}
+
+/*
+** CSerialTransfer
+*/
+
+CSerialTransfer::CSerialTransfer()
+{
+    m_pPort = NULL;
+    m_Status = SERIAL_TRANSFER_IDLE;
+    m_dwTimeoutMs = SERIAL_TRANSFER_TIMEOUT_MS;
+    m_nRetries = SERIAL_TRANSFER_RETRIES;
+    m_nTimeouts = 0;
+    memset( &m_Progress, 0, sizeof( m_Progress ) );
+    memset( &m_Stats, 0, sizeof( m_Stats ) );
+    m_nPending = 0;
+    m_qwActivity = 0;
+    m_qwDataStart = 0;
+    m_qwReported = 0;
+    m_pfnProgress = NULL;
+    m_pProgressContext = NULL;
+    m_qwProgressIntervalNs = 0;
+    m_pfnDone = NULL;
+    m_pDoneContext = NULL;
+}
+
+CSerialTransfer::~CSerialTransfer()
+{
+    if ( m_pPort != NULL )
+    {
+        assert( !m_pPort->IsOpen() );
+        m_pPort->SetRxNotify( NULL, NULL );
+    }
+}
+
+void CSerialTransfer::Attach( CSerialPort *pPort )
+{
+    assert( !pPort->IsOpen() );
+    m_pPort = pPort;
+    m_pPort->SetRxCallback( OnRx, this );
+    m_pPort->SetRxNotify( OnNotify, this );
+}
+
+void CSerialTransfer::SetTimeout( DWORD dwTimeoutMs, UINT nRetries )
+{
+    std::lock_guard<std::mutex> Lock( m_Lock );
+    m_dwTimeoutMs = ( dwTimeoutMs > 0 ) ? dwTimeoutMs : 1;
+    m_nRetries = nRetries;
+}
+
+void CSerialTransfer::SetProgressCallback( SERIAL_TRANSFER_PROGRESS_CALLBACK pfnCallback, void *pContext, DWORD dwIntervalMs )
+{
+    std::lock_guard<std::mutex> Lock( m_Lock );
+    m_pfnProgress = pfnCallback;
+    m_pProgressContext = pContext;
+    m_qwProgressIntervalNs = ( UINT64 )dwIntervalMs * 1000000;
+}
+
+void CSerialTransfer::SetDoneCallback( SERIAL_TRANSFER_DONE_CALLBACK pfnCallback, void *pContext )
+{
+    std::lock_guard<std::mutex> Lock( m_Lock );
+    m_pfnDone = pfnCallback;
+    m_pDoneContext = pContext;
+}
+
+void CSerialTransfer::Cancel()
+{
+    std::unique_lock<std::mutex> Lock( m_Lock );
+
+    if ( m_Status == SERIAL_TRANSFER_RUNNING )
+    {
+        SendControl( SERIAL_TRANSFER_CAN, 0 );
+        Finish( Lock, SERIAL_TRANSFER_CANCELLED );
+    }
+}
+
+BOOL CSerialTransfer::Wait( DWORD dwTimeout )
+{
+    std::unique_lock<std::mutex> Lock( m_Lock );
+    auto Done = [this]() { return m_Status != SERIAL_TRANSFER_RUNNING; };
+
+    if ( dwTimeout == INFINITE )
+    {
+        m_cvDone.wait( Lock, Done );
+        return TRUE;
+    }
+
+    return m_cvDone.wait_for( Lock, std::chrono::milliseconds( dwTimeout ), Done );
+}
+
+SERIAL_TRANSFER_STATUS CSerialTransfer::GetStatus()
+{
+    std::lock_guard<std::mutex> Lock( m_Lock );
+    return m_Status;
+}
+
+void CSerialTransfer::GetProgress( SERIAL_TRANSFER_PROGRESS *pProgress )
+{
+    std::lock_guard<std::mutex> Lock( m_Lock );
+    *pProgress = m_Progress;
+}
+
+void CSerialTransfer::GetStats( SERIAL_TRANSFER_STATS *pStats, BOOL bReset )
+{
+    std::lock_guard<std::mutex> Lock( m_Lock );
+    *pStats = m_Stats;
+
+    if ( bReset )
+    {
+        memset( &m_Stats, 0, sizeof( m_Stats ) );
+    }
+}
+
+BOOL CSerialTransfer::SendControl( BYTE nType, UINT32 dwOffset, const void *pPayload, UINT nLength )
+{
+    BYTE Packet[SERIAL_TRANSFER_MAX_PACKET];
+    UINT nSize = SERIAL_TRANSFER_HEADER + nLength + SERIAL_TRANSFER_TRAILER;
+
+    assert( nLength <= SERIAL_TRANSFER_BLOCK );
+    StoreHeader( Packet, nType, dwOffset, nLength );
+
+    if ( nLength > 0 )
+    {
+        memcpy( Packet + SERIAL_TRANSFER_HEADER, pPayload, nLength );
+    }
+
+    SerialChecksumStore( SERIAL_CHECKSUM_CRC16_XMODEM, SerialCrc16Xmodem( Packet, SERIAL_TRANSFER_HEADER + nLength ),
+                         Packet + SERIAL_TRANSFER_HEADER + nLength );
+
+    // never waits, this runs on the I/O thread as well; ahead of the data in the bulk lane
+    if ( ( m_pPort == NULL ) || !m_pPort->WriteAsync( Packet, nSize, NULL, NULL, 0 ) )
+    {
+        return FALSE;
+    }
+
+    m_Stats.qwWireBytes += nSize;
+    return TRUE;
+}
+
+void CSerialTransfer::Start()
+{
+    m_Status = SERIAL_TRANSFER_RUNNING;
+    m_nTimeouts = 0;
+    m_qwActivity = 0;
+    m_qwDataStart = 0;
+    m_qwReported = 0;
+    memset( &m_Progress, 0, sizeof( m_Progress ) );
+}
+
+void CSerialTransfer::Arm( UINT64 qwNow )
+{
+    m_qwActivity = qwNow;
+    m_pPort->SetRxNotifyDeadline( qwNow + ( UINT64 )m_dwTimeoutMs * 1000000 );
+}
+
+void CSerialTransfer::Touch( UINT64 qwNow )
+{
+    // the deadline stays where it is, OnNotify() moves it when it finds activity since
+    if ( m_qwActivity != 0 )
+    {
+        m_qwActivity = qwNow;
+    }
+
+    m_nTimeouts = 0;
+}
+
+void CSerialTransfer::StartData( UINT64 qwSize, UINT64 qwStart, UINT64 qwNow )
+{
+    m_Progress.qwSize = qwSize;
+    m_Progress.qwStart = qwStart;
+    m_Progress.qwDone = qwStart;
+    m_qwDataStart = qwNow;
+}
+
+void CSerialTransfer::Advance( std::unique_lock<std::mutex> &Lock, UINT64 qwDone, UINT64 qwNow )
+{
+    m_Progress.qwDone = qwDone;
+    Touch( qwNow );
+    Report( Lock, qwNow, FALSE );
+}
+
+void CSerialTransfer::Report( std::unique_lock<std::mutex> &Lock, UINT64 qwNow, BOOL bForce )
+{
+    if ( m_qwDataStart != 0 )
+    {
+        m_Progress.qwElapsedNs = qwNow - m_qwDataStart;
+        m_Progress.dBytesPerSecond = ( m_Progress.qwElapsedNs > 0 ) ?
+                                     ( double )( m_Progress.qwDone - m_Progress.qwStart ) * 1e9 / ( double )m_Progress.qwElapsedNs : 0.0;
+    }
+
+    if ( ( m_pfnProgress == NULL ) || ( !bForce && ( qwNow - m_qwReported < m_qwProgressIntervalNs ) ) )
+    {
+        return;
+    }
+
+    SERIAL_TRANSFER_PROGRESS_CALLBACK pfnProgress = m_pfnProgress;
+    void *pContext = m_pProgressContext;
+    SERIAL_TRANSFER_PROGRESS Progress = m_Progress;
+
+    m_qwReported = qwNow;
+    Lock.unlock();
+    pfnProgress( pContext, &Progress );
+    Lock.lock();
+}
+
+void CSerialTransfer::Finish( std::unique_lock<std::mutex> &Lock, SERIAL_TRANSFER_STATUS Status )
+{
+    if ( m_Status != SERIAL_TRANSFER_RUNNING )
+    {
+        return;
+    }
+
+    // clearing the deadline needs no wakeup of the I/O thread
+    m_Status = Status;
+    m_qwActivity = 0;
+    m_pPort->SetRxNotifyDeadline( 0 );
+    OnFinish();
+    m_cvDone.notify_all();
+
+    SERIAL_TRANSFER_DONE_CALLBACK pfnDone = m_pfnDone;
+    void *pContext = m_pDoneContext;
+
+    Report( Lock, SerialMetricsNow(), TRUE );
+
+    if ( pfnDone != NULL )
+    {
+        Lock.unlock();
+        pfnDone( pContext, Status );
+        Lock.lock();
+    }
+}
+
+void CSerialTransfer::OnRx( void *pContext, const BYTE *pData, UINT nLength, UINT64 qwTimestamp )
+{
+    CSerialTransfer *pThis = ( CSerialTransfer * )pContext;
+    std::unique_lock<std::mutex> Lock( pThis->m_Lock );
+
+    // after a parse at most one packet is left incomplete, there is always room for another one
+    while ( nLength > 0 )
+    {
+        UINT nTake = ( UINT )sizeof( pThis->m_Pending ) - pThis->m_nPending;
+        nTake = ( nTake < nLength ) ? nTake : nLength;
+
+        memcpy( pThis->m_Pending + pThis->m_nPending, pData, nTake );
+        pThis->m_nPending += nTake;
+        pData += nTake;
+        nLength -= nTake;
+        pThis->Parse( Lock, qwTimestamp );
+    }
+}
+
+void CSerialTransfer::Parse( std::unique_lock<std::mutex> &Lock, UINT64 qwNow )
+{
+    UINT i = 0;
+
+    // resynchronizes byte by byte: a damaged packet is searched again for the start of the next one
+    while ( i < m_nPending )
+    {
+        const BYTE *pPacket = m_Pending + i;
+        UINT nAvailable = m_nPending - i;
+
+        if ( !IsAccepted( pPacket[0] ) )
+        {
+            i++;
+            continue;
+        }
+
+        if ( nAvailable < SERIAL_TRANSFER_HEADER )
+        {
+            break;
+        }
+
+        UINT nLength = ( UINT )pPacket[5] | ( ( UINT )pPacket[6] << 8 );
+        UINT nSize = SERIAL_TRANSFER_HEADER + nLength + SERIAL_TRANSFER_TRAILER;
+
+        if ( nLength > SERIAL_TRANSFER_BLOCK )
+        {
+            i++;
+            continue;
+        }
+
+        if ( nAvailable < nSize )
+        {
+            break;
+        }
+
+        if ( !SerialChecksumVerify( SERIAL_CHECKSUM_CRC16_XMODEM, pPacket, nSize ) )
+        {
+            m_Stats.qwCrcErrors++;
+            i++;
+            continue;
+        }
+
+        // only the I/O thread changes m_Pending, the packet stays valid while a callback runs
+        i += nSize;
+        OnPacket( Lock, pPacket[0], LoadUint32( pPacket + 1 ), pPacket + SERIAL_TRANSFER_HEADER, nLength, qwNow );
+    }
+
+    m_nPending -= i;
+    memmove( m_Pending, m_Pending + i, m_nPending );
+}
+
+void CSerialTransfer::OnNotify( void *pContext, UINT64 qwNow )
+{
+    CSerialTransfer *pThis = ( CSerialTransfer * )pContext;
+    std::unique_lock<std::mutex> Lock( pThis->m_Lock );
+    UINT64 qwTimeoutNs = ( UINT64 )pThis->m_dwTimeoutMs * 1000000;
+
+    if ( ( pThis->m_Status != SERIAL_TRANSFER_RUNNING ) || ( pThis->m_qwActivity == 0 ) )
+    {
+        return;
+    }
+
+    if ( qwNow >= pThis->m_qwActivity + qwTimeoutNs )
+    {
+        pThis->m_Stats.qwTimeouts++;
+
+        if ( ++pThis->m_nTimeouts > pThis->m_nRetries )
+        {
+            pThis->SendControl( SERIAL_TRANSFER_CAN, 0 );
+            pThis->Finish( Lock, SERIAL_TRANSFER_TIMEOUT );
+            return;
+        }
+
+        pThis->m_qwActivity = qwNow;
+        pThis->OnTimeout( qwNow );
+    }
+
+    // the port cleared the deadline when it called, progress since only moves the next one
+    pThis->m_pPort->SetRxNotifyDeadline( pThis->m_qwActivity + qwTimeoutNs );
+}
+
+/*
+** CSerialFileSender
+*/
+
+CSerialFileSender::CSerialFileSender()
+{
+    m_State = STATE_IDLE;
+    m_nWindow = SERIAL_TRANSFER_WINDOW;
+    m_pBase = NULL;
+    m_qwSize = 0;
+#ifdef _WIN32
+    m_hFile = INVALID_HANDLE_VALUE;
+    m_hMapping = NULL;
+#else
+    m_nFile = -1;
+#endif
+    m_qwAcked = 0;
+    m_qwNext = 0;
+    m_qwSent = 0;
+    m_dwCrc = 0;
+    m_qwCrcEnd = 0;
+    m_nQueued = 0;
+}
+
+CSerialFileSender::~CSerialFileSender()
+{
+    std::lock_guard<std::mutex> Lock( m_Lock );
+
+    // a closed port released every packet
+    assert( m_nQueued == 0 );
+    Unmap();
+}
+
+void CSerialFileSender::SetWindow( UINT nWindow )
+{
+    std::lock_guard<std::mutex> Lock( m_Lock );
+    m_nWindow = ( nWindow > 0 ) ? nWindow : 1;
+    Pump();
+}
+
+BOOL CSerialFileSender::Send( const char *pszPath, const char *pszName )
+{
+    std::unique_lock<std::mutex> Lock( m_Lock );
+    const char *pszBase;
+
+    assert( m_pPort != NULL );
+
+    if ( m_Status == SERIAL_TRANSFER_RUNNING )
+    {
+        return FALSE;
+    }
+
+    // packets of the last transfer may still point into its mapping
+    m_cvDone.wait( Lock, [this]() { return m_nQueued == 0; } );
+    Unmap();
+
+    if ( !Map( pszPath ) )
+    {
+        m_Status = SERIAL_TRANSFER_FILE_ERROR;
+        return FALSE;
+    }
+
+    if ( pszName == NULL )
+    {
+        pszName = pszPath;
+
+        for ( pszBase = pszPath; *pszBase != '\0'; pszBase++ )
+        {
+            if ( ( *pszBase == '/' ) || ( *pszBase == '\\' ) )
+            {
+                pszName = pszBase + 1;
+            }
+        }
+    }
+
+    m_strName.assign( pszName, strnlen( pszName, SERIAL_TRANSFER_MAX_NAME ) );
+    m_qwAcked = m_qwNext = m_qwSent = 0;
+    m_dwCrc = 0;
+    m_qwCrcEnd = 0;
+    m_State = STATE_HEADER;
+    Start();
+    Arm( SerialMetricsNow() );
+    SendHeader();
+    return TRUE;
+}
+
+void CSerialFileSender::OnPacket( std::unique_lock<std::mutex> &Lock, BYTE nType, UINT32 dwOffset,
+                                  const BYTE *pPayload, UINT nLength, UINT64 qwNow )
+{
+    if ( m_Status != SERIAL_TRANSFER_RUNNING )
+    {
+        return;
+    }
+
+    if ( nType == SERIAL_TRANSFER_CAN )
+    {
+        Finish( Lock, SERIAL_TRANSFER_CANCELLED );
+        return;
+    }
+
+    switch ( m_State )
+    {
+        case STATE_HEADER:
+        {
+            UINT64 qwStart = dwOffset;
+
+            // the reply to SOH carries a CRC unless it is 0, late ones of an earlier transfer do not
+            if ( ( nType != SERIAL_TRANSFER_ACK ) || ( ( qwStart > 0 ) && ( nLength != sizeof( UINT32 ) ) ) )
+            {
+                break;
+            }
+
+            // the rest of a file the receiver has the start of, all of it when its start differs
+            if ( ( qwStart > 0 ) && ( qwStart <= m_qwSize ) )
+            {
+                m_dwCrc = SerialCrc32( m_pBase, ( size_t )qwStart );
+                qwStart = ( m_dwCrc == LoadUint32( pPayload ) ) ? qwStart : 0;
+            }
+            else
+            {
+                qwStart = 0;
+            }
+
+            m_dwCrc = ( qwStart > 0 ) ? m_dwCrc : 0;
+            m_qwCrcEnd = qwStart;
+            m_qwAcked = m_qwNext = m_qwSent = qwStart;
+            m_State = STATE_DATA;
+            StartData( m_qwSize, qwStart, qwNow );
+            Touch( qwNow );
+
+            if ( m_qwAcked == m_qwSize )
+            {
+                m_State = STATE_END;
+                SendEnd();
+            }
+
+            Pump();
+            break;
+        }
+
+        case STATE_DATA:
+        {
+            // both carry what the receiver has, a NAK also where to go back to
+            if ( ( dwOffset < m_qwAcked ) || ( dwOffset > m_qwSent ) )
+            {
+                break;
+            }
+
+            BOOL bProgress = ( dwOffset > m_qwAcked );
+            m_qwAcked = dwOffset;
+
+            if ( nType == SERIAL_TRANSFER_NAK )
+            {
+                m_Stats.qwNaks++;
+                Rewind( dwOffset );
+                Touch( qwNow );
+            }
+            else if ( m_qwNext < m_qwAcked )
+            {
+                // the packets resent before were taken already
+                m_qwNext = m_qwAcked;
+            }
+
+            if ( m_qwAcked == m_qwSize )
+            {
+                m_State = STATE_END;
+                SendEnd();
+            }
+
+            Pump();
+
+            if ( bProgress )
+            {
+                Advance( Lock, dwOffset, qwNow );
+            }
+
+            break;
+        }
+
+        case STATE_END:
+        {
+            if ( ( nType == SERIAL_TRANSFER_ACK ) && ( dwOffset == m_qwSize ) )
+            {
+                Finish( Lock, SERIAL_TRANSFER_OK );
+            }
+            else if ( nType == SERIAL_TRANSFER_NAK )
+            {
+                SendEnd();
+            }
+
+            break;
+        }
+
+        default:
+            break;
+    }
+}
+
+void CSerialFileSender::OnTimeout( UINT64 qwNow )
+{
+    ( void )qwNow;
+
+    switch ( m_State )
+    {
+        case STATE_HEADER:
+            SendHeader();
+            break;
+
+        case STATE_DATA:
+            // the acknowledgement or the packet after the last one got lost
+            Rewind( m_qwAcked );
+            Pump();
+            break;
+
+        case STATE_END:
+            SendEnd();
+            break;
+
+        default:
+            break;
+    }
+}
+
+void CSerialFileSender::OnFinish()
+{
+    m_State = STATE_IDLE;
+
+    if ( m_nQueued == 0 )
+    {
+        Unmap();
+    }
+}
+
+BOOL CSerialFileSender::IsAccepted( BYTE nType )
+{
+    return ( nType == SERIAL_TRANSFER_ACK ) || ( nType == SERIAL_TRANSFER_NAK ) || ( nType == SERIAL_TRANSFER_CAN );
+}
+
+void CSerialFileSender::OnSent( void *pContext, DWORD dwBytesWritten, BOOL bSuccess )
+{
+    CSerialFileSender *pThis = ( CSerialFileSender * )pContext;
+    std::lock_guard<std::mutex> Lock( pThis->m_Lock );
+
+    ( void )dwBytesWritten;
+    pThis->m_nQueued--;
+
+    if ( pThis->m_Status == SERIAL_TRANSFER_RUNNING )
+    {
+        // the queue has room again, a failed write leaves it to the timeout
+        if ( bSuccess )
+        {
+            pThis->Pump();
+        }
+    }
+    else if ( pThis->m_nQueued == 0 )
+    {
+        pThis->Unmap();
+        pThis->m_cvDone.notify_all();
+    }
+}
+
+void CSerialFileSender::OnReleaseBuffer( void *pContext, const void *pData, UINT nSize )
+{
+    ( void )pData;
+    ( void )nSize;
+    SerialBufferRelease( ( SERIAL_BUFFER * )pContext );
+}
+
+BOOL CSerialFileSender::Map( const char *pszPath )
+{
+#ifdef _WIN32
+    LARGE_INTEGER liSize;
+
+    m_hFile = CreateFileA( pszPath, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL );
+
+    if ( m_hFile == INVALID_HANDLE_VALUE )
+    {
+        return FALSE;
+    }
+
+    if ( !GetFileSizeEx( m_hFile, &liSize ) || ( ( UINT64 )liSize.QuadPart > 0xFFFFFFFFULL ) )
+    {
+        Unmap();
+        return FALSE;
+    }
+
+    m_qwSize = ( UINT64 )liSize.QuadPart;
+
+    // an empty file cannot be mapped, it has nothing to send either
+    if ( m_qwSize > 0 )
+    {
+        m_hMapping = CreateFileMapping( m_hFile, NULL, PAGE_READONLY, 0, 0, NULL );
+        m_pBase = ( m_hMapping != NULL ) ? ( const BYTE * )MapViewOfFile( m_hMapping, FILE_MAP_READ, 0, 0, 0 ) : NULL;
+
+        if ( m_pBase == NULL )
+        {
+            Unmap();
+            return FALSE;
+        }
+    }
+#else
+    struct stat st;
+
+    m_nFile = open( pszPath, O_RDONLY | O_CLOEXEC );
+
+    if ( m_nFile < 0 )
+    {
+        return FALSE;
+    }
+
+    if ( ( fstat( m_nFile, &st ) != 0 ) || ( ( UINT64 )st.st_size > 0xFFFFFFFFULL ) )
+    {
+        Unmap();
+        return FALSE;
+    }
+
+    m_qwSize = ( UINT64 )st.st_size;
+
+    if ( m_qwSize > 0 )
+    {
+        void *pMapping = mmap( NULL, ( size_t )m_qwSize, PROT_READ, MAP_SHARED, m_nFile, 0 );
+
+        if ( pMapping == MAP_FAILED )
+        {
+            Unmap();
+            return FALSE;
+        }
+
+        // read front to back, a rewind only goes back a window
+        madvise( pMapping, ( size_t )m_qwSize, MADV_SEQUENTIAL );
+        m_pBase = ( const BYTE * )pMapping;
+    }
+#endif
+
+    return TRUE;
+}
+
+void CSerialFileSender::Unmap()
+{
+#ifdef _WIN32
+    if ( m_pBase != NULL )
+    {
+        UnmapViewOfFile( m_pBase );
+    }
+
+    if ( m_hMapping != NULL )
+    {
+        CloseHandle( m_hMapping );
+    }
+
+    if ( m_hFile != INVALID_HANDLE_VALUE )
+    {
+        CloseHandle( m_hFile );
+    }
+
+    m_hMapping = NULL;
+    m_hFile = INVALID_HANDLE_VALUE;
+#else
+    if ( m_pBase != NULL )
+    {
+        munmap( ( void * )m_pBase, ( size_t )m_qwSize );
+    }
+
+    if ( m_nFile >= 0 )
+    {
+        close( m_nFile );
+    }
+
+    m_nFile = -1;
+#endif
+    m_pBase = NULL;
+}
+
+BOOL CSerialFileSender::SendHeader()
+{
+    return SendControl( SERIAL_TRANSFER_SOH, ( UINT32 )m_qwSize, m_strName.data(), ( UINT )m_strName.size() );
+}
+
+BOOL CSerialFileSender::SendEnd()
+{
+    BYTE Crc[sizeof( UINT32 )];
+
+    assert( m_qwCrcEnd == m_qwSize );
+    StoreUint32( Crc, m_dwCrc );
+    return SendControl( SERIAL_TRANSFER_EOT, ( UINT32 )m_qwSize, Crc, sizeof( Crc ) );
+}
+
+void CSerialFileSender::Pump()
+{
+    CSerialBufferPool *pPool = m_pPort->GetBufferPool();
+
+    while ( ( m_State == STATE_DATA ) && ( m_qwNext < m_qwSize ) && ( m_qwNext < m_qwAcked + ( UINT64 )m_nWindow * SERIAL_TRANSFER_BLOCK ) )
+    {
+        UINT64 qwLeft = m_qwSize - m_qwNext;
+        UINT nLength = ( qwLeft < SERIAL_TRANSFER_BLOCK ) ? ( UINT )qwLeft : ( UINT )SERIAL_TRANSFER_BLOCK;
+        const BYTE *pPayload = m_pBase + m_qwNext;
+        SERIAL_BUFFER *pBuffer;
+        SERIAL_TX_BUFFER Segments[3];
+
+        // header and CRC in one small pooled buffer, the payload straight from the mapping
+        if ( ( pBuffer = pPool->Alloc( SERIAL_TRANSFER_HEADER + SERIAL_TRANSFER_TRAILER ) ) == NULL )
+        {
+            break;
+        }
+
+        BYTE *pHeader = pBuffer->pData;
+        BYTE *pTrailer = pBuffer->pData + SERIAL_TRANSFER_HEADER;
+        StoreHeader( pHeader, SERIAL_TRANSFER_STX, ( UINT32 )m_qwNext, nLength );
+        SerialChecksumStore( SERIAL_CHECKSUM_CRC16_XMODEM,
+                             SerialCrc16Xmodem( pPayload, nLength, SerialCrc16Xmodem( pHeader, SERIAL_TRANSFER_HEADER ) ), pTrailer );
+
+        Segments[0].pData = pHeader;
+        Segments[0].nSize = SERIAL_TRANSFER_HEADER;
+        Segments[0].pfnRelease = NULL;
+        Segments[0].pContext = NULL;
+        Segments[1].pData = pPayload;
+        Segments[1].nSize = nLength;
+        Segments[1].pfnRelease = NULL;
+        Segments[1].pContext = NULL;
+        Segments[2].pData = pTrailer;
+        Segments[2].nSize = SERIAL_TRANSFER_TRAILER;
+        Segments[2].pfnRelease = OnReleaseBuffer;
+        Segments[2].pContext = pBuffer;
+
+        // above its high-water mark the lane refuses, OnSent() of a queued packet pumps again
+        if ( !m_pPort->WriteVLane( SERIAL_TX_BULK, Segments, 3, OnSent, this, 0 ) )
+        {
+            SerialBufferRelease( pBuffer );
+            break;
+        }
+
+        m_nQueued++;
+        m_Stats.qwPackets++;
+        m_Stats.qwWireBytes += SERIAL_TRANSFER_HEADER + nLength + SERIAL_TRANSFER_TRAILER;
+
+        if ( m_qwNext < m_qwSent )
+        {
+            m_Stats.qwResent += nLength;
+        }
+
+        // the file CRC follows the first pass, a rewind never skips ahead of it
+        if ( m_qwNext == m_qwCrcEnd )
+        {
+            m_dwCrc = SerialCrc32( pPayload, nLength, m_dwCrc );
+            m_qwCrcEnd += nLength;
+        }
+
+        m_qwNext += nLength;
+        m_qwSent = ( m_qwNext > m_qwSent ) ? m_qwNext : m_qwSent;
+    }
+}
+
+void CSerialFileSender::Rewind( UINT64 qwOffset )
+{
+    // go-back-N, what is still queued goes out and the receiver drops it
+    m_qwNext = qwOffset;
+}
+
+/*
+** CSerialFileReceiver
+*/
+
+CSerialFileReceiver::CSerialFileReceiver()
+{
+    // asks again before the sender repeats on its own
+    m_dwTimeoutMs = SERIAL_TRANSFER_TIMEOUT_MS / 2;
+    m_nRetries = 2 * SERIAL_TRANSFER_RETRIES;
+    m_State = STATE_IDLE;
+    m_pFile = NULL;
+    m_qwSize = 0;
+    m_qwExpected = 0;
+    m_dwCrc = 0;
+    m_bFresh = FALSE;
+    m_bNakSent = FALSE;
+    m_bDuplicateAcked = FALSE;
+    m_FinalStatus = SERIAL_TRANSFER_IDLE;
+}
+
+CSerialFileReceiver::~CSerialFileReceiver()
+{
+    if ( m_pFile != NULL )
+    {
+        fclose( m_pFile );
+    }
+}
+
+BOOL CSerialFileReceiver::Receive( const char *pszPath, BOOL bResume )
+{
+    std::lock_guard<std::mutex> Lock( m_Lock );
+    std::vector<BYTE> Chunk( TRANSFER_READ_CHUNK );
+    size_t nRead;
+
+    if ( m_Status == SERIAL_TRANSFER_RUNNING )
+    {
+        return FALSE;
+    }
+
+    if ( m_pFile != NULL )
+    {
+        fclose( m_pFile );
+    }
+
+    m_strPath = pszPath;
+    m_strName.clear();
+    m_pFile = bResume ? fopen( pszPath, "r+b" ) : NULL;
+    m_pFile = ( m_pFile != NULL ) ? m_pFile : fopen( pszPath, "w+b" );
+    m_qwExpected = 0;
+    m_dwCrc = 0;
+
+    if ( m_pFile == NULL )
+    {
+        m_Status = SERIAL_TRANSFER_FILE_ERROR;
+        return FALSE;
+    }
+
+    // what an earlier transfer left, its CRC tells the sender whether it is the start of the same file
+    while ( ( nRead = fread( &Chunk[0], 1, Chunk.size(), m_pFile ) ) > 0 )
+    {
+        m_dwCrc = SerialCrc32( &Chunk[0], nRead, m_dwCrc );
+        m_qwExpected += nRead;
+    }
+
+    if ( ferror( m_pFile ) || ( m_qwExpected > 0xFFFFFFFFULL ) || !Restart( FALSE ) )
+    {
+        fclose( m_pFile );
+        m_pFile = NULL;
+        m_Status = SERIAL_TRANSFER_FILE_ERROR;
+        return FALSE;
+    }
+
+    m_State = STATE_HEADER;
+    m_FinalStatus = SERIAL_TRANSFER_IDLE;
+    Start();
+    return TRUE;
+}
+
+std::string CSerialFileReceiver::GetName()
+{
+    std::lock_guard<std::mutex> Lock( m_Lock );
+    return m_strName;
+}
+
+void CSerialFileReceiver::OnPacket( std::unique_lock<std::mutex> &Lock, BYTE nType, UINT32 dwOffset,
+                                    const BYTE *pPayload, UINT nLength, UINT64 qwNow )
+{
+    switch ( nType )
+    {
+        case SERIAL_TRANSFER_SOH:
+        {
+            BYTE Crc[sizeof( UINT32 )];
+
+            // repeated while the sender did not get the reply, no data came yet
+            if ( ( m_Status != SERIAL_TRANSFER_RUNNING ) || ( ( m_State != STATE_HEADER ) && !m_bFresh ) )
+            {
+                break;
+            }
+
+            if ( ( m_qwExpected > dwOffset ) && !Restart( TRUE ) )
+            {
+                SendControl( SERIAL_TRANSFER_CAN, 0 );
+                Finish( Lock, SERIAL_TRANSFER_FILE_ERROR );
+                break;
+            }
+
+            m_strName.assign( ( const char * )pPayload, nLength );
+            m_qwSize = dwOffset;
+            m_bFresh = TRUE;
+            m_bNakSent = FALSE;
+            m_bDuplicateAcked = FALSE;
+            StoreUint32( Crc, m_dwCrc );
+            SendControl( SERIAL_TRANSFER_ACK, ( UINT32 )m_qwExpected, Crc, ( m_qwExpected > 0 ) ? sizeof( Crc ) : 0 );
+
+            if ( m_State == STATE_HEADER )
+            {
+                m_State = STATE_DATA;
+                StartData( m_qwSize, m_qwExpected, qwNow );
+                Arm( qwNow );
+            }
+
+            break;
+        }
+
+        case SERIAL_TRANSFER_STX:
+        {
+            if ( ( m_Status == SERIAL_TRANSFER_RUNNING ) && ( m_State == STATE_DATA ) )
+            {
+                OnData( Lock, dwOffset, pPayload, nLength, qwNow );
+            }
+
+            break;
+        }
+
+        case SERIAL_TRANSFER_EOT:
+        {
+            // the final ACK got lost, the sender asks again
+            if ( m_State == STATE_DONE )
+            {
+                if ( m_FinalStatus == SERIAL_TRANSFER_OK )
+                {
+                    SendControl( SERIAL_TRANSFER_ACK, ( UINT32 )m_qwSize );
+                }
+
+                break;
+            }
+
+            if ( ( m_Status != SERIAL_TRANSFER_RUNNING ) || ( m_State != STATE_DATA ) )
+            {
+                break;
+            }
+
+            if ( ( m_qwExpected < m_qwSize ) || ( dwOffset != m_qwSize ) )
+            {
+                SendControl( SERIAL_TRANSFER_NAK, ( UINT32 )m_qwExpected );
+                m_Stats.qwNaks++;
+                break;
+            }
+
+            m_State = STATE_DONE;
+
+            if ( ( fflush( m_pFile ) != 0 ) || ferror( m_pFile ) )
+            {
+                m_FinalStatus = SERIAL_TRANSFER_FILE_ERROR;
+            }
+            else if ( ( nLength != sizeof( UINT32 ) ) || ( LoadUint32( pPayload ) != m_dwCrc ) )
+            {
+                m_FinalStatus = SERIAL_TRANSFER_CORRUPT;
+            }
+            else
+            {
+                m_FinalStatus = SERIAL_TRANSFER_OK;
+            }
+
+            SendControl( ( m_FinalStatus == SERIAL_TRANSFER_OK ) ? SERIAL_TRANSFER_ACK : SERIAL_TRANSFER_CAN,
+                         ( m_FinalStatus == SERIAL_TRANSFER_OK ) ? ( UINT32 )m_qwSize : 0 );
+            Finish( Lock, m_FinalStatus );
+            break;
+        }
+
+        case SERIAL_TRANSFER_CAN:
+        {
+            Finish( Lock, SERIAL_TRANSFER_CANCELLED );
+            break;
+        }
+
+        default:
+            break;
+    }
+}
+
+void CSerialFileReceiver::OnData( std::unique_lock<std::mutex> &Lock, UINT32 dwOffset, const BYTE *pPayload,
+                                  UINT nLength, UINT64 qwNow )
+{
+    // a sender which does not trust what is there starts over at 0
+    if ( ( dwOffset == 0 ) && m_bFresh && ( m_qwExpected > 0 ) )
+    {
+        if ( !Restart( TRUE ) )
+        {
+            SendControl( SERIAL_TRANSFER_CAN, 0 );
+            Finish( Lock, SERIAL_TRANSFER_FILE_ERROR );
+            return;
+        }
+
+        m_Progress.qwStart = 0;
+    }
+
+    if ( dwOffset != m_qwExpected )
+    {
+        m_Stats.qwResent++;
+
+        // one answer per gap or stall, the timeout asks again if it gets lost
+        if ( ( dwOffset > m_qwExpected ) && !m_bNakSent )
+        {
+            SendControl( SERIAL_TRANSFER_NAK, ( UINT32 )m_qwExpected );
+            m_Stats.qwNaks++;
+            m_bNakSent = TRUE;
+        }
+        else if ( ( dwOffset < m_qwExpected ) && !m_bDuplicateAcked )
+        {
+            SendControl( SERIAL_TRANSFER_ACK, ( UINT32 )m_qwExpected );
+            m_bDuplicateAcked = TRUE;
+        }
+
+        return;
+    }
+
+    if ( ( nLength == 0 ) || ( m_qwExpected + nLength > m_qwSize ) )
+    {
+        return;
+    }
+
+    if ( fwrite( pPayload, 1, nLength, m_pFile ) != nLength )
+    {
+        SendControl( SERIAL_TRANSFER_CAN, 0 );
+        Finish( Lock, SERIAL_TRANSFER_FILE_ERROR );
+        return;
+    }
+
+    m_dwCrc = SerialCrc32( pPayload, nLength, m_dwCrc );
+    m_qwExpected += nLength;
+    m_Stats.qwPackets++;
+    m_bFresh = FALSE;
+    m_bNakSent = FALSE;
+    m_bDuplicateAcked = FALSE;
+    SendControl( SERIAL_TRANSFER_ACK, ( UINT32 )m_qwExpected );
+    Advance( Lock, m_qwExpected, qwNow );
+}
+
+void CSerialFileReceiver::OnTimeout( UINT64 qwNow )
+{
+    ( void )qwNow;
+
+    if ( m_State == STATE_DATA )
+    {
+        SendControl( SERIAL_TRANSFER_NAK, ( UINT32 )m_qwExpected );
+        m_Stats.qwNaks++;
+        m_bNakSent = TRUE;
+        m_bDuplicateAcked = FALSE;
+    }
+}
+
+void CSerialFileReceiver::OnFinish()
+{
+    // what was written stays, a later Receive() with bResume continues it
+    if ( m_pFile != NULL )
+    {
+        fclose( m_pFile );
+        m_pFile = NULL;
+    }
+
+    if ( m_State != STATE_DONE )
+    {
+        m_State = STATE_IDLE;
+    }
+}
+
+BOOL CSerialFileReceiver::IsAccepted( BYTE nType )
+{
+    return ( nType == SERIAL_TRANSFER_SOH ) || ( nType == SERIAL_TRANSFER_STX ) || ( nType == SERIAL_TRANSFER_EOT ) ||
+           ( nType == SERIAL_TRANSFER_CAN );
+}
+
+BOOL CSerialFileReceiver::Restart( BOOL bTruncate )
+{
+    if ( bTruncate )
+    {
+        m_pFile = freopen( m_strPath.c_str(), "w+b", m_pFile );
+        m_qwExpected = 0;
+        m_dwCrc = 0;
+
+        if ( m_pFile == NULL )
+        {
+            return FALSE;
+        }
+    }
+
+    // the next payload goes right behind what is there
+    return fseek( m_pFile, ( long )m_qwExpected, SEEK_SET ) == 0;
+}
@@ -0,0 +1,290 @@
+/*
+**  FILENAME            SerialFileTransfer.h
+**
+**  PURPOSE             Bulk file transfer over a port, firmware and configuration
+**                      uploads. XMODEM-1K sized packets with a CRC-16 each, but
+**                      addressed by their offset in the file as in ZMODEM: a
+**                      window of packets is in flight, the receiver acknowledges
+**                      the offset it expects next and a gap makes the sender go
+**                      back to it. The source is sent from a memory-mapped view of
+**                      the file without a copy, a transfer broken off resumes at
+**                      what the receiver already has, and the CRC-32 of the whole
+**                      file is checked at the end.
+**
+**  CREATION DATE       16-10-2026
+**  LAST MODIFICATION   16-10-2026
+*/
+
+#ifndef SERIAL_FILE_TRANSFER_H
+#define SERIAL_FILE_TRANSFER_H
+
+#include "SerialPort.h"
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <stdio.h>
+
+#define SERIAL_TRANSFER_BLOCK       1024                    /* payload of a data packet */
+#define SERIAL_TRANSFER_HEADER      7                       /* type, offset, length */
+#define SERIAL_TRANSFER_TRAILER     2                       /* CRC-16/XMODEM, high byte first */
+#define SERIAL_TRANSFER_MAX_PACKET  ( SERIAL_TRANSFER_HEADER + SERIAL_TRANSFER_BLOCK + SERIAL_TRANSFER_TRAILER )
+#define SERIAL_TRANSFER_WINDOW      16                      /* packets in flight */
+#define SERIAL_TRANSFER_TIMEOUT_MS  3000                    /* without progress, raise it below 4800 baud */
+#define SERIAL_TRANSFER_RETRIES     10                      /* timeouts in a row */
+#define SERIAL_TRANSFER_MAX_NAME    255
+
+/*
+** Packet types, the first byte of a packet. A packet is the type, a 32 bit offset
+** and a 16 bit payload length, both low byte first, the payload and a CRC-16 over
+** all of it:
+**
+**      SOH     size of the file            name
+**      STX     offset of the payload       up to SERIAL_TRANSFER_BLOCK bytes of the file
+**      EOT     size of the file            CRC-32 of the file
+**      ACK     the next offset expected    for the reply to SOH, the CRC-32 of what is there
+**      NAK     resend from this offset
+**      CAN     0                           the transfer is abandoned
+*/
+#define SERIAL_TRANSFER_SOH         0x01
+#define SERIAL_TRANSFER_STX         0x02
+#define SERIAL_TRANSFER_EOT         0x04
+#define SERIAL_TRANSFER_ACK         0x06
+#define SERIAL_TRANSFER_NAK         0x15
+#define SERIAL_TRANSFER_CAN         0x18
+
+typedef enum _SERIAL_TRANSFER_STATUS
+{
+    SERIAL_TRANSFER_IDLE,
+    SERIAL_TRANSFER_RUNNING,
+    SERIAL_TRANSFER_OK,
+    SERIAL_TRANSFER_TIMEOUT,                    // the retries ran out
+    SERIAL_TRANSFER_CANCELLED,                  // Cancel() on either side
+    SERIAL_TRANSFER_FILE_ERROR,                 // could not be opened, mapped or written, or is above 4 GB
+    SERIAL_TRANSFER_CORRUPT                     // the CRC-32 of the whole file did not match
+} SERIAL_TRANSFER_STATUS;
+
+typedef struct _SERIAL_TRANSFER_PROGRESS
+{
+    UINT64              qwSize;                 // of the file, 0 until the receiver has the header
+    UINT64              qwStart;                // resumed from, 0 for a whole transfer
+    UINT64              qwDone;                 // acknowledged by the receiver, written by it
+    UINT64              qwElapsedNs;            // since the data started
+    double              dBytesPerSecond;        // of the file, since the data started
+} SERIAL_TRANSFER_PROGRESS;
+
+typedef struct _SERIAL_TRANSFER_STATS
+{
+    UINT64              qwPackets;              // data packets sent, accepted
+    UINT64              qwResent;               // payload bytes sent again, packets discarded out of order
+    UINT64              qwNaks;                 // received, sent
+    UINT64              qwTimeouts;
+    UINT64              qwCrcErrors;            // packets dropped by their CRC-16
+    UINT64              qwWireBytes;            // sent, framing included
+} SERIAL_TRANSFER_STATS;
+
+/*
+** On the I/O thread, at most every interval of SetProgressCallback() and once at the
+** end; the done callback once per transfer. No lock is held, both may Cancel().
+*/
+typedef void ( *SERIAL_TRANSFER_PROGRESS_CALLBACK )( void *pContext, const SERIAL_TRANSFER_PROGRESS *pProgress );
+typedef void ( *SERIAL_TRANSFER_DONE_CALLBACK )( void *pContext, SERIAL_TRANSFER_STATUS Status );
+
+/*
+** What both ends share: the receive side of the port, the packet parser, the timer
+** and the outcome. The timer is the receive notification deadline of the port (so it
+** cannot be combined with CSerialCoPort or CSerialTransactor). Close the port before
+** the end goes away.
+*/
+class CSerialTransfer
+{
+    public:
+        virtual ~CSerialTransfer();
+
+        // before Open(), takes over the receive callback and notification of the port
+        void                Attach( CSerialPort *pPort );
+        // any time, used from the next timeout on
+        void                SetTimeout( DWORD dwTimeoutMs, UINT nRetries = SERIAL_TRANSFER_RETRIES );
+        void                SetProgressCallback( SERIAL_TRANSFER_PROGRESS_CALLBACK pfnCallback, void *pContext, DWORD dwIntervalMs = 100 );
+        void                SetDoneCallback( SERIAL_TRANSFER_DONE_CALLBACK pfnCallback, void *pContext );
+
+        // tells the other end and ends the transfer, a receiver keeps what it has for a resume
+        void                Cancel();
+        // TRUE once the transfer ended, whatever the outcome
+        BOOL                Wait( DWORD dwTimeout = INFINITE );
+        SERIAL_TRANSFER_STATUS GetStatus();
+        void                GetProgress( SERIAL_TRANSFER_PROGRESS *pProgress );
+        void                GetStats( SERIAL_TRANSFER_STATS *pStats, BOOL bReset = FALSE );
+
+    protected:
+        CSerialTransfer();
+
+        // with m_Lock held, a packet with a valid CRC-16 and one of the types of the end
+        virtual void        OnPacket( std::unique_lock<std::mutex> &Lock, BYTE nType, UINT32 dwOffset,
+                                      const BYTE *pPayload, UINT nLength, UINT64 qwNow ) = 0;
+        // with m_Lock held, m_dwTimeoutMs passed without activity
+        virtual void        OnTimeout( UINT64 qwNow ) = 0;
+        // with m_Lock held, when the transfer ends; files are closed here
+        virtual void        OnFinish() = 0;
+        virtual BOOL        IsAccepted( BYTE nType ) = 0;
+
+        // with m_Lock held
+        BOOL                SendControl( BYTE nType, UINT32 dwOffset, const void *pPayload = NULL, UINT nLength = 0 );
+        void                Start();
+        void                Arm( UINT64 qwNow );    // starts the timeout, it runs until Finish()
+        void                Touch( UINT64 qwNow );  // progress, pushes the timeout out
+        void                StartData( UINT64 qwSize, UINT64 qwStart, UINT64 qwNow );
+        void                Advance( std::unique_lock<std::mutex> &Lock, UINT64 qwDone, UINT64 qwNow );
+        void                Finish( std::unique_lock<std::mutex> &Lock, SERIAL_TRANSFER_STATUS Status );
+
+        CSerialPort         *m_pPort;
+        std::mutex          m_Lock;
+        SERIAL_TRANSFER_STATUS m_Status;
+        DWORD               m_dwTimeoutMs;
+        UINT                m_nRetries;
+        UINT                m_nTimeouts;            // in a row
+        SERIAL_TRANSFER_PROGRESS m_Progress;
+        SERIAL_TRANSFER_STATS m_Stats;
+        std::condition_variable m_cvDone;           // the end of a transfer, of the sender's queued packets
+
+    private:
+        CSerialTransfer( const CSerialTransfer & );
+        CSerialTransfer     &operator=( const CSerialTransfer & );
+
+        static void         OnRx( void *pContext, const BYTE *pData, UINT nLength, UINT64 qwTimestamp );
+        static void         OnNotify( void *pContext, UINT64 qwNow );
+        void                Parse( std::unique_lock<std::mutex> &Lock, UINT64 qwNow );
+        void                Report( std::unique_lock<std::mutex> &Lock, UINT64 qwNow, BOOL bForce );
+
+        // I/O thread only, the bytes of a packet not complete yet
+        BYTE                m_Pending[2 * SERIAL_TRANSFER_MAX_PACKET];
+        UINT                m_nPending;
+
+        UINT64              m_qwActivity;           // last progress, the timeout counts from it, 0 unarmed
+        UINT64              m_qwDataStart;
+        UINT64              m_qwReported;
+        SERIAL_TRANSFER_PROGRESS_CALLBACK m_pfnProgress;
+        void                *m_pProgressContext;
+        UINT64              m_qwProgressIntervalNs;
+        SERIAL_TRANSFER_DONE_CALLBACK m_pfnDone;
+        void                *m_pDoneContext;
+};
+
+/*
+** Sends one file at a time. The data packets reference the mapped file in the
+** SERIAL_TX_BULK lane of the port, the mapping goes away once the last of them was
+** written. The other packets, and everything else written to the port, go ahead of
+** them with the default strict scheduling.
+*/
+class CSerialFileSender : public CSerialTransfer
+{
+    public:
+        CSerialFileSender();
+        ~CSerialFileSender();
+
+        // packets unacknowledged at a time, 1 is stop-and-wait; any time
+        void                SetWindow( UINT nWindow );
+        /*
+        ** Any thread, returns at once; FALSE when a transfer is running or the file
+        ** cannot be mapped. pszName goes to the receiver, NULL for the file part of pszPath.
+        */
+        BOOL                Send( const char *pszPath, const char *pszName = NULL );
+
+    protected:
+        virtual void        OnPacket( std::unique_lock<std::mutex> &Lock, BYTE nType, UINT32 dwOffset,
+                                      const BYTE *pPayload, UINT nLength, UINT64 qwNow );
+        virtual void        OnTimeout( UINT64 qwNow );
+        virtual void        OnFinish();
+        virtual BOOL        IsAccepted( BYTE nType );
+
+    private:
+        enum STATE
+        {
+            STATE_IDLE,
+            STATE_HEADER,                           // SOH sent, waiting for the offset to start at
+            STATE_DATA,
+            STATE_END                               // EOT sent, waiting for the final ACK
+        };
+
+        static void         OnSent( void *pContext, DWORD dwBytesWritten, BOOL bSuccess );
+        static void         OnReleaseBuffer( void *pContext, const void *pData, UINT nSize );
+
+        // with m_Lock held
+        BOOL                Map( const char *pszPath );
+        void                Unmap();
+        BOOL                SendHeader();
+        BOOL                SendEnd();
+        void                Pump();                 // data packets while the window has room
+        void                Rewind( UINT64 qwOffset );
+
+        STATE               m_State;
+        UINT                m_nWindow;
+        std::string         m_strName;
+        const BYTE          *m_pBase;
+        UINT64              m_qwSize;
+#ifdef _WIN32
+        HANDLE              m_hFile;
+        HANDLE              m_hMapping;
+#else
+        int                 m_nFile;
+#endif
+        UINT64              m_qwAcked;              // the receiver has everything before it
+        UINT64              m_qwNext;               // next payload to send
+        UINT64              m_qwSent;               // end of what was sent so far
+        UINT32              m_dwCrc;                // CRC-32 of the file up to m_qwCrcEnd
+        UINT64              m_qwCrcEnd;
+        UINT                m_nQueued;              // packets in the transmit queue of the port
+};
+
+/*
+** The reference receiver. The file is written in order, so what is on disk after a
+** broken off transfer is a valid start to resume from.
+*/
+class CSerialFileReceiver : public CSerialTransfer
+{
+    public:
+        CSerialFileReceiver();
+        ~CSerialFileReceiver();
+
+        /*
+        ** Any thread, returns at once and takes the next file offered into pszPath.
+        ** With bResume what is already there is offered to the sender, which sends the
+        ** rest when its own file starts with the same bytes and all of it otherwise.
+        */
+        BOOL                Receive( const char *pszPath, BOOL bResume = FALSE );
+        std::string         GetName();              // as the sender gave it
+
+    protected:
+        virtual void        OnPacket( std::unique_lock<std::mutex> &Lock, BYTE nType, UINT32 dwOffset,
+                                      const BYTE *pPayload, UINT nLength, UINT64 qwNow );
+        virtual void        OnTimeout( UINT64 qwNow );
+        virtual void        OnFinish();
+        virtual BOOL        IsAccepted( BYTE nType );
+
+    private:
+        enum STATE
+        {
+            STATE_IDLE,
+            STATE_HEADER,                           // waiting for a sender
+            STATE_DATA,
+            STATE_DONE                              // final ACK sent, repeated if the sender asks again
+        };
+
+        // with m_Lock held
+        BOOL                Restart( BOOL bTruncate );  // positions behind what is kept, nothing with bTruncate
+        void                OnData( std::unique_lock<std::mutex> &Lock, UINT32 dwOffset, const BYTE *pPayload,
+                                    UINT nLength, UINT64 qwNow );
+
+        STATE               m_State;
+        std::string         m_strPath;
+        std::string         m_strName;
+        FILE                *m_pFile;
+        UINT64              m_qwSize;
+        UINT64              m_qwExpected;           // next offset, everything before it is in the file
+        UINT32              m_dwCrc;                // CRC-32 of the file up to m_qwExpected
+        BOOL                m_bFresh;               // nothing accepted since the header, the sender may start over
+        BOOL                m_bNakSent;             // for the current gap, one NAK until a timeout
+        BOOL                m_bDuplicateAcked;      // for the current stall, one ACK for old packets
+        SERIAL_TRANSFER_STATUS m_FinalStatus;       // answered to a repeated EOT in STATE_DONE
+};
+
+#endif // SERIAL_FILE_TRANSFER_H
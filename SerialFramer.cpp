@@ -0,0 +1,793 @@
+/*
+**  FILENAME            SerialFramer.cpp
+**
+**  PURPOSE             Frame decoders fed with the received byte stream on the I/O
+**                      thread, and the vectorized delimiter scan they share.
+**
+**  CREATION DATE       16-10-2026
+**  LAST MODIFICATION   16-10-2026
+*/
+
+#ifdef _WIN32
+#include "stdafx.h"
+#endif
+#include "SerialFramer.h"
+#include <assert.h>
+#include <string.h>
+
+#if defined( _M_X64 ) || defined( __x86_64__ )
+#define SERIAL_FRAMER_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define SERIAL_TARGET_AVX2
+#else
+#define SERIAL_TARGET_AVX2          __attribute__(( target( "avx2" ) ))
+#endif
+#endif
+
+#define SLIP_END            0xC0
+#define SLIP_ESC            0xDB
+#define SLIP_ESC_END        0xDC
+#define SLIP_ESC_ESC        0xDD
+
+#ifdef SERIAL_FRAMER_X86
+static inline UINT LowestBit( UINT nMask )
+{
+#ifdef _MSC_VER
+    unsigned long nIndex;
+    _BitScanForward( &nIndex, nMask );
+    return ( UINT )nIndex;
+#else
+    return ( UINT )__builtin_ctz( nMask );
+#endif
+}
+
+static const BYTE *FindByteSse2( const BYTE *pData, UINT nLength, BYTE c )
+{
+    const __m128i Needle = _mm_set1_epi8( ( char )c );
+    UINT i = 0;
+
+    for ( ; i + 16 <= nLength; i += 16 )
+    {
+        __m128i Block = _mm_loadu_si128( ( const __m128i * )( pData + i ) );
+        UINT nMask = ( UINT )_mm_movemask_epi8( _mm_cmpeq_epi8( Block, Needle ) );
+
+        if ( nMask != 0 )
+        {
+            return pData + i + LowestBit( nMask );
+        }
+    }
+
+    for ( ; i < nLength; i++ )
+    {
+        if ( pData[i] == c )
+        {
+            return pData + i;
+        }
+    }
+
+    return NULL;
+}
+
+SERIAL_TARGET_AVX2 static const BYTE *FindByteAvx2( const BYTE *pData, UINT nLength, BYTE c )
+{
+    const __m256i Needle = _mm256_set1_epi8( ( char )c );
+    UINT i = 0;
+
+    // two blocks per step, the common case of a long frame has no match in either
+    for ( ; i + 64 <= nLength; i += 64 )
+    {
+        __m256i Match0 = _mm256_cmpeq_epi8( _mm256_loadu_si256( ( const __m256i * )( pData + i ) ), Needle );
+        __m256i Match1 = _mm256_cmpeq_epi8( _mm256_loadu_si256( ( const __m256i * )( pData + i + 32 ) ), Needle );
+
+        if ( !_mm256_testz_si256( _mm256_or_si256( Match0, Match1 ), _mm256_or_si256( Match0, Match1 ) ) )
+        {
+            UINT nMask = ( UINT )_mm256_movemask_epi8( Match0 );
+
+            if ( nMask != 0 )
+            {
+                return pData + i + LowestBit( nMask );
+            }
+
+            return pData + i + 32 + LowestBit( ( UINT )_mm256_movemask_epi8( Match1 ) );
+        }
+    }
+
+    for ( ; i + 32 <= nLength; i += 32 )
+    {
+        UINT nMask = ( UINT )_mm256_movemask_epi8( _mm256_cmpeq_epi8( _mm256_loadu_si256( ( const __m256i * )( pData + i ) ), Needle ) );
+
+        if ( nMask != 0 )
+        {
+            return pData + i + LowestBit( nMask );
+        }
+    }
+
+    return FindByteSse2( pData + i, nLength - i, c );
+}
+
+static BOOL HasAvx2()
+{
+#ifdef _MSC_VER
+    int Regs[4];
+    __cpuid( Regs, 1 );
+
+    // OSXSAVE and the OS saving the YMM registers
+    if ( ( ( Regs[2] & ( 1 << 27 ) ) == 0 ) || ( ( _xgetbv( 0 ) & 6 ) != 6 ) )
+    {
+        return FALSE;
+    }
+
+    __cpuidex( Regs, 7, 0 );
+    return ( Regs[1] & ( 1 << 5 ) ) != 0;
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports( "avx2" ) ? TRUE : FALSE;
+#endif
+}
+#endif
+
+typedef const BYTE *( *FIND_BYTE )( const BYTE *pData, UINT nLength, BYTE c );
+
+#ifndef SERIAL_FRAMER_X86
+static const BYTE *FindByteScalar( const BYTE *pData, UINT nLength, BYTE c )
+{
+    return ( const BYTE * )memchr( pData, c, nLength );
+}
+#endif
+
+static FIND_BYTE SelectFindByte()
+{
+#ifdef SERIAL_FRAMER_X86
+    return HasAvx2() ? FindByteAvx2 : FindByteSse2;
+#else
+    return FindByteScalar;
+#endif
+}
+
+const BYTE *SerialFindByte( const BYTE *pData, UINT nLength, BYTE c )
+{
+    static const FIND_BYTE pfnFind = SelectFindByte();
+    return pfnFind( pData, nLength, c );
+}
+
+CSerialFramer::CSerialFramer()
+{
+    m_pfnCallback = NULL;
+    m_pfnBufferCallback = NULL;
+    m_pContext = NULL;
+    m_pPool = NULL;
+    m_nMaxFrame = SERIAL_FRAME_MAX_SIZE;
+    m_Checksum = SERIAL_CHECKSUM_NONE;
+    m_qwCharTime = 0;
+    m_qwTimestamp = 0;
+    m_qwFrameTime = 0;
+    ResetStats();
+}
+
+CSerialFramer::~CSerialFramer()
+{
+}
+
+void CSerialFramer::SetCallback( SERIAL_FRAME_CALLBACK pfnCallback, void *pContext )
+{
+    m_pfnCallback = pfnCallback;
+    m_pfnBufferCallback = NULL;
+    m_pContext = pContext;
+    m_pPool = NULL;
+}
+
+void CSerialFramer::SetCallback( SERIAL_FRAME_BUFFER_CALLBACK pfnCallback, void *pContext, CSerialBufferPool *pPool )
+{
+    assert( ( pfnCallback == NULL ) || ( pPool != NULL ) );
+    m_pfnCallback = NULL;
+    m_pfnBufferCallback = pfnCallback;
+    m_pContext = pContext;
+    m_pPool = pPool;
+}
+
+void CSerialFramer::SetMaxFrameSize( UINT nSize )
+{
+    assert( nSize > 0 );
+    m_nMaxFrame = nSize;
+}
+
+void CSerialFramer::SetChecksum( SERIAL_CHECKSUM Type )
+{
+    m_Checksum = Type;
+}
+
+void CSerialFramer::Reset()
+{
+    m_Frame.clear();
+}
+
+void CSerialFramer::Feed( const BYTE *pData, UINT nLength, UINT64 qwTimestamp )
+{
+    m_qwTimestamp = qwTimestamp;
+    m_qwFrameTime = qwTimestamp;
+    Input( pData, nLength );
+}
+
+UINT64 CSerialFramer::GetDeadline()
+{
+    return 0;
+}
+
+void CSerialFramer::OnIdle( UINT64 qwNow )
+{
+    ( void )qwNow;
+}
+
+void CSerialFramer::SetCharacterTime( UINT64 qwNs )
+{
+    m_qwCharTime.store( qwNs, std::memory_order_relaxed );
+}
+
+void CSerialFramer::GetStats( SERIAL_FRAMER_STATS *pStats )
+{
+    pStats->qwFrames = m_qwFrames.load( std::memory_order_relaxed );
+    pStats->qwFrameBytes = m_qwFrameBytes.load( std::memory_order_relaxed );
+    pStats->qwGarbageBytes = m_qwGarbageBytes.load( std::memory_order_relaxed );
+    pStats->qwResyncs = m_qwResyncs.load( std::memory_order_relaxed );
+    pStats->qwOversize = m_qwOversize.load( std::memory_order_relaxed );
+    pStats->qwChecksumErrors = m_qwChecksumErrors.load( std::memory_order_relaxed );
+    pStats->qwNoBuffer = m_qwNoBuffer.load( std::memory_order_relaxed );
+}
+
+void CSerialFramer::ResetStats()
+{
+    m_qwFrames = 0;
+    m_qwFrameBytes = 0;
+    m_qwGarbageBytes = 0;
+    m_qwResyncs = 0;
+    m_qwOversize = 0;
+    m_qwChecksumErrors = 0;
+    m_qwNoBuffer = 0;
+}
+
+void CSerialFramer::Emit( const BYTE *pFrame, UINT nLength )
+{
+    if ( m_Checksum != SERIAL_CHECKSUM_NONE )
+    {
+        if ( !SerialChecksumVerify( m_Checksum, pFrame, nLength ) )
+        {
+            m_qwChecksumErrors.store( m_qwChecksumErrors.load( std::memory_order_relaxed ) + 1, std::memory_order_relaxed );
+            Drop( nLength );
+            return;
+        }
+
+        nLength -= SerialChecksumSize( m_Checksum );
+    }
+
+    SERIAL_BUFFER *pBuffer = ( m_pfnBufferCallback != NULL ) ? m_pPool->Alloc( nLength ) : NULL;
+
+    // only the I/O thread writes the counters, no read-modify-write needed
+    if ( ( m_pfnBufferCallback != NULL ) && ( pBuffer == NULL ) )
+    {
+        m_qwNoBuffer.store( m_qwNoBuffer.load( std::memory_order_relaxed ) + 1, std::memory_order_relaxed );
+        return;
+    }
+
+    m_qwFrames.store( m_qwFrames.load( std::memory_order_relaxed ) + 1, std::memory_order_relaxed );
+    m_qwFrameBytes.store( m_qwFrameBytes.load( std::memory_order_relaxed ) + nLength, std::memory_order_relaxed );
+
+    if ( m_pfnCallback != NULL )
+    {
+        m_pfnCallback( m_pContext, pFrame, nLength );
+    }
+    else if ( pBuffer != NULL )
+    {
+        memcpy( pBuffer->pData, pFrame, nLength );
+        pBuffer->qwTimestamp = m_qwFrameTime;
+        m_pfnBufferCallback( m_pContext, pBuffer );
+    }
+}
+
+void CSerialFramer::Drop( UINT64 nBytes )
+{
+    m_qwGarbageBytes.store( m_qwGarbageBytes.load( std::memory_order_relaxed ) + nBytes, std::memory_order_relaxed );
+}
+
+void CSerialFramer::Resync()
+{
+    m_qwResyncs.store( m_qwResyncs.load( std::memory_order_relaxed ) + 1, std::memory_order_relaxed );
+}
+
+void CSerialFramer::Oversize()
+{
+    m_qwOversize.store( m_qwOversize.load( std::memory_order_relaxed ) + 1, std::memory_order_relaxed );
+}
+
+CSerialLineFramer::CSerialLineFramer( BYTE cDelimiter, BOOL bStripCR )
+{
+    m_cDelimiter = cDelimiter;
+    m_bStripCR = bStripCR;
+    m_bDiscarding = FALSE;
+}
+
+void CSerialLineFramer::Reset()
+{
+    CSerialFramer::Reset();
+    m_bDiscarding = FALSE;
+}
+
+void CSerialLineFramer::EmitLine( const BYTE *pLine, UINT nLength )
+{
+    if ( m_bStripCR && ( nLength > 0 ) && ( pLine[nLength - 1] == '\r' ) )
+    {
+        nLength--;
+    }
+
+    Emit( pLine, nLength );
+}
+
+void CSerialLineFramer::Input( const BYTE *pData, UINT nLength )
+{
+    while ( nLength > 0 )
+    {
+        const BYTE *pEnd = SerialFindByte( pData, nLength, m_cDelimiter );
+        UINT nSpan = ( pEnd != NULL ) ? ( UINT )( pEnd - pData ) : nLength;
+        UINT nDelimiter = ( pEnd != NULL ) ? 1 : 0;
+
+        if ( m_bDiscarding )
+        {
+            // rest of an oversize line
+            Drop( nSpan + nDelimiter );
+            m_bDiscarding = ( pEnd == NULL );
+        }
+        else if ( m_Frame.size() + nSpan > GetMaxFrameSize() )
+        {
+            Oversize();
+            Drop( m_Frame.size() + nSpan + nDelimiter );
+            m_Frame.clear();
+            m_bDiscarding = ( pEnd == NULL );
+        }
+        else if ( ( pEnd != NULL ) && m_Frame.empty() )
+        {
+            // the whole line is in this chunk, deliver it in place
+            EmitLine( pData, nSpan );
+        }
+        else
+        {
+            m_Frame.insert( m_Frame.end(), pData, pData + nSpan );
+
+            if ( pEnd != NULL )
+            {
+                EmitLine( m_Frame.data(), ( UINT )m_Frame.size() );
+                m_Frame.clear();
+            }
+        }
+
+        pData += nSpan + nDelimiter;
+        nLength -= nSpan + nDelimiter;
+    }
+}
+
+CSerialLengthFramer::CSerialLengthFramer( UINT nFieldSize, BOOL bBigEndian, int nAdjust )
+{
+    assert( ( nFieldSize == 1 ) || ( nFieldSize == 2 ) || ( nFieldSize == 4 ) );
+    m_nFieldSize = nFieldSize;
+    m_bBigEndian = bBigEndian;
+    m_nAdjust = nAdjust;
+    m_nPayload = 0;
+    m_bInSync = TRUE;
+}
+
+void CSerialLengthFramer::Reset()
+{
+    CSerialFramer::Reset();
+    m_nPayload = 0;
+    m_bInSync = TRUE;
+}
+
+BOOL CSerialLengthFramer::ParseHeader( const BYTE *pHeader, UINT *pnPayload )
+{
+    UINT64 qwValue = 0;
+    INT64 qwPayload;
+
+    for ( UINT i = 0; i < m_nFieldSize; i++ )
+    {
+        UINT nByte = m_bBigEndian ? pHeader[i] : pHeader[m_nFieldSize - 1 - i];
+        qwValue = ( qwValue << 8 ) | nByte;
+    }
+
+    qwPayload = ( INT64 )qwValue + m_nAdjust;
+
+    if ( ( qwPayload < 0 ) || ( qwPayload > ( INT64 )GetMaxFrameSize() ) )
+    {
+        if ( m_bInSync )
+        {
+            Resync();
+            m_bInSync = FALSE;
+        }
+
+        return FALSE;
+    }
+
+    m_bInSync = TRUE;
+    *pnPayload = ( UINT )qwPayload;
+    return TRUE;
+}
+
+void CSerialLengthFramer::Input( const BYTE *pData, UINT nLength )
+{
+    while ( nLength > 0 )
+    {
+        UINT nTake;
+
+        if ( m_Frame.empty() )
+        {
+            UINT nPayload;
+
+            // whole frames inside the chunk are delivered in place
+            while ( nLength >= m_nFieldSize )
+            {
+                if ( !ParseHeader( pData, &nPayload ) )
+                {
+                    Drop( 1 );
+                    pData++;
+                    nLength--;
+                    continue;
+                }
+
+                if ( nLength - m_nFieldSize < nPayload )
+                {
+                    break;
+                }
+
+                Emit( pData + m_nFieldSize, nPayload );
+                pData += m_nFieldSize + nPayload;
+                nLength -= m_nFieldSize + nPayload;
+            }
+
+            if ( nLength == 0 )
+            {
+                break;
+            }
+        }
+
+        if ( m_Frame.size() < m_nFieldSize )
+        {
+            nTake = m_nFieldSize - ( UINT )m_Frame.size();
+            nTake = ( nTake < nLength ) ? nTake : nLength;
+            m_Frame.insert( m_Frame.end(), pData, pData + nTake );
+            pData += nTake;
+            nLength -= nTake;
+
+            if ( m_Frame.size() < m_nFieldSize )
+            {
+                break;
+            }
+
+            if ( !ParseHeader( m_Frame.data(), &m_nPayload ) )
+            {
+                // slide by one byte, the rest of the field may start the next header
+                BYTE Rest[4];
+                UINT nRest = m_nFieldSize - 1;
+                memcpy( Rest, m_Frame.data() + 1, nRest );
+                m_Frame.clear();
+                Drop( 1 );
+                Input( Rest, nRest );
+                continue;
+            }
+        }
+
+        nTake = m_nFieldSize + m_nPayload - ( UINT )m_Frame.size();
+        nTake = ( nTake < nLength ) ? nTake : nLength;
+        m_Frame.insert( m_Frame.end(), pData, pData + nTake );
+        pData += nTake;
+        nLength -= nTake;
+
+        if ( m_Frame.size() == m_nFieldSize + m_nPayload )
+        {
+            Emit( m_Frame.data() + m_nFieldSize, m_nPayload );
+            m_Frame.clear();
+        }
+    }
+}
+
+CSerialSlipFramer::CSerialSlipFramer()
+{
+    m_bEscape = FALSE;
+    m_bDiscarding = FALSE;
+}
+
+void CSerialSlipFramer::Reset()
+{
+    CSerialFramer::Reset();
+    m_bEscape = FALSE;
+    m_bDiscarding = FALSE;
+}
+
+void CSerialSlipFramer::Input( const BYTE *pData, UINT nLength )
+{
+    while ( nLength > 0 )
+    {
+        const BYTE *pEnd = SerialFindByte( pData, nLength, SLIP_END );
+        UINT nSpan = ( pEnd != NULL ) ? ( UINT )( pEnd - pData ) : nLength;
+
+        if ( m_bDiscarding )
+        {
+            Drop( nSpan );
+        }
+        else if ( ( pEnd != NULL ) && m_Frame.empty() && !m_bEscape &&
+                  ( SerialFindByte( pData, nSpan, SLIP_ESC ) == NULL ) )
+        {
+            // nothing to unescape, deliver in place
+            if ( nSpan > GetMaxFrameSize() )
+            {
+                Oversize();
+                Drop( nSpan );
+            }
+            else if ( nSpan > 0 )
+            {
+                Emit( pData, nSpan );
+            }
+        }
+        else
+        {
+            for ( UINT i = 0; i < nSpan; i++ )
+            {
+                BYTE c = pData[i];
+
+                if ( m_bEscape )
+                {
+                    m_bEscape = FALSE;
+
+                    if ( c == SLIP_ESC_END )
+                    {
+                        c = SLIP_END;
+                    }
+                    else if ( c == SLIP_ESC_ESC )
+                    {
+                        c = SLIP_ESC;
+                    }
+                    else
+                    {
+                        // protocol violation, the frame is lost
+                        Resync();
+                        Drop( m_Frame.size() + nSpan - i );
+                        m_Frame.clear();
+                        m_bDiscarding = TRUE;
+                        break;
+                    }
+                }
+                else if ( c == SLIP_ESC )
+                {
+                    m_bEscape = TRUE;
+                    continue;
+                }
+
+                if ( m_Frame.size() >= GetMaxFrameSize() )
+                {
+                    Oversize();
+                    Drop( m_Frame.size() + nSpan - i );
+                    m_Frame.clear();
+                    m_bDiscarding = TRUE;
+                    break;
+                }
+
+                m_Frame.push_back( c );
+            }
+
+            if ( ( pEnd != NULL ) && !m_bDiscarding )
+            {
+                if ( m_bEscape )
+                {
+                    // ESC END
+                    Resync();
+                    Drop( m_Frame.size() );
+                }
+                else if ( !m_Frame.empty() )
+                {
+                    Emit( m_Frame.data(), ( UINT )m_Frame.size() );
+                }
+
+                m_Frame.clear();
+                m_bEscape = FALSE;
+            }
+        }
+
+        if ( pEnd == NULL )
+        {
+            break;
+        }
+
+        // END starts a clean frame
+        m_bDiscarding = FALSE;
+        m_bEscape = FALSE;
+        pData += nSpan + 1;
+        nLength -= nSpan + 1;
+    }
+}
+
+CSerialCobsFramer::CSerialCobsFramer()
+{
+    m_bDiscarding = FALSE;
+}
+
+void CSerialCobsFramer::Reset()
+{
+    CSerialFramer::Reset();
+    m_bDiscarding = FALSE;
+}
+
+void CSerialCobsFramer::Decode( const BYTE *pData, UINT nLength )
+{
+    UINT i = 0;
+    UINT nOut = 0;
+
+    if ( nLength == 0 )
+    {
+        return;
+    }
+
+    // the decoded frame is one byte shorter than the encoded one at least
+    m_Decoded.resize( nLength );
+
+    while ( i < nLength )
+    {
+        UINT nCode = pData[i];
+
+        if ( i + nCode > nLength )
+        {
+            // code points past the delimiter, the frame is corrupt or truncated
+            Resync();
+            Drop( nLength );
+            return;
+        }
+
+        memcpy( &m_Decoded[nOut], pData + i + 1, nCode - 1 );
+        nOut += nCode - 1;
+        i += nCode;
+
+        if ( ( nCode < 0xFF ) && ( i < nLength ) )
+        {
+            m_Decoded[nOut++] = 0;
+        }
+    }
+
+    if ( nOut > GetMaxFrameSize() )
+    {
+        Oversize();
+        Drop( nLength );
+        return;
+    }
+
+    Emit( m_Decoded.data(), nOut );
+}
+
+void CSerialCobsFramer::Input( const BYTE *pData, UINT nLength )
+{
+    // a frame of nMax bytes takes one code byte per 254 bytes more when encoded
+    UINT nMaxEncoded = GetMaxFrameSize() + GetMaxFrameSize() / 254 + 1;
+
+    while ( nLength > 0 )
+    {
+        const BYTE *pEnd = SerialFindByte( pData, nLength, 0 );
+        UINT nSpan = ( pEnd != NULL ) ? ( UINT )( pEnd - pData ) : nLength;
+        UINT nDelimiter = ( pEnd != NULL ) ? 1 : 0;
+
+        if ( m_bDiscarding )
+        {
+            Drop( nSpan );
+            m_bDiscarding = ( pEnd == NULL );
+        }
+        else if ( m_Frame.size() + nSpan > nMaxEncoded )
+        {
+            Oversize();
+            Drop( m_Frame.size() + nSpan );
+            m_Frame.clear();
+            m_bDiscarding = ( pEnd == NULL );
+        }
+        else if ( ( pEnd != NULL ) && m_Frame.empty() )
+        {
+            Decode( pData, nSpan );
+        }
+        else
+        {
+            m_Frame.insert( m_Frame.end(), pData, pData + nSpan );
+
+            if ( pEnd != NULL )
+            {
+                Decode( m_Frame.data(), ( UINT )m_Frame.size() );
+                m_Frame.clear();
+            }
+        }
+
+        pData += nSpan + nDelimiter;
+        nLength -= nSpan + nDelimiter;
+    }
+}
+
+CSerialGapFramer::CSerialGapFramer( double dCharTimes, UINT64 qwMinGapNs )
+{
+    assert( dCharTimes > 0.0 );
+    m_dCharTimes = dCharTimes;
+    m_qwMinGap = qwMinGapNs;
+    m_qwLastByte = 0;
+    m_bPending = FALSE;
+    m_bDiscarding = FALSE;
+}
+
+void CSerialGapFramer::Reset()
+{
+    CSerialFramer::Reset();
+    m_bPending = FALSE;
+    m_bDiscarding = FALSE;
+}
+
+UINT64 CSerialGapFramer::GetGap() const
+{
+    UINT64 qwGap = ( UINT64 )( m_dCharTimes * ( double )GetCharacterTime() );
+    return ( qwGap > m_qwMinGap ) ? qwGap : m_qwMinGap;
+}
+
+UINT64 CSerialGapFramer::GetDeadline()
+{
+    return m_bPending ? m_qwLastByte + GetGap() : 0;
+}
+
+void CSerialGapFramer::OnIdle( UINT64 qwNow )
+{
+    if ( m_bPending && ( qwNow >= m_qwLastByte + GetGap() ) )
+    {
+        Finish();
+    }
+}
+
+void CSerialGapFramer::Finish()
+{
+    if ( !m_bDiscarding )
+    {
+        m_qwFrameTime = m_qwLastByte;
+        Emit( m_Frame.data(), ( UINT )m_Frame.size() );
+    }
+
+    m_Frame.clear();
+    m_bPending = FALSE;
+    m_bDiscarding = FALSE;
+}
+
+void CSerialGapFramer::Input( const BYTE *pData, UINT nLength )
+{
+    UINT64 qwSpread;
+    UINT64 qwFirst;
+
+    if ( nLength == 0 )
+    {
+        return;
+    }
+
+    // the first byte of the chunk came in nLength - 1 character times before the read returned
+    qwSpread = ( UINT64 )( nLength - 1 ) * GetCharacterTime();
+    qwFirst = ( m_qwTimestamp > qwSpread ) ? m_qwTimestamp - qwSpread : 0;
+
+    if ( m_bPending && ( qwFirst >= m_qwLastByte + GetGap() ) )
+    {
+        Finish();
+    }
+
+    m_bPending = TRUE;
+    m_qwLastByte = m_qwTimestamp;
+
+    if ( m_bDiscarding )
+    {
+        Drop( nLength );
+    }
+    else if ( m_Frame.size() + nLength > GetMaxFrameSize() )
+    {
+        // the rest of the frame goes as well, up to the next gap
+        Oversize();
+        Drop( m_Frame.size() + nLength );
+        m_Frame.clear();
+        m_bDiscarding = TRUE;
+    }
+    else
+    {
+        // the end is only known after the gap, so the frame is always collected
+        m_Frame.insert( m_Frame.end(), pData, pData + nLength );
+    }
+}
@@ -0,0 +1,251 @@
+/*
+**  FILENAME            SerialFramer.h
+**
+**  PURPOSE             Frame decoders fed with the received byte stream on the I/O
+**                      thread. Each one hands complete frames to its consumer and
+**                      counts the bytes it had to throw away to find the next one.
+**
+**  CREATION DATE       16-10-2026
+**  LAST MODIFICATION   16-10-2026
+*/
+
+#ifndef SERIAL_FRAMER_H
+#define SERIAL_FRAMER_H
+
+#ifndef _WIN32
+#include "SerialPortPosix.h"
+#endif
+#include "SerialBufferPool.h"
+#include "SerialChecksum.h"
+#include <atomic>
+#include <vector>
+
+#define SERIAL_FRAME_MAX_SIZE       4096UL                  /* default limit, longer frames are dropped */
+
+/*
+** Called with each complete frame. The frame is only valid until the callback
+** returns, it may point into the receive buffer of the port.
+*/
+typedef void ( *SERIAL_FRAME_CALLBACK )( void *pContext, const BYTE *pFrame, UINT nLength );
+
+/*
+** The same with the frame copied into a pool buffer, qwTimestamp is GetFrameTime().
+** The callback owns one reference and releases it, now or later from any thread.
+*/
+typedef void ( *SERIAL_FRAME_BUFFER_CALLBACK )( void *pContext, SERIAL_BUFFER *pFrame );
+
+#define SERIAL_GAP_MODBUS_CHARS     3.5                     /* Modbus RTU inter-frame silence */
+#define SERIAL_GAP_MODBUS_MIN_NS    1750000ULL              /* fixed 1.75 ms above 19200 baud */
+
+typedef struct _SERIAL_FRAMER_STATS
+{
+    UINT64              qwFrames;               // frames delivered
+    UINT64              qwFrameBytes;
+    UINT64              qwGarbageBytes;         // bytes dropped outside of a valid frame
+    UINT64              qwResyncs;              // times the decoder lost and searched the frame boundary
+    UINT64              qwOversize;             // frames dropped for exceeding the maximum size
+    UINT64              qwChecksumErrors;       // frames dropped for a wrong trailing checksum
+    UINT64              qwNoBuffer;             // frames dropped, the pool had no buffer for them
+} SERIAL_FRAMER_STATS;
+
+/*
+** First occurrence of c in pData[0..nLength), NULL when there is none. Scans
+** 32 bytes per step with AVX2 when the CPU has it, 16 with SSE2 otherwise.
+*/
+const BYTE *SerialFindByte( const BYTE *pData, UINT nLength, BYTE c );
+
+/*
+** Base of all decoders. A custom decoder implements Input() and calls Emit(),
+** Drop() and Resync() to deliver frames and account for lost bytes.
+*/
+class CSerialFramer
+{
+    public:
+        CSerialFramer();
+        virtual             ~CSerialFramer();
+
+        void                SetCallback( SERIAL_FRAME_CALLBACK pfnCallback, void *pContext );
+        void                SetCallback( SERIAL_FRAME_BUFFER_CALLBACK pfnCallback, void *pContext, CSerialBufferPool *pPool );
+        void                SetMaxFrameSize( UINT nSize );
+        // frames end with this checksum, it is verified and stripped before delivery
+        void                SetChecksum( SERIAL_CHECKSUM Type );
+        UINT                GetMaxFrameSize() const
+        {
+            return m_nMaxFrame;
+        }
+
+        // called on the I/O thread with the received bytes, in order
+        virtual void        Input( const BYTE *pData, UINT nLength ) = 0;
+        // forget a partially received frame, e.g. after the port was reopened
+        virtual void        Reset();
+
+        /*
+        ** The port feeds each chunk with the SerialMetricsNow() time its read completed.
+        ** A decoder which has to act on silence returns the time it wants OnIdle() at
+        ** from GetDeadline(), 0 for none; both run on the I/O thread.
+        */
+        void                Feed( const BYTE *pData, UINT nLength, UINT64 qwTimestamp );
+        virtual UINT64      GetDeadline();
+        virtual void        OnIdle( UINT64 qwNow );
+        // the silence which ends a frame, 0 for decoders which do not look at the time
+        virtual UINT64      GetGap() const
+        {
+            return 0;
+        }
+
+        // nanoseconds per character on the line, the port sets it from its DCB
+        void                SetCharacterTime( UINT64 qwNs );
+        UINT64              GetCharacterTime() const
+        {
+            return m_qwCharTime.load( std::memory_order_relaxed );
+        }
+
+        // in the frame callback: when the read which completed the frame returned
+        UINT64              GetFrameTime() const
+        {
+            return m_qwFrameTime;
+        }
+
+        // may be called from any thread
+        void                GetStats( SERIAL_FRAMER_STATS *pStats );
+        void                ResetStats();
+
+    protected:
+        void                Emit( const BYTE *pFrame, UINT nLength );
+        void                Drop( UINT64 nBytes );
+        void                Resync();
+        void                Oversize();
+
+        std::vector<BYTE>   m_Frame;                // frame spanning several Input() calls
+        UINT64              m_qwTimestamp;          // of the chunk passed to Input()
+        UINT64              m_qwFrameTime;          // reported for the next Emit()
+
+    private:
+        CSerialFramer( const CSerialFramer & );
+        CSerialFramer       &operator=( const CSerialFramer & );
+
+        SERIAL_FRAME_CALLBACK   m_pfnCallback;
+        SERIAL_FRAME_BUFFER_CALLBACK m_pfnBufferCallback;
+        void                    *m_pContext;
+        CSerialBufferPool       *m_pPool;
+        UINT                    m_nMaxFrame;
+        SERIAL_CHECKSUM         m_Checksum;
+        std::atomic<UINT64>     m_qwCharTime;
+        std::atomic<UINT64>     m_qwFrames;
+        std::atomic<UINT64>     m_qwFrameBytes;
+        std::atomic<UINT64>     m_qwGarbageBytes;
+        std::atomic<UINT64>     m_qwResyncs;
+        std::atomic<UINT64>     m_qwOversize;
+        std::atomic<UINT64>     m_qwChecksumErrors;
+        std::atomic<UINT64>     m_qwNoBuffer;
+};
+
+/*
+** Frames terminated by a delimiter, '\n' by default. The delimiter is not part
+** of the frame, an optional '\r' before it is stripped as well.
+*/
+class CSerialLineFramer : public CSerialFramer
+{
+    public:
+        CSerialLineFramer( BYTE cDelimiter = '\n', BOOL bStripCR = TRUE );
+
+        virtual void        Input( const BYTE *pData, UINT nLength );
+        virtual void        Reset();
+
+    private:
+        void                EmitLine( const BYTE *pLine, UINT nLength );
+
+        BYTE                m_cDelimiter;
+        BOOL                m_bStripCR;
+        BOOL                m_bDiscarding;          // inside an oversize line
+};
+
+/*
+** Frames preceded by a 1, 2 or 4 byte length field. The field value plus
+** nAdjust is the number of payload bytes that follow it; only the payload is
+** delivered. Lengths above the maximum frame size are taken as a lost boundary
+** and the decoder slides forward one byte at a time until a sane header shows up.
+*/
+class CSerialLengthFramer : public CSerialFramer
+{
+    public:
+        CSerialLengthFramer( UINT nFieldSize = 2, BOOL bBigEndian = TRUE, int nAdjust = 0 );
+
+        virtual void        Input( const BYTE *pData, UINT nLength );
+        virtual void        Reset();
+
+    private:
+        BOOL                ParseHeader( const BYTE *pHeader, UINT *pnPayload );
+
+        UINT                m_nFieldSize;
+        BOOL                m_bBigEndian;
+        int                 m_nAdjust;
+        UINT                m_nPayload;             // payload size of the frame in m_Frame, once known
+        BOOL                m_bInSync;
+};
+
+/*
+** SLIP (RFC 1055): frames end with 0xC0, 0xC0 and 0xDB inside a frame are sent
+** as 0xDB 0xDC and 0xDB 0xDD. Empty frames between two END bytes are skipped.
+*/
+class CSerialSlipFramer : public CSerialFramer
+{
+    public:
+        CSerialSlipFramer();
+
+        virtual void        Input( const BYTE *pData, UINT nLength );
+        virtual void        Reset();
+
+    private:
+        BOOL                m_bEscape;
+        BOOL                m_bDiscarding;          // bad escape or oversize, wait for the next END
+};
+
+/*
+** COBS: each frame is encoded without zero bytes and terminated by 0x00.
+*/
+class CSerialCobsFramer : public CSerialFramer
+{
+    public:
+        CSerialCobsFramer();
+
+        virtual void        Input( const BYTE *pData, UINT nLength );
+        virtual void        Reset();
+
+    private:
+        void                Decode( const BYTE *pData, UINT nLength );
+
+        std::vector<BYTE>   m_Decoded;
+        BOOL                m_bDiscarding;
+};
+
+/*
+** Frames delimited by silence on the line, as Modbus RTU and many sensor buses
+** do. A frame ends when no byte followed its last one for dCharTimes character
+** times (at least qwMinGapNs). The gap is measured between the chunks the I/O
+** thread reads, the first byte of a chunk is taken to have arrived at line
+** rate before its end, so bytes which came in one read are never split.
+*/
+class CSerialGapFramer : public CSerialFramer
+{
+    public:
+        CSerialGapFramer( double dCharTimes = SERIAL_GAP_MODBUS_CHARS, UINT64 qwMinGapNs = 0 );
+
+        virtual void        Input( const BYTE *pData, UINT nLength );
+        virtual void        Reset();
+        virtual UINT64      GetDeadline();
+        virtual void        OnIdle( UINT64 qwNow );
+
+        virtual UINT64      GetGap() const;     // nanoseconds
+
+    private:
+        void                Finish();
+
+        double              m_dCharTimes;
+        UINT64              m_qwMinGap;
+        UINT64              m_qwLastByte;       // estimated arrival of the last byte of m_Frame
+        BOOL                m_bPending;         // a frame (or an oversize one) is open
+        BOOL                m_bDiscarding;
+};
+
+#endif // SERIAL_FRAMER_H
@@ -0,0 +1,254 @@
+/*
+**  FILENAME            SerialMetrics.cpp
+**
+**  PURPOSE             Per-port counters and latency histograms.
+**
+**  CREATION DATE       16-10-2026
+**  LAST MODIFICATION   16-10-2026
+*/
+
+#ifdef _WIN32
+#include "stdafx.h"
+#endif
+#include "SerialMetrics.h"
+#include <chrono>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#define HISTOGRAM_SUB_COUNT     ( 1U << SERIAL_HISTOGRAM_SUB_BITS )
+
+static inline UINT HighestBit( UINT64 qwValue )
+{
+#ifdef _MSC_VER
+    unsigned long nBit;
+    _BitScanReverse64( &nBit, qwValue );
+    return ( UINT )nBit;
+#else
+    return 63 - ( UINT )__builtin_clzll( qwValue );
+#endif
+}
+
+static inline UINT BucketIndex( UINT64 qwValue )
+{
+    UINT nBit;
+
+    if ( qwValue < HISTOGRAM_SUB_COUNT )
+    {
+        return ( UINT )qwValue;
+    }
+
+    nBit = HighestBit( qwValue );
+
+    if ( nBit >= 48 )
+    {
+        return SERIAL_HISTOGRAM_BUCKETS - 1;
+    }
+
+    // the bits below the leading one select the sub-bucket
+    return ( ( nBit - SERIAL_HISTOGRAM_SUB_BITS + 1 ) << SERIAL_HISTOGRAM_SUB_BITS ) +
+           ( UINT )( ( qwValue >> ( nBit - SERIAL_HISTOGRAM_SUB_BITS ) ) & ( HISTOGRAM_SUB_COUNT - 1 ) );
+}
+
+static inline UINT64 BucketBase( UINT nBucket )
+{
+    UINT nRange = nBucket >> SERIAL_HISTOGRAM_SUB_BITS;
+
+    if ( nRange == 0 )
+    {
+        return nBucket;
+    }
+
+    return ( UINT64 )( HISTOGRAM_SUB_COUNT + ( nBucket & ( HISTOGRAM_SUB_COUNT - 1 ) ) ) << ( nRange - 1 );
+}
+
+UINT64 SerialMetricsNow()
+{
+#ifdef _WIN32
+    return ( UINT64 )std::chrono::duration_cast<std::chrono::nanoseconds>( std::chrono::steady_clock::now().time_since_epoch() ).count();
+#else
+    // the clock of the poll()/epoll timeouts of the I/O threads
+    struct timespec ts;
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return ( UINT64 )ts.tv_sec * 1000000000 + ( UINT64 )ts.tv_nsec;
+#endif
+}
+
+UINT64 SerialHistogramBucketLimit( UINT nBucket )
+{
+    if ( nBucket + 1 >= SERIAL_HISTOGRAM_BUCKETS )
+    {
+        return ~( UINT64 )0;
+    }
+
+    return BucketBase( nBucket + 1 ) - 1;
+}
+
+UINT64 SerialHistogramPercentile( const SERIAL_HISTOGRAM *pHistogram, double dFraction )
+{
+    UINT64 qwRank;
+    UINT64 qwSeen = 0;
+
+    if ( pHistogram->qwCount == 0 )
+    {
+        return 0;
+    }
+
+    dFraction = ( dFraction < 0.0 ) ? 0.0 : ( ( dFraction > 1.0 ) ? 1.0 : dFraction );
+    qwRank = ( UINT64 )( dFraction * ( double )pHistogram->qwCount + 0.5 );
+    qwRank = ( qwRank == 0 ) ? 1 : qwRank;
+
+    for ( UINT i = 0; i < SERIAL_HISTOGRAM_BUCKETS; i++ )
+    {
+        qwSeen += pHistogram->qwBuckets[i];
+
+        if ( qwSeen >= qwRank )
+        {
+            UINT64 qwLimit = SerialHistogramBucketLimit( i );
+            return ( qwLimit < pHistogram->qwMax ) ? qwLimit : pHistogram->qwMax;
+        }
+    }
+
+    return pHistogram->qwMax;
+}
+
+CSerialHistogram::CSerialHistogram()
+{
+    SERIAL_HISTOGRAM Discard;
+    Snapshot( &Discard, TRUE );
+}
+
+void CSerialHistogram::Record( UINT64 qwValue )
+{
+    UINT64 qwMin = m_qwMin.load( std::memory_order_relaxed );
+    UINT64 qwMax = m_qwMax.load( std::memory_order_relaxed );
+
+    m_qwBuckets[BucketIndex( qwValue )].fetch_add( 1, std::memory_order_relaxed );
+    m_qwSum.fetch_add( qwValue, std::memory_order_relaxed );
+
+    while ( ( qwValue < qwMin ) && !m_qwMin.compare_exchange_weak( qwMin, qwValue, std::memory_order_relaxed ) )
+    {
+    }
+
+    while ( ( qwValue > qwMax ) && !m_qwMax.compare_exchange_weak( qwMax, qwValue, std::memory_order_relaxed ) )
+    {
+    }
+}
+
+void CSerialHistogram::Snapshot( SERIAL_HISTOGRAM *pHistogram, BOOL bReset )
+{
+    // a sample recorded meanwhile may show in its bucket but not yet in the count, the
+    // count is therefore taken from the buckets
+    pHistogram->qwCount = 0;
+
+    for ( UINT i = 0; i < SERIAL_HISTOGRAM_BUCKETS; i++ )
+    {
+        pHistogram->qwBuckets[i] = bReset ? m_qwBuckets[i].exchange( 0, std::memory_order_relaxed ) :
+                                            m_qwBuckets[i].load( std::memory_order_relaxed );
+        pHistogram->qwCount += pHistogram->qwBuckets[i];
+    }
+
+    if ( bReset )
+    {
+        pHistogram->qwSum = m_qwSum.exchange( 0, std::memory_order_relaxed );
+        pHistogram->qwMin = m_qwMin.exchange( ~( UINT64 )0, std::memory_order_relaxed );
+        pHistogram->qwMax = m_qwMax.exchange( 0, std::memory_order_relaxed );
+    }
+    else
+    {
+        pHistogram->qwSum = m_qwSum.load( std::memory_order_relaxed );
+        pHistogram->qwMin = m_qwMin.load( std::memory_order_relaxed );
+        pHistogram->qwMax = m_qwMax.load( std::memory_order_relaxed );
+    }
+
+    if ( pHistogram->qwCount == 0 )
+    {
+        pHistogram->qwMin = 0;
+    }
+}
+
+CSerialPortMetrics::CSerialPortMetrics()
+{
+    m_qwRxPendingSince = 0;
+    Reset();
+}
+
+void CSerialPortMetrics::Reset()
+{
+    SERIAL_PORT_METRICS *pDiscard = new SERIAL_PORT_METRICS;
+    Snapshot( pDiscard, TRUE );
+    delete pDiscard;
+}
+
+void CSerialPortMetrics::Snapshot( SERIAL_PORT_METRICS *pMetrics, BOOL bReset )
+{
+    if ( bReset )
+    {
+        pMetrics->qwRxBytes = m_qwRxBytes.exchange( 0, std::memory_order_relaxed );
+        pMetrics->qwRxChunks = m_qwRxChunks.exchange( 0, std::memory_order_relaxed );
+        pMetrics->qwRxErrors = m_qwRxErrors.exchange( 0, std::memory_order_relaxed );
+        pMetrics->qwRxOverrunBytes = m_qwRxOverrunBytes.exchange( 0, std::memory_order_relaxed );
+        pMetrics->qwRxOverrunChunks = m_qwRxOverrunChunks.exchange( 0, std::memory_order_relaxed );
+        pMetrics->nRxHighWater = m_nRxHighWater.exchange( 0, std::memory_order_relaxed );
+        pMetrics->qwTxBytes = m_qwTxBytes.exchange( 0, std::memory_order_relaxed );
+        pMetrics->qwTxChunks = m_qwTxChunks.exchange( 0, std::memory_order_relaxed );
+        pMetrics->qwTxErrors = m_qwTxErrors.exchange( 0, std::memory_order_relaxed );
+        pMetrics->qwTxRequests = m_qwTxRequests.exchange( 0, std::memory_order_relaxed );
+        pMetrics->nTxHighWater = m_nTxHighWater.exchange( 0, std::memory_order_relaxed );
+    }
+    else
+    {
+        pMetrics->qwRxBytes = m_qwRxBytes.load( std::memory_order_relaxed );
+        pMetrics->qwRxChunks = m_qwRxChunks.load( std::memory_order_relaxed );
+        pMetrics->qwRxErrors = m_qwRxErrors.load( std::memory_order_relaxed );
+        pMetrics->qwRxOverrunBytes = m_qwRxOverrunBytes.load( std::memory_order_relaxed );
+        pMetrics->qwRxOverrunChunks = m_qwRxOverrunChunks.load( std::memory_order_relaxed );
+        pMetrics->nRxHighWater = m_nRxHighWater.load( std::memory_order_relaxed );
+        pMetrics->qwTxBytes = m_qwTxBytes.load( std::memory_order_relaxed );
+        pMetrics->qwTxChunks = m_qwTxChunks.load( std::memory_order_relaxed );
+        pMetrics->qwTxErrors = m_qwTxErrors.load( std::memory_order_relaxed );
+        pMetrics->qwTxRequests = m_qwTxRequests.load( std::memory_order_relaxed );
+        pMetrics->nTxHighWater = m_nTxHighWater.load( std::memory_order_relaxed );
+    }
+
+    m_TxWait.Snapshot( &pMetrics->TxWait, bReset );
+
+    for ( UINT i = 0; i < SERIAL_TX_LANES; i++ )
+    {
+        m_TxStart[i].Snapshot( &pMetrics->TxStart[i], bReset );
+    }
+
+    m_RxDelivery.Snapshot( &pMetrics->RxDelivery, bReset );
+    m_Wakeup.Snapshot( &pMetrics->Wakeup, bReset );
+}
+
+void CSerialPortMetrics::OnRxBuffered( UINT64 qwNow )
+{
+    UINT64 qwIdle = 0;
+
+    if ( m_qwRxPendingSince.load( std::memory_order_relaxed ) == 0 )
+    {
+        m_qwRxPendingSince.compare_exchange_strong( qwIdle, qwNow, std::memory_order_relaxed );
+    }
+}
+
+void CSerialPortMetrics::OnRxConsumed( BOOL bEmpty )
+{
+    UINT64 qwSince = m_qwRxPendingSince.exchange( 0, std::memory_order_relaxed );
+    UINT64 qwNow;
+
+    if ( qwSince == 0 )
+    {
+        return;
+    }
+
+    qwNow = SerialMetricsNow();
+    m_RxDelivery.Record( ( qwNow > qwSince ) ? qwNow - qwSince : 0 );
+
+    if ( !bEmpty )
+    {
+        // the rest arrived after the stamp, from now on its age is a lower bound
+        UINT64 qwIdle = 0;
+        m_qwRxPendingSince.compare_exchange_strong( qwIdle, qwNow, std::memory_order_relaxed );
+    }
+}
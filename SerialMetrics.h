@@ -0,0 +1,183 @@
+/*
+**  FILENAME            SerialMetrics.h
+**
+**  PURPOSE             Per-port counters and latency histograms. The I/O thread and
+**                      the producers update them with relaxed atomics, any thread
+**                      takes a snapshot without locking the port.
+**
+**  CREATION DATE       16-10-2026
+**  LAST MODIFICATION   16-10-2026
+*/
+
+#ifndef SERIAL_METRICS_H
+#define SERIAL_METRICS_H
+
+#ifndef _WIN32
+#include "SerialPortPosix.h"
+#endif
+#include <atomic>
+
+/*
+** Log-linear buckets as in HdrHistogram: values below 16 have a bucket each, above
+** that every power of two is split into 16 buckets, i.e. about 6% resolution up to
+** 2^48 ns. Larger values land in the last bucket.
+*/
+#define SERIAL_HISTOGRAM_SUB_BITS   4
+#define SERIAL_HISTOGRAM_BUCKETS    ( ( 48 - SERIAL_HISTOGRAM_SUB_BITS + 1 ) << SERIAL_HISTOGRAM_SUB_BITS )
+
+#define SERIAL_TX_LANES             4                       /* transmit priorities, see SerialTxScheduler.h */
+
+typedef struct _SERIAL_HISTOGRAM
+{
+    UINT64              qwCount;
+    UINT64              qwSum;                  // nanoseconds
+    UINT64              qwMin;
+    UINT64              qwMax;
+    UINT64              qwBuckets[SERIAL_HISTOGRAM_BUCKETS];
+} SERIAL_HISTOGRAM;
+
+typedef struct _SERIAL_PORT_METRICS
+{
+    UINT64              qwRxBytes;
+    UINT64              qwRxChunks;             // reads which returned data
+    UINT64              qwRxErrors;             // failed reads
+    UINT64              qwRxOverrunBytes;       // dropped, the receive buffer was full
+    UINT64              qwRxOverrunChunks;
+    UINT                nRxHighWater;           // most bytes waiting in the receive buffer
+    UINT64              qwTxBytes;
+    UINT64              qwTxChunks;             // writes which took data
+    UINT64              qwTxErrors;             // failed writes
+    UINT64              qwTxRequests;           // requests completed
+    UINT                nTxHighWater;           // most bytes waiting in the transmit queue
+    SERIAL_HISTOGRAM    TxWait;                 // queued until the last byte went to the driver
+    SERIAL_HISTOGRAM    TxStart[SERIAL_TX_LANES];   // per lane, queued until the first byte went; qwMax is the worst case
+    SERIAL_HISTOGRAM    RxDelivery;             // read from the driver until taken by the consumer
+    SERIAL_HISTOGRAM    Wakeup;                 // a timed wait of the I/O thread, from its deadline until it ran
+} SERIAL_PORT_METRICS;
+
+UINT64      SerialMetricsNow();                 // monotonic nanoseconds, CLOCK_MONOTONIC on POSIX
+
+// highest value which falls into the same bucket as the given fraction (0..1) of the samples
+UINT64      SerialHistogramPercentile( const SERIAL_HISTOGRAM *pHistogram, double dFraction );
+UINT64      SerialHistogramBucketLimit( UINT nBucket );
+
+class CSerialHistogram
+{
+    public:
+        CSerialHistogram();
+
+        void                Record( UINT64 qwValue );
+        void                Snapshot( SERIAL_HISTOGRAM *pHistogram, BOOL bReset );
+
+    private:
+        CSerialHistogram( const CSerialHistogram & );
+        CSerialHistogram    &operator=( const CSerialHistogram & );
+
+        std::atomic<UINT64> m_qwSum;
+        std::atomic<UINT64> m_qwMin;
+        std::atomic<UINT64> m_qwMax;
+        std::atomic<UINT64> m_qwBuckets[SERIAL_HISTOGRAM_BUCKETS];
+};
+
+class CSerialPortMetrics
+{
+    public:
+        CSerialPortMetrics();
+
+        /*
+        ** A snapshot taken with bReset exchanges every counter with zero, so no
+        ** event is lost or counted twice between two exports.
+        */
+        void                Snapshot( SERIAL_PORT_METRICS *pMetrics, BOOL bReset );
+        void                Reset();
+
+        // I/O thread
+        void                OnRxChunk( UINT nBytes, UINT nBuffered )
+        {
+            m_qwRxBytes.fetch_add( nBytes, std::memory_order_relaxed );
+            m_qwRxChunks.fetch_add( 1, std::memory_order_relaxed );
+            UpdateMax( m_nRxHighWater, nBuffered );
+        }
+        void                OnRxOverrun( UINT nBytes )
+        {
+            m_qwRxOverrunBytes.fetch_add( nBytes, std::memory_order_relaxed );
+            m_qwRxOverrunChunks.fetch_add( 1, std::memory_order_relaxed );
+        }
+        void                OnRxError()
+        {
+            m_qwRxErrors.fetch_add( 1, std::memory_order_relaxed );
+        }
+        void                OnTxChunk( UINT nBytes )
+        {
+            m_qwTxBytes.fetch_add( nBytes, std::memory_order_relaxed );
+            m_qwTxChunks.fetch_add( 1, std::memory_order_relaxed );
+        }
+        void                OnTxError()
+        {
+            m_qwTxErrors.fetch_add( 1, std::memory_order_relaxed );
+        }
+        void                OnWakeup( UINT64 qwLateNs )
+        {
+            m_Wakeup.Record( qwLateNs );
+        }
+
+        // transmit queue
+        void                OnTxQueued( UINT nQueuedBytes )
+        {
+            UpdateMax( m_nTxHighWater, nQueuedBytes );
+        }
+        void                OnTxComplete( UINT64 qwWaitNs )
+        {
+            m_qwTxRequests.fetch_add( 1, std::memory_order_relaxed );
+            m_TxWait.Record( qwWaitNs );
+        }
+        void                OnTxStarted( UINT nLane, UINT64 qwWaitNs )
+        {
+            m_TxStart[nLane].Record( qwWaitNs );
+        }
+
+        /*
+        ** Age of the oldest byte in the receive buffer: stamped by the producer when
+        ** data arrives in an empty buffer, recorded when the consumer takes it.
+        */
+        void                OnRxBuffered( UINT64 qwNow );
+        void                OnRxConsumed( BOOL bEmpty );
+
+        UINT64              GetRxOverrun() const
+        {
+            return m_qwRxOverrunBytes.load( std::memory_order_relaxed );
+        }
+
+    private:
+        CSerialPortMetrics( const CSerialPortMetrics & );
+        CSerialPortMetrics  &operator=( const CSerialPortMetrics & );
+
+        static void         UpdateMax( std::atomic<UINT> &Max, UINT nValue )
+        {
+            UINT nMax = Max.load( std::memory_order_relaxed );
+
+            // the common case is a plain load, the exchange only runs on a new maximum
+            while ( ( nValue > nMax ) && !Max.compare_exchange_weak( nMax, nValue, std::memory_order_relaxed ) )
+            {
+            }
+        }
+
+        std::atomic<UINT64> m_qwRxBytes;
+        std::atomic<UINT64> m_qwRxChunks;
+        std::atomic<UINT64> m_qwRxErrors;
+        std::atomic<UINT64> m_qwRxOverrunBytes;
+        std::atomic<UINT64> m_qwRxOverrunChunks;
+        std::atomic<UINT>   m_nRxHighWater;
+        std::atomic<UINT64> m_qwRxPendingSince;
+        std::atomic<UINT64> m_qwTxBytes;
+        std::atomic<UINT64> m_qwTxChunks;
+        std::atomic<UINT64> m_qwTxErrors;
+        std::atomic<UINT64> m_qwTxRequests;
+        std::atomic<UINT>   m_nTxHighWater;
+        CSerialHistogram    m_TxWait;
+        CSerialHistogram    m_TxStart[SERIAL_TX_LANES];
+        CSerialHistogram    m_RxDelivery;
+        CSerialHistogram    m_Wakeup;
+};
+
+#endif // SERIAL_METRICS_H
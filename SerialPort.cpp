@@ -3,29 +3,85 @@
 **
 **  PURPOSE             This class can read, write and watch one serial port.
 **                      It sends messages to its owner when something happends on the port
-**                      The class creates a thread for reading and writing so the main
-**                      program is not blocked.
+**                      The class creates a thread for reading and one for writing, so
+**                      the main program is not blocked and both directions run at once.
 **
 **  CREATION DATE       15-09-1997
-**  LAST MODIFICATION   18-03-2018
+**  LAST MODIFICATION   16-10-2026
 **
 **  AUTHOR              Remon Spekreijse
 */
 
+#ifdef _WIN32
 #include "stdafx.h"
+#endif
 #include "SerialPort.h"
 #include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include <thread>
 
+#ifdef _WIN32
 #pragma warning(disable:4996)
 
+#define RX_RETRY_MAX_SHIFT          5                       /* a failing wait is retried after at most 32 ms */
+#endif
+
 CSerialPort::CSerialPort()
 {
     m_hComm = INVALID_HANDLE_VALUE;
-    m_szWriteBuffer = NULL;
     m_bThreadAlive = FALSE;
     m_bUserRequestClose = FALSE;
-    m_nWriteSize = 0;
+    m_nCloseCount = 0;
+    m_qwCharTime = 0;
+    m_nWriteBufferSize = 0;
+#ifdef _WIN32
     m_Thread = NULL;
+    m_TxThread = NULL;
+    m_hShutdownEvent = NULL;
+    m_hTxEvent = NULL;
+    m_hRxWakeEvent = NULL;
+    m_nRxRetries = 0;
+#else
+    m_bThreadStarted = FALSE;
+    m_nWakeFd[0] = -1;
+    m_nWakeFd[1] = -1;
+    m_bWakePending = FALSE;
+    m_qwWriteDeadline = 0;
+    m_qwTxPaceDeadline = 0;
+#endif
+#ifdef SERIAL_PORT_REACTOR
+    m_pReactor = NULL;
+    m_bReactorAttached = FALSE;
+    m_nReactorLoop = 0;
+    m_bReactorPollOut = FALSE;
+    m_bReactorWoken = FALSE;
+#endif
+    m_nPortNr = 0;
+    m_szPortName[0] = '\0';
+    m_nRxBufferSize = SERIAL_RX_BUFFER_SIZE;
+    m_pfnRxCallback = NULL;
+    m_pfnRxStampedCallback = NULL;
+    m_pfnRxBufferCallback = NULL;
+    m_pRxContext = NULL;
+    m_pFramer = NULL;
+    m_pCapture = NULL;
+    m_nCaptureId = 0;
+    m_bRxNotifyPending = FALSE;
+    m_pfnRxNotify = NULL;
+    m_pRxNotifyContext = NULL;
+    m_qwRxNotifyDeadline = 0;
+    m_qwLastRxTime = 0;
+    m_nRxMinBytes = 0;
+    m_nRxMaxDelayUs = 0;
+    m_qwRxHeldSince = 0;
+    SerialThreadDefaults( &m_ThreadOptions );
+    m_dwThreadState = 0;
+    m_qwProbeNext = 0;
+    m_pPool = &m_Pool;
+    m_TxScheduler.SetMetrics( &m_Metrics );
+    m_TxScheduler.SetPool( m_pPool );
     InitializeCriticalSection( &m_csCommunicationSync );
 }
 
@@ -35,6 +91,7 @@ CSerialPort::~CSerialPort()
     DeleteCriticalSection( &m_csCommunicationSync );
 }
 
+#ifdef _WIN32
 BOOL CSerialPort::Open( HWND    pPortOwner,      // the owner (CWnd) of the port (receives message)
                         UINT    port,            // portnumber (0..SERIAL_PORT_MAX)
                         UINT    baud,            // baudrate
@@ -48,37 +105,72 @@ BOOL CSerialPort::Open( HWND    pPortOwner,      // the owner (CWnd) of the port
                         DWORD   ReadTotalTimeoutConstant,
                         DWORD   WriteTotalTimeoutMultiplier,
                         DWORD   WriteTotalTimeoutConstant )
+{
+    char szPort[MAX_PATH];
+    assert( port <= SERIAL_PORT_MAX );
+    // prepare port strings
+    sprintf( szPort, _T( "\\\\.\\%s%d" ), SERIAL_DEVICE_PREFIX, (signed int)port );
+    m_nPortNr = port;
+    return OpenDevice( pPortOwner, szPort, baud, parity, databits, stopbits, dwCommEvents, nBufferSize,
+                       ReadIntervalTimeout, ReadTotalTimeoutMultiplier, ReadTotalTimeoutConstant,
+                       WriteTotalTimeoutMultiplier, WriteTotalTimeoutConstant );
+}
 
+BOOL CSerialPort::OpenDevice( HWND    pPortOwner,      // the owner (CWnd) of the port (receives message)
+                              const char *szPort,      // device name, e.g. \\.\COM8
+                              UINT    baud,            // baudrate
+                              BYTE    parity,          // parity
+                              BYTE    databits,        // databits
+                              BYTE    stopbits,        // stopbits
+                              DWORD   dwCommEvents,    // EV_RXCHAR, EV_CTS etc
+                              UINT    nBufferSize,     // size to the writebuffer
+                              DWORD   ReadIntervalTimeout,
+                              DWORD   ReadTotalTimeoutMultiplier,
+                              DWORD   ReadTotalTimeoutConstant,
+                              DWORD   WriteTotalTimeoutMultiplier,
+                              DWORD   WriteTotalTimeoutConstant )
 {
     BOOL ret = TRUE;
-    char szPort[MAX_PATH];
     Close();
     EnterCriticalSection( &m_csCommunicationSync );
-    assert( port <= SERIAL_PORT_MAX );
-    assert( pPortOwner != NULL );
-    // save the owner
+    assert( szPort != NULL );
+    // save the owner, may be NULL when the data is taken through a callback or Read()
     m_pOwner = pPortOwner;
-    // Allocate memory
-    m_szWriteBuffer = new char[nBufferSize];
-
-    if ( m_szWriteBuffer == NULL )
+    // nBufferSize is the high-water mark of the transmit queue
+    m_nWriteBufferSize = nBufferSize;
+    m_TxScheduler.Open( nBufferSize );
+    m_TxPacer.Reset();
+    m_bRxNotifyPending = FALSE;
+    m_qwRxHeldSince = 0;
+    m_qwProbeNext = 0;
+    m_dwThreadState = 0;
+    m_nRxRetries = 0;
+    m_Metrics.Reset();
+    m_Errors.Clear();
+
+    if ( !m_RxBuffer.Create( m_nRxBufferSize ) )
     {
         ret = FALSE;
         goto done;
     }
 
-    m_nPortNr = port;
-    m_nWriteBufferSize = nBufferSize;
+    LockBuffers();
+
+    if ( m_pFramer != NULL )
+    {
+        m_pFramer->Reset();
+    }
+
     m_dwCommEvents = dwCommEvents | (EV_RXCHAR | EV_TXEMPTY);
-    // prepare port strings
-    sprintf( szPort, _T( "\\\\.\\%s%d" ), SERIAL_DEVICE_PREFIX, (signed int)port );
+    strncpy( m_szPortName, szPort, sizeof( m_szPortName ) - 1 );
+    m_szPortName[sizeof( m_szPortName ) - 1] = '\0';
     // get a handle to the port
     m_hComm = CreateFile( szPort,                       // communication port string (COMX)
                           GENERIC_READ | GENERIC_WRITE, // read/write types
                           0,                            // comm devices must be opened with exclusive access
                           NULL,                         // no security attributes
                           OPEN_EXISTING,                // comm devices must use OPEN_EXISTING
-                          FILE_FLAG_NO_BUFFERING | FILE_FLAG_WRITE_THROUGH,
+                          FILE_FLAG_OVERLAPPED | FILE_FLAG_NO_BUFFERING | FILE_FLAG_WRITE_THROUGH,
                           0 );                          // template must be 0 for comm devices
 
     if ( m_hComm == INVALID_HANDLE_VALUE )
@@ -97,7 +189,7 @@ BOOL CSerialPort::Open( HWND    pPortOwner,      // the owner (CWnd) of the port
     // configure
     if ( SetCommTimeouts( m_hComm, &m_CommTimeouts ) )
     {
-        if ( SetCommMask( m_hComm, dwCommEvents ) )
+        if ( SetCommMask( m_hComm, dwCommEvents | EV_RXCHAR ) )
         {
             if ( GetCommState( m_hComm, &m_dcb ) )
             {
@@ -124,6 +216,8 @@ BOOL CSerialPort::Open( HWND    pPortOwner,      // the owner (CWnd) of the port
                     ret = FALSE;
                     goto done;
                 }
+
+                OnLineChanged();
             }
             else
             {
@@ -162,16 +256,28 @@ BOOL CSerialPort::Open( HWND    pPortOwner,      // the owner (CWnd) of the port
         goto done;
     }
 
+    // Close() and a failing thread stop both threads, WakeIoThread() starts a transmission
+    m_hShutdownEvent = CreateEvent( NULL, TRUE, FALSE, NULL );
+    m_hTxEvent = CreateEvent( NULL, FALSE, FALSE, NULL );
+    m_hRxWakeEvent = CreateEvent( NULL, FALSE, FALSE, NULL );
+
+    if ( ( m_hShutdownEvent == NULL ) || ( m_hTxEvent == NULL ) || ( m_hRxWakeEvent == NULL ) )
+    {
+        ProcessErrorMessage( "CreateEvent()" );
+        ret = FALSE;
+        goto done;
+    }
+
     m_bThreadAlive = TRUE;
     m_bUserRequestClose = FALSE;
-    assert( m_Thread == NULL );
+    assert( ( m_Thread == NULL ) && ( m_TxThread == NULL ) );
     m_Thread = ::CreateThread(NULL, 0, CommThread, this, 0, NULL);
+    m_TxThread = ::CreateThread(NULL, 0, TxThread, this, 0, NULL);
 
-    if (m_Thread == NULL)
+    if ( ( m_Thread == NULL ) || ( m_TxThread == NULL ) )
     {
         ProcessErrorMessage( "CreateThread()" );
         ret = FALSE;
-        m_bThreadAlive = FALSE;
         goto done;
     }
 
@@ -189,255 +295,1126 @@ done:
 DWORD WINAPI CSerialPort::CommThread( LPVOID pParam )
 {
     CSerialPort *pPort = ( CSerialPort * )pParam;
+    OVERLAPPED ov;
 
-    while ( pPort->m_bThreadAlive )
+    pPort->ApplyThreadOptions();
+
+    // receive side only, the transmit side has its own thread and never waits for this one
+    memset( &ov, 0, sizeof( ov ) );
+    ov.hEvent = CreateEvent( NULL, TRUE, FALSE, NULL );
+
+    while ( pPort->m_bThreadAlive && ( ov.hEvent != NULL ) )
     {
         if ( pPort->m_bUserRequestClose )
         {
             break;
         }
 
-        if (pPort->m_nWriteSize > 0)
+        if ( !ReceiveChar( pPort, &ov ) )
+        {
+            break;
+        }
+    }
+
+    if ( ov.hEvent != NULL )
+    {
+        CloseHandle( ov.hEvent );
+    }
+
+    // stop the transmit thread as well
+    pPort->m_bThreadAlive = FALSE;
+    SetEvent( pPort->m_hShutdownEvent );
+    ::ExitThread(0);
+    //return 0;
+}
+
+DWORD WINAPI CSerialPort::TxThread( LPVOID pParam )
+{
+    CSerialPort *pPort = ( CSerialPort * )pParam;
+    HANDLE hEvents[2] = { pPort->m_hShutdownEvent, pPort->m_hTxEvent };
+    OVERLAPPED ov;
+    const char *pszFailed;
+
+    // the same scheduling as the receive thread, GetThreadState() reports that one
+    SerialThreadApply( &pPort->m_ThreadOptions, &pszFailed );
+
+    if ( pszFailed != NULL )
+    {
+        pPort->ProcessErrorMessage( pszFailed );
+    }
+
+    memset( &ov, 0, sizeof( ov ) );
+    ov.hEvent = CreateEvent( NULL, TRUE, FALSE, NULL );
+
+    while ( pPort->m_bThreadAlive && ( ov.hEvent != NULL ) )
+    {
+        if ( pPort->m_bUserRequestClose )
         {
-            UINT BytesSent = WriteChar(pPort);
+            break;
+        }
 
-            if (EOF != BytesSent)
+        if ( pPort->m_TxScheduler.IsEmpty() )
+        {
+            // m_hTxEvent is auto reset and set after the push, no request is missed
+            if ( WaitForMultipleObjects( 2, hEvents, FALSE, INFINITE ) != WAIT_OBJECT_0 + 1 )
             {
-                ::PostMessage(pPort->m_pOwner, SERIAL_PORT_MESSAGE, ( WPARAM )EV_TXEMPTY, ( LPARAM )BytesSent);
+                break;
             }
-            else
+
+            continue;
+        }
+
+        UINT nBudget = ~0U;
+
+        if ( pPort->m_TxPacer.IsActive() )
+        {
+            UINT64 qwReady;
+            nBudget = pPort->m_TxPacer.GetBudget( SerialMetricsNow(), pPort->GetDriverBacklog(),
+                                                  pPort->m_TxScheduler.GetQueuedBytes(), &qwReady );
+
+            if ( nBudget == 0 )
             {
-                break;
+                UINT64 qwNow = SerialMetricsNow();
+                DWORD dwWait = ( qwReady > qwNow ) ? ( DWORD )( ( qwReady - qwNow + 999999 ) / 1000000 ) : 0;
+
+                // held back by the pacer, new requests and Close() end the pause early
+                if ( WaitForMultipleObjects( 2, hEvents, FALSE, dwWait ) == WAIT_OBJECT_0 )
+                {
+                    break;
+                }
+
+                continue;
+            }
+        }
+
+        UINT BytesSent = WriteChar( pPort, &ov, nBudget );
+
+        if (EOF != BytesSent)
+        {
+            if ( ( pPort->m_pOwner != NULL ) && pPort->m_TxScheduler.IsEmpty() )
+            {
+                ::PostMessage(pPort->m_pOwner, SERIAL_PORT_MESSAGE, ( WPARAM )EV_TXEMPTY, ( LPARAM )BytesSent);
             }
         }
+        else
+        {
+            break;
+        }
+    }
 
-        ReceiveChar(pPort);
+    if ( ov.hEvent != NULL )
+    {
+        CloseHandle( ov.hEvent );
     }
 
+    // nothing sends the queued requests any more, they fail and new ones are refused
+    pPort->m_TxScheduler.Close();
     pPort->m_bThreadAlive = FALSE;
+    SetEvent( pPort->m_hShutdownEvent );
     ::ExitThread(0);
     //return 0;
 }
 
-void CSerialPort::ProcessErrorMessage( char *ErrorText )
+BOOL CSerialPort::CompleteIo( CSerialPort *pPort, OVERLAPPED *pOverlapped, BOOL bResult, DWORD *pdwBytes )
 {
-    char *Temp;
-    char *lpMsgBuf = NULL;
-    DWORD dwError = GetLastError();
+    HANDLE hEvents[2] = { pOverlapped->hEvent, pPort->m_hShutdownEvent };
 
-    if ( FormatMessage(
-                FORMAT_MESSAGE_ALLOCATE_BUFFER | FORMAT_MESSAGE_FROM_SYSTEM,
-                NULL,
-                dwError,
-                MAKELANGID( LANG_NEUTRAL, SUBLANG_DEFAULT ),
-                ( LPTSTR )&lpMsgBuf,
-                0,
-                NULL
-            ) > 0 )
-    {
-        if (lpMsgBuf != NULL)
-        {
-            Temp = ( char * )LocalAlloc( LMEM_ZEROINIT, ( lstrlen( ( LPCTSTR )lpMsgBuf ) + INT16_MAX ) );
+    if ( !bResult && ( GetLastError() != ERROR_IO_PENDING ) )
+    {
+        *pdwBytes = 0;
+        return FALSE;
+    }
 
-            if ( Temp != NULL )
-            {
-                sprintf( Temp, _T( "ERROR:\"%s\" failed with the following error:\n\ndwError=%d\n%s\nPort:%s%d\n" ), ( char * )ErrorText, (signed int)dwError, lpMsgBuf, SERIAL_DEVICE_PREFIX, (signed int)m_nPortNr );
-                AfxMessageBox(Temp, MB_OK | MB_ICONERROR | MB_SYSTEMMODAL | MB_TOPMOST);
-                LocalFree( Temp );
-            }
+    if ( !bResult && ( WaitForMultipleObjects( 2, hEvents, FALSE, INFINITE ) != WAIT_OBJECT_0 ) )
+    {
+        // Close() or the other thread failed, abandon the request
+        CancelIo( pPort->m_hComm );
+    }
 
-            LocalFree( lpMsgBuf );
-        }
+    return GetOverlappedResult( pPort->m_hComm, pOverlapped, pdwBytes, TRUE );
+}
+
+UINT CSerialPort::GetDriverBacklog()
+{
+    DWORD dwErrors;
+    COMSTAT ComStat;
+
+    if ( ( m_hComm == INVALID_HANDLE_VALUE ) || !ClearCommError( m_hComm, &dwErrors, &ComStat ) )
+    {
+        return 0;
+    }
+
+    return ( UINT )ComStat.cbOutQue;
+}
+
+void CSerialPort::WakeIoThread()
+{
+    if ( m_hTxEvent != NULL )
+    {
+        SetEvent( m_hTxEvent );
+    }
+}
+
+void CSerialPort::ProcessErrorMessage( const char *ErrorText )
+{
+    DWORD dwError = GetLastError();
 
-        assert(dwError == ERROR_SUCCESS);
+    // never a dialog, the I/O threads keep running while the owner looks at the error
+    if ( m_Errors.Push( ErrorText, dwError ) && ( m_pOwner != NULL ) )
+    {
+        ::PostMessage( m_pOwner, SERIAL_PORT_MESSAGE, ( WPARAM )EV_ERR, ( LPARAM )dwError );
     }
 }
 
-UINT CSerialPort::WriteChar( CSerialPort *pPort )
+UINT CSerialPort::WriteChar( CSerialPort *pPort, OVERLAPPED *pOverlapped, UINT nBudget )
 {
     BOOL bResult;
     DWORD Sent = 0;
-    EnterCriticalSection( &pPort->m_csCommunicationSync );
+    const BYTE *pData;
+    DWORD nSize = pPort->m_TxScheduler.GetFront( &pData );
+
+    if ( nSize == 0 )
+    {
+        return 0;
+    }
+
+    nSize = ( nSize < nBudget ) ? nSize : nBudget;
+
+    // no lock, a read pending on the receive thread does not hold the write back
     bResult = WriteFile( pPort->m_hComm,
-                         pPort->m_szWriteBuffer,
-                         pPort->m_nWriteSize,
-                         &Sent,
-                         NULL);
-    LeaveCriticalSection( &pPort->m_csCommunicationSync );
+                         pData,
+                         nSize,
+                         NULL,
+                         pOverlapped);
+    bResult = CompleteIo( pPort, pOverlapped, bResult, &Sent );
+
+    if ( Sent > 0 )
+    {
+        pPort->m_Metrics.OnTxChunk( Sent );
+        pPort->m_TxPacer.OnSent( SerialMetricsNow(), Sent );
+
+        if ( pPort->m_pCapture != NULL )
+        {
+            pPort->m_pCapture->Record( pPort->m_nCaptureId, SERIAL_CAPTURE_TX, SerialMetricsNow(), pData, Sent );
+        }
+    }
 
     if ( !bResult )
     {
-        pPort->ProcessErrorMessage("WriteFile()");
-        pPort->m_nWriteSize = 0;
+        if ( !pPort->m_bUserRequestClose )
+        {
+            pPort->m_Metrics.OnTxError();
+            pPort->ProcessErrorMessage("WriteFile()");
+        }
+
+        pPort->m_TxScheduler.FailFront();
         return (UINT)EOF; //break;
     }
+    else if ( Sent < nSize )
+    {
+        // WriteTotalTimeoutMultiplier/Constant expired
+        pPort->m_Metrics.OnTxError();
+        pPort->m_TxScheduler.Advance( Sent );
+        pPort->m_TxScheduler.FailFront();
+        return (UINT)Sent;
+    }
     else
     {
-        assert ( Sent == (DWORD)pPort->m_nWriteSize );
-        pPort->m_nWriteSize = 0;
+        pPort->m_TxScheduler.Advance( Sent );
         return (UINT)Sent;
     }
 }
 
-BOOL CSerialPort::ReceiveChar( CSerialPort *pPort )
+BOOL CSerialPort::ReceiveChar( CSerialPort *pPort, OVERLAPPED *pOverlapped )
 {
     BOOL  bResult = TRUE;
     DWORD BytesRead = 0;
-    unsigned char RXBuff;
+    DWORD dwEvent = 0;
+    BYTE  *pSpan;
+    DWORD nSpan;
+    BYTE  Discard[MAX_PATH];
 
-    while ( pPort->m_bThreadAlive )
+    // read whatever the driver has, straight into the ring buffer
+    nSpan = pPort->m_RxBuffer.GetWriteSpan( &pSpan );
+
+    if ( nSpan == 0 )
     {
-        if ( pPort->m_bUserRequestClose )
+        // the consumer is behind, the data is lost either way
+        pSpan = Discard;
+        nSpan = sizeof( Discard );
+    }
+
+    bResult = ReadFile( pPort->m_hComm,      // Handle to COMM port
+                        pSpan,               // RX Buffer Pointer
+                        nSpan,               // Read up to the free contiguous span
+                        NULL,
+                        pOverlapped);
+    bResult = CompleteIo( pPort, pOverlapped, bResult, &BytesRead );
+
+    if (bResult && (BytesRead > 0) && (BytesRead <= nSpan))
+    {
+        // stamped when the read completed, before anything else runs
+        UINT64 qwNow = SerialMetricsNow();
+
+        if ( pPort->m_pCapture != NULL )
         {
-            break;
+            pPort->m_pCapture->Record( pPort->m_nCaptureId, SERIAL_CAPTURE_RX, qwNow, pSpan, BytesRead );
+        }
+
+        if ( pSpan == Discard )
+        {
+            pPort->m_Metrics.OnRxOverrun( BytesRead );
+        }
+        else
+        {
+            pPort->m_RxBuffer.CommitWrite( BytesRead );
+            pPort->m_Metrics.OnRxChunk( BytesRead, pPort->m_RxBuffer.GetCount() );
+            pPort->m_Metrics.OnRxBuffered( qwNow );
         }
 
-        EnterCriticalSection( &pPort->m_csCommunicationSync );
-        bResult = ReadFile( pPort->m_hComm,      // Handle to COMM port
-                            &RXBuff,             // RX Buffer Pointer
-                            sizeof( RXBuff ),    // Read one byte
-                            &BytesRead,          // Stores number of bytes read
-                            NULL);
-        LeaveCriticalSection( &pPort->m_csCommunicationSync );
+        pPort->DeliverRx( qwNow, ( pSpan == Discard ) ? 0 : BytesRead );
+    }
+    else if ( pPort->m_bUserRequestClose )
+    {
+        return FALSE;
+    }
+    else if ((!bResult) && (ERROR_ACCESS_DENIED == GetLastError()))
+    {
+        pPort->m_Metrics.OnRxError();
+        pPort->ProcessErrorMessage("ReadFile()");
+        return FALSE;
+    }
+    else
+    {
+        // the driver is empty, sleep until the next character arrives
+        bResult = WaitCommEvent( pPort->m_hComm, &dwEvent, pOverlapped );
 
-        if (bResult && (BytesRead > 0) && (BytesRead <= sizeof(RXBuff)))
+        if ( !bResult && ( GetLastError() == ERROR_IO_PENDING ) )
         {
-            ::PostMessage( pPort->m_pOwner, SERIAL_PORT_MESSAGE, ( WPARAM )  EV_RXCHAR, ( LPARAM ) RXBuff );
+            HANDLE hEvents[3] = { pOverlapped->hEvent, pPort->m_hShutdownEvent, pPort->m_hRxWakeEvent };
+            DWORD dwResult;
+
+            // a gap of the framer or a waiter's deadline, SetRxNotifyDeadline() makes it look again
+            do
+            {
+                UINT64 qwDeadline = pPort->GetRxDeadline();
+                UINT64 qwNow = SerialMetricsNow();
+                UINT64 qwProbe = pPort->GetProbeDeadline( qwNow );
+
+                if ( ( qwProbe != 0 ) && ( ( qwDeadline == 0 ) || ( qwProbe < qwDeadline ) ) )
+                {
+                    qwDeadline = qwProbe;
+                }
+
+                DWORD dwWait = ( qwDeadline == 0 ) ? INFINITE :
+                               ( qwNow >= qwDeadline ) ? 0 : ( DWORD )( ( qwDeadline - qwNow + 999999 ) / 1000000 );
+
+                if ( ( dwResult = WaitForMultipleObjects( 3, hEvents, FALSE, dwWait ) ) == WAIT_TIMEOUT )
+                {
+                    qwNow = SerialMetricsNow();
+                    pPort->OnTimedWakeup( qwDeadline, qwNow );
+                    pPort->CheckRxIdle( qwNow );
+                }
+            }
+            while ( ( dwResult == WAIT_TIMEOUT ) || ( dwResult == WAIT_OBJECT_0 + 2 ) );
+
+            SetLastError( ERROR_IO_PENDING );
         }
-        else if ((!bResult) && (ERROR_ACCESS_DENIED == GetLastError()))
+
+        if ( !CompleteIo( pPort, pOverlapped, bResult, &BytesRead ) && !pPort->m_bUserRequestClose )
         {
-            pPort->ProcessErrorMessage("ReadFile()");
-            return FALSE;
+            DWORD dwErrors;
+
+            // a line error stops every request with fAbortOnError until it is cleared, the
+            // first retry is at once, one which keeps failing backs off from 1 ms
+            pPort->m_Metrics.OnRxError();
+            ClearCommError( pPort->m_hComm, &dwErrors, NULL );
+
+            if ( pPort->m_nRxRetries > 0 )
+            {
+                UINT nShift = ( pPort->m_nRxRetries - 1 < RX_RETRY_MAX_SHIFT ) ? pPort->m_nRxRetries - 1 : RX_RETRY_MAX_SHIFT;
+                WaitForSingleObject( pPort->m_hShutdownEvent, 1UL << nShift );
+            }
+
+            pPort->m_nRxRetries++;
         }
         else
         {
-            ::Sleep( MAX_PATH );
-            break;
+            pPort->m_nRxRetries = 0;
         }
     }
 
     return TRUE;
 }
+#endif
 
-DCB *CSerialPort::GetDCB()
-{
-    return &m_dcb;
-}
-
-BOOL CSerialPort::SetDCB( DCB *dcb )
+// nLength is what the read added to the buffer, 0 when it was discarded
+void CSerialPort::DeliverRx( UINT64 qwTimestamp, UINT nLength )
 {
-    BOOL ret = TRUE;
-    assert( m_hComm != INVALID_HANDLE_VALUE );
-    assert( dcb != NULL );
+    UINT nClose = m_nCloseCount.load();
+    UINT nMinBytes = m_nRxMinBytes.load( std::memory_order_relaxed );
+    UINT64 qwLast = m_qwLastRxTime.exchange( qwTimestamp, std::memory_order_relaxed );
 
-    do
+    if ( nMinBytes > 1 )
     {
-        ::Sleep( 0 );
-    }
-    while ( m_nWriteSize );
+        UINT64 qwGap = ( m_pFramer != NULL ) ? m_pFramer->GetGap() : 0;
+        UINT64 qwSpread = ( nLength > 0 ) ? ( UINT64 )( nLength - 1 ) * GetCharacterTime() : 0;
 
-    EnterCriticalSection( &m_csCommunicationSync );
-    m_dcb = *dcb;
+        // a read which started after the gap of the framer ends the hold, what was held
+        // is a frame of its own and goes out with the time of its last read
+        if ( ( m_qwRxHeldSince != 0 ) && ( qwGap != 0 ) && ( nLength > 0 ) && ( qwTimestamp >= qwSpread ) &&
+             ( qwTimestamp - qwSpread >= qwLast + qwGap ) )
+        {
+            DispatchRx( qwLast, m_RxBuffer.GetCount() - nLength );
 
-    if ( SetCommState( m_hComm, &m_dcb ) == 0 )
-    {
-        ProcessErrorMessage( "SetCommState()" );
-        ret = FALSE;
+            if ( m_nCloseCount.load() != nClose )
+            {
+                return;
+            }
+
+            m_pFramer->OnIdle( qwTimestamp );
+
+            if ( m_nCloseCount.load() != nClose )
+            {
+                return;
+            }
+        }
+
+        if ( m_qwRxHeldSince == 0 )
+        {
+            m_qwRxHeldSince = qwTimestamp;
+        }
+
+        // a full buffer goes out whatever the policy says
+        if ( ( m_RxBuffer.GetCount() < nMinBytes ) && ( m_RxBuffer.GetCount() < m_RxBuffer.GetCapacity() ) &&
+             ( qwTimestamp < GetRxHoldDeadline() ) )
+        {
+            return;
+        }
     }
 
-    LeaveCriticalSection( &m_csCommunicationSync );
-    return ret;
+    DispatchRx( qwTimestamp );
 }
 
-BOOL CSerialPort::IsOpen()
+// at most nLimit bytes go to the callbacks and the framer, the rest stays in the buffer
+void CSerialPort::DispatchRx( UINT64 qwTimestamp, UINT nLimit )
 {
-    return m_hComm != INVALID_HANDLE_VALUE;
-}
+    UINT nClose = m_nCloseCount.load();
+    m_qwRxHeldSince = 0;
 
-void CSerialPort::Close()
-{
-    if ( (!m_bUserRequestClose) && (m_bThreadAlive) )
+    if ( ( m_pfnRxCallback != NULL ) || ( m_pfnRxStampedCallback != NULL ) || ( m_pfnRxBufferCallback != NULL ) || ( m_pFramer != NULL ) )
     {
-        m_bUserRequestClose = TRUE;
+        const BYTE *pData;
+        UINT nSpan;
 
-        do
+        while ( ( nLimit > 0 ) && ( ( nSpan = m_RxBuffer.GetReadSpan( &pData ) ) > 0 ) )
         {
-            ::Sleep( 0 );
-        }
-        while ( m_bThreadAlive );
+            nSpan = ( nSpan < nLimit ) ? nSpan : nLimit;
 
-        m_bUserRequestClose = FALSE;
-    }
+            if ( m_pfnRxCallback != NULL )
+            {
+                m_pfnRxCallback( m_pRxContext, pData, nSpan );
+            }
+            else if ( m_pfnRxStampedCallback != NULL )
+            {
+                m_pfnRxStampedCallback( m_pRxContext, pData, nSpan, qwTimestamp );
+            }
+            else if ( m_pfnRxBufferCallback != NULL )
+            {
+                SERIAL_BUFFER *pBuffer;
+                nSpan = ( nSpan < SERIAL_BUFFER_MAX_SIZE ) ? nSpan : ( UINT )SERIAL_BUFFER_MAX_SIZE;
 
-    EnterCriticalSection( &m_csCommunicationSync );
+                // without a buffer the data stays in the ring, the next read tries again
+                if ( ( pBuffer = m_pPool->Alloc( nSpan ) ) == NULL )
+                {
+                    break;
+                }
 
-    if ( m_hComm != INVALID_HANDLE_VALUE )
-    {
-        CloseHandle( m_hComm );
-        m_hComm = INVALID_HANDLE_VALUE;
-    }
+                memcpy( pBuffer->pData, pData, nSpan );
+                pBuffer->qwTimestamp = qwTimestamp;
+                m_pfnRxBufferCallback( m_pRxContext, pBuffer );
+            }
+
+            // closed from the callback, the buffer is gone
+            if ( m_nCloseCount.load() != nClose )
+            {
+                return;
+            }
+
+            // complete frames go out straight from the ring buffer
+            if ( m_pFramer != NULL )
+            {
+                m_pFramer->Feed( pData, nSpan, qwTimestamp );
+
+                if ( m_nCloseCount.load() != nClose )
+                {
+                    return;
+                }
+            }
+
+            m_RxBuffer.CommitRead( nSpan );
+            nLimit -= nSpan;
+        }
 
-    if ( m_szWriteBuffer != NULL )
+        m_Metrics.OnRxConsumed( TRUE );
+    }
+    else if ( m_pfnRxNotify != NULL )
     {
-        delete [] m_szWriteBuffer;
-        m_szWriteBuffer = NULL;
+        m_pfnRxNotify( m_pRxNotifyContext, qwTimestamp );
     }
-
-    if ( m_Thread != NULL )
+    else if ( ( m_pOwner != NULL ) && !m_bRxNotifyPending.exchange( TRUE ) )
     {
-        CloseHandle( m_Thread );
-        m_Thread = NULL;
+        // one message until the consumer reads again, LPARAM is the number of bytes buffered
+        ::PostMessage( m_pOwner, SERIAL_PORT_MESSAGE, ( WPARAM )EV_RXCHAR, ( LPARAM )m_RxBuffer.GetCount() );
     }
-
-    LeaveCriticalSection( &m_csCommunicationSync );
 }
 
-void CSerialPort::Write( char *Buffer )
+void CSerialPort::SetRxBufferSize( UINT nSize )
 {
-    int nSize;
-    int ttl;
-    assert( m_hComm != INVALID_HANDLE_VALUE );
-    assert( Buffer != NULL );
-    nSize = strlen( Buffer );
+    assert( !IsOpen() );
     assert( nSize > 0 );
-    EnterCriticalSection( &m_csCommunicationSync );
-    assert( ( m_nWriteSize + nSize ) < ( int )m_nWriteBufferSize );
-    strcpy( m_szWriteBuffer + m_nWriteSize, Buffer );
-    m_nWriteSize += nSize;
-    ttl = ((1000UL * (m_dcb.ByteSize + m_dcb.StopBits + 1) * m_nWriteSize) / m_dcb.BaudRate) + 1;
-    LeaveCriticalSection( &m_csCommunicationSync );
+    m_nRxBufferSize = nSize;
+}
 
-    do
-    {
-        ::Sleep( 0 );
-    }
-    while ( m_nWriteSize );
+void CSerialPort::SetRxCallback( SERIAL_RX_CALLBACK pfnCallback, void *pContext )
+{
+    assert( !IsOpen() );
+    m_pfnRxCallback = pfnCallback;
+    m_pfnRxStampedCallback = NULL;
+    m_pfnRxBufferCallback = NULL;
+    m_pRxContext = pContext;
+}
 
-    ::Sleep( ttl );
+void CSerialPort::SetRxCallback( SERIAL_RX_STAMPED_CALLBACK pfnCallback, void *pContext )
+{
+    assert( !IsOpen() );
+    m_pfnRxCallback = NULL;
+    m_pfnRxStampedCallback = pfnCallback;
+    m_pfnRxBufferCallback = NULL;
+    m_pRxContext = pContext;
 }
 
-void CSerialPort::Write( void *Buffer, int nSize )
+void CSerialPort::SetRxCallback( SERIAL_RX_BUFFER_CALLBACK pfnCallback, void *pContext )
 {
-    int ttl;
-    assert( m_hComm != INVALID_HANDLE_VALUE );
-    assert( Buffer != NULL );
-    assert( nSize > 0 );
-    EnterCriticalSection( &m_csCommunicationSync );
-    assert( ( m_nWriteSize + nSize ) < ( int )m_nWriteBufferSize );
-    memcpy( m_szWriteBuffer + m_nWriteSize, Buffer, nSize );
-    m_nWriteSize += nSize;
-    ttl = ((1000UL * (m_dcb.ByteSize + m_dcb.StopBits + 1) * m_nWriteSize) / m_dcb.BaudRate) + 1;
-    LeaveCriticalSection( &m_csCommunicationSync );
+    assert( !IsOpen() );
+    m_pfnRxCallback = NULL;
+    m_pfnRxStampedCallback = NULL;
+    m_pfnRxBufferCallback = pfnCallback;
+    m_pRxContext = pContext;
+}
 
-    do
-    {
-        ::Sleep( 0 );
-    }
-    while ( m_nWriteSize );
+void CSerialPort::SetBufferPool( CSerialBufferPool *pPool )
+{
+    assert( !IsOpen() );
+    m_pPool = ( pPool != NULL ) ? pPool : &m_Pool;
+    m_TxScheduler.SetPool( m_pPool );
+}
+
+CSerialBufferPool *CSerialPort::GetBufferPool()
+{
+    return m_pPool;
+}
+
+void CSerialPort::SetFramer( CSerialFramer *pFramer )
+{
+    assert( !IsOpen() );
+    m_pFramer = pFramer;
+}
+
+void CSerialPort::SetCapture( CSerialCapture *pCapture, UINT nPortId )
+{
+    assert( !IsOpen() );
+    m_pCapture = pCapture;
+    m_nCaptureId = nPortId;
+}
+
+UINT64 CSerialPort::GetLastRxTime()
+{
+    return m_qwLastRxTime.load( std::memory_order_relaxed );
+}
+
+UINT64 CSerialPort::GetCharacterTime()
+{
+    return m_qwCharTime.load( std::memory_order_relaxed );
+}
+
+// a DCB was applied, under the lock; the I/O paths, the framer and the capture follow the character time
+void CSerialPort::OnLineChanged()
+{
+    // start bit, data bits, parity and stop bits, in half bits for 1.5 stop bits
+    UINT nHalfBits = 2 * ( 1 + m_dcb.ByteSize ) + ( ( m_dcb.Parity != NOPARITY ) ? 2 : 0 );
+    nHalfBits += ( m_dcb.StopBits == ONESTOPBIT ) ? 2 : ( ( m_dcb.StopBits == ONE5STOPBITS ) ? 3 : 4 );
+    UINT64 qwCharTime = ( m_dcb.BaudRate != 0 ) ? ( UINT64 )nHalfBits * 500000000ULL / m_dcb.BaudRate : 0;
+
+    m_qwCharTime.store( qwCharTime, std::memory_order_relaxed );
+    m_TxPacer.SetCharacterTime( qwCharTime );
+
+    if ( m_pFramer != NULL )
+    {
+        m_pFramer->SetCharacterTime( qwCharTime );
+    }
+
+    if ( m_pCapture != NULL )
+    {
+        m_pCapture->Record( m_nCaptureId, SERIAL_CAPTURE_LINE, SerialMetricsNow(), ( const BYTE * )&qwCharTime, sizeof( qwCharTime ) );
+    }
+}
+
+void CSerialPort::SetRxPolicy( UINT nMinBytes, UINT nMaxDelayUs )
+{
+    m_nRxMaxDelayUs.store( nMaxDelayUs, std::memory_order_relaxed );
+    m_nRxMinBytes.store( nMinBytes, std::memory_order_relaxed );
+}
+
+void CSerialPort::GetRxPolicy( UINT *pnMinBytes, UINT *pnMaxDelayUs )
+{
+    *pnMinBytes = m_nRxMinBytes.load( std::memory_order_relaxed );
+    *pnMaxDelayUs = m_nRxMaxDelayUs.load( std::memory_order_relaxed );
+}
+
+void CSerialPort::SetRxNotify( SERIAL_RX_NOTIFY pfnNotify, void *pContext )
+{
+    assert( !IsOpen() );
+    m_pfnRxNotify = pfnNotify;
+    m_pRxNotifyContext = pContext;
+}
+
+void CSerialPort::SetRxNotifyDeadline( UINT64 qwDeadline )
+{
+    m_qwRxNotifyDeadline.store( qwDeadline );
+
+    // clearing needs no wakeup, a deadline nobody waits for only costs a spurious call
+    if ( qwDeadline != 0 )
+    {
+#ifdef _WIN32
+        if ( m_hRxWakeEvent != NULL )
+        {
+            SetEvent( m_hRxWakeEvent );
+        }
+#else
+        WakeIoThread();
+#endif
+    }
+}
+
+// when the data held since m_qwRxHeldSince has to go out, 0 when nothing is held
+UINT64 CSerialPort::GetRxHoldDeadline()
+{
+    UINT64 qwDelay = ( UINT64 )m_nRxMaxDelayUs.load( std::memory_order_relaxed ) * 1000;
+
+    if ( m_qwRxHeldSince == 0 )
+    {
+        return 0;
+    }
+
+    if ( qwDelay == 0 )
+    {
+        qwDelay = ( UINT64 )m_nRxMinBytes.load( std::memory_order_relaxed ) * GetCharacterTime();
+    }
+
+    return m_qwRxHeldSince + qwDelay;
+}
+
+UINT64 CSerialPort::GetRxDeadline()
+{
+    UINT64 qwDeadlines[3];
+    UINT64 qwDeadline = 0;
+
+    qwDeadlines[0] = ( m_pFramer != NULL ) ? m_pFramer->GetDeadline() : 0;
+    qwDeadlines[1] = GetRxHoldDeadline();
+    qwDeadlines[2] = m_qwRxNotifyDeadline.load();
+
+    for ( UINT i = 0; i < 3; i++ )
+    {
+        if ( ( qwDeadlines[i] != 0 ) && ( ( qwDeadline == 0 ) || ( qwDeadlines[i] < qwDeadline ) ) )
+        {
+            qwDeadline = qwDeadlines[i];
+        }
+    }
+
+    return qwDeadline;
+}
+
+void CSerialPort::CheckRxIdle( UINT64 qwNow )
+{
+    UINT nClose = m_nCloseCount.load();
+    UINT64 qwDeadline = GetRxDeadline();
+    UINT64 qwFramer = ( m_pFramer != NULL ) ? m_pFramer->GetDeadline() : 0;
+    BOOL bFramerDue = ( qwFramer != 0 ) && ( qwNow >= qwFramer );
+
+    if ( ( qwDeadline == 0 ) || ( qwNow < qwDeadline ) )
+    {
+        return;
+    }
+
+    // held data arrived before the silence the framer waits for, it goes first
+    if ( ( m_qwRxHeldSince != 0 ) && ( bFramerDue || ( qwNow >= GetRxHoldDeadline() ) ) )
+    {
+        DispatchRx( m_qwLastRxTime.load( std::memory_order_relaxed ) );
+    }
+
+    if ( ( m_nCloseCount.load() == nClose ) && ( m_pFramer != NULL ) && ( ( qwDeadline = m_pFramer->GetDeadline() ) != 0 ) &&
+         ( qwNow >= qwDeadline ) )
+    {
+        m_pFramer->OnIdle( qwNow );
+    }
+
+    if ( m_nCloseCount.load() != nClose )
+    {
+        return;
+    }
+
+    // cleared before the call, the waiter sets its next one
+    qwDeadline = m_qwRxNotifyDeadline.load();
+
+    if ( ( qwDeadline != 0 ) && ( qwNow >= qwDeadline ) && m_qwRxNotifyDeadline.compare_exchange_strong( qwDeadline, 0 ) &&
+         ( m_pfnRxNotify != NULL ) )
+    {
+        m_pfnRxNotify( m_pRxNotifyContext, qwNow );
+    }
+}
+
+void CSerialPort::SetThreadOptions( const SERIAL_THREAD_OPTIONS *pOptions )
+{
+    assert( !IsOpen() );
+    m_ThreadOptions = *pOptions;
+}
+
+DWORD CSerialPort::GetThreadState()
+{
+    return m_dwThreadState.load();
+}
+
+void CSerialPort::LockBuffers()
+{
+    if ( !m_ThreadOptions.bLockMemory )
+    {
+        return;
+    }
+
+    // locked with the receive buffer and the pool, the thread adds its stack
+    if ( m_RxBuffer.LockMemory() && m_pPool->LockMemory() )
+    {
+        m_dwThreadState |= SERIAL_THREAD_LOCKED;
+    }
+    else
+    {
+        ProcessErrorMessage( "mlock()" );
+    }
+}
+
+void CSerialPort::ApplyThreadOptions()
+{
+    const char *pszFailed;
+    DWORD dwGranted = SerialThreadApply( &m_ThreadOptions, &pszFailed );
+
+    m_dwThreadState = dwGranted & ( m_dwThreadState.load() | ~( DWORD )SERIAL_THREAD_LOCKED );
+
+    if ( pszFailed != NULL )
+    {
+        ProcessErrorMessage( pszFailed );
+    }
+}
+
+UINT64 CSerialPort::GetProbeDeadline( UINT64 qwNow )
+{
+    if ( m_ThreadOptions.nProbeUs == 0 )
+    {
+        return 0;
+    }
+
+    if ( m_qwProbeNext == 0 )
+    {
+        m_qwProbeNext = qwNow + ( UINT64 )m_ThreadOptions.nProbeUs * 1000;
+    }
+
+    return m_qwProbeNext;
+}
+
+void CSerialPort::OnTimedWakeup( UINT64 qwDeadline, UINT64 qwNow )
+{
+    m_Metrics.OnWakeup( ( qwNow > qwDeadline ) ? qwNow - qwDeadline : 0 );
+
+    if ( ( m_qwProbeNext != 0 ) && ( qwNow >= m_qwProbeNext ) )
+    {
+        // the next tick of the grid, missed ones are not made up
+        UINT64 qwPeriod = ( UINT64 )m_ThreadOptions.nProbeUs * 1000;
+        m_qwProbeNext += ( ( qwNow - m_qwProbeNext ) / qwPeriod + 1 ) * qwPeriod;
+    }
+}
+
+UINT CSerialPort::Read( void *Buffer, UINT nSize )
+{
+    assert( Buffer != NULL );
+    // cleared before reading, data committed after this point is notified again
+    m_bRxNotifyPending = FALSE;
+    UINT nRead = m_RxBuffer.Read( Buffer, nSize );
+
+    if ( nRead > 0 )
+    {
+        m_Metrics.OnRxConsumed( m_RxBuffer.GetCount() == 0 );
+    }
+
+    return nRead;
+}
+
+UINT CSerialPort::PeekRx( const BYTE **ppData )
+{
+    assert( ppData != NULL );
+    m_bRxNotifyPending = FALSE;
+    return m_RxBuffer.GetReadSpan( ppData );
+}
+
+void CSerialPort::ConsumeRx( UINT nSize )
+{
+    m_RxBuffer.CommitRead( nSize );
+
+    if ( nSize > 0 )
+    {
+        m_Metrics.OnRxConsumed( m_RxBuffer.GetCount() == 0 );
+    }
+}
+
+UINT CSerialPort::GetRxCount()
+{
+    return m_RxBuffer.GetCount();
+}
+
+UINT64 CSerialPort::GetRxOverrun()
+{
+    return m_Metrics.GetRxOverrun();
+}
+
+BOOL CSerialPort::GetError( SERIAL_PORT_ERROR *pError )
+{
+    assert( pError != NULL );
+    return m_Errors.Pop( pError );
+}
+
+UINT CSerialPort::GetErrorCount()
+{
+    return m_Errors.GetCount();
+}
+
+void CSerialPort::GetMetrics( SERIAL_PORT_METRICS *pMetrics, BOOL bReset )
+{
+    assert( pMetrics != NULL );
+    m_Metrics.Snapshot( pMetrics, bReset );
+}
+
+void CSerialPort::ResetMetrics()
+{
+    m_Metrics.Reset();
+}
+
+DCB *CSerialPort::GetDCB()
+{
+    return &m_dcb;
+}
+
+#ifdef _WIN32
+BOOL CSerialPort::SetDCB( DCB *dcb )
+{
+    BOOL ret = TRUE;
+    assert( m_hComm != INVALID_HANDLE_VALUE );
+    assert( dcb != NULL );
+    // applied at once, bytes still queued go out with the new settings; a refused DCB changes nothing
+    EnterCriticalSection( &m_csCommunicationSync );
+
+    if ( SetCommState( m_hComm, dcb ) == 0 )
+    {
+        ProcessErrorMessage( "SetCommState()" );
+        ret = FALSE;
+    }
+    else
+    {
+        m_dcb = *dcb;
+        OnLineChanged();
+    }
+
+    LeaveCriticalSection( &m_csCommunicationSync );
+    return ret;
+}
+#endif
+
+BOOL CSerialPort::IsOpen()
+{
+    return m_hComm != INVALID_HANDLE_VALUE;
+}
+
+#ifdef _WIN32
+void CSerialPort::Close()
+{
+    HANDLE hThreads[2];
+    DWORD nThreads = 0;
+
+    if ( m_Thread != NULL )
+    {
+        hThreads[nThreads++] = m_Thread;
+    }
+
+    if ( m_TxThread != NULL )
+    {
+        hThreads[nThreads++] = m_TxThread;
+    }
+
+    if ( nThreads > 0 )
+    {
+        // wakes both threads and cancels their pending reads and writes
+        m_nCloseCount++;
+        m_bUserRequestClose = TRUE;
+        SetEvent( m_hShutdownEvent );
+        WaitForMultipleObjects( nThreads, hThreads, TRUE, INFINITE );
+        m_bThreadAlive = FALSE;
+        m_bUserRequestClose = FALSE;
+    }
+
+    EnterCriticalSection( &m_csCommunicationSync );
+
+    if ( m_hComm != INVALID_HANDLE_VALUE )
+    {
+        CloseHandle( m_hComm );
+        m_hComm = INVALID_HANDLE_VALUE;
+    }
+
+    m_RxBuffer.Destroy();
+    m_TxScheduler.Close();
+
+    if ( m_Thread != NULL )
+    {
+        CloseHandle( m_Thread );
+        m_Thread = NULL;
+    }
+
+    if ( m_TxThread != NULL )
+    {
+        CloseHandle( m_TxThread );
+        m_TxThread = NULL;
+    }
+
+    if ( m_hShutdownEvent != NULL )
+    {
+        CloseHandle( m_hShutdownEvent );
+        m_hShutdownEvent = NULL;
+    }
+
+    if ( m_hTxEvent != NULL )
+    {
+        CloseHandle( m_hTxEvent );
+        m_hTxEvent = NULL;
+    }
+
+    if ( m_hRxWakeEvent != NULL )
+    {
+        CloseHandle( m_hRxWakeEvent );
+        m_hRxWakeEvent = NULL;
+    }
+
+    LeaveCriticalSection( &m_csCommunicationSync );
+}
+#endif
+
+void CSerialPort::Write( char *Buffer )
+{
+    assert( Buffer != NULL );
+    Write( Buffer, ( int )strlen( Buffer ) );
+}
+
+void CSerialPort::Write( void *Buffer, int nSize )
+{
+    UINT64 qwSequence;
+    UINT64 qwCharTime;
+    UINT nBacklog;
+    UINT nLast = ~0U;
+    assert( m_hComm != INVALID_HANDLE_VALUE );
+    assert( Buffer != NULL );
+    assert( nSize > 0 );
+    qwSequence = m_TxScheduler.GetLane( SERIAL_TX_NORMAL ).Push( Buffer, nSize, NULL, NULL, INFINITE );
+
+    if ( qwSequence == 0 )
+    {
+        return;
+    }
+
+    WakeIoThread();
+
+    if ( !m_TxScheduler.GetLane( SERIAL_TX_NORMAL ).WaitComplete( qwSequence, GetWriteWait( m_TxScheduler.GetQueuedBytes() ) ) )
+    {
+        return;
+    }
+
+    qwCharTime = GetCharacterTime();
+
+    // until the driver's output queue went out, as long as it keeps draining
+    while ( ( ( nBacklog = GetTxBacklog() ) > 0 ) && ( nBacklog < nLast ) )
+    {
+        nLast = nBacklog;
+        std::this_thread::sleep_for( std::chrono::nanoseconds( nBacklog * qwCharTime ) );
+    }
+}
 
-    ::Sleep( ttl );
+// as long as WriteFile() would take for nBytes by the write timeouts, without them twice
+// the time the bytes take on the line
+DWORD CSerialPort::GetWriteWait( UINT nBytes )
+{
+    UINT64 qwWait;
+
+    EnterCriticalSection( &m_csCommunicationSync );
+
+    if ( ( m_CommTimeouts.WriteTotalTimeoutMultiplier != 0 ) || ( m_CommTimeouts.WriteTotalTimeoutConstant != 0 ) )
+    {
+        qwWait = ( UINT64 )m_CommTimeouts.WriteTotalTimeoutMultiplier * nBytes + m_CommTimeouts.WriteTotalTimeoutConstant;
+    }
+    else
+    {
+        qwWait = 2 * ( UINT64 )nBytes * GetCharacterTime() / 1000000 + SERIAL_WRITE_MIN_WAIT_MS;
+    }
+
+    LeaveCriticalSection( &m_csCommunicationSync );
+    return ( qwWait < INFINITE ) ? ( DWORD )qwWait : INFINITE - 1;
+}
+
+BOOL CSerialPort::WriteAsync( const void *Buffer, UINT nSize, SERIAL_TX_CALLBACK pfnCallback, void *pContext, DWORD dwTimeout )
+{
+    return WriteLane( SERIAL_TX_NORMAL, Buffer, nSize, pfnCallback, pContext, dwTimeout );
+}
+
+BOOL CSerialPort::WriteLane( UINT nLane, const void *Buffer, UINT nSize, SERIAL_TX_CALLBACK pfnCallback, void *pContext, DWORD dwTimeout )
+{
+    assert( nLane < SERIAL_TX_LANES );
+    assert( Buffer != NULL );
+    assert( nSize > 0 );
+
+    // blocks only while the lane is above the high-water mark, never for the transmit time
+    if ( m_TxScheduler.GetLane( nLane ).Push( Buffer, nSize, pfnCallback, pContext, dwTimeout ) == 0 )
+    {
+        return FALSE;
+    }
+
+    WakeIoThread();
+    return TRUE;
+}
+
+BOOL CSerialPort::WriteChecked( const void *Buffer, UINT nSize, SERIAL_CHECKSUM Type, SERIAL_TX_CALLBACK pfnCallback, void *pContext, DWORD dwTimeout )
+{
+    BYTE Trailer[SERIAL_CHECKSUM_MAX_SIZE];
+    assert( Buffer != NULL );
+    assert( nSize > 0 );
+
+    // the checksum is appended to the queued copy of the data
+    SerialChecksumStore( Type, SerialChecksumUpdate( Type, SerialChecksumInit( Type ), Buffer, nSize ), Trailer );
+
+    if ( m_TxScheduler.GetLane( SERIAL_TX_NORMAL ).Push( Buffer, nSize, pfnCallback, pContext, dwTimeout, Trailer, SerialChecksumSize( Type ) ) == 0 )
+    {
+        return FALSE;
+    }
+
+    WakeIoThread();
+    return TRUE;
+}
+
+static void ReleaseTxBuffer( void *pContext, const void *pData, UINT nSize )
+{
+    ( void )pData;
+    ( void )nSize;
+    SerialBufferRelease( ( SERIAL_BUFFER * )pContext );
+}
+
+BOOL CSerialPort::WriteBuffer( SERIAL_BUFFER *pBuffer, SERIAL_TX_CALLBACK pfnCallback, void *pContext, DWORD dwTimeout )
+{
+    SERIAL_TX_BUFFER Buffer;
+    assert( pBuffer != NULL );
+    assert( pBuffer->nSize > 0 );
+
+    Buffer.pData = pBuffer->pData;
+    Buffer.nSize = pBuffer->nSize;
+    Buffer.pfnRelease = ReleaseTxBuffer;
+    Buffer.pContext = pBuffer;
+    SerialBufferAddRef( pBuffer );
+
+    if ( m_TxScheduler.GetLane( SERIAL_TX_NORMAL ).PushV( &Buffer, 1, pfnCallback, pContext, dwTimeout ) == 0 )
+    {
+        SerialBufferRelease( pBuffer );
+        return FALSE;
+    }
+
+    WakeIoThread();
+    return TRUE;
+}
+
+BOOL CSerialPort::WriteV( const SERIAL_TX_BUFFER *pBuffers, UINT nCount, SERIAL_TX_CALLBACK pfnCallback, void *pContext, DWORD dwTimeout )
+{
+    return WriteVLane( SERIAL_TX_NORMAL, pBuffers, nCount, pfnCallback, pContext, dwTimeout );
+}
+
+BOOL CSerialPort::WriteVLane( UINT nLane, const SERIAL_TX_BUFFER *pBuffers, UINT nCount, SERIAL_TX_CALLBACK pfnCallback, void *pContext, DWORD dwTimeout )
+{
+    assert( nLane < SERIAL_TX_LANES );
+    assert( pBuffers != NULL );
+    assert( nCount > 0 );
+
+    // no copy, the buffers belong to the caller until their release callback
+    if ( m_TxScheduler.GetLane( nLane ).PushV( pBuffers, nCount, pfnCallback, pContext, dwTimeout ) == 0 )
+    {
+        return FALSE;
+    }
+
+    WakeIoThread();
+    return TRUE;
+}
+
+void CSerialPort::SetTxScheduling( SERIAL_TX_SCHEDULING Scheduling )
+{
+    assert( !IsOpen() );
+    m_TxScheduler.SetScheduling( Scheduling );
+}
+
+void CSerialPort::SetTxLane( UINT nLane, UINT nSlice, UINT nWeight )
+{
+    assert( !IsOpen() );
+    assert( nLane < SERIAL_TX_LANES );
+    m_TxScheduler.SetLane( nLane, nSlice, nWeight );
+}
+
+void CSerialPort::SetTxPacing( SERIAL_TX_PACING Pacing, UINT nLeadUs )
+{
+    assert( !IsOpen() );
+    m_TxPacer.SetPacing( Pacing, nLeadUs );
+}
+
+void CSerialPort::SetTxRateLimit( UINT nBytesPerSecond, UINT nBurst )
+{
+    assert( !IsOpen() );
+    m_TxPacer.SetRateLimit( nBytesPerSecond, nBurst );
+}
+
+UINT CSerialPort::GetTxBacklog()
+{
+    return m_TxPacer.GetBacklog( SerialMetricsNow(), GetDriverBacklog() );
+}
+
+void CSerialPort::SetTxHighWaterMark( UINT nSize )
+{
+    m_TxScheduler.SetHighWaterMark( nSize );
+}
+
+UINT CSerialPort::GetTxQueued()
+{
+    return m_TxScheduler.GetQueuedBytes();
+}
+
+BOOL CSerialPort::WaitTxEmpty( DWORD dwTimeout )
+{
+    return m_TxScheduler.WaitEmpty( dwTimeout );
+}
+
+void CSerialPort::GetTxStats( SERIAL_TX_STATS *pStats )
+{
+    assert( pStats != NULL );
+    m_TxScheduler.GetStats( pStats );
 }
 
+#ifdef _WIN32
 BOOL CSerialPort::QueryRegistry( HKEY hKey )
 {
     TCHAR    achClass[MAX_PATH] = _T( "" );   // buffer for class name
@@ -562,3 +1539,4 @@ void CSerialPort::EnumSerialPort( CComboBox &m_PortNO )
         RegCloseKey( hTestKey );
     }
 }
+#endif
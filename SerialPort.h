@@ -3,11 +3,11 @@
 **
 **  PURPOSE             This class can read, write and watch one serial port.
 **                      It sends messages to its owner when something happends on the port
-**                      The class creates a thread for reading and writing so the main
-**                      program is not blocked.
+**                      The class creates a thread for reading and one for writing, so
+**                      the main program is not blocked and both directions run at once.
 **
 **  CREATION DATE       15-09-1997
-**  LAST MODIFICATION   18-03-2018
+**  LAST MODIFICATION   16-10-2026
 **
 **  AUTHOR              Remon Spekreijse
 */
@@ -15,12 +15,61 @@
 #ifndef SERIAL_PORT_H
 #define SERIAL_PORT_H
 
+#ifndef _WIN32
+#include "SerialPortPosix.h"
+#endif
+
 #define SERIAL_PORT_MAX             256UL                   /* http://digital.ni.com/public.nsf/allkb/F7A9002D7B8E31E7862568D6006BD10B */
+
+#ifdef _WIN32
 #define MAX_VALUE_NAME              16383UL                 /* https://msdn.microsoft.com/en-us/library/ms724872(v=vs.85).aspx */
 #define SERIAL_DEVICE_PREFIX        _T("COM")
 #define WM_SERIAL_PORT_MESSAGE      _T("WM_SERIAL_PORT_MESSAGE_ID")
 
 const static UINT  SERIAL_PORT_MESSAGE = ::RegisterWindowMessage( WM_SERIAL_PORT_MESSAGE );
+#else
+#define SERIAL_DEVICE_PREFIX        "/dev/ttyS"
+#endif
+
+#include "SerialBufferPool.h"
+#include "SerialCapture.h"
+#include "SerialChecksum.h"
+#include "SerialErrorQueue.h"
+#include "SerialFramer.h"
+#include "SerialMetrics.h"
+#include "SerialRingBuffer.h"
+#include "SerialThread.h"
+#include "SerialTxPacer.h"
+#include "SerialTxScheduler.h"
+
+#define SERIAL_RX_BUFFER_SIZE       65536UL                 /* default size of the receive ring buffer */
+#define SERIAL_WRITE_MIN_WAIT_MS    1000UL                  /* Write() without write timeouts, added to the line time */
+
+/*
+** Called on the I/O thread with each contiguous span of received data. The span
+** is released as soon as the callback returns.
+*/
+typedef void ( *SERIAL_RX_CALLBACK )( void *pContext, const BYTE *pData, UINT nLength );
+
+// the same with the SerialMetricsNow() time at which the read of the span completed
+typedef void ( *SERIAL_RX_STAMPED_CALLBACK )( void *pContext, const BYTE *pData, UINT nLength, UINT64 qwTimestamp );
+
+/*
+** The same copied into a buffer of the port's pool, with the timestamp in it. The
+** callback owns one reference and may keep the buffer as long as it likes.
+*/
+typedef void ( *SERIAL_RX_BUFFER_CALLBACK )( void *pContext, SERIAL_BUFFER *pBuffer );
+
+/*
+** Called on the I/O thread, instead of EV_RXCHAR, when received data is ready for the
+** pull interface, and once the deadline of SetRxNotifyDeadline() passed. qwNow is the
+** time of the read or of the check.
+*/
+typedef void ( *SERIAL_RX_NOTIFY )( void *pContext, UINT64 qwNow );
+
+#ifdef SERIAL_PORT_REACTOR
+class CSerialPortReactor;
+#endif
 
 class CSerialPort
 {
@@ -41,36 +90,229 @@ class CSerialPort
                                   DWORD ReadTotalTimeoutConstant = 0,
                                   DWORD WriteTotalTimeoutMultiplier = 10,
                                   DWORD WriteTotalTimeoutConstant = 10 );
+        BOOL                OpenDevice( HWND  pPortOwner,
+                                        const char *szPort,
+                                        UINT  baud = 9600,
+                                        BYTE  parity = NOPARITY,
+                                        BYTE  databits = 8,
+                                        BYTE  stopbits = ONESTOPBIT,
+                                        DWORD dwCommEvents = EV_RXCHAR,
+                                        UINT  nBufferSize = 4096,
+                                        DWORD ReadIntervalTimeout = MAXDWORD,
+                                        DWORD ReadTotalTimeoutMultiplier = 0,
+                                        DWORD ReadTotalTimeoutConstant = 0,
+                                        DWORD WriteTotalTimeoutMultiplier = 10,
+                                        DWORD WriteTotalTimeoutConstant = 10 );
         void                Write( char *Buffer );
         void                Write( void *Buffer, int nSize );
+        BOOL                WriteAsync( const void *Buffer, UINT nSize,
+                                        SERIAL_TX_CALLBACK pfnCallback = NULL, void *pContext = NULL,
+                                        DWORD dwTimeout = INFINITE );
+        BOOL                WriteChecked( const void *Buffer, UINT nSize, SERIAL_CHECKSUM Type,
+                                          SERIAL_TX_CALLBACK pfnCallback = NULL, void *pContext = NULL,
+                                          DWORD dwTimeout = INFINITE );
+        BOOL                WriteV( const SERIAL_TX_BUFFER *pBuffers, UINT nCount,
+                                    SERIAL_TX_CALLBACK pfnCallback = NULL, void *pContext = NULL,
+                                    DWORD dwTimeout = INFINITE );
+        // into a lane of SerialTxScheduler.h, the others above go to SERIAL_TX_NORMAL
+        BOOL                WriteLane( UINT nLane, const void *Buffer, UINT nSize,
+                                       SERIAL_TX_CALLBACK pfnCallback = NULL, void *pContext = NULL,
+                                       DWORD dwTimeout = INFINITE );
+        BOOL                WriteVLane( UINT nLane, const SERIAL_TX_BUFFER *pBuffers, UINT nCount,
+                                        SERIAL_TX_CALLBACK pfnCallback = NULL, void *pContext = NULL,
+                                        DWORD dwTimeout = INFINITE );
+        // no copy, the queue takes its own reference for pBuffer->nSize bytes
+        BOOL                WriteBuffer( SERIAL_BUFFER *pBuffer,
+                                         SERIAL_TX_CALLBACK pfnCallback = NULL, void *pContext = NULL,
+                                         DWORD dwTimeout = INFINITE );
+        void                SetTxScheduling( SERIAL_TX_SCHEDULING Scheduling );             // before Open()
+        void                SetTxLane( UINT nLane, UINT nSlice, UINT nWeight = 1 );         // before Open()
+        // how much the driver is handed ahead of the line, see SerialTxPacer.h; before Open()
+        void                SetTxPacing( SERIAL_TX_PACING Pacing, UINT nLeadUs = SERIAL_TX_LEAD_US );
+        void                SetTxRateLimit( UINT nBytesPerSecond, UINT nBurst = 1 );
+        UINT                GetTxBacklog();         // bytes the driver holds which are not on the line yet
+        void                SetTxHighWaterMark( UINT nSize );
+        UINT                GetTxQueued();
+        void                GetTxStats( SERIAL_TX_STATS *pStats );
+        BOOL                WaitTxEmpty( DWORD dwTimeout = INFINITE );
         void                Close();
 
         DCB                 *GetDCB();
         BOOL                SetDCB( DCB *dcb );
         BOOL                IsOpen();
+
+        // receive path, call before Open()
+        void                SetRxBufferSize( UINT nSize );
+        void                SetRxCallback( SERIAL_RX_CALLBACK pfnCallback, void *pContext );
+        void                SetRxCallback( SERIAL_RX_STAMPED_CALLBACK pfnCallback, void *pContext );
+        void                SetRxCallback( SERIAL_RX_BUFFER_CALLBACK pfnCallback, void *pContext );
+        void                SetFramer( CSerialFramer *pFramer );
+        // records both directions under nPortId, call before Open()
+        void                SetCapture( CSerialCapture *pCapture, UINT nPortId = 0 );
+
+        /*
+        ** Queued copies, received buffers and frames of a framer set up with it come
+        ** from this pool, NULL is the port's own. Call before Open(); a shared pool
+        ** has to outlive the port.
+        */
+        void                SetBufferPool( CSerialBufferPool *pPool );
+        CSerialBufferPool   *GetBufferPool();
+
+        /*
+        ** Delivery policy of the callback, the framer and EV_RXCHAR: received data is
+        ** held until nMinBytes are buffered or nMaxDelayUs passed since the first held
+        ** byte came in. nMinBytes 0 or 1 delivers every read (the default), nMaxDelayUs
+        ** 0 waits as long as nMinBytes take at the baud rate of the DCB. May be changed
+        ** while open, from the next read on.
+        */
+        void                SetRxPolicy( UINT nMinBytes, UINT nMaxDelayUs = 0 );
+        void                GetRxPolicy( UINT *pnMinBytes, UINT *pnMaxDelayUs );
+
+        // the hook of waiters on the pull interface, see SerialPortCoroutine.h
+        void                SetRxNotify( SERIAL_RX_NOTIFY pfnNotify, void *pContext );      // before Open()
+        void                SetRxNotifyDeadline( UINT64 qwDeadline );                       // any thread, 0 for none
+
+        // pull interface when no callback is set
+        UINT                Read( void *Buffer, UINT nSize );
+        UINT                PeekRx( const BYTE **ppData );
+        void                ConsumeRx( UINT nSize );
+        UINT                GetRxCount();
+        UINT64              GetRxOverrun();
+        UINT64              GetLastRxTime();        // SerialMetricsNow() of the last read which returned data
+        UINT64              GetCharacterTime();     // nanoseconds per character with the current DCB
+
+        // counters and histograms since Open() or the last reset, no lock is taken
+        void                GetMetrics( SERIAL_PORT_METRICS *pMetrics, BOOL bReset = FALSE );
+        void                ResetMetrics();
+
+        /*
+        ** Failed calls are queued instead of shown, the owner gets EV_ERR (LPARAM is the
+        ** error code) when the queue stops being empty and takes the entries from here.
+        */
+        BOOL                GetError( SERIAL_PORT_ERROR *pError );
+        UINT                GetErrorCount();
+
+        /*
+        ** Affinity, realtime policy and locked memory of the I/O threads, see SerialThread.h;
+        ** call before Open(). What was refused goes to the error queue, the port runs anyway.
+        ** With a reactor only the buffers are locked, the reactor schedules its own loops.
+        */
+        void                SetThreadOptions( const SERIAL_THREAD_OPTIONS *pOptions );
+        DWORD               GetThreadState();       // the SERIAL_THREAD_ flags granted
+#ifdef SERIAL_PORT_REACTOR
+
+        // serviced by a shared reactor instead of an own thread, call before Open()
+        void                SetReactor( CSerialPortReactor *pReactor );
+#endif
+#ifdef _WIN32
         void                EnumSerialPort( CComboBox &m_PortNO );
+#endif
 
     protected:
-        HANDLE              m_Thread;
+#ifdef _WIN32
+        HANDLE              m_Thread;               // receive
+        HANDLE              m_TxThread;
+        HANDLE              m_hShutdownEvent;
+        HANDLE              m_hTxEvent;             // auto reset, transmit data queued
+        HANDLE              m_hRxWakeEvent;         // auto reset, the receive deadline changed
+        UINT                m_nRxRetries;           // receive thread, failed waits in a row
+#else
+        pthread_t           m_Thread;
+        BOOL                m_bThreadStarted;
+        int                 m_nWakeFd[2];           // one eventfd in both slots on Linux
+        std::atomic<int>    m_bWakePending;
+        struct termios      m_tioSaved;
+        UINT64              m_qwWriteDeadline;
+        UINT64              m_qwTxPaceDeadline;     // the pacer holds the queue back until then, 0 when it does not
+#endif
+#ifdef SERIAL_PORT_REACTOR
+        friend class CSerialPortReactor;
+        friend class CSerialBridge;
+
+        CSerialPortReactor  *m_pReactor;
+        BOOL                m_bReactorAttached;
+        UINT                m_nReactorLoop;
+        BOOL                m_bReactorPollOut;      // owned by the reactor loop
+        BOOL                m_bReactorWoken;
+#endif
         HANDLE              m_hComm;
         CRITICAL_SECTION    m_csCommunicationSync;
         COMMTIMEOUTS        m_CommTimeouts;
-        DCB                 m_dcb;
+        DCB                 m_dcb;                  // under m_csCommunicationSync
+        std::atomic<UINT64> m_qwCharTime;           // of m_dcb as applied, read by the I/O paths without the lock
         HWND                m_pOwner;
         volatile BOOL       m_bThreadAlive;
         volatile BOOL       m_bUserRequestClose;
+        std::atomic<UINT>   m_nCloseCount;          // Close() calls, a callback on the I/O thread may have closed the port
         UINT                m_nPortNr;
+        char                m_szPortName[MAX_PATH];
         DWORD               m_dwCommEvents;
         DWORD               m_nWriteBufferSize;
-        char                *m_szWriteBuffer;
-        volatile int        m_nWriteSize;
+        CSerialBufferPool   m_Pool;                 // before the queue, which releases into it
+        CSerialBufferPool   *m_pPool;
+        CSerialTxScheduler  m_TxScheduler;
+        CSerialTxPacer      m_TxPacer;
+#ifdef _WIN32
         int                 m_nComArray[SERIAL_PORT_MAX + 1];
+#endif
+        CSerialRingBuffer   m_RxBuffer;
+        UINT                m_nRxBufferSize;
+        SERIAL_RX_CALLBACK  m_pfnRxCallback;
+        SERIAL_RX_STAMPED_CALLBACK m_pfnRxStampedCallback;
+        SERIAL_RX_BUFFER_CALLBACK m_pfnRxBufferCallback;
+        void                *m_pRxContext;
+        CSerialFramer       *m_pFramer;
+        CSerialCapture      *m_pCapture;
+        UINT                m_nCaptureId;
+        std::atomic<int>    m_bRxNotifyPending;
+        SERIAL_RX_NOTIFY    m_pfnRxNotify;
+        void                *m_pRxNotifyContext;
+        std::atomic<UINT64> m_qwRxNotifyDeadline;
+        std::atomic<UINT64> m_qwLastRxTime;
+        std::atomic<UINT>   m_nRxMinBytes;
+        std::atomic<UINT>   m_nRxMaxDelayUs;
+        UINT64              m_qwRxHeldSince;        // I/O thread, first read not yet delivered
+        SERIAL_THREAD_OPTIONS m_ThreadOptions;
+        std::atomic<DWORD>  m_dwThreadState;
+        UINT64              m_qwProbeNext;          // I/O thread, the next wakeup of the jitter probe
+        CSerialPortMetrics  m_Metrics;
+        CSerialErrorQueue   m_Errors;
+
+#ifdef _WIN32
 
         static DWORD WINAPI CommThread( LPVOID pParam );
-        static BOOL         ReceiveChar( CSerialPort *pPort );
-        static UINT         WriteChar( CSerialPort *pPort );
-        void                ProcessErrorMessage( char *ErrorText );
+        static DWORD WINAPI TxThread( LPVOID pParam );
+        static BOOL         ReceiveChar( CSerialPort *pPort, OVERLAPPED *pOverlapped );
+        static UINT         WriteChar( CSerialPort *pPort, OVERLAPPED *pOverlapped, UINT nBudget );
+        static BOOL         CompleteIo( CSerialPort *pPort, OVERLAPPED *pOverlapped, BOOL bResult, DWORD *pdwBytes );
+#else
+        static void         *CommThread( void *pParam );
+        static int          ReceiveChar( CSerialPort *pPort, UINT nBudget );
+        static UINT         WriteChar( CSerialPort *pPort, UINT nBudget );
+        BOOL                ApplyDCB();
+        BOOL                IsTxPending();
+        UINT64              GetWriteDeadline();
+        UINT64              GetTxPaceDeadline();
+        void                CheckWriteTimeout( UINT64 qwNow );
+        BOOL                ServiceIo( short revents, UINT nBudget );
+#endif
+        void                WakeIoThread();
+        UINT                GetDriverBacklog();     // the output queue the driver reports, 0 when it does not
+        DWORD               GetWriteWait( UINT nBytes );
+        void                DeliverRx( UINT64 qwTimestamp, UINT nLength );
+        void                DispatchRx( UINT64 qwTimestamp, UINT nLimit = MAXDWORD );
+        UINT64              GetRxHoldDeadline();
+        UINT64              GetRxDeadline();
+        void                CheckRxIdle( UINT64 qwNow );
+        void                ApplyThreadOptions();   // on the I/O thread
+        void                LockBuffers();
+        UINT64              GetProbeDeadline( UINT64 qwNow );
+        void                OnTimedWakeup( UINT64 qwDeadline, UINT64 qwNow );
+        void                OnLineChanged();
+        void                ProcessErrorMessage( const char *ErrorText );
+#ifdef _WIN32
         BOOL                QueryRegistry( HKEY hKey );
+#endif
 };
 
-#endif SERIAL_PORT_H
+#endif // SERIAL_PORT_H
@@ -0,0 +1,211 @@
+/*
+**  FILENAME            SerialPortCoroutine.cpp
+**
+**  PURPOSE             C++20 coroutine interface of CSerialPort.
+**
+**  CREATION DATE       16-10-2026
+**  LAST MODIFICATION   16-10-2026
+*/
+
+#ifdef _WIN32
+#include "stdafx.h"
+#endif
+#include "SerialPortCoroutine.h"
+
+#ifdef SERIAL_PORT_COROUTINE
+
+#include <assert.h>
+#include <string.h>
+
+UINT64 SerialDeadlineUs( UINT64 qwMicroseconds )
+{
+    return SerialMetricsNow() + qwMicroseconds * 1000;
+}
+
+CSerialCoRead::CSerialCoRead( CSerialCoPort *pCo, BYTE *pBuffer, UINT nSize, int nDelimiter, UINT64 qwDeadline )
+{
+    m_pCo = pCo;
+    m_pBuffer = pBuffer;
+    m_nSize = nSize;
+    m_nDone = 0;
+    m_nDelimiter = nDelimiter;
+    m_qwDeadline = qwDeadline;
+}
+
+BOOL CSerialCoRead::Work()
+{
+    CSerialPort &Port = m_pCo->m_Port;
+    const BYTE *pData;
+    UINT nSpan;
+
+    // WaitUntil() only ends at the deadline
+    while ( ( m_pBuffer != NULL ) && ( m_nDone < m_nSize ) && ( ( nSpan = Port.PeekRx( &pData ) ) > 0 ) )
+    {
+        const BYTE *pEnd = NULL;
+        nSpan = ( nSpan < m_nSize - m_nDone ) ? nSpan : m_nSize - m_nDone;
+
+        if ( m_nDelimiter >= 0 )
+        {
+            pEnd = SerialFindByte( pData, nSpan, ( BYTE )m_nDelimiter );
+            nSpan = ( pEnd != NULL ) ? ( UINT )( pEnd - pData ) + 1 : nSpan;
+        }
+
+        memcpy( m_pBuffer + m_nDone, pData, nSpan );
+        Port.ConsumeRx( nSpan );
+        m_nDone += nSpan;
+
+        if ( pEnd != NULL )
+        {
+            return TRUE;
+        }
+    }
+
+    if ( ( m_pBuffer != NULL ) && ( m_nDone == m_nSize ) )
+    {
+        return TRUE;
+    }
+
+    return ( m_qwDeadline != 0 ) && ( SerialMetricsNow() >= m_qwDeadline );
+}
+
+bool CSerialCoRead::await_ready()
+{
+    // a read which the buffered data satisfies never suspends
+    return ( m_pBuffer != NULL ) && Work();
+}
+
+bool CSerialCoRead::await_suspend( std::coroutine_handle<> hResume )
+{
+    CSerialCoPort *pCo = m_pCo;
+    CSerialCoRead *pExpected = NULL;
+
+    m_hResume = hResume;
+    assert( pCo->m_pReader.load() == NULL );
+
+    if ( m_qwDeadline != 0 )
+    {
+        pCo->m_Port.SetRxNotifyDeadline( m_qwDeadline );
+    }
+
+    for ( ;; )
+    {
+        pCo->m_pReader.store( this );
+
+        /*
+        ** Data committed from here on is followed by a notification which finds the
+        ** reader. Data which came before it is taken here, unless the I/O thread took
+        ** the reader out in between, then it is the one to finish the read.
+        */
+        if ( ( m_pBuffer == NULL ) || ( pCo->m_Port.GetRxCount() == 0 ) )
+        {
+            return true;
+        }
+
+        pExpected = this;
+
+        if ( !pCo->m_pReader.compare_exchange_strong( pExpected, NULL ) )
+        {
+            return true;
+        }
+
+        if ( Work() )
+        {
+            pCo->m_Port.SetRxNotifyDeadline( 0 );
+            return false;
+        }
+    }
+}
+
+CSerialCoWrite::CSerialCoWrite( CSerialCoPort *pCo, const void *pData, UINT nSize )
+{
+    m_pCo = pCo;
+    m_pData = pData;
+    m_nSize = nSize;
+    m_nWritten = 0;
+}
+
+bool CSerialCoWrite::await_suspend( std::coroutine_handle<> hResume )
+{
+    SERIAL_TX_BUFFER Buffer;
+
+    // no copy, the coroutine keeps the data alive while it is suspended
+    Buffer.pData = m_pData;
+    Buffer.nSize = m_nSize;
+    Buffer.pfnRelease = NULL;
+    Buffer.pContext = NULL;
+    m_hResume = hResume;
+
+    // the completion may resume the coroutine before this returns, nothing is touched after the call
+    return m_pCo->m_Port.WriteV( &Buffer, 1, OnWritten, this, INFINITE ) ? true : false;
+}
+
+void CSerialCoWrite::OnWritten( void *pContext, DWORD dwBytesWritten, BOOL bSuccess )
+{
+    CSerialCoWrite *pWrite = ( CSerialCoWrite * )pContext;
+    pWrite->m_nWritten = bSuccess ? ( UINT )dwBytesWritten : 0;
+    pWrite->m_pCo->Resume( pWrite->m_hResume );
+}
+
+CSerialCoPort::CSerialCoPort( CSerialPort &Port, const SERIAL_EXECUTOR *pExecutor ) : m_Port( Port )
+{
+    m_pExecutor = pExecutor;
+    m_pReader = NULL;
+    m_Port.SetRxNotify( OnRxNotify, this );
+}
+
+CSerialCoPort::~CSerialCoPort()
+{
+    assert( m_pReader.load() == NULL );
+    m_Port.SetRxNotify( NULL, NULL );
+}
+
+void CSerialCoPort::CancelRead()
+{
+    CSerialCoRead *pReader = m_pReader.exchange( NULL );
+
+    if ( pReader != NULL )
+    {
+        m_Port.SetRxNotifyDeadline( 0 );
+        Resume( pReader->m_hResume );
+    }
+}
+
+void CSerialCoPort::OnRxNotify( void *pContext, UINT64 qwNow )
+{
+    CSerialCoPort *pCo = ( CSerialCoPort * )pContext;
+    CSerialCoRead *pReader = pCo->m_pReader.exchange( NULL );
+    ( void )qwNow;
+
+    if ( pReader == NULL )
+    {
+        return;
+    }
+
+    // only the producer adds data, nothing can arrive unnoticed while the reader is out
+    if ( !pReader->Work() )
+    {
+        pCo->m_pReader.store( pReader );
+        return;
+    }
+
+    if ( pReader->m_qwDeadline != 0 )
+    {
+        pCo->m_Port.SetRxNotifyDeadline( 0 );
+    }
+
+    pCo->Resume( pReader->m_hResume );
+}
+
+void CSerialCoPort::Resume( std::coroutine_handle<> hResume )
+{
+    if ( m_pExecutor != NULL )
+    {
+        m_pExecutor->pfnPost( m_pExecutor->pContext, hResume );
+    }
+    else
+    {
+        hResume.resume();
+    }
+}
+
+#endif
@@ -0,0 +1,177 @@
+/*
+**  FILENAME            SerialPortCoroutine.h
+**
+**  PURPOSE             C++20 coroutine interface of CSerialPort. Protocol code awaits
+**                      reads, reads up to a delimiter, writes and deadlines instead of
+**                      handling EV_RXCHAR messages. A suspended coroutine is resumed
+**                      on the I/O thread of the port, or handed to an executor of the
+**                      caller's choice. The awaiters live in the coroutine frame, an
+**                      await allocates nothing. Empty below C++20.
+**
+**  CREATION DATE       16-10-2026
+**  LAST MODIFICATION   16-10-2026
+*/
+
+#ifndef SERIAL_PORT_COROUTINE_H
+#define SERIAL_PORT_COROUTINE_H
+
+#if defined( __cpp_impl_coroutine ) && ( __cpp_impl_coroutine >= 201902L )
+
+#include "SerialPort.h"
+#include <atomic>
+#include <coroutine>
+#include <exception>
+
+#define SERIAL_PORT_COROUTINE
+
+// runs hResume.resume() on a thread of its own; pfnPost must not block the I/O thread
+typedef struct _SERIAL_EXECUTOR
+{
+    void                ( *pfnPost )( void *pContext, std::coroutine_handle<> hResume );
+    void                *pContext;
+} SERIAL_EXECUTOR;
+
+// SerialMetricsNow() based deadline, for the qwDeadline of the awaiters
+UINT64      SerialDeadlineUs( UINT64 qwMicroseconds );
+
+/*
+** A started and forgotten coroutine, the frame goes away when it returns. Any other
+** coroutine type works with the awaiters as well.
+*/
+struct CSerialTask
+{
+    struct promise_type
+    {
+        CSerialTask         get_return_object()
+        {
+            return CSerialTask();
+        }
+        std::suspend_never  initial_suspend() noexcept
+        {
+            return std::suspend_never();
+        }
+        std::suspend_never  final_suspend() noexcept
+        {
+            return std::suspend_never();
+        }
+        void                return_void()
+        {
+        }
+        void                unhandled_exception()
+        {
+            std::terminate();
+        }
+    };
+};
+
+class CSerialCoPort;
+
+// Read(), ReadUntil() and WaitUntil(), co_await gives the bytes stored
+class CSerialCoRead
+{
+    public:
+        bool                await_ready();
+        bool                await_suspend( std::coroutine_handle<> hResume );
+        UINT                await_resume()
+        {
+            return m_nDone;
+        }
+
+    private:
+        friend class CSerialCoPort;
+
+        CSerialCoRead( CSerialCoPort *pCo, BYTE *pBuffer, UINT nSize, int nDelimiter, UINT64 qwDeadline );
+        BOOL                Work();                 // takes what the port has, TRUE when done
+
+        CSerialCoPort       *m_pCo;
+        BYTE                *m_pBuffer;             // NULL for WaitUntil()
+        UINT                m_nSize;
+        UINT                m_nDone;
+        int                 m_nDelimiter;           // -1 for none
+        UINT64              m_qwDeadline;           // 0 for none
+        std::coroutine_handle<> m_hResume;
+};
+
+// Write(), co_await gives the bytes written, 0 when the request failed
+class CSerialCoWrite
+{
+    public:
+        bool                await_ready()
+        {
+            return m_nSize == 0;
+        }
+        bool                await_suspend( std::coroutine_handle<> hResume );
+        UINT                await_resume()
+        {
+            return m_nWritten;
+        }
+
+    private:
+        friend class CSerialCoPort;
+
+        CSerialCoWrite( CSerialCoPort *pCo, const void *pData, UINT nSize );
+        static void         OnWritten( void *pContext, DWORD dwBytesWritten, BOOL bSuccess );
+
+        CSerialCoPort       *m_pCo;
+        const void          *m_pData;
+        UINT                m_nSize;
+        UINT                m_nWritten;
+        std::coroutine_handle<> m_hResume;
+};
+
+/*
+** Takes over the pull interface of the port: no RX callback may be set, the
+** framer and EV_RXCHAR are not used. Create it before Open(). One read and any
+** number of writes may be pending at a time; writes do not copy, the data has to
+** stay valid until the co_await returns.
+*/
+class CSerialCoPort
+{
+    public:
+        CSerialCoPort( CSerialPort &Port, const SERIAL_EXECUTOR *pExecutor = NULL );
+        ~CSerialCoPort();
+
+        // nSize bytes, fewer when the deadline passed
+        CSerialCoRead       Read( void *pBuffer, UINT nSize, UINT64 qwDeadline = 0 )
+        {
+            return CSerialCoRead( this, ( BYTE * )pBuffer, nSize, -1, qwDeadline );
+        }
+        // up to and including cDelimiter, nSize bytes without it, fewer when the deadline passed
+        CSerialCoRead       ReadUntil( BYTE cDelimiter, void *pBuffer, UINT nSize, UINT64 qwDeadline = 0 )
+        {
+            return CSerialCoRead( this, ( BYTE * )pBuffer, nSize, cDelimiter, qwDeadline );
+        }
+        CSerialCoRead       WaitUntil( UINT64 qwDeadline )
+        {
+            return CSerialCoRead( this, NULL, 0, -1, qwDeadline );
+        }
+        CSerialCoWrite      Write( const void *pData, UINT nSize )
+        {
+            return CSerialCoWrite( this, pData, nSize );
+        }
+
+        // resumes a pending read with what it has, e.g. before Close(); any thread
+        void                CancelRead();
+        CSerialPort         &GetPort()
+        {
+            return m_Port;
+        }
+
+    private:
+        friend class CSerialCoRead;
+        friend class CSerialCoWrite;
+
+        CSerialCoPort( const CSerialCoPort & );
+        CSerialCoPort       &operator=( const CSerialCoPort & );
+
+        static void         OnRxNotify( void *pContext, UINT64 qwNow );
+        void                Resume( std::coroutine_handle<> hResume );
+
+        CSerialPort         &m_Port;
+        const SERIAL_EXECUTOR *m_pExecutor;
+        std::atomic<CSerialCoRead *> m_pReader;     // whoever takes it out may touch the ring
+};
+
+#endif
+
+#endif // SERIAL_PORT_COROUTINE_H
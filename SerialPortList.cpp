@@ -0,0 +1,570 @@
+/*
+**  FILENAME            SerialPortList.cpp
+**
+**  PURPOSE             Cached serial port enumeration with hotplug updates.
+**
+**  CREATION DATE       16-10-2026
+**  LAST MODIFICATION   16-10-2026
+*/
+
+#ifdef _WIN32
+#include "stdafx.h"
+#endif
+#include "SerialPortList.h"
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifndef _WIN32
+#include <dirent.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#endif
+#ifdef __linux__
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#endif
+#include <algorithm>
+
+static void CopyString( char *szTarget, size_t nSize, const char *szSource )
+{
+    size_t nLength = strlen( szSource );
+    nLength = ( nLength < nSize ) ? nLength : nSize - 1;
+    memcpy( szTarget, szSource, nLength );
+    szTarget[nLength] = '\0';
+}
+
+// ttyS2 before ttyS10: runs of digits compare by their value
+static bool NameLess( const SERIAL_PORT_INFO &a, const SERIAL_PORT_INFO &b )
+{
+    const char *p = a.szName;
+    const char *q = b.szName;
+
+    while ( ( *p != '\0' ) && ( *q != '\0' ) )
+    {
+        if ( isdigit( ( unsigned char )*p ) && isdigit( ( unsigned char )*q ) )
+        {
+            unsigned long nP = strtoul( p, ( char ** )&p, 10 );
+            unsigned long nQ = strtoul( q, ( char ** )&q, 10 );
+
+            if ( nP != nQ )
+            {
+                return nP < nQ;
+            }
+        }
+        else if ( *p != *q )
+        {
+            return ( unsigned char )*p < ( unsigned char )*q;
+        }
+        else
+        {
+            p++;
+            q++;
+        }
+    }
+
+    return ( *p == '\0' ) && ( *q != '\0' );
+}
+
+#ifndef _WIN32
+// one line attribute, trailing white space stripped
+static BOOL ReadAttribute( const std::string &strPath, char *szValue, size_t nSize )
+{
+    int nFile = open( strPath.c_str(), O_RDONLY | O_CLOEXEC );
+    ssize_t n;
+
+    if ( nFile < 0 )
+    {
+        return FALSE;
+    }
+
+    n = read( nFile, szValue, nSize - 1 );
+    close( nFile );
+
+    if ( n < 0 )
+    {
+        return FALSE;
+    }
+
+    while ( ( n > 0 ) && isspace( ( unsigned char )szValue[n - 1] ) )
+    {
+        n--;
+    }
+
+    szValue[n] = '\0';
+    return TRUE;
+}
+
+static const char *BaseName( const char *szPath )
+{
+    const char *p = strrchr( szPath, '/' );
+    return ( p != NULL ) ? p + 1 : szPath;
+}
+#endif
+
+CSerialPortList::CSerialPortList( const char *szSysRoot, const char *szDevRoot )
+{
+    m_strSysRoot = szSysRoot;
+    m_strDevRoot = szDevRoot;
+    m_pfnCallback = NULL;
+    m_pContext = NULL;
+#ifdef __linux__
+    m_bThreadStarted = FALSE;
+    m_nInotify = -1;
+    m_nWakeFd = -1;
+#endif
+}
+
+CSerialPortList::~CSerialPortList()
+{
+    Stop();
+}
+
+void CSerialPortList::SetCallback( SERIAL_PORT_LIST_CALLBACK pfnCallback, void *pContext )
+{
+    m_pfnCallback = pfnCallback;
+    m_pContext = pContext;
+}
+
+void CSerialPortList::GetPorts( std::vector<SERIAL_PORT_INFO> &Ports )
+{
+    std::lock_guard<std::mutex> Lock( m_Lock );
+    Ports = m_Ports;
+}
+
+BOOL CSerialPortList::Find( const char *szName, SERIAL_PORT_INFO *pInfo )
+{
+    std::lock_guard<std::mutex> Lock( m_Lock );
+
+    for ( size_t i = 0; i < m_Ports.size(); i++ )
+    {
+        if ( strcmp( m_Ports[i].szName, szName ) == 0 )
+        {
+            *pInfo = m_Ports[i];
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+UINT CSerialPortList::GetCount()
+{
+    std::lock_guard<std::mutex> Lock( m_Lock );
+    return ( UINT )m_Ports.size();
+}
+
+void CSerialPortList::Notify( const SERIAL_PORT_INFO &Info, BOOL bArrived )
+{
+    if ( m_pfnCallback != NULL )
+    {
+        m_pfnCallback( m_pContext, &Info, bArrived );
+    }
+}
+
+#ifdef _WIN32
+BOOL CSerialPortList::Probe( const char *szName, SERIAL_PORT_INFO *pInfo )
+{
+    // the device map has no per-port attributes, a name is all there is
+    memset( pInfo, 0, sizeof( *pInfo ) );
+    CopyString( pInfo->szName, sizeof( pInfo->szName ), szName );
+    _snprintf_s( pInfo->szDevice, sizeof( pInfo->szDevice ), _TRUNCATE, "\\\\.\\%s", szName );
+    return TRUE;
+}
+
+BOOL CSerialPortList::Scan( std::vector<SERIAL_PORT_INFO> &Ports )
+{
+    HKEY hKey;
+
+    if ( RegOpenKeyExA( HKEY_LOCAL_MACHINE, "HARDWARE\\DEVICEMAP\\SERIALCOMM", 0, KEY_READ, &hKey ) != ERROR_SUCCESS )
+    {
+        return FALSE;
+    }
+
+    for ( DWORD i = 0; ; i++ )
+    {
+        char szValue[MAX_PATH];
+        BYTE Data[MAX_PATH];
+        DWORD cchValue = sizeof( szValue );
+        DWORD cbData = sizeof( Data ) - 1;
+        DWORD dwType;
+        LONG nResult = RegEnumValueA( hKey, i, szValue, &cchValue, NULL, &dwType, Data, &cbData );
+
+        if ( nResult == ERROR_NO_MORE_ITEMS )
+        {
+            break;
+        }
+
+        if ( ( nResult == ERROR_SUCCESS ) && ( dwType == REG_SZ ) )
+        {
+            // \Device\Serial0 -> COM1, the kernel device names the driver
+            SERIAL_PORT_INFO Info;
+            const char *szDriver = strrchr( szValue, '\\' );
+            Data[cbData] = '\0';
+            Probe( ( const char * )Data, &Info );
+            CopyString( Info.szDriver, sizeof( Info.szDriver ), ( szDriver != NULL ) ? szDriver + 1 : szValue );
+            Ports.push_back( Info );
+        }
+    }
+
+    RegCloseKey( hKey );
+    return TRUE;
+}
+#else
+BOOL CSerialPortList::Probe( const char *szName, SERIAL_PORT_INFO *pInfo )
+{
+    std::string strNode = m_strDevRoot + "/" + szName;
+    struct stat st;
+
+    memset( pInfo, 0, sizeof( *pInfo ) );
+
+#ifdef __linux__
+    std::string strEntry = m_strSysRoot + "/class/tty/" + szName;
+    std::string strDevice = strEntry + "/device";
+    char szReal[PATH_MAX];
+    char szValue[PATH_MAX];
+    ssize_t n;
+
+    // virtual consoles, pseudo-terminals and the like have no device behind them
+    if ( realpath( strDevice.c_str(), szReal ) == NULL )
+    {
+        return FALSE;
+    }
+
+    // the 8250 driver registers its ttyS lines whether or not a UART answers, type 0 is none
+    if ( ReadAttribute( strEntry + "/type", szValue, sizeof( szValue ) ) && ( strcmp( szValue, "0" ) == 0 ) )
+    {
+        return FALSE;
+    }
+#else
+    // the callout devices of macOS and the BSDs, cu.usbserial-1410, cuaU0, ...
+    if ( strncmp( szName, "cu", 2 ) != 0 )
+    {
+        return FALSE;
+    }
+#endif
+
+    // listed once the node is there to be opened, udev may create it after sysfs
+    if ( stat( strNode.c_str(), &st ) != 0 )
+    {
+        return FALSE;
+    }
+
+    CopyString( pInfo->szName, sizeof( pInfo->szName ), szName );
+    CopyString( pInfo->szDevice, sizeof( pInfo->szDevice ), strNode.c_str() );
+
+#ifdef __linux__
+    if ( ( n = readlink( ( strDevice + "/driver" ).c_str(), szValue, sizeof( szValue ) - 1 ) ) > 0 )
+    {
+        szValue[n] = '\0';
+        CopyString( pInfo->szDriver, sizeof( pInfo->szDriver ), BaseName( szValue ) );
+    }
+
+    // the USB device is the closest parent with an idVendor attribute
+    for ( std::string strDir = szReal; strDir.length() > 1; strDir.erase( strDir.rfind( '/' ) ) )
+    {
+        if ( ReadAttribute( strDir + "/idVendor", szValue, sizeof( szValue ) ) )
+        {
+            pInfo->wVendorId = ( WORD )strtoul( szValue, NULL, 16 );
+
+            if ( ReadAttribute( strDir + "/idProduct", szValue, sizeof( szValue ) ) )
+            {
+                pInfo->wProductId = ( WORD )strtoul( szValue, NULL, 16 );
+            }
+
+            if ( ReadAttribute( strDir + "/serial", szValue, sizeof( szValue ) ) )
+            {
+                CopyString( pInfo->szSerial, sizeof( pInfo->szSerial ), szValue );
+            }
+
+            if ( ReadAttribute( strDir + "/manufacturer", szValue, sizeof( szValue ) ) )
+            {
+                CopyString( pInfo->szManufacturer, sizeof( pInfo->szManufacturer ), szValue );
+            }
+
+            if ( ReadAttribute( strDir + "/product", szValue, sizeof( szValue ) ) )
+            {
+                CopyString( pInfo->szProduct, sizeof( pInfo->szProduct ), szValue );
+            }
+
+            CopyString( pInfo->szLocation, sizeof( pInfo->szLocation ), BaseName( strDir.c_str() ) );
+            break;
+        }
+    }
+#endif
+
+    return TRUE;
+}
+
+BOOL CSerialPortList::Scan( std::vector<SERIAL_PORT_INFO> &Ports )
+{
+#ifdef __linux__
+    std::string strDir = m_strSysRoot + "/class/tty";
+#else
+    std::string strDir = m_strDevRoot;
+#endif
+    DIR *pDir = opendir( strDir.c_str() );
+    struct dirent *pEntry;
+
+    if ( pDir == NULL )
+    {
+        return FALSE;
+    }
+
+    while ( ( pEntry = readdir( pDir ) ) != NULL )
+    {
+        SERIAL_PORT_INFO Info;
+
+        if ( ( pEntry->d_name[0] != '.' ) && Probe( pEntry->d_name, &Info ) )
+        {
+            Ports.push_back( Info );
+        }
+    }
+
+    closedir( pDir );
+    return TRUE;
+}
+#endif
+
+BOOL CSerialPortList::Refresh()
+{
+    std::vector<SERIAL_PORT_INFO> Ports;
+    std::vector<SERIAL_PORT_INFO> Old;
+
+    if ( !Scan( Ports ) )
+    {
+        return FALSE;
+    }
+
+    std::sort( Ports.begin(), Ports.end(), NameLess );
+
+    {
+        std::lock_guard<std::mutex> Lock( m_Lock );
+        Old.swap( m_Ports );
+        m_Ports = Ports;
+    }
+
+    // both lists are sorted, one pass finds what went and what came
+    size_t i = 0;
+    size_t j = 0;
+
+    while ( ( i < Old.size() ) || ( j < Ports.size() ) )
+    {
+        if ( ( j == Ports.size() ) || ( ( i < Old.size() ) && NameLess( Old[i], Ports[j] ) ) )
+        {
+            Notify( Old[i++], FALSE );
+        }
+        else if ( ( i == Old.size() ) || NameLess( Ports[j], Old[i] ) )
+        {
+            Notify( Ports[j++], TRUE );
+        }
+        else
+        {
+            if ( memcmp( &Old[i], &Ports[j], sizeof( SERIAL_PORT_INFO ) ) != 0 )
+            {
+                // another device under the same name
+                Notify( Old[i], FALSE );
+                Notify( Ports[j], TRUE );
+            }
+
+            i++;
+            j++;
+        }
+    }
+
+    return TRUE;
+}
+
+// probes one name again, the cache gains, keeps or loses it
+void CSerialPortList::Update( const char *szName )
+{
+    SERIAL_PORT_INFO Info;
+    SERIAL_PORT_INFO Old;
+    BOOL bFound = Probe( szName, &Info );
+    BOOL bHad = FALSE;
+
+    {
+        std::lock_guard<std::mutex> Lock( m_Lock );
+        std::vector<SERIAL_PORT_INFO>::iterator it;
+
+        memset( &Old, 0, sizeof( Old ) );
+        CopyString( Old.szName, sizeof( Old.szName ), szName );
+        it = std::lower_bound( m_Ports.begin(), m_Ports.end(), Old, NameLess );
+
+        if ( ( it != m_Ports.end() ) && ( strcmp( it->szName, szName ) == 0 ) )
+        {
+            if ( bFound && ( memcmp( &*it, &Info, sizeof( Info ) ) == 0 ) )
+            {
+                return;
+            }
+
+            Old = *it;
+            bHad = TRUE;
+            it = m_Ports.erase( it );
+        }
+
+        if ( bFound )
+        {
+            m_Ports.insert( it, Info );
+        }
+    }
+
+    if ( bHad )
+    {
+        Notify( Old, FALSE );
+    }
+
+    if ( bFound )
+    {
+        Notify( Info, TRUE );
+    }
+}
+
+#ifdef __linux__
+BOOL CSerialPortList::Start()
+{
+    if ( m_bThreadStarted )
+    {
+        return TRUE;
+    }
+
+    m_nInotify = inotify_init1( IN_NONBLOCK | IN_CLOEXEC );
+    m_nWakeFd = eventfd( 0, EFD_NONBLOCK | EFD_CLOEXEC );
+
+    // watched before the scan, so nothing that changes meanwhile is missed; sysfs only
+    // reports changes made from user space (a fake tree), the kernel's show up in /dev
+    if ( ( m_nInotify < 0 ) || ( m_nWakeFd < 0 ) ||
+         ( inotify_add_watch( m_nInotify, m_strDevRoot.c_str(), IN_CREATE | IN_DELETE | IN_ATTRIB | IN_MOVED_FROM | IN_MOVED_TO ) < 0 ) )
+    {
+        Stop();
+        return FALSE;
+    }
+
+    ( void )inotify_add_watch( m_nInotify, ( m_strSysRoot + "/class/tty" ).c_str(), IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO );
+
+    if ( !Refresh() || ( pthread_create( &m_Thread, NULL, WatchThread, this ) != 0 ) )
+    {
+        Stop();
+        return FALSE;
+    }
+
+    m_bThreadStarted = TRUE;
+    return TRUE;
+}
+
+void CSerialPortList::Stop()
+{
+    if ( m_bThreadStarted )
+    {
+        uint64_t qwOne = 1;
+        ( void )write( m_nWakeFd, &qwOne, sizeof( qwOne ) );
+        pthread_join( m_Thread, NULL );
+        m_bThreadStarted = FALSE;
+    }
+
+    if ( m_nInotify >= 0 )
+    {
+        close( m_nInotify );
+        m_nInotify = -1;
+    }
+
+    if ( m_nWakeFd >= 0 )
+    {
+        close( m_nWakeFd );
+        m_nWakeFd = -1;
+    }
+}
+
+void *CSerialPortList::WatchThread( void *pParam )
+{
+    ( ( CSerialPortList * )pParam )->Watch();
+    return NULL;
+}
+
+void CSerialPortList::Watch()
+{
+    struct pollfd Fds[2];
+    std::vector<std::string> Names;
+    // aligned for the inotify_event records read into it
+    union
+    {
+        struct inotify_event    Event;
+        char                    Buffer[16384];
+    } Events;
+
+    Fds[0].fd = m_nInotify;
+    Fds[0].events = POLLIN;
+    Fds[1].fd = m_nWakeFd;
+    Fds[1].events = POLLIN;
+
+    for ( ;; )
+    {
+        BOOL bOverflow = FALSE;
+        ssize_t n;
+
+        if ( poll( Fds, 2, -1 ) < 0 )
+        {
+            if ( errno == EINTR )
+            {
+                continue;
+            }
+
+            break;
+        }
+
+        if ( Fds[1].revents & POLLIN )
+        {
+            break;
+        }
+
+        // a hotplug touches a name several times (node, attributes, links), each is probed once
+        Names.clear();
+
+        while ( ( n = read( m_nInotify, Events.Buffer, sizeof( Events.Buffer ) ) ) > 0 )
+        {
+            for ( char *p = Events.Buffer; p < Events.Buffer + n; )
+            {
+                struct inotify_event *pEvent = ( struct inotify_event * )p;
+
+                if ( pEvent->mask & IN_Q_OVERFLOW )
+                {
+                    bOverflow = TRUE;
+                }
+                else if ( ( pEvent->len > 0 ) && !( pEvent->mask & IN_ISDIR ) )
+                {
+                    Names.push_back( pEvent->name );
+                }
+
+                p += sizeof( struct inotify_event ) + pEvent->len;
+            }
+        }
+
+        if ( bOverflow )
+        {
+            Refresh();
+            continue;
+        }
+
+        std::sort( Names.begin(), Names.end() );
+        Names.erase( std::unique( Names.begin(), Names.end() ), Names.end() );
+
+        for ( size_t i = 0; i < Names.size(); i++ )
+        {
+            Update( Names[i].c_str() );
+        }
+    }
+}
+#else
+BOOL CSerialPortList::Start()
+{
+    // no change notifications here, the list stands as of this scan
+    return Refresh();
+}
+
+void CSerialPortList::Stop()
+{
+}
+#endif
@@ -0,0 +1,87 @@
+/*
+**  FILENAME            SerialPortList.h
+**
+**  PURPOSE             Lists the serial ports of the machine without opening them and
+**                      keeps the list up to date. On Linux the entries come from the
+**                      sysfs attributes of /sys/class/tty (driver, USB ids, serial
+**                      number), a watcher thread follows /dev and sysfs with inotify
+**                      and probes only the names that changed. Windows reads the
+**                      SERIALCOMM device map on each Refresh().
+**
+**  CREATION DATE       16-10-2026
+**  LAST MODIFICATION   16-10-2026
+*/
+
+#ifndef SERIAL_PORT_LIST_H
+#define SERIAL_PORT_LIST_H
+
+#ifndef _WIN32
+#include "SerialPortPosix.h"
+#endif
+#include <mutex>
+#include <string>
+#include <vector>
+
+typedef struct _SERIAL_PORT_INFO
+{
+    char                szName[32];             // ttyUSB0, COM3
+    char                szDevice[96];           // the path for OpenDevice(), /dev/ttyUSB0, \\.\COM3
+    char                szDriver[32];           // ftdi_sio, cdc_acm, serial8250, ...
+    WORD                wVendorId;              // USB ids, 0 for other buses
+    WORD                wProductId;
+    char                szSerial[64];
+    char                szManufacturer[64];
+    char                szProduct[64];
+    char                szLocation[32];         // USB port path, 1-1.2, the same for the same socket
+} SERIAL_PORT_INFO;
+
+// called on the watcher thread for each port which appeared (bArrived) or went away
+typedef void ( *SERIAL_PORT_LIST_CALLBACK )( void *pContext, const SERIAL_PORT_INFO *pInfo, BOOL bArrived );
+
+class CSerialPortList
+{
+    public:
+        // the roots can point to a copy of the trees, e.g. a fake sysfs for tests
+        CSerialPortList( const char *szSysRoot = "/sys", const char *szDevRoot = "/dev" );
+        ~CSerialPortList();
+
+        void                SetCallback( SERIAL_PORT_LIST_CALLBACK pfnCallback, void *pContext );
+
+        // full scan; Start() makes one and then follows the changes
+        BOOL                Refresh();
+        BOOL                Start();
+        void                Stop();
+
+        // a copy of the cache, sorted by name
+        void                GetPorts( std::vector<SERIAL_PORT_INFO> &Ports );
+        BOOL                Find( const char *szName, SERIAL_PORT_INFO *pInfo );
+        UINT                GetCount();
+
+    private:
+        CSerialPortList( const CSerialPortList & );
+        CSerialPortList     &operator=( const CSerialPortList & );
+
+        BOOL                Scan( std::vector<SERIAL_PORT_INFO> &Ports );
+        BOOL                Probe( const char *szName, SERIAL_PORT_INFO *pInfo );
+        void                Update( const char *szName );
+        void                Notify( const SERIAL_PORT_INFO &Info, BOOL bArrived );
+#ifdef __linux__
+        static void         *WatchThread( void *pParam );
+        void                Watch();
+#endif
+
+        std::string         m_strSysRoot;
+        std::string         m_strDevRoot;
+        std::mutex          m_Lock;             // the cache, never held across the callback
+        std::vector<SERIAL_PORT_INFO> m_Ports;
+        SERIAL_PORT_LIST_CALLBACK m_pfnCallback;
+        void                *m_pContext;
+#ifdef __linux__
+        pthread_t           m_Thread;
+        BOOL                m_bThreadStarted;
+        int                 m_nInotify;
+        int                 m_nWakeFd;
+#endif
+};
+
+#endif // SERIAL_PORT_LIST_H
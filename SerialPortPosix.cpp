@@ -0,0 +1,989 @@
+/*
+**  FILENAME            SerialPortPosix.cpp
+**
+**  PURPOSE             POSIX (termios) backend of CSerialPort. The port is opened
+**                      non-blocking and one I/O thread per port waits in poll()
+**                      for receive data, transmit space and wakeup requests, or
+**                      a CSerialPortReactor services the port together with others.
+**
+**  CREATION DATE       16-10-2026
+**  LAST MODIFICATION   16-10-2026
+*/
+
+#ifndef _WIN32
+
+#include "SerialPort.h"
+#include "SerialPortReactor.h"
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/uio.h>
+#ifdef __linux__
+#include <sys/eventfd.h>
+#endif
+
+#define TX_MAX_IOV          16
+
+static const struct
+{
+    DWORD   dwBaud;
+    speed_t nSpeed;
+} s_BaudTable[] =
+{
+    { 50, B50 }, { 75, B75 }, { 110, B110 }, { 134, B134 }, { 150, B150 }, { 200, B200 },
+    { 300, B300 }, { 600, B600 }, { 1200, B1200 }, { 1800, B1800 }, { 2400, B2400 },
+    { 4800, B4800 }, { 9600, B9600 }, { 19200, B19200 }, { 38400, B38400 },
+    { 57600, B57600 }, { 115200, B115200 }, { 230400, B230400 },
+#ifdef B460800
+    { 460800, B460800 },
+#endif
+#ifdef B500000
+    { 500000, B500000 },
+#endif
+#ifdef B576000
+    { 576000, B576000 },
+#endif
+#ifdef B921600
+    { 921600, B921600 },
+#endif
+#ifdef B1000000
+    { 1000000, B1000000 },
+#endif
+#ifdef B1152000
+    { 1152000, B1152000 },
+#endif
+#ifdef B1500000
+    { 1500000, B1500000 },
+#endif
+#ifdef B2000000
+    { 2000000, B2000000 },
+#endif
+#ifdef B2500000
+    { 2500000, B2500000 },
+#endif
+#ifdef B3000000
+    { 3000000, B3000000 },
+#endif
+#ifdef B3500000
+    { 3500000, B3500000 },
+#endif
+#ifdef B4000000
+    { 4000000, B4000000 },
+#endif
+};
+
+BOOL SerialBaudToSpeed( DWORD dwBaud, speed_t *pSpeed )
+{
+    for ( size_t i = 0; i < sizeof( s_BaudTable ) / sizeof( s_BaudTable[0] ); i++ )
+    {
+        if ( s_BaudTable[i].dwBaud == dwBaud )
+        {
+            *pSpeed = s_BaudTable[i].nSpeed;
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+static UINT64 GetTickCountMs()
+{
+    return SerialMetricsNow() / 1000000;
+}
+
+// poll() until qwDeadline (SerialMetricsNow() nanoseconds, 0 for none)
+static int PollUntil( struct pollfd *pFds, nfds_t nFds, UINT64 qwDeadline )
+{
+    UINT64 qwWait = 0;
+
+    if ( qwDeadline != 0 )
+    {
+        UINT64 qwNow = SerialMetricsNow();
+        qwWait = ( qwNow >= qwDeadline ) ? 0 : qwDeadline - qwNow;
+    }
+
+#ifdef __linux__
+    // nanosecond timeout, an inter-frame gap is often well below a millisecond
+    struct timespec ts;
+    ts.tv_sec = ( time_t )( qwWait / 1000000000 );
+    ts.tv_nsec = ( long )( qwWait % 1000000000 );
+    return ppoll( pFds, nFds, ( qwDeadline != 0 ) ? &ts : NULL, NULL );
+#else
+    return poll( pFds, nFds, ( qwDeadline != 0 ) ? ( int )( ( qwWait + 999999 ) / 1000000 ) : -1 );
+#endif
+}
+
+#ifndef __linux__
+static BOOL SetNonBlocking( int fd )
+{
+    int flags = fcntl( fd, F_GETFL );
+    return ( flags >= 0 ) && ( fcntl( fd, F_SETFL, flags | O_NONBLOCK ) == 0 ) && ( fcntl( fd, F_SETFD, FD_CLOEXEC ) == 0 );
+}
+#endif
+
+BOOL CSerialPort::Open( HWND    pPortOwner,      // the owner of the port (receives message)
+                        UINT    port,            // portnumber (0..SERIAL_PORT_MAX), /dev/ttyS<port>
+                        UINT    baud,            // baudrate
+                        BYTE    parity,          // parity
+                        BYTE    databits,        // databits
+                        BYTE    stopbits,        // stopbits
+                        DWORD   dwCommEvents,    // EV_RXCHAR, EV_CTS etc
+                        UINT    nBufferSize,     // size to the writebuffer
+                        DWORD   ReadIntervalTimeout,
+                        DWORD   ReadTotalTimeoutMultiplier,
+                        DWORD   ReadTotalTimeoutConstant,
+                        DWORD   WriteTotalTimeoutMultiplier,
+                        DWORD   WriteTotalTimeoutConstant )
+{
+    char szPort[MAX_PATH];
+    assert( port <= SERIAL_PORT_MAX );
+    // prepare port strings
+    snprintf( szPort, sizeof( szPort ), "%s%u", SERIAL_DEVICE_PREFIX, port );
+    m_nPortNr = port;
+    return OpenDevice( pPortOwner, szPort, baud, parity, databits, stopbits, dwCommEvents, nBufferSize,
+                       ReadIntervalTimeout, ReadTotalTimeoutMultiplier, ReadTotalTimeoutConstant,
+                       WriteTotalTimeoutMultiplier, WriteTotalTimeoutConstant );
+}
+
+BOOL CSerialPort::OpenDevice( HWND    pPortOwner,      // the owner of the port (receives message)
+                              const char *szPort,      // device path, e.g. /dev/ttyUSB0
+                              UINT    baud,            // baudrate
+                              BYTE    parity,          // parity
+                              BYTE    databits,        // databits
+                              BYTE    stopbits,        // stopbits
+                              DWORD   dwCommEvents,    // EV_RXCHAR, EV_CTS etc
+                              UINT    nBufferSize,     // size to the writebuffer
+                              DWORD   ReadIntervalTimeout,
+                              DWORD   ReadTotalTimeoutMultiplier,
+                              DWORD   ReadTotalTimeoutConstant,
+                              DWORD   WriteTotalTimeoutMultiplier,
+                              DWORD   WriteTotalTimeoutConstant )
+{
+    BOOL ret = TRUE;
+    Close();
+    EnterCriticalSection( &m_csCommunicationSync );
+    assert( szPort != NULL );
+    // save the owner, may be NULL when the data is taken through a callback or Read()
+    m_pOwner = pPortOwner;
+    // nBufferSize is the high-water mark of the transmit queue
+    m_nWriteBufferSize = nBufferSize;
+    m_TxScheduler.Open( nBufferSize );
+    m_TxPacer.Reset();
+    m_qwTxPaceDeadline = 0;
+    m_bRxNotifyPending = FALSE;
+    m_qwRxHeldSince = 0;
+    m_qwProbeNext = 0;
+    m_dwThreadState = 0;
+    m_Metrics.Reset();
+    m_Errors.Clear();
+
+    if ( !m_RxBuffer.Create( m_nRxBufferSize ) )
+    {
+        ret = FALSE;
+        goto done;
+    }
+
+    LockBuffers();
+
+    if ( m_pFramer != NULL )
+    {
+        m_pFramer->Reset();
+    }
+
+    m_dwCommEvents = dwCommEvents | (EV_RXCHAR | EV_TXEMPTY);
+    strncpy( m_szPortName, szPort, sizeof( m_szPortName ) - 1 );
+    m_szPortName[sizeof( m_szPortName ) - 1] = '\0';
+    // get a handle to the port, the I/O thread never blocks in read() or write()
+    m_hComm = open( szPort, O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC );
+
+    if ( m_hComm == INVALID_HANDLE_VALUE )
+    {
+        ProcessErrorMessage( "open()" );
+        ret = FALSE;
+        goto done;
+    }
+
+    if ( tcgetattr( m_hComm, &m_tioSaved ) != 0 )
+    {
+        ProcessErrorMessage( "tcgetattr()" );
+        close( m_hComm );
+        m_hComm = INVALID_HANDLE_VALUE;
+        ret = FALSE;
+        goto done;
+    }
+
+    // set the timeout values
+    m_CommTimeouts.ReadIntervalTimeout         = ReadIntervalTimeout;
+    m_CommTimeouts.ReadTotalTimeoutMultiplier  = ReadTotalTimeoutMultiplier;
+    m_CommTimeouts.ReadTotalTimeoutConstant    = ReadTotalTimeoutConstant;
+    m_CommTimeouts.WriteTotalTimeoutMultiplier = WriteTotalTimeoutMultiplier;
+    m_CommTimeouts.WriteTotalTimeoutConstant   = WriteTotalTimeoutConstant;
+
+    // configure
+    memset( &m_dcb, 0, sizeof( m_dcb ) );
+    m_dcb.DCBlength = sizeof( m_dcb );
+    m_dcb.BaudRate = baud;
+    m_dcb.Parity   = parity;
+    m_dcb.ByteSize = databits;
+    m_dcb.StopBits = stopbits;
+    m_dcb.fOutxCtsFlow = FALSE;
+    m_dcb.fRtsControl = RTS_CONTROL_DISABLE;
+    m_dcb.fOutxDsrFlow = FALSE;
+    m_dcb.fDtrControl = DTR_CONTROL_DISABLE;
+    m_dcb.fBinary = TRUE;
+    m_dcb.fDsrSensitivity = FALSE;
+    m_dcb.fTXContinueOnXoff = FALSE;
+    m_dcb.fOutX = FALSE;
+    m_dcb.fInX = FALSE;
+    m_dcb.fErrorChar = FALSE;
+    m_dcb.fNull = FALSE;
+    m_dcb.fAbortOnError = FALSE;
+    m_dcb.XonChar = 0x11;
+    m_dcb.XoffChar = 0x13;
+
+    if ( !ApplyDCB() )
+    {
+        ProcessErrorMessage( "tcsetattr()" );
+        ret = FALSE;
+        goto done;
+    }
+
+    OnLineChanged();
+
+    // flush the port
+    if ( tcflush( m_hComm, TCIOFLUSH ) != 0 )
+    {
+        ProcessErrorMessage( "tcflush()" );
+        ret = FALSE;
+        goto done;
+    }
+
+#ifdef SERIAL_PORT_REACTOR
+    if ( m_pReactor != NULL )
+    {
+        m_bThreadAlive = TRUE;
+        m_bUserRequestClose = FALSE;
+
+        if ( !m_pReactor->Attach( this ) )
+        {
+            ProcessErrorMessage( "epoll_ctl()" );
+            ret = FALSE;
+            m_bThreadAlive = FALSE;
+            goto done;
+        }
+
+        m_bReactorAttached = TRUE;
+        goto done;
+    }
+
+#endif
+    // the wakeup descriptor lets Write() and Close() interrupt poll()
+    m_bWakePending = FALSE;
+#ifdef __linux__
+    m_nWakeFd[0] = m_nWakeFd[1] = eventfd( 0, EFD_NONBLOCK | EFD_CLOEXEC );
+
+    if ( m_nWakeFd[0] < 0 )
+    {
+        ProcessErrorMessage( "eventfd()" );
+        m_nWakeFd[1] = -1;
+        ret = FALSE;
+        goto done;
+    }
+#else
+    if ( ( pipe( m_nWakeFd ) != 0 ) || !SetNonBlocking( m_nWakeFd[0] ) || !SetNonBlocking( m_nWakeFd[1] ) )
+    {
+        ProcessErrorMessage( "pipe()" );
+        ret = FALSE;
+        goto done;
+    }
+#endif
+
+    m_bThreadAlive = TRUE;
+    m_bUserRequestClose = FALSE;
+    assert( !m_bThreadStarted );
+
+    if ( pthread_create( &m_Thread, NULL, CommThread, this ) != 0 )
+    {
+        ProcessErrorMessage( "pthread_create()" );
+        ret = FALSE;
+        m_bThreadAlive = FALSE;
+        goto done;
+    }
+
+    m_bThreadStarted = TRUE;
+
+done:
+    LeaveCriticalSection( &m_csCommunicationSync );
+
+    if ( !ret )
+    {
+        Close();
+    }
+
+    return ret;
+}
+
+BOOL CSerialPort::ApplyDCB()
+{
+    struct termios tio;
+    speed_t speed;
+
+    if ( !SerialBaudToSpeed( m_dcb.BaudRate, &speed ) )
+    {
+        errno = EINVAL;
+        return FALSE;
+    }
+
+    if ( tcgetattr( m_hComm, &tio ) != 0 )
+    {
+        return FALSE;
+    }
+
+    // raw mode, the same as a Win32 comm handle in binary mode
+    tio.c_iflag &= ~( IGNBRK | BRKINT | PARMRK | ISTRIP | INLCR | IGNCR | ICRNL | IXON | IXOFF | IXANY | INPCK );
+    tio.c_oflag &= ~OPOST;
+    tio.c_lflag &= ~( ECHO | ECHONL | ICANON | ISIG | IEXTEN );
+    tio.c_cflag &= ~( CSIZE | PARENB | PARODD | CSTOPB );
+    tio.c_cflag |= CREAD | CLOCAL;
+#ifdef CRTSCTS
+    tio.c_cflag &= ~CRTSCTS;
+#endif
+#ifdef CMSPAR
+    tio.c_cflag &= ~CMSPAR;
+#endif
+
+    switch ( m_dcb.ByteSize )
+    {
+        case 5: tio.c_cflag |= CS5; break;
+        case 6: tio.c_cflag |= CS6; break;
+        case 7: tio.c_cflag |= CS7; break;
+        case 8: tio.c_cflag |= CS8; break;
+        default:
+            errno = EINVAL;
+            return FALSE;
+    }
+
+    switch ( m_dcb.Parity )
+    {
+        case NOPARITY:
+            break;
+        case ODDPARITY:
+            tio.c_cflag |= PARENB | PARODD;
+            break;
+        case EVENPARITY:
+            tio.c_cflag |= PARENB;
+            break;
+#ifdef CMSPAR
+        case MARKPARITY:
+            tio.c_cflag |= PARENB | PARODD | CMSPAR;
+            break;
+        case SPACEPARITY:
+            tio.c_cflag |= PARENB | CMSPAR;
+            break;
+#endif
+        default:
+            errno = EINVAL;
+            return FALSE;
+    }
+
+    if ( m_dcb.fParity && ( m_dcb.Parity != NOPARITY ) )
+    {
+        tio.c_iflag |= INPCK;
+    }
+
+    // termios has no 1.5 stop bits, the UART uses 1.5 for 5 data bits when CSTOPB is set
+    if ( m_dcb.StopBits != ONESTOPBIT )
+    {
+        tio.c_cflag |= CSTOPB;
+    }
+
+#ifdef CRTSCTS
+    if ( m_dcb.fOutxCtsFlow || ( m_dcb.fRtsControl == RTS_CONTROL_HANDSHAKE ) )
+    {
+        tio.c_cflag |= CRTSCTS;
+    }
+#endif
+
+    if ( m_dcb.fOutX )
+    {
+        tio.c_iflag |= IXON;
+    }
+
+    if ( m_dcb.fInX )
+    {
+        tio.c_iflag |= IXOFF;
+    }
+
+    if ( m_dcb.XonChar != 0 )
+    {
+        tio.c_cc[VSTART] = ( cc_t )m_dcb.XonChar;
+    }
+
+    if ( m_dcb.XoffChar != 0 )
+    {
+        tio.c_cc[VSTOP] = ( cc_t )m_dcb.XoffChar;
+    }
+
+    // ReadIntervalTimeout == MAXDWORD with zero totals means "return what is there",
+    // otherwise the interval timeout becomes the inter-byte timer in 1/10 seconds.
+    // The I/O thread reads non-blocking, so this only matters for other readers.
+    if ( ( m_CommTimeouts.ReadIntervalTimeout == MAXDWORD ) &&
+         ( m_CommTimeouts.ReadTotalTimeoutMultiplier == 0 ) &&
+         ( m_CommTimeouts.ReadTotalTimeoutConstant == 0 ) )
+    {
+        tio.c_cc[VMIN] = 0;
+        tio.c_cc[VTIME] = 0;
+    }
+    else
+    {
+        DWORD dwInterval = ( m_CommTimeouts.ReadIntervalTimeout == MAXDWORD ) ? 0 : m_CommTimeouts.ReadIntervalTimeout;
+        tio.c_cc[VMIN] = 1;
+        tio.c_cc[VTIME] = ( cc_t )( ( ( dwInterval + 99 ) / 100 ) > 255 ? 255 : ( dwInterval + 99 ) / 100 );
+    }
+
+    if ( ( cfsetispeed( &tio, speed ) != 0 ) || ( cfsetospeed( &tio, speed ) != 0 ) )
+    {
+        return FALSE;
+    }
+
+    if ( tcsetattr( m_hComm, TCSANOW, &tio ) != 0 )
+    {
+        return FALSE;
+    }
+
+    // modem lines, not every device has them (a pty has none)
+    int nBits = TIOCM_DTR;
+    ioctl( m_hComm, ( m_dcb.fDtrControl == DTR_CONTROL_DISABLE ) ? TIOCMBIC : TIOCMBIS, &nBits );
+
+    if ( m_dcb.fRtsControl != RTS_CONTROL_HANDSHAKE )
+    {
+        nBits = TIOCM_RTS;
+        ioctl( m_hComm, ( m_dcb.fRtsControl == RTS_CONTROL_DISABLE ) ? TIOCMBIC : TIOCMBIS, &nBits );
+    }
+
+    return TRUE;
+}
+
+void *CSerialPort::CommThread( void *pParam )
+{
+    CSerialPort *pPort = ( CSerialPort * )pParam;
+    UINT nClose = pPort->m_nCloseCount.load();
+    struct pollfd fds[2];
+
+    pPort->ApplyThreadOptions();
+
+    // a callback which closed the port ends the thread at once, the port is its owner's again
+    while ( pPort->m_bThreadAlive && ( pPort->m_nCloseCount.load() == nClose ) )
+    {
+        if ( pPort->m_bUserRequestClose )
+        {
+            break;
+        }
+
+        fds[0].fd = pPort->m_hComm;
+        fds[0].events = pPort->IsTxPending() ? ( POLLIN | POLLOUT ) : POLLIN;
+        fds[0].revents = 0;
+        fds[1].fd = pPort->m_nWakeFd[0];
+        fds[1].events = POLLIN;
+        fds[1].revents = 0;
+
+        // the nearest of the write timeout, the pacer and the receive deadlines (gap, held data, waiter)
+        UINT64 qwDeadline = pPort->GetWriteDeadline() * 1000000;
+        UINT64 qwPaceDeadline = pPort->GetTxPaceDeadline();
+        UINT64 qwRxDeadline = pPort->GetRxDeadline();
+        UINT64 qwProbeDeadline = pPort->GetProbeDeadline( SerialMetricsNow() );
+
+        if ( ( qwPaceDeadline != 0 ) && ( ( qwDeadline == 0 ) || ( qwPaceDeadline < qwDeadline ) ) )
+        {
+            qwDeadline = qwPaceDeadline;
+        }
+
+        if ( ( qwRxDeadline != 0 ) && ( ( qwDeadline == 0 ) || ( qwRxDeadline < qwDeadline ) ) )
+        {
+            qwDeadline = qwRxDeadline;
+        }
+
+        if ( ( qwProbeDeadline != 0 ) && ( ( qwDeadline == 0 ) || ( qwProbeDeadline < qwDeadline ) ) )
+        {
+            qwDeadline = qwProbeDeadline;
+        }
+
+        int n = PollUntil( fds, 2, qwDeadline );
+
+        if ( ( n == 0 ) && ( qwDeadline != 0 ) )
+        {
+            pPort->OnTimedWakeup( qwDeadline, SerialMetricsNow() );
+        }
+
+        if ( n < 0 )
+        {
+            if ( errno == EINTR )
+            {
+                continue;
+            }
+
+            pPort->ProcessErrorMessage( "poll()" );
+            break;
+        }
+
+        if ( fds[1].revents & POLLIN )
+        {
+            char szDrain[64];
+
+            // cleared first, a wakeup requested while draining is not lost
+            pPort->m_bWakePending = FALSE;
+
+            while ( read( pPort->m_nWakeFd[0], szDrain, sizeof( szDrain ) ) > 0 )
+            {
+            }
+        }
+
+        if ( n == 0 )
+        {
+            pPort->CheckWriteTimeout( GetTickCountMs() );
+        }
+
+        if ( ( pPort->m_nCloseCount.load() != nClose ) || !pPort->ServiceIo( fds[0].revents, pPort->m_RxBuffer.GetCapacity() ) )
+        {
+            break;
+        }
+
+        if ( pPort->GetRxDeadline() != 0 )
+        {
+            pPort->CheckRxIdle( SerialMetricsNow() );
+        }
+    }
+
+    if ( pPort->m_nCloseCount.load() != nClose )
+    {
+        // Close() takes care of the port, it may be open again with another thread
+        return NULL;
+    }
+
+    // nothing sends the queued requests any more, they fail and new ones are refused
+    pPort->m_TxScheduler.Close();
+    pPort->m_bThreadAlive = FALSE;
+    return NULL;
+}
+
+BOOL CSerialPort::IsTxPending()
+{
+    // held back by the pacer there is no point in waiting for POLLOUT
+    return !m_TxScheduler.IsEmpty() && ( GetTxPaceDeadline() <= SerialMetricsNow() );
+}
+
+UINT64 CSerialPort::GetTxPaceDeadline()
+{
+    return m_TxScheduler.IsEmpty() ? 0 : m_qwTxPaceDeadline;
+}
+
+UINT CSerialPort::GetDriverBacklog()
+{
+    int nQueued = 0;
+
+    if ( ( m_hComm == INVALID_HANDLE_VALUE ) || ( ioctl( m_hComm, TIOCOUTQ, &nQueued ) != 0 ) || ( nQueued < 0 ) )
+    {
+        return 0;
+    }
+
+    return ( UINT )nQueued;
+}
+
+UINT64 CSerialPort::GetWriteDeadline()
+{
+    // the whole request, a WriteV() header alone would leave its payload no time
+    UINT nPending = m_TxScheduler.GetFrontLeft();
+
+    if ( ( nPending == 0 ) ||
+         ( ( m_CommTimeouts.WriteTotalTimeoutConstant == 0 ) && ( m_CommTimeouts.WriteTotalTimeoutMultiplier == 0 ) ) )
+    {
+        return 0;
+    }
+
+    if ( m_qwWriteDeadline == 0 )
+    {
+        // WriteTotalTimeoutMultiplier/Constant per request, as WriteFile() would apply them
+        m_qwWriteDeadline = GetTickCountMs() + m_CommTimeouts.WriteTotalTimeoutConstant +
+                            ( UINT64 )m_CommTimeouts.WriteTotalTimeoutMultiplier * nPending;
+    }
+
+    return m_qwWriteDeadline;
+}
+
+void CSerialPort::CheckWriteTimeout( UINT64 qwNow )
+{
+    UINT64 qwDeadline = GetWriteDeadline();
+
+    if ( ( qwDeadline != 0 ) && ( qwNow >= qwDeadline ) )
+    {
+        // the device did not take the data in time, fail the request like a timed out WriteFile()
+        m_qwWriteDeadline = 0;
+        m_Metrics.OnTxError();
+        m_TxScheduler.FailFront();
+        errno = ETIMEDOUT;
+        ProcessErrorMessage( "write()" );
+    }
+}
+
+// FALSE when the I/O stopped, or when a callback closed the port and it must not be touched
+BOOL CSerialPort::ServiceIo( short revents, UINT nBudget )
+{
+    UINT nClose = m_nCloseCount.load();
+
+    if ( revents & POLLOUT )
+    {
+        UINT BytesSent = WriteChar( this, nBudget );
+
+        if ( ( EOF == ( int )BytesSent ) || ( m_nCloseCount.load() != nClose ) )
+        {
+            return FALSE;
+        }
+
+        if ( ( BytesSent > 0 ) && ( m_pOwner != NULL ) && m_TxScheduler.IsEmpty() )
+        {
+            ::PostMessage( m_pOwner, SERIAL_PORT_MESSAGE, ( WPARAM )EV_TXEMPTY, ( LPARAM )BytesSent );
+
+            if ( m_nCloseCount.load() != nClose )
+            {
+                return FALSE;
+            }
+        }
+    }
+
+    if ( revents & ( POLLIN | POLLHUP | POLLERR | POLLNVAL ) )
+    {
+        int nRead = ReceiveChar( this, nBudget );
+
+        if ( ( nRead < 0 ) || ( m_nCloseCount.load() != nClose ) )
+        {
+            return FALSE;
+        }
+
+        if ( ( nRead == 0 ) && ( revents & ( POLLHUP | POLLERR | POLLNVAL ) ) )
+        {
+            // the device is gone (hang up, usb to serial cable unplugged)
+            errno = EIO;
+            ProcessErrorMessage( "poll()" );
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+#ifdef SERIAL_PORT_REACTOR
+void CSerialPort::SetReactor( CSerialPortReactor *pReactor )
+{
+    assert( !IsOpen() );
+    m_pReactor = pReactor;
+}
+
+#endif
+void CSerialPort::WakeIoThread()
+{
+    UINT64 qwOne = 1;
+
+#ifdef SERIAL_PORT_REACTOR
+    if ( m_bReactorAttached )
+    {
+        m_pReactor->Wake( this );
+        return;
+    }
+
+#endif
+    // one system call per wakeup of the I/O thread, not per queued request
+    if ( ( m_nWakeFd[1] >= 0 ) && !m_bWakePending.exchange( TRUE ) )
+    {
+        // eight bytes as an eventfd wants them, a full pipe already has a wakeup pending
+        ( void )write( m_nWakeFd[1], &qwOne, sizeof( qwOne ) );
+    }
+}
+
+void CSerialPort::ProcessErrorMessage( const char *ErrorText )
+{
+    int nError = errno;
+
+    // queued, the owner callback runs on the I/O thread and should not block either
+    if ( m_Errors.Push( ErrorText, ( DWORD )nError ) && ( m_pOwner != NULL ) )
+    {
+        ::PostMessage( m_pOwner, SERIAL_PORT_MESSAGE, ( WPARAM )EV_ERR, ( LPARAM )nError );
+    }
+}
+
+UINT CSerialPort::WriteChar( CSerialPort *pPort, UINT nBudget )
+{
+    UINT nClose = pPort->m_nCloseCount.load();
+    UINT nTotal = 0;
+    SERIAL_TX_SPAN Spans[TX_MAX_IOV];
+    struct iovec iov[TX_MAX_IOV];
+    UINT nSpans;
+    UINT nSize;
+
+    if ( pPort->m_TxPacer.IsActive() )
+    {
+        UINT nPaced = pPort->m_TxPacer.GetBudget( SerialMetricsNow(), pPort->GetDriverBacklog(),
+                                                  pPort->m_TxScheduler.GetQueuedBytes(), &pPort->m_qwTxPaceDeadline );
+        nBudget = ( nPaced < nBudget ) ? nPaced : nBudget;
+    }
+
+    // hand the driver as much of the queue as it takes without blocking, several
+    // segments (header, payload, crc, ...) per system call, at most nBudget bytes
+    while ( ( nTotal < nBudget ) && ( ( nSpans = pPort->m_TxScheduler.GetFront( Spans, TX_MAX_IOV, &nSize ) ) > 0 ) )
+    {
+        UINT nLeft = nBudget - nTotal;
+        UINT nCount = 0;
+        nSize = 0;
+
+        while ( ( nCount < nSpans ) && ( nLeft > 0 ) )
+        {
+            UINT nTake = ( Spans[nCount].nSize < nLeft ) ? Spans[nCount].nSize : nLeft;
+            iov[nCount].iov_base = ( void * )Spans[nCount].pData;
+            iov[nCount].iov_len = nTake;
+            nSize += nTake;
+            nLeft -= nTake;
+            nCount++;
+        }
+
+        nSpans = nCount;
+
+        // no lock, m_csCommunicationSync only serializes configuration changes
+        ssize_t Sent = writev( pPort->m_hComm, iov, ( int )nSpans );
+
+        if ( Sent < 0 )
+        {
+            if ( errno == EINTR )
+            {
+                continue;
+            }
+
+            if ( errno == EAGAIN )
+            {
+                break;
+            }
+
+            pPort->m_Metrics.OnTxError();
+            pPort->ProcessErrorMessage( "write()" );
+            pPort->m_qwWriteDeadline = 0;
+            pPort->m_TxScheduler.FailFront();
+            return (UINT)EOF;
+        }
+
+        nTotal += ( UINT )Sent;
+        pPort->m_Metrics.OnTxChunk( ( UINT )Sent );
+        pPort->m_TxPacer.OnSent( SerialMetricsNow(), ( UINT )Sent );
+
+        if ( pPort->m_pCapture != NULL )
+        {
+            pPort->m_pCapture->Record( pPort->m_nCaptureId, SERIAL_CAPTURE_TX, SerialMetricsNow(), Spans, nSpans, ( UINT )Sent );
+        }
+
+        if ( pPort->m_TxScheduler.Advance( ( UINT )Sent ) > 0 )
+        {
+            pPort->m_qwWriteDeadline = 0;
+        }
+
+        if ( ( UINT )Sent < nSize )
+        {
+            // the output queue of the driver is full
+            break;
+        }
+
+        if ( pPort->m_nCloseCount.load() != nClose )
+        {
+            // closed from a completion callback
+            break;
+        }
+    }
+
+    return nTotal;
+}
+
+int CSerialPort::ReceiveChar( CSerialPort *pPort, UINT nBudget )
+{
+    UINT nClose = pPort->m_nCloseCount.load();
+    int nTotal = 0;
+    BYTE Discard[MAX_PATH];
+
+    // read whatever the driver has straight into the ring buffer, bounded by nBudget
+    // so that a fast sender cannot starve the transmit side or other ports
+    while ( pPort->m_bThreadAlive && ( ( UINT )nTotal < nBudget ) )
+    {
+        BYTE *pSpan;
+        UINT nSpan;
+
+        if ( pPort->m_bUserRequestClose )
+        {
+            break;
+        }
+
+        nSpan = pPort->m_RxBuffer.GetWriteSpan( &pSpan );
+
+        if ( nSpan == 0 )
+        {
+            // the consumer is behind, the data is lost either way
+            pSpan = Discard;
+            nSpan = sizeof( Discard );
+        }
+
+        if ( nSpan > nBudget - ( UINT )nTotal )
+        {
+            nSpan = nBudget - ( UINT )nTotal;
+        }
+
+        ssize_t BytesRead = read( pPort->m_hComm, pSpan, nSpan );
+
+        if ( BytesRead > 0 )
+        {
+            // stamped when the read completed, each chunk is delivered with its own time
+            UINT64 qwNow = SerialMetricsNow();
+
+            if ( pPort->m_pCapture != NULL )
+            {
+                pPort->m_pCapture->Record( pPort->m_nCaptureId, SERIAL_CAPTURE_RX, qwNow, pSpan, ( UINT )BytesRead );
+            }
+
+            if ( pSpan == Discard )
+            {
+                pPort->m_Metrics.OnRxOverrun( ( UINT )BytesRead );
+            }
+            else
+            {
+                pPort->m_RxBuffer.CommitWrite( ( UINT )BytesRead );
+                pPort->m_Metrics.OnRxChunk( ( UINT )BytesRead, pPort->m_RxBuffer.GetCount() );
+                pPort->m_Metrics.OnRxBuffered( qwNow );
+            }
+
+            pPort->DeliverRx( qwNow, ( pSpan == Discard ) ? 0 : ( UINT )BytesRead );
+            nTotal += ( int )BytesRead;
+
+            if ( ( UINT )BytesRead < nSpan )
+            {
+                // the driver is empty
+                break;
+            }
+
+            if ( pPort->m_nCloseCount.load() != nClose )
+            {
+                // closed from a callback, the descriptor and the buffer are gone
+                break;
+            }
+        }
+        else if ( ( BytesRead < 0 ) && ( errno == EINTR ) )
+        {
+            continue;
+        }
+        else if ( ( BytesRead < 0 ) && ( errno != EAGAIN ) )
+        {
+            pPort->m_Metrics.OnRxError();
+            pPort->ProcessErrorMessage( "read()" );
+            return -1;
+        }
+        else
+        {
+            break;
+        }
+    }
+
+    return nTotal;
+}
+
+BOOL CSerialPort::SetDCB( DCB *dcb )
+{
+    BOOL ret = TRUE;
+    assert( m_hComm != INVALID_HANDLE_VALUE );
+    assert( dcb != NULL );
+
+    // applied at once (TCSANOW), bytes still queued go out with the new settings; a refused
+    // DCB fails before tcsetattr() and changes nothing
+    EnterCriticalSection( &m_csCommunicationSync );
+    DCB Saved = m_dcb;
+    m_dcb = *dcb;
+
+    if ( !ApplyDCB() )
+    {
+        m_dcb = Saved;
+        ProcessErrorMessage( "tcsetattr()" );
+        ret = FALSE;
+    }
+    else
+    {
+        OnLineChanged();
+    }
+
+    LeaveCriticalSection( &m_csCommunicationSync );
+    return ret;
+}
+
+void CSerialPort::Close()
+{
+    m_nCloseCount++;
+
+    if ( m_bThreadStarted )
+    {
+        m_bUserRequestClose = TRUE;
+        WakeIoThread();
+
+        // from a callback on the I/O thread, which ends once the callback returned
+        if ( pthread_equal( pthread_self(), m_Thread ) )
+        {
+            pthread_detach( m_Thread );
+        }
+        else
+        {
+            pthread_join( m_Thread, NULL );
+        }
+
+        m_bThreadStarted = FALSE;
+        m_bThreadAlive = FALSE;
+        m_bUserRequestClose = FALSE;
+    }
+
+#ifdef SERIAL_PORT_REACTOR
+    if ( m_bReactorAttached )
+    {
+        // returns once the reactor no longer touches the port
+        m_bUserRequestClose = TRUE;
+        m_pReactor->Detach( this );
+        m_bReactorAttached = FALSE;
+        m_bThreadAlive = FALSE;
+        m_bUserRequestClose = FALSE;
+    }
+
+#endif
+    EnterCriticalSection( &m_csCommunicationSync );
+
+    if ( m_hComm != INVALID_HANDLE_VALUE )
+    {
+        tcsetattr( m_hComm, TCSANOW, &m_tioSaved );
+        close( m_hComm );
+        m_hComm = INVALID_HANDLE_VALUE;
+    }
+
+    m_RxBuffer.Destroy();
+
+    if ( m_nWakeFd[1] == m_nWakeFd[0] )
+    {
+        // an eventfd, both slots hold the same descriptor
+        m_nWakeFd[1] = -1;
+    }
+
+    for ( int i = 0; i < 2; i++ )
+    {
+        if ( m_nWakeFd[i] >= 0 )
+        {
+            close( m_nWakeFd[i] );
+            m_nWakeFd[i] = -1;
+        }
+    }
+
+    m_TxScheduler.Close();
+    m_qwWriteDeadline = 0;
+    m_qwTxPaceDeadline = 0;
+    LeaveCriticalSection( &m_csCommunicationSync );
+}
+
+#endif
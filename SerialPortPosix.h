@@ -0,0 +1,202 @@
+/*
+**  FILENAME            SerialPortPosix.h
+**
+**  PURPOSE             Win32 compatible types, constants and helpers for the POSIX
+**                      build of CSerialPort, so that the class keeps one interface
+**                      on every platform.
+**
+**  CREATION DATE       16-10-2026
+**  LAST MODIFICATION   16-10-2026
+*/
+
+#ifndef SERIAL_PORT_POSIX_H
+#define SERIAL_PORT_POSIX_H
+
+#include <errno.h>
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+#include <termios.h>
+#include <time.h>
+
+typedef int                 BOOL;
+typedef uint8_t             BYTE;
+typedef uint16_t            WORD;
+typedef uint32_t            DWORD;
+typedef uint16_t            UINT16;
+typedef uint32_t            UINT32;
+typedef unsigned int        UINT;
+typedef uint64_t            UINT64;
+typedef int64_t             INT64;
+typedef uintptr_t           WPARAM;
+typedef intptr_t            LPARAM;
+typedef int                 HANDLE;                 /* file descriptor */
+
+#ifndef TRUE
+#define TRUE                1
+#endif
+#ifndef FALSE
+#define FALSE               0
+#endif
+#define MAXDWORD            0xFFFFFFFFUL
+#define INFINITE            0xFFFFFFFFUL
+#define MAX_PATH            260
+#define INVALID_HANDLE_VALUE (-1)
+#define _T(x)               x
+
+/* epoll is Linux only, elsewhere every port keeps its own I/O thread */
+#ifdef __linux__
+#define SERIAL_PORT_REACTOR
+#endif
+
+/* parity */
+#define NOPARITY            0
+#define ODDPARITY           1
+#define EVENPARITY          2
+#define MARKPARITY          3
+#define SPACEPARITY         4
+
+/* stop bits */
+#define ONESTOPBIT          0
+#define ONE5STOPBITS        1
+#define TWOSTOPBITS         2
+
+/* DCB.fDtrControl */
+#define DTR_CONTROL_DISABLE     0x00
+#define DTR_CONTROL_ENABLE      0x01
+#define DTR_CONTROL_HANDSHAKE   0x02
+
+/* DCB.fRtsControl */
+#define RTS_CONTROL_DISABLE     0x00
+#define RTS_CONTROL_ENABLE      0x01
+#define RTS_CONTROL_HANDSHAKE   0x02
+#define RTS_CONTROL_TOGGLE      0x03
+
+/* comm events */
+#define EV_RXCHAR           0x0001
+#define EV_RXFLAG           0x0002
+#define EV_TXEMPTY          0x0004
+#define EV_CTS              0x0008
+#define EV_DSR              0x0010
+#define EV_RLSD             0x0020
+#define EV_BREAK            0x0040
+#define EV_ERR              0x0080
+#define EV_RING             0x0100
+
+typedef struct _DCB
+{
+    DWORD DCBlength;
+    DWORD BaudRate;
+    DWORD fBinary: 1;
+    DWORD fParity: 1;
+    DWORD fOutxCtsFlow: 1;
+    DWORD fOutxDsrFlow: 1;
+    DWORD fDtrControl: 2;
+    DWORD fDsrSensitivity: 1;
+    DWORD fTXContinueOnXoff: 1;
+    DWORD fOutX: 1;
+    DWORD fInX: 1;
+    DWORD fErrorChar: 1;
+    DWORD fNull: 1;
+    DWORD fRtsControl: 2;
+    DWORD fAbortOnError: 1;
+    DWORD fDummy2: 17;
+    WORD  wReserved;
+    WORD  XonLim;
+    WORD  XoffLim;
+    BYTE  ByteSize;
+    BYTE  Parity;
+    BYTE  StopBits;
+    char  XonChar;
+    char  XoffChar;
+    char  ErrorChar;
+    char  EofChar;
+    char  EvtChar;
+    WORD  wReserved1;
+} DCB;
+
+typedef struct _COMMTIMEOUTS
+{
+    DWORD ReadIntervalTimeout;
+    DWORD ReadTotalTimeoutMultiplier;
+    DWORD ReadTotalTimeoutConstant;
+    DWORD WriteTotalTimeoutMultiplier;
+    DWORD WriteTotalTimeoutConstant;
+} COMMTIMEOUTS;
+
+/*
+** There is no window message queue on POSIX. The port owner is a callback which
+** receives exactly what PostMessage() would have posted to the owner window.
+** It is invoked on the I/O thread of the port.
+*/
+typedef void ( *SERIAL_PORT_NOTIFY )( void *pContext, UINT message, WPARAM wParam, LPARAM lParam );
+
+typedef struct _SERIAL_PORT_OWNER
+{
+    SERIAL_PORT_NOTIFY  pfnNotify;
+    void                *pContext;
+} SERIAL_PORT_OWNER, *HWND;
+
+#define SERIAL_PORT_MESSAGE     0x8000U             /* WM_APP */
+
+static inline BOOL PostMessage( HWND hWnd, UINT Msg, WPARAM wParam, LPARAM lParam )
+{
+    if ( ( hWnd == NULL ) || ( hWnd->pfnNotify == NULL ) )
+    {
+        return FALSE;
+    }
+
+    hWnd->pfnNotify( hWnd->pContext, Msg, wParam, lParam );
+    return TRUE;
+}
+
+/* CRITICAL_SECTION is recursive on Win32, keep it that way */
+typedef pthread_mutex_t     CRITICAL_SECTION;
+
+static inline void InitializeCriticalSection( CRITICAL_SECTION *cs )
+{
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init( &attr );
+    pthread_mutexattr_settype( &attr, PTHREAD_MUTEX_RECURSIVE );
+    pthread_mutex_init( cs, &attr );
+    pthread_mutexattr_destroy( &attr );
+}
+
+static inline void DeleteCriticalSection( CRITICAL_SECTION *cs )
+{
+    pthread_mutex_destroy( cs );
+}
+
+static inline void EnterCriticalSection( CRITICAL_SECTION *cs )
+{
+    pthread_mutex_lock( cs );
+}
+
+static inline void LeaveCriticalSection( CRITICAL_SECTION *cs )
+{
+    pthread_mutex_unlock( cs );
+}
+
+static inline void Sleep( DWORD dwMilliseconds )
+{
+    struct timespec ts;
+
+    if ( dwMilliseconds == 0 )
+    {
+        sched_yield();
+        return;
+    }
+
+    ts.tv_sec = dwMilliseconds / 1000;
+    ts.tv_nsec = ( long )( dwMilliseconds % 1000 ) * 1000000L;
+
+    while ( ( nanosleep( &ts, &ts ) != 0 ) && ( errno == EINTR ) )
+    {
+    }
+}
+
+/* the termios speed of a DCB BaudRate, FALSE when the platform has none */
+BOOL SerialBaudToSpeed( DWORD dwBaud, speed_t *pSpeed );
+
+#endif // SERIAL_PORT_POSIX_H
@@ -0,0 +1,649 @@
+/*
+**  FILENAME            SerialPortReactor.cpp
+**
+**  PURPOSE             Services the I/O of many open CSerialPort objects from one
+**                      epoll loop, or from a small fixed pool of them.
+**
+**  CREATION DATE       16-10-2026
+**  LAST MODIFICATION   16-10-2026
+*/
+
+#ifdef _WIN32
+#include "stdafx.h"
+#endif
+#include "SerialPortReactor.h"
+
+#ifdef SERIAL_PORT_REACTOR
+
+#include <assert.h>
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+#include <algorithm>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+
+static void EraseValue( std::vector<CSerialPort *> &Ports, CSerialPort *pPort )
+{
+    Ports.erase( std::remove( Ports.begin(), Ports.end(), pPort ), Ports.end() );
+}
+
+CSerialPortReactor::CSerialPortReactor()
+{
+    m_nBudget = SERIAL_REACTOR_BUDGET;
+    SerialThreadDefaults( &m_ThreadOptions );
+    m_dwThreadState = 0;
+    m_nLoopsApplied = 0;
+}
+
+CSerialPortReactor::~CSerialPortReactor()
+{
+    Stop();
+}
+
+BOOL CSerialPortReactor::Start( UINT nThreads, UINT nBudget )
+{
+    assert( m_Loops.empty() );
+    assert( ( nThreads > 0 ) && ( nBudget > 0 ) );
+    m_nBudget = nBudget;
+    m_dwThreadState = ~( DWORD )0;
+    m_nLoopsApplied = 0;
+
+    for ( UINT i = 0; i < nThreads; i++ )
+    {
+        struct epoll_event ev;
+        LOOP *pLoop = new LOOP;
+        pLoop->pReactor = this;
+        pLoop->bThreadStarted = FALSE;
+        pLoop->bStop = FALSE;
+        pLoop->bExited = FALSE;
+        pLoop->bApplied = FALSE;
+        pLoop->pszRefused = NULL;
+        pLoop->nRefusedError = 0;
+        pLoop->pBatch = NULL;
+        pLoop->nBatch = 0;
+        pLoop->nEpoll = epoll_create1( EPOLL_CLOEXEC );
+        pLoop->nEvent = eventfd( 0, EFD_NONBLOCK | EFD_CLOEXEC );
+        pLoop->nTimer = timerfd_create( CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC );
+        pLoop->qwTimerArmed = 0;
+        pLoop->qwProbeNext = 0;
+        m_Loops.push_back( pLoop );
+
+        if ( ( pLoop->nEpoll < 0 ) || ( pLoop->nEvent < 0 ) || ( pLoop->nTimer < 0 ) )
+        {
+            Stop();
+            return FALSE;
+        }
+
+        // the eventfd and the timerfd are told apart from the ports by their data pointer
+        memset( &ev, 0, sizeof( ev ) );
+        ev.events = EPOLLIN;
+        ev.data.ptr = pLoop;
+
+        if ( epoll_ctl( pLoop->nEpoll, EPOLL_CTL_ADD, pLoop->nEvent, &ev ) != 0 )
+        {
+            Stop();
+            return FALSE;
+        }
+
+        ev.data.ptr = &pLoop->nTimer;
+
+        if ( ( epoll_ctl( pLoop->nEpoll, EPOLL_CTL_ADD, pLoop->nTimer, &ev ) != 0 ) ||
+             ( pthread_create( &pLoop->Thread, NULL, LoopThread, pLoop ) != 0 ) )
+        {
+            Stop();
+            return FALSE;
+        }
+
+        pLoop->bThreadStarted = TRUE;
+    }
+
+    return TRUE;
+}
+
+void CSerialPortReactor::Stop()
+{
+    for ( size_t i = 0; i < m_Loops.size(); i++ )
+    {
+        LOOP *pLoop = m_Loops[i];
+
+        if ( pLoop->bThreadStarted )
+        {
+            pLoop->bStop = TRUE;
+            Signal( pLoop );
+            pthread_join( pLoop->Thread, NULL );
+        }
+
+        assert( pLoop->Ports.empty() );
+
+        if ( pLoop->nEvent >= 0 )
+        {
+            close( pLoop->nEvent );
+        }
+
+        if ( pLoop->nTimer >= 0 )
+        {
+            close( pLoop->nTimer );
+        }
+
+        if ( pLoop->nEpoll >= 0 )
+        {
+            close( pLoop->nEpoll );
+        }
+
+        delete pLoop;
+    }
+
+    m_Loops.clear();
+}
+
+BOOL CSerialPortReactor::IsRunning()
+{
+    return !m_Loops.empty();
+}
+
+UINT CSerialPortReactor::GetPortCount()
+{
+    UINT nCount = 0;
+
+    for ( size_t i = 0; i < m_Loops.size(); i++ )
+    {
+        std::lock_guard<std::mutex> Lock( m_Loops[i]->Lock );
+        nCount += ( UINT )m_Loops[i]->Ports.size();
+    }
+
+    return nCount;
+}
+
+void CSerialPortReactor::SetThreadOptions( const SERIAL_THREAD_OPTIONS *pOptions )
+{
+    assert( m_Loops.empty() );
+    m_ThreadOptions = *pOptions;
+}
+
+DWORD CSerialPortReactor::GetThreadState()
+{
+    // nothing until every loop has started
+    if ( m_Loops.empty() || ( m_nLoopsApplied.load() < m_Loops.size() ) )
+    {
+        return 0;
+    }
+
+    return m_dwThreadState.load();
+}
+
+void CSerialPortReactor::GetWakeupJitter( SERIAL_HISTOGRAM *pHistogram, BOOL bReset )
+{
+    m_Wakeup.Snapshot( pHistogram, bReset );
+}
+
+BOOL CSerialPortReactor::Attach( CSerialPort *pPort )
+{
+    struct epoll_event ev;
+    UINT nLoop = 0;
+    size_t nLeast = ( size_t ) -1;
+
+    if ( m_Loops.empty() )
+    {
+        errno = ENXIO;
+        return FALSE;
+    }
+
+    // the least loaded loop which still runs takes the port
+    for ( size_t i = 0; i < m_Loops.size(); i++ )
+    {
+        std::lock_guard<std::mutex> Lock( m_Loops[i]->Lock );
+
+        if ( !m_Loops[i]->bExited && ( m_Loops[i]->Ports.size() < nLeast ) )
+        {
+            nLeast = m_Loops[i]->Ports.size();
+            nLoop = ( UINT )i;
+        }
+    }
+
+    LOOP *pLoop = m_Loops[nLoop];
+    std::unique_lock<std::mutex> Lock( pLoop->Lock );
+    const char *pszRefused;
+    int nRefusedError;
+
+    if ( pLoop->bExited )
+    {
+        errno = ENXIO;
+        return FALSE;
+    }
+
+    memset( &ev, 0, sizeof( ev ) );
+    ev.events = EPOLLIN;
+    ev.data.ptr = pPort;
+
+    if ( epoll_ctl( pLoop->nEpoll, EPOLL_CTL_ADD, pPort->m_hComm, &ev ) != 0 )
+    {
+        return FALSE;
+    }
+
+    pPort->m_nReactorLoop = nLoop;
+    pPort->m_bReactorPollOut = FALSE;
+    pPort->m_bReactorWoken = TRUE;
+    pLoop->Ports.push_back( pPort );
+    // pick up anything queued before the port was attached
+    pLoop->Woken.push_back( pPort );
+    Signal( pLoop );
+
+    // a thread option the loop was refused is queued to every port it serves, those
+    // attached before it was tried learn it from the loop
+    pszRefused = pLoop->bApplied ? pLoop->pszRefused : NULL;
+    nRefusedError = pLoop->nRefusedError;
+    Lock.unlock();
+
+    if ( pszRefused != NULL )
+    {
+        errno = nRefusedError;
+        pPort->ProcessErrorMessage( pszRefused );
+    }
+
+    return TRUE;
+}
+
+void CSerialPortReactor::Detach( CSerialPort *pPort )
+{
+    LOOP *pLoop = m_Loops[pPort->m_nReactorLoop];
+    std::unique_lock<std::mutex> Lock( pLoop->Lock );
+
+    if ( pthread_equal( pthread_self(), pLoop->Thread ) )
+    {
+        // closed from a callback running on the loop
+        Remove( pLoop, pPort );
+        return;
+    }
+
+    // a loop which ended has let go of the port already
+    if ( pLoop->bExited )
+    {
+        return;
+    }
+
+    pLoop->Detaching.push_back( pPort );
+    Signal( pLoop );
+    pLoop->cvDetached.wait( Lock, [pLoop, pPort]()
+    {
+        return std::find( pLoop->Detaching.begin(), pLoop->Detaching.end(), pPort ) == pLoop->Detaching.end();
+    } );
+}
+
+void CSerialPortReactor::Wake( CSerialPort *pPort )
+{
+    LOOP *pLoop = m_Loops[pPort->m_nReactorLoop];
+    std::lock_guard<std::mutex> Lock( pLoop->Lock );
+
+    if ( !pPort->m_bReactorWoken )
+    {
+        pPort->m_bReactorWoken = TRUE;
+        pLoop->Woken.push_back( pPort );
+        Signal( pLoop );
+    }
+}
+
+void CSerialPortReactor::Signal( LOOP *pLoop )
+{
+    uint64_t qwOne = 1;
+
+    // a full counter already has a wakeup pending
+    ( void )write( pLoop->nEvent, &qwOne, sizeof( qwOne ) );
+}
+
+void CSerialPortReactor::UpdateInterest( LOOP *pLoop, CSerialPort *pPort )
+{
+    BOOL bPollOut = pPort->IsTxPending();
+
+    if ( bPollOut != pPort->m_bReactorPollOut )
+    {
+        struct epoll_event ev;
+        memset( &ev, 0, sizeof( ev ) );
+        ev.events = bPollOut ? ( EPOLLIN | EPOLLOUT ) : EPOLLIN;
+        ev.data.ptr = pPort;
+
+        if ( epoll_ctl( pLoop->nEpoll, EPOLL_CTL_MOD, pPort->m_hComm, &ev ) == 0 )
+        {
+            pPort->m_bReactorPollOut = bPollOut;
+        }
+    }
+}
+
+void CSerialPortReactor::Remove( LOOP *pLoop, CSerialPort *pPort )
+{
+    epoll_ctl( pLoop->nEpoll, EPOLL_CTL_DEL, pPort->m_hComm, NULL );
+    EraseValue( pLoop->Ports, pPort );
+    EraseValue( pLoop->Woken, pPort );
+    pPort->m_bReactorWoken = FALSE;
+
+    // events of the current batch must not reach the port any more
+    for ( int i = 0; i < pLoop->nBatch; i++ )
+    {
+        if ( pLoop->pBatch[i].data.ptr == pPort )
+        {
+            pLoop->pBatch[i].data.ptr = NULL;
+        }
+    }
+}
+
+void CSerialPortReactor::Exit( LOOP *pLoop, int nError )
+{
+    std::vector<CSerialPort *> Done;
+
+    // the ports learn why their I/O stopped and their queued requests fail while they are
+    // still attached, i.e. before a Close() waiting for this loop can return; a port closed
+    // by its owner from the report is left alone, one attached meanwhile is taken on the
+    // next pass
+    for ( ;; )
+    {
+        std::unique_lock<std::mutex> Lock( pLoop->Lock );
+        CSerialPort *pPort = NULL;
+
+        for ( size_t i = 0; ( i < pLoop->Ports.size() ) && ( pPort == NULL ); i++ )
+        {
+            if ( std::find( Done.begin(), Done.end(), pLoop->Ports[i] ) == Done.end() )
+            {
+                pPort = pLoop->Ports[i];
+            }
+        }
+
+        if ( pPort == NULL )
+        {
+            // nothing services the ports any more, Detach() must not wait for this loop
+            Done = pLoop->Ports;
+
+            for ( size_t i = 0; i < Done.size(); i++ )
+            {
+                Remove( pLoop, Done[i] );
+                Done[i]->m_bThreadAlive = FALSE;
+            }
+
+            pLoop->Detaching.clear();
+            pLoop->bExited = TRUE;
+            pLoop->cvDetached.notify_all();
+            return;
+        }
+
+        UINT nClose = pPort->m_nCloseCount.load();
+        Done.push_back( pPort );
+        Lock.unlock();
+
+        if ( nError != 0 )
+        {
+            errno = nError;
+            pPort->ProcessErrorMessage( "epoll_wait()" );
+        }
+
+        if ( pPort->m_nCloseCount.load() == nClose )
+        {
+            pPort->m_TxScheduler.Close();
+        }
+    }
+}
+
+void *CSerialPortReactor::LoopThread( void *pParam )
+{
+    LOOP *pLoop = ( LOOP * )pParam;
+    CSerialPortReactor *pReactor = pLoop->pReactor;
+    std::vector<CSerialPort *> Ports;
+    const char *pszFailed;
+    DWORD dwGranted = SerialThreadApply( &pReactor->m_ThreadOptions, &pszFailed );
+    int nError = errno;
+
+    {
+        std::lock_guard<std::mutex> Lock( pLoop->Lock );
+        pLoop->bApplied = TRUE;
+        pLoop->pszRefused = pszFailed;
+        pLoop->nRefusedError = nError;
+        Ports = pLoop->Ports;
+    }
+
+    pReactor->m_dwThreadState &= dwGranted;
+    pReactor->m_nLoopsApplied++;
+
+    // Detach() waits for Run(), none of these ports goes away before
+    for ( size_t i = 0; ( pszFailed != NULL ) && ( i < Ports.size() ); i++ )
+    {
+        errno = nError;
+        Ports[i]->ProcessErrorMessage( pszFailed );
+    }
+
+    pReactor->Run( pLoop );
+    return NULL;
+}
+
+void CSerialPortReactor::Run( LOOP *pLoop )
+{
+    struct epoll_event Events[SERIAL_REACTOR_MAX_EVENTS];
+    std::vector<CSerialPort *> Work;
+    std::vector<UINT> WorkClose;            // m_nCloseCount of the ports in Work
+    int nError = 0;
+
+    while ( !pLoop->bStop )
+    {
+        UINT64 qwDeadline = 0;
+        int n;
+
+        // the nearest write timeout of the ports which are transmitting, end of a pause
+        // of the pacer, or end of a receive gap a framer waits for, in nanoseconds
+        {
+            std::lock_guard<std::mutex> Lock( pLoop->Lock );
+
+            for ( size_t i = 0; i < pLoop->Ports.size(); i++ )
+            {
+                UINT64 qwPort = pLoop->Ports[i]->GetRxDeadline();
+                UINT64 qwPace = pLoop->Ports[i]->GetTxPaceDeadline();
+
+                if ( ( qwPace != 0 ) && ( ( qwPort == 0 ) || ( qwPace < qwPort ) ) )
+                {
+                    qwPort = qwPace;
+                }
+
+                if ( pLoop->Ports[i]->m_bReactorPollOut )
+                {
+                    UINT64 qwWrite = pLoop->Ports[i]->GetWriteDeadline() * 1000000;
+
+                    if ( ( qwWrite != 0 ) && ( ( qwPort == 0 ) || ( qwWrite < qwPort ) ) )
+                    {
+                        qwPort = qwWrite;
+                    }
+                }
+
+                if ( ( qwPort != 0 ) && ( ( qwDeadline == 0 ) || ( qwPort < qwDeadline ) ) )
+                {
+                    qwDeadline = qwPort;
+                }
+            }
+        }
+
+        // the ports are only checked for their own deadlines, not for a tick of the probe
+        UINT64 qwTimer = qwDeadline;
+
+        if ( m_ThreadOptions.nProbeUs != 0 )
+        {
+            if ( pLoop->qwProbeNext == 0 )
+            {
+                pLoop->qwProbeNext = SerialMetricsNow() + ( UINT64 )m_ThreadOptions.nProbeUs * 1000;
+            }
+
+            if ( ( qwTimer == 0 ) || ( pLoop->qwProbeNext < qwTimer ) )
+            {
+                qwTimer = pLoop->qwProbeNext;
+            }
+        }
+
+        // an absolute timerfd instead of the millisecond epoll_wait() timeout
+        if ( qwTimer != pLoop->qwTimerArmed )
+        {
+            struct itimerspec its;
+            memset( &its, 0, sizeof( its ) );
+            its.it_value.tv_sec = ( time_t )( qwTimer / 1000000000 );
+            its.it_value.tv_nsec = ( long )( qwTimer % 1000000000 );
+            timerfd_settime( pLoop->nTimer, TFD_TIMER_ABSTIME, &its, NULL );
+            pLoop->qwTimerArmed = qwTimer;
+        }
+
+        n = epoll_wait( pLoop->nEpoll, Events, SERIAL_REACTOR_MAX_EVENTS, -1 );
+        UINT64 qwWoken = SerialMetricsNow();
+
+        if ( n < 0 )
+        {
+            if ( errno == EINTR )
+            {
+                continue;
+            }
+
+            nError = errno;
+            break;
+        }
+
+        // level triggered and a budget per port, so every ready port gets its turn
+        pLoop->pBatch = Events;
+        pLoop->nBatch = n;
+
+        for ( int i = 0; i < n; i++ )
+        {
+            CSerialPort *pPort = ( CSerialPort * )Events[i].data.ptr;
+            short revents = 0;
+
+            if ( Events[i].data.ptr == pLoop )
+            {
+                uint64_t qwCount;
+                ( void )read( pLoop->nEvent, &qwCount, sizeof( qwCount ) );
+                continue;
+            }
+
+            if ( Events[i].data.ptr == &pLoop->nTimer )
+            {
+                // expired, armed again on the next turn even for the same deadline
+                uint64_t qwCount;
+                ( void )read( pLoop->nTimer, &qwCount, sizeof( qwCount ) );
+                m_Wakeup.Record( ( qwWoken > pLoop->qwTimerArmed ) ? qwWoken - pLoop->qwTimerArmed : 0 );
+
+                if ( ( pLoop->qwProbeNext != 0 ) && ( qwWoken >= pLoop->qwProbeNext ) )
+                {
+                    // the next tick of the grid, missed ones are not made up
+                    UINT64 qwPeriod = ( UINT64 )m_ThreadOptions.nProbeUs * 1000;
+                    pLoop->qwProbeNext += ( ( qwWoken - pLoop->qwProbeNext ) / qwPeriod + 1 ) * qwPeriod;
+                }
+
+                pLoop->qwTimerArmed = 0;
+                continue;
+            }
+
+            if ( pPort == NULL )
+            {
+                continue;
+            }
+
+            revents |= ( Events[i].events & EPOLLIN ) ? POLLIN : 0;
+            revents |= ( Events[i].events & EPOLLOUT ) ? POLLOUT : 0;
+            revents |= ( Events[i].events & EPOLLERR ) ? POLLERR : 0;
+            revents |= ( Events[i].events & EPOLLHUP ) ? POLLHUP : 0;
+
+            // a port closed by one of its callbacks was removed already and is left alone
+            UINT nClose = pPort->m_nCloseCount.load();
+
+            if ( !pPort->ServiceIo( revents, m_nBudget ) )
+            {
+                if ( pPort->m_nCloseCount.load() != nClose )
+                {
+                    continue;
+                }
+
+                {
+                    std::lock_guard<std::mutex> Lock( pLoop->Lock );
+                    Remove( pLoop, pPort );
+                    pPort->m_bThreadAlive = FALSE;
+                }
+
+                // outside the lock, the completions may queue or close; a Close() from
+                // another thread waits for this turn, so the port is still there
+                pPort->m_TxScheduler.Close();
+                continue;
+            }
+
+            if ( pPort->m_nCloseCount.load() == nClose )
+            {
+                UpdateInterest( pLoop, pPort );
+            }
+        }
+
+        pLoop->pBatch = NULL;
+        pLoop->nBatch = 0;
+
+        // transmit requests queued since the last turn
+        {
+            std::lock_guard<std::mutex> Lock( pLoop->Lock );
+            Work.swap( pLoop->Woken );
+
+            for ( size_t i = 0; i < Work.size(); i++ )
+            {
+                Work[i]->m_bReactorWoken = FALSE;
+                UpdateInterest( pLoop, Work[i] );
+            }
+
+            Work.clear();
+
+            if ( qwDeadline != 0 )
+            {
+                Work = pLoop->Ports;
+                WorkClose.resize( Work.size() );
+
+                for ( size_t i = 0; i < Work.size(); i++ )
+                {
+                    WorkClose[i] = Work[i]->m_nCloseCount.load();
+                }
+            }
+        }
+
+        // write timeouts, paced ports and receive gaps, outside the lock as they complete
+        // requests and deliver frames; only this thread removes ports, so the copied list stays
+        // valid, a port closed by a callback of this turn is skipped
+        if ( !Work.empty() )
+        {
+            UINT64 qwNow = SerialMetricsNow();
+
+            for ( size_t i = 0; i < Work.size(); i++ )
+            {
+                if ( Work[i]->m_bReactorPollOut && ( Work[i]->m_nCloseCount.load() == WorkClose[i] ) )
+                {
+                    Work[i]->CheckWriteTimeout( qwNow / 1000000 );
+                }
+
+                if ( Work[i]->m_nCloseCount.load() == WorkClose[i] )
+                {
+                    Work[i]->CheckRxIdle( qwNow );
+                }
+
+                if ( Work[i]->m_nCloseCount.load() == WorkClose[i] )
+                {
+                    UpdateInterest( pLoop, Work[i] );
+                }
+            }
+
+            Work.clear();
+        }
+
+        // ports being closed
+        {
+            std::lock_guard<std::mutex> Lock( pLoop->Lock );
+
+            if ( !pLoop->Detaching.empty() )
+            {
+                for ( size_t i = 0; i < pLoop->Detaching.size(); i++ )
+                {
+                    Remove( pLoop, pLoop->Detaching[i] );
+                }
+
+                pLoop->Detaching.clear();
+                pLoop->cvDetached.notify_all();
+            }
+        }
+    }
+
+    Exit( pLoop, nError );
+}
+
+#endif // SERIAL_PORT_REACTOR
@@ -0,0 +1,101 @@
+/*
+**  FILENAME            SerialPortReactor.h
+**
+**  PURPOSE             Services the I/O of many open CSerialPort objects from one
+**                      epoll loop, or from a small fixed pool of them, instead of
+**                      one thread per port.
+**
+**  CREATION DATE       16-10-2026
+**  LAST MODIFICATION   16-10-2026
+*/
+
+#ifndef SERIAL_PORT_REACTOR_H
+#define SERIAL_PORT_REACTOR_H
+
+#include "SerialPort.h"
+
+#ifdef SERIAL_PORT_REACTOR
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+
+#define SERIAL_REACTOR_BUDGET       4096UL                  /* bytes per port and direction per turn */
+#define SERIAL_REACTOR_MAX_EVENTS   64
+
+class CSerialPort;
+
+class CSerialPortReactor
+{
+    public:
+        CSerialPortReactor();
+        ~CSerialPortReactor();
+
+        BOOL                Start( UINT nThreads = 1, UINT nBudget = SERIAL_REACTOR_BUDGET );
+        void                Stop();                 // close the ports first
+        BOOL                IsRunning();
+        UINT                GetPortCount();
+
+        /*
+        ** Affinity, realtime policy and locked stacks of the loops, see SerialThread.h; call
+        ** before Start(). The jitter probe of the options records into GetWakeupJitter().
+        */
+        void                SetThreadOptions( const SERIAL_THREAD_OPTIONS *pOptions );
+        DWORD               GetThreadState();       // the SERIAL_THREAD_ flags granted to every loop
+        // timed wakeups of the loops, from the deadline until the loop ran
+        void                GetWakeupJitter( SERIAL_HISTOGRAM *pHistogram, BOOL bReset = FALSE );
+
+    protected:
+        friend class CSerialPort;
+
+        BOOL                Attach( CSerialPort *pPort );
+        void                Detach( CSerialPort *pPort );
+        void                Wake( CSerialPort *pPort );
+
+    private:
+        struct LOOP
+        {
+            CSerialPortReactor          *pReactor;
+            int                         nEpoll;
+            int                         nEvent;     // eventfd, wakes epoll_wait()
+            int                         nTimer;     // timerfd, write timeouts and receive gaps
+            UINT64                      qwTimerArmed;
+            UINT64                      qwProbeNext;
+            pthread_t                   Thread;
+            BOOL                        bThreadStarted;
+            volatile BOOL               bStop;
+            BOOL                        bExited;    // under Lock, the loop let go of its ports
+            BOOL                        bApplied;   // under Lock, the thread options were tried
+            const char                  *pszRefused;    // under Lock, the call of the first option refused
+            int                         nRefusedError;
+            std::mutex                  Lock;
+            std::condition_variable     cvDetached;
+            std::vector<CSerialPort *>  Ports;      // attached, modified under Lock
+            std::vector<CSerialPort *>  Woken;      // transmit data queued
+            std::vector<CSerialPort *>  Detaching;
+            struct epoll_event          *pBatch;    // events being dispatched
+            int                         nBatch;
+        };
+
+        CSerialPortReactor( const CSerialPortReactor & );
+        CSerialPortReactor  &operator=( const CSerialPortReactor & );
+
+        static void         *LoopThread( void *pParam );
+        void                Run( LOOP *pLoop );
+        void                Signal( LOOP *pLoop );
+        void                UpdateInterest( LOOP *pLoop, CSerialPort *pPort );
+        void                Remove( LOOP *pLoop, CSerialPort *pPort );
+        void                Exit( LOOP *pLoop, int nError );
+
+        std::vector<LOOP *> m_Loops;
+        UINT                m_nBudget;
+        SERIAL_THREAD_OPTIONS m_ThreadOptions;
+        std::atomic<DWORD>  m_dwThreadState;
+        std::atomic<UINT>   m_nLoopsApplied;
+        CSerialHistogram    m_Wakeup;
+};
+
+#endif // SERIAL_PORT_REACTOR
+
+#endif // SERIAL_PORT_REACTOR_H
@@ -0,0 +1,160 @@
+/*
+**  FILENAME            SerialRingBuffer.cpp
+**
+**  PURPOSE             Lock-free single-producer/single-consumer byte ring buffer.
+**
+**  CREATION DATE       16-10-2026
+**  LAST MODIFICATION   16-10-2026
+*/
+
+#ifdef _WIN32
+#include "stdafx.h"
+#endif
+#include "SerialRingBuffer.h"
+#include "SerialThread.h"
+#include <assert.h>
+#include <string.h>
+
+CSerialRingBuffer::CSerialRingBuffer()
+{
+    m_pBuffer = NULL;
+    m_nSize = 0;
+    m_nMask = 0;
+    m_bLocked = FALSE;
+    m_nHead.store( 0, std::memory_order_relaxed );
+    m_nTail.store( 0, std::memory_order_relaxed );
+}
+
+CSerialRingBuffer::~CSerialRingBuffer()
+{
+    Destroy();
+}
+
+BOOL CSerialRingBuffer::Create( UINT nSize )
+{
+    UINT nCapacity = 1;
+    Destroy();
+
+    while ( ( nCapacity < nSize ) && ( nCapacity < 0x80000000U ) )
+    {
+        nCapacity <<= 1;
+    }
+
+    m_pBuffer = new BYTE[nCapacity];
+
+    if ( m_pBuffer == NULL )
+    {
+        return FALSE;
+    }
+
+    m_nSize = nCapacity;
+    m_nMask = nCapacity - 1;
+    Reset();
+    return TRUE;
+}
+
+void CSerialRingBuffer::Destroy()
+{
+    if ( m_pBuffer != NULL )
+    {
+        if ( m_bLocked )
+        {
+            SerialUnlockMemory( m_pBuffer, m_nSize );
+            m_bLocked = FALSE;
+        }
+
+        delete [] m_pBuffer;
+        m_pBuffer = NULL;
+    }
+
+    m_nSize = 0;
+    m_nMask = 0;
+    Reset();
+}
+
+void CSerialRingBuffer::Reset()
+{
+    m_nHead.store( 0, std::memory_order_relaxed );
+    m_nTail.store( 0, std::memory_order_release );
+}
+
+BOOL CSerialRingBuffer::LockMemory()
+{
+    if ( !m_bLocked && ( m_pBuffer != NULL ) )
+    {
+        m_bLocked = SerialLockMemory( m_pBuffer, m_nSize );
+    }
+
+    return m_bLocked;
+}
+
+UINT CSerialRingBuffer::GetWriteSpan( BYTE **ppData )
+{
+    size_t nHead = m_nHead.load( std::memory_order_relaxed );
+    size_t nTail = m_nTail.load( std::memory_order_acquire );
+    UINT nFree = m_nSize - ( UINT )( nHead - nTail );
+    UINT nOffset = ( UINT )nHead & m_nMask;
+    UINT nSpan = m_nSize - nOffset;
+    *ppData = m_pBuffer + nOffset;
+    return ( nSpan < nFree ) ? nSpan : nFree;
+}
+
+void CSerialRingBuffer::CommitWrite( UINT nSize )
+{
+    size_t nHead = m_nHead.load( std::memory_order_relaxed );
+    assert( nSize <= m_nSize - ( UINT )( nHead - m_nTail.load( std::memory_order_relaxed ) ) );
+    m_nHead.store( nHead + nSize, std::memory_order_release );
+}
+
+UINT CSerialRingBuffer::GetReadSpan( const BYTE **ppData )
+{
+    size_t nTail = m_nTail.load( std::memory_order_relaxed );
+    size_t nHead = m_nHead.load( std::memory_order_acquire );
+    UINT nCount = ( UINT )( nHead - nTail );
+    UINT nOffset = ( UINT )nTail & m_nMask;
+    UINT nSpan = m_nSize - nOffset;
+    *ppData = m_pBuffer + nOffset;
+    return ( nSpan < nCount ) ? nSpan : nCount;
+}
+
+void CSerialRingBuffer::CommitRead( UINT nSize )
+{
+    size_t nTail = m_nTail.load( std::memory_order_relaxed );
+    assert( nSize <= ( UINT )( m_nHead.load( std::memory_order_relaxed ) - nTail ) );
+    m_nTail.store( nTail + nSize, std::memory_order_release );
+}
+
+UINT CSerialRingBuffer::Read( void *pBuffer, UINT nSize )
+{
+    UINT nTotal = 0;
+
+    // at most two spans, the second one starts at the beginning of the buffer
+    while ( nTotal < nSize )
+    {
+        const BYTE *pData;
+        UINT nSpan = GetReadSpan( &pData );
+
+        if ( nSpan == 0 )
+        {
+            break;
+        }
+
+        if ( nSpan > nSize - nTotal )
+        {
+            nSpan = nSize - nTotal;
+        }
+
+        memcpy( ( BYTE * )pBuffer + nTotal, pData, nSpan );
+        CommitRead( nSpan );
+        nTotal += nSpan;
+    }
+
+    return nTotal;
+}
+
+UINT CSerialRingBuffer::GetCount() const
+{
+    size_t nTail = m_nTail.load( std::memory_order_acquire );
+    size_t nHead = m_nHead.load( std::memory_order_acquire );
+    return ( UINT )( nHead - nTail );
+}
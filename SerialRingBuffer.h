@@ -0,0 +1,60 @@
+/*
+**  FILENAME            SerialRingBuffer.h
+**
+**  PURPOSE             Lock-free single-producer/single-consumer byte ring buffer.
+**                      The I/O thread reads from the device straight into the free
+**                      span, the consumer drains contiguous spans without copying.
+**
+**  CREATION DATE       16-10-2026
+**  LAST MODIFICATION   16-10-2026
+*/
+
+#ifndef SERIAL_RING_BUFFER_H
+#define SERIAL_RING_BUFFER_H
+
+#ifndef _WIN32
+#include "SerialPortPosix.h"
+#endif
+#include <atomic>
+#include <stddef.h>
+
+class CSerialRingBuffer
+{
+    public:
+        CSerialRingBuffer();
+        ~CSerialRingBuffer();
+
+        BOOL                Create( UINT nSize );   // rounded up to a power of two
+        void                Destroy();
+        void                Reset();                // neither side may be active
+        BOOL                LockMemory();           // resident until Destroy()
+
+        // producer side
+        UINT                GetWriteSpan( BYTE **ppData );
+        void                CommitWrite( UINT nSize );
+
+        // consumer side
+        UINT                GetReadSpan( const BYTE **ppData );
+        void                CommitRead( UINT nSize );
+        UINT                Read( void *pBuffer, UINT nSize );
+
+        UINT                GetCount() const;
+        UINT                GetCapacity() const
+        {
+            return m_nSize;
+        }
+
+    private:
+        CSerialRingBuffer( const CSerialRingBuffer & );
+        CSerialRingBuffer   &operator=( const CSerialRingBuffer & );
+
+        BYTE                *m_pBuffer;
+        UINT                m_nSize;
+        UINT                m_nMask;
+        BOOL                m_bLocked;
+        // free running indices, on separate cache lines for producer and consumer
+        alignas( 64 ) std::atomic<size_t> m_nHead;  // written by the producer
+        alignas( 64 ) std::atomic<size_t> m_nTail;  // written by the consumer
+};
+
+#endif // SERIAL_RING_BUFFER_H
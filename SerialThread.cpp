@@ -0,0 +1,179 @@
+/*
+**  FILENAME            SerialThread.cpp
+**
+**  PURPOSE             Scheduling of the I/O threads: CPU affinity, a realtime
+**                      policy and locked memory.
+**
+**  CREATION DATE       16-10-2026
+**  LAST MODIFICATION   16-10-2026
+*/
+
+#ifdef _WIN32
+#include "stdafx.h"
+#endif
+#include "SerialThread.h"
+#include <string.h>
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#endif
+
+void SerialThreadDefaults( SERIAL_THREAD_OPTIONS *pOptions )
+{
+    memset( pOptions, 0, sizeof( *pOptions ) );
+    pOptions->Policy = SERIAL_THREAD_NORMAL;
+}
+
+BOOL SerialLockMemory( const void *pData, size_t nSize )
+{
+#ifdef _WIN32
+    return VirtualLock( ( LPVOID )pData, nSize );
+#else
+    return mlock( pData, nSize ) == 0;
+#endif
+}
+
+void SerialUnlockMemory( const void *pData, size_t nSize )
+{
+#ifdef _WIN32
+    VirtualUnlock( ( LPVOID )pData, nSize );
+#else
+    munlock( pData, nSize );
+#endif
+}
+
+/*
+** The pages a wakeup runs on are faulted in and locked now, not on the first deep
+** call after a long idle time. They stay locked after the frame is gone.
+*/
+static BOOL LockStack()
+{
+    volatile BYTE Stack[SERIAL_THREAD_STACK_LOCK];
+
+    memset( ( void * )Stack, 0, sizeof( Stack ) );
+    return SerialLockMemory( ( const void * )Stack, sizeof( Stack ) );
+}
+
+DWORD SerialThreadApply( const SERIAL_THREAD_OPTIONS *pOptions, const char **ppszFailed )
+{
+    DWORD dwGranted = 0;
+    const char *pszFailed = NULL;
+#ifdef _WIN32
+    DWORD dwError = 0;
+#else
+    int nError = 0;
+#endif
+
+#ifdef _WIN32
+    if ( pOptions->qwCpuMask != 0 )
+    {
+        if ( SetThreadAffinityMask( GetCurrentThread(), ( DWORD_PTR )pOptions->qwCpuMask ) != 0 )
+        {
+            dwGranted |= SERIAL_THREAD_PINNED;
+        }
+        else if ( pszFailed == NULL )
+        {
+            pszFailed = "SetThreadAffinityMask()";
+            dwError = GetLastError();
+        }
+    }
+
+    // no fixed priority policies, the highest level of the priority class instead
+    if ( pOptions->Policy != SERIAL_THREAD_NORMAL )
+    {
+        if ( SetThreadPriority( GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL ) )
+        {
+            dwGranted |= SERIAL_THREAD_REALTIME;
+        }
+        else if ( pszFailed == NULL )
+        {
+            pszFailed = "SetThreadPriority()";
+            dwError = GetLastError();
+        }
+    }
+#else
+#ifdef __linux__
+    if ( pOptions->qwCpuMask != 0 )
+    {
+        cpu_set_t Set;
+        CPU_ZERO( &Set );
+
+        for ( UINT i = 0; i < 64; i++ )
+        {
+            if ( pOptions->qwCpuMask & ( 1ULL << i ) )
+            {
+                CPU_SET( i, &Set );
+            }
+        }
+
+        // returns the error instead of setting errno
+        int nResult = pthread_setaffinity_np( pthread_self(), sizeof( Set ), &Set );
+
+        if ( nResult == 0 )
+        {
+            dwGranted |= SERIAL_THREAD_PINNED;
+        }
+        else if ( pszFailed == NULL )
+        {
+            pszFailed = "pthread_setaffinity_np()";
+            nError = nResult;
+        }
+    }
+#else
+    if ( ( pOptions->qwCpuMask != 0 ) && ( pszFailed == NULL ) )
+    {
+        pszFailed = "pthread_setaffinity_np()";
+        nError = ENOTSUP;
+    }
+#endif
+
+    if ( pOptions->Policy != SERIAL_THREAD_NORMAL )
+    {
+        struct sched_param Param;
+        int nPolicy = ( pOptions->Policy == SERIAL_THREAD_RR ) ? SCHED_RR : SCHED_FIFO;
+        memset( &Param, 0, sizeof( Param ) );
+        Param.sched_priority = pOptions->nPriority;
+
+        int nResult = pthread_setschedparam( pthread_self(), nPolicy, &Param );
+
+        if ( nResult == 0 )
+        {
+            dwGranted |= SERIAL_THREAD_REALTIME;
+        }
+        else if ( pszFailed == NULL )
+        {
+            pszFailed = "pthread_setschedparam()";
+            nError = nResult;
+        }
+    }
+#endif
+
+    if ( pOptions->bLockMemory )
+    {
+        if ( LockStack() )
+        {
+            dwGranted |= SERIAL_THREAD_LOCKED;
+        }
+        else if ( pszFailed == NULL )
+        {
+            pszFailed = "mlock()";
+#ifdef _WIN32
+            dwError = GetLastError();
+#else
+            nError = errno;
+#endif
+        }
+    }
+
+    if ( ppszFailed != NULL )
+    {
+        *ppszFailed = pszFailed;
+    }
+
+#ifdef _WIN32
+    SetLastError( dwError );
+#else
+    errno = nError;
+#endif
+    return dwGranted;
+}
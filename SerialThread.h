@@ -0,0 +1,56 @@
+/*
+**  FILENAME            SerialThread.h
+**
+**  PURPOSE             Scheduling of the I/O threads for control loops: CPU
+**                      affinity, a realtime policy and locked memory, applied by
+**                      the thread to itself when it starts.
+**
+**  CREATION DATE       16-10-2026
+**  LAST MODIFICATION   16-10-2026
+*/
+
+#ifndef SERIAL_THREAD_H
+#define SERIAL_THREAD_H
+
+#ifndef _WIN32
+#include "SerialPortPosix.h"
+#endif
+#include <stddef.h>
+
+#define SERIAL_THREAD_STACK_LOCK    65536UL                 /* stack bytes touched and locked with bLockMemory */
+
+typedef enum _SERIAL_THREAD_POLICY
+{
+    SERIAL_THREAD_NORMAL,                       // left as created
+    SERIAL_THREAD_FIFO,                         // SCHED_FIFO, THREAD_PRIORITY_TIME_CRITICAL on Win32
+    SERIAL_THREAD_RR                            // SCHED_RR, the same as FIFO on Win32
+} SERIAL_THREAD_POLICY;
+
+// what the system granted, see GetThreadState()
+#define SERIAL_THREAD_PINNED        0x0001
+#define SERIAL_THREAD_REALTIME      0x0002
+#define SERIAL_THREAD_LOCKED        0x0004
+
+typedef struct _SERIAL_THREAD_OPTIONS
+{
+    UINT64              qwCpuMask;              // bit n runs the thread on CPU n, 0 leaves the affinity alone
+    SERIAL_THREAD_POLICY Policy;
+    int                 nPriority;              // of SCHED_FIFO and SCHED_RR, 1 to 99 on Linux
+    BOOL                bLockMemory;            // the receive buffer, the buffer pool and the stack of the thread
+    UINT                nProbeUs;               // jitter probe, a timed wakeup every nProbeUs; 0 is off
+} SERIAL_THREAD_OPTIONS;
+
+void        SerialThreadDefaults( SERIAL_THREAD_OPTIONS *pOptions );
+
+/*
+** Applies the options to the calling thread. Every step is tried, the flags of those
+** which were granted are returned; *ppszFailed names the call of the first refused
+** one, its error is left in errno (GetLastError() on Win32).
+*/
+DWORD       SerialThreadApply( const SERIAL_THREAD_OPTIONS *pOptions, const char **ppszFailed );
+
+// mlock() / VirtualLock(), the pages stay resident until unlocked or freed
+BOOL        SerialLockMemory( const void *pData, size_t nSize );
+void        SerialUnlockMemory( const void *pData, size_t nSize );
+
+#endif // SERIAL_THREAD_H
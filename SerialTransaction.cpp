@@ -0,0 +1,387 @@
+/*
+**  FILENAME            SerialTransaction.cpp
+**
+**  PURPOSE             Request/response transactions over a port.
+**
+**  CREATION DATE       16-10-2026
+**  LAST MODIFICATION   16-10-2026
+*/
+
+#ifdef _WIN32
+#include "stdafx.h"
+#endif
+#include "SerialTransaction.h"
+#include <assert.h>
+#include <string.h>
+
+CSerialTransactor::CSerialTransactor( UINT nCapacity )
+{
+    assert( nCapacity > 0 );
+    m_pPort = NULL;
+    m_pFramer = NULL;
+    m_pfnKey = NULL;
+    m_pKeyContext = NULL;
+
+    m_Transactions.resize( nCapacity );
+    m_pFree = NULL;
+
+    for ( UINT i = nCapacity; i-- > 0; )
+    {
+        m_Transactions[i].State = STATE_FREE;
+        m_Transactions[i].pRequest = NULL;
+        m_Transactions[i].pNext = m_pFree;
+        m_pFree = &m_Transactions[i];
+    }
+
+    m_Queued.pHead = m_Queued.pTail = NULL;
+    m_Queued.nCount = 0;
+    m_Outstanding.pHead = m_Outstanding.pTail = NULL;
+    m_Outstanding.nCount = 0;
+    memset( m_pWheel, 0, sizeof( m_pWheel ) );
+    m_qwWheelTick = SerialMetricsNow() / SERIAL_TRANSACTION_TICK_NS;
+    m_qwArmed = 0;
+    m_nWindow = 1;
+
+    m_qwSubmitted = 0;
+    m_qwCompleted = 0;
+    m_qwTimedOut = 0;
+    m_qwFailed = 0;
+    m_qwCancelled = 0;
+    m_qwUnmatched = 0;
+}
+
+CSerialTransactor::~CSerialTransactor()
+{
+    CancelAll();
+
+    if ( m_pPort != NULL )
+    {
+        m_pPort->SetRxNotify( NULL, NULL );
+    }
+}
+
+void CSerialTransactor::Attach( CSerialPort *pPort, CSerialFramer *pFramer )
+{
+    assert( !pPort->IsOpen() );
+    m_pPort = pPort;
+    m_pFramer = pFramer;
+    m_pFramer->SetCallback( OnFrame, this );
+    m_pPort->SetFramer( pFramer );
+    m_pPort->SetRxNotify( OnNotify, this );
+}
+
+void CSerialTransactor::SetKeyExtractor( SERIAL_TRANSACTION_KEY pfnKey, void *pContext )
+{
+    std::lock_guard<std::mutex> Lock( m_Lock );
+    m_pfnKey = pfnKey;
+    m_pKeyContext = pContext;
+}
+
+void CSerialTransactor::SetWindow( UINT nWindow )
+{
+    std::unique_lock<std::mutex> Lock( m_Lock );
+    m_nWindow = ( nWindow > 0 ) ? nWindow : 1;
+    Pump( Lock );
+    Arm();
+}
+
+BOOL CSerialTransactor::Submit( const void *pRequest, UINT nSize, UINT64 qwKey, DWORD dwTimeoutMs,
+                                SERIAL_TRANSACTION_CALLBACK pfnCallback, void *pContext )
+{
+    SERIAL_BUFFER *pBuffer;
+    UINT64 qwTick;
+
+    assert( m_pPort != NULL );
+
+    if ( ( pBuffer = m_pPort->GetBufferPool()->Alloc( nSize ) ) == NULL )
+    {
+        return FALSE;
+    }
+
+    memcpy( pBuffer->pData, pRequest, nSize );
+    std::unique_lock<std::mutex> Lock( m_Lock );
+    TRANSACTION *pTransaction = m_pFree;
+
+    if ( pTransaction == NULL )
+    {
+        Lock.unlock();
+        SerialBufferRelease( pBuffer );
+        return FALSE;
+    }
+
+    m_pFree = pTransaction->pNext;
+    pTransaction->State = STATE_QUEUED;
+    pTransaction->pRequest = pBuffer;
+    pTransaction->qwKey = qwKey;
+    pTransaction->qwDeadline = SerialMetricsNow() + ( UINT64 )dwTimeoutMs * 1000000;
+    pTransaction->qwSentAt = 0;
+    pTransaction->pfnCallback = pfnCallback;
+    pTransaction->pContext = pContext;
+    Append( &m_Queued, pTransaction );
+
+    // the first tick at or after the deadline, never one the wheel has passed already
+    qwTick = ( pTransaction->qwDeadline + SERIAL_TRANSACTION_TICK_NS - 1 ) / SERIAL_TRANSACTION_TICK_NS;
+    qwTick = ( qwTick > m_qwWheelTick ) ? qwTick : m_qwWheelTick + 1;
+    pTransaction->nSlot = ( UINT )( qwTick % SERIAL_TRANSACTION_SLOTS );
+    pTransaction->pWheelPrev = NULL;
+    pTransaction->pWheelNext = m_pWheel[pTransaction->nSlot];
+
+    if ( pTransaction->pWheelNext != NULL )
+    {
+        pTransaction->pWheelNext->pWheelPrev = pTransaction;
+    }
+
+    m_pWheel[pTransaction->nSlot] = pTransaction;
+    m_qwSubmitted++;
+
+    Pump( Lock );
+    Arm();
+    return TRUE;
+}
+
+void CSerialTransactor::CancelAll()
+{
+    std::unique_lock<std::mutex> Lock( m_Lock );
+    TRANSACTION *pTransaction;
+
+    while ( ( ( pTransaction = m_Outstanding.pHead ) != NULL ) || ( ( pTransaction = m_Queued.pHead ) != NULL ) )
+    {
+        m_qwCancelled++;
+        Complete( Lock, pTransaction, SERIAL_TRANSACTION_CANCELLED, NULL, 0, 0 );
+    }
+
+    Arm();
+}
+
+void CSerialTransactor::GetStats( SERIAL_TRANSACTION_STATS *pStats, BOOL bReset )
+{
+    std::lock_guard<std::mutex> Lock( m_Lock );
+
+    pStats->qwSubmitted = m_qwSubmitted;
+    pStats->qwCompleted = m_qwCompleted;
+    pStats->qwTimedOut = m_qwTimedOut;
+    pStats->qwFailed = m_qwFailed;
+    pStats->qwCancelled = m_qwCancelled;
+    pStats->qwUnmatched = m_qwUnmatched;
+    pStats->nQueued = m_Queued.nCount;
+    pStats->nOutstanding = m_Outstanding.nCount;
+    m_Latency.Snapshot( &pStats->Latency, bReset );
+
+    if ( bReset )
+    {
+        m_qwSubmitted = m_qwCompleted = m_qwTimedOut = m_qwFailed = m_qwCancelled = m_qwUnmatched = 0;
+    }
+}
+
+void CSerialTransactor::OnFrame( void *pContext, const BYTE *pFrame, UINT nLength )
+{
+    CSerialTransactor *pThis = ( CSerialTransactor * )pContext;
+    std::unique_lock<std::mutex> Lock( pThis->m_Lock );
+    TRANSACTION *pTransaction = pThis->m_Outstanding.pHead;
+    UINT64 qwKey = 0;
+
+    if ( pThis->m_pfnKey != NULL )
+    {
+        if ( !pThis->m_pfnKey( pThis->m_pKeyContext, pFrame, nLength, &qwKey ) )
+        {
+            pTransaction = NULL;
+        }
+
+        // the oldest with the key, a repeated request is answered in order
+        while ( ( pTransaction != NULL ) && ( pTransaction->qwKey != qwKey ) )
+        {
+            pTransaction = pTransaction->pNext;
+        }
+    }
+
+    if ( pTransaction == NULL )
+    {
+        pThis->m_qwUnmatched++;
+        return;
+    }
+
+    UINT64 qwReceived = pThis->m_pFramer->GetFrameTime();
+    UINT64 qwLatency = ( qwReceived > pTransaction->qwSentAt ) ? qwReceived - pTransaction->qwSentAt : 0;
+
+    pThis->m_qwCompleted++;
+    pThis->m_Latency.Record( qwLatency );
+    pThis->Complete( Lock, pTransaction, SERIAL_TRANSACTION_OK, pFrame, nLength, qwLatency );
+    pThis->Pump( Lock );
+    pThis->Arm();
+}
+
+void CSerialTransactor::OnNotify( void *pContext, UINT64 qwNow )
+{
+    CSerialTransactor *pThis = ( CSerialTransactor * )pContext;
+    std::unique_lock<std::mutex> Lock( pThis->m_Lock );
+    TRANSACTION *pTransaction;
+
+    // the port cleared the deadline before the call
+    pThis->m_qwArmed = 0;
+
+    while ( ( pTransaction = pThis->Expired( qwNow ) ) != NULL )
+    {
+        pThis->m_qwTimedOut++;
+        pThis->Complete( Lock, pTransaction, SERIAL_TRANSACTION_TIMEOUT, NULL, 0, 0 );
+    }
+
+    pThis->Pump( Lock );
+    pThis->Arm();
+}
+
+void CSerialTransactor::Append( LIST *pList, TRANSACTION *pTransaction )
+{
+    pTransaction->pPrev = pList->pTail;
+    pTransaction->pNext = NULL;
+
+    if ( pList->pTail != NULL )
+    {
+        pList->pTail->pNext = pTransaction;
+    }
+    else
+    {
+        pList->pHead = pTransaction;
+    }
+
+    pList->pTail = pTransaction;
+    pList->nCount++;
+}
+
+void CSerialTransactor::Remove( LIST *pList, TRANSACTION *pTransaction )
+{
+    if ( pTransaction->pPrev != NULL )
+    {
+        pTransaction->pPrev->pNext = pTransaction->pNext;
+    }
+    else
+    {
+        pList->pHead = pTransaction->pNext;
+    }
+
+    if ( pTransaction->pNext != NULL )
+    {
+        pTransaction->pNext->pPrev = pTransaction->pPrev;
+    }
+    else
+    {
+        pList->pTail = pTransaction->pPrev;
+    }
+
+    pList->nCount--;
+}
+
+void CSerialTransactor::Unlink( TRANSACTION *pTransaction )
+{
+    assert( pTransaction->State != STATE_FREE );
+    Remove( ( pTransaction->State == STATE_QUEUED ) ? &m_Queued : &m_Outstanding, pTransaction );
+
+    if ( pTransaction->pWheelPrev != NULL )
+    {
+        pTransaction->pWheelPrev->pWheelNext = pTransaction->pWheelNext;
+    }
+    else
+    {
+        m_pWheel[pTransaction->nSlot] = pTransaction->pWheelNext;
+    }
+
+    if ( pTransaction->pWheelNext != NULL )
+    {
+        pTransaction->pWheelNext->pWheelPrev = pTransaction->pWheelPrev;
+    }
+
+    if ( pTransaction->pRequest != NULL )
+    {
+        SerialBufferRelease( pTransaction->pRequest );
+        pTransaction->pRequest = NULL;
+    }
+
+    pTransaction->State = STATE_FREE;
+    pTransaction->pNext = m_pFree;
+    m_pFree = pTransaction;
+}
+
+void CSerialTransactor::Arm()
+{
+    UINT64 qwDeadline = 0;
+
+    // a slot may hold deadlines of later rotations, waking up for them only re-arms
+    for ( UINT64 qwTick = m_qwWheelTick + 1; qwTick <= m_qwWheelTick + SERIAL_TRANSACTION_SLOTS; qwTick++ )
+    {
+        if ( m_pWheel[qwTick % SERIAL_TRANSACTION_SLOTS] != NULL )
+        {
+            qwDeadline = qwTick * SERIAL_TRANSACTION_TICK_NS;
+            break;
+        }
+    }
+
+    if ( ( qwDeadline != m_qwArmed ) && ( m_pPort != NULL ) )
+    {
+        m_qwArmed = qwDeadline;
+        m_pPort->SetRxNotifyDeadline( qwDeadline );
+    }
+}
+
+CSerialTransactor::TRANSACTION *CSerialTransactor::Expired( UINT64 qwNow )
+{
+    UINT64 qwNowTick = qwNow / SERIAL_TRANSACTION_TICK_NS;
+    UINT64 qwTicks = ( qwNowTick > m_qwWheelTick ) ? qwNowTick - m_qwWheelTick : 0;
+
+    // one rotation visits every slot, however long the wheel stood still
+    qwTicks = ( qwTicks < SERIAL_TRANSACTION_SLOTS ) ? qwTicks : SERIAL_TRANSACTION_SLOTS;
+
+    for ( UINT64 i = 1; i <= qwTicks; i++ )
+    {
+        for ( TRANSACTION *p = m_pWheel[( m_qwWheelTick + i ) % SERIAL_TRANSACTION_SLOTS]; p != NULL; p = p->pWheelNext )
+        {
+            if ( p->qwDeadline <= qwNow )
+            {
+                // the slot is looked at again with the next call
+                m_qwWheelTick += i - 1;
+                return p;
+            }
+        }
+    }
+
+    m_qwWheelTick = ( qwNowTick > m_qwWheelTick ) ? qwNowTick : m_qwWheelTick;
+    return NULL;
+}
+
+void CSerialTransactor::Pump( std::unique_lock<std::mutex> &Lock )
+{
+    TRANSACTION *pTransaction;
+
+    // in the order of the outstanding list, the lock is held over the write
+    while ( ( m_Outstanding.nCount < m_nWindow ) && ( ( pTransaction = m_Queued.pHead ) != NULL ) )
+    {
+        if ( !m_pPort->WriteBuffer( pTransaction->pRequest, NULL, NULL, 0 ) )
+        {
+            m_qwFailed++;
+            Complete( Lock, pTransaction, SERIAL_TRANSACTION_FAILED, NULL, 0, 0 );
+            continue;
+        }
+
+        SerialBufferRelease( pTransaction->pRequest );
+        pTransaction->pRequest = NULL;
+        Remove( &m_Queued, pTransaction );
+        pTransaction->State = STATE_OUTSTANDING;
+        pTransaction->qwSentAt = SerialMetricsNow();
+        Append( &m_Outstanding, pTransaction );
+    }
+}
+
+void CSerialTransactor::Complete( std::unique_lock<std::mutex> &Lock, TRANSACTION *pTransaction,
+                                  SERIAL_TRANSACTION_STATUS Status, const BYTE *pReply, UINT nLength, UINT64 qwLatency )
+{
+    SERIAL_TRANSACTION_CALLBACK pfnCallback = pTransaction->pfnCallback;
+    void *pContext = pTransaction->pContext;
+
+    Unlink( pTransaction );
+
+    // the callback may submit the next request
+    if ( pfnCallback != NULL )
+    {
+        Lock.unlock();
+        pfnCallback( pContext, Status, pReply, nLength, qwLatency );
+        Lock.lock();
+    }
+}
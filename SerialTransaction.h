@@ -0,0 +1,163 @@
+/*
+**  FILENAME            SerialTransaction.h
+**
+**  PURPOSE             Request/response transactions over a port: several requests
+**                      are on the wire at once, each reply frame is matched to its
+**                      request by a key the caller extracts, and one timer wheel
+**                      serviced by the I/O thread of the port ends the transactions
+**                      whose reply did not come in time.
+**
+**  CREATION DATE       16-10-2026
+**  LAST MODIFICATION   16-10-2026
+*/
+
+#ifndef SERIAL_TRANSACTION_H
+#define SERIAL_TRANSACTION_H
+
+#include "SerialPort.h"
+#include <mutex>
+#include <vector>
+
+#define SERIAL_TRANSACTION_SLOTS    256                     /* timer wheel, one rotation is 256 ticks */
+#define SERIAL_TRANSACTION_TICK_NS  1000000ULL              /* 1 ms, the resolution of the timeouts */
+
+typedef enum _SERIAL_TRANSACTION_STATUS
+{
+    SERIAL_TRANSACTION_OK,
+    SERIAL_TRANSACTION_TIMEOUT,
+    SERIAL_TRANSACTION_FAILED,                  // the port did not take the request
+    SERIAL_TRANSACTION_CANCELLED
+} SERIAL_TRANSACTION_STATUS;
+
+/*
+** Key of a reply frame, FALSE when the frame carries none; such a frame and one
+** whose key no outstanding request has are counted as unmatched and dropped.
+*/
+typedef BOOL ( *SERIAL_TRANSACTION_KEY )( void *pContext, const BYTE *pFrame, UINT nLength, UINT64 *pqwKey );
+
+/*
+** Called once per transaction, on the I/O thread for replies and timeouts. The
+** reply is only valid until the callback returns. qwLatency is the time from
+** handing the request to the port to the read which completed its reply.
+*/
+typedef void ( *SERIAL_TRANSACTION_CALLBACK )( void *pContext, SERIAL_TRANSACTION_STATUS Status,
+                                                const BYTE *pReply, UINT nLength, UINT64 qwLatency );
+
+typedef struct _SERIAL_TRANSACTION_STATS
+{
+    UINT64              qwSubmitted;
+    UINT64              qwCompleted;            // matched a reply
+    UINT64              qwTimedOut;
+    UINT64              qwFailed;
+    UINT64              qwCancelled;
+    UINT64              qwUnmatched;            // reply frames without an outstanding request
+    UINT                nQueued;                // waiting for room in the window
+    UINT                nOutstanding;           // sent, waiting for their reply
+    SERIAL_HISTOGRAM    Latency;                // of the completed ones
+} SERIAL_TRANSACTION_STATS;
+
+/*
+** Takes over the frame callback of a framer and the receive notification of a
+** port (so it cannot be combined with CSerialCoPort). Requests go out in the
+** order of Submit(), at most the window of them unanswered; without a key
+** extractor each reply belongs to the oldest outstanding request. Close the
+** port before the transactor goes away.
+*/
+class CSerialTransactor
+{
+    public:
+        CSerialTransactor( UINT nCapacity = 256 );
+        ~CSerialTransactor();
+
+        // before Open(), also sets the framer of the port
+        void                Attach( CSerialPort *pPort, CSerialFramer *pFramer );
+        void                SetKeyExtractor( SERIAL_TRANSACTION_KEY pfnKey, void *pContext );
+        // requests on the wire at a time, 1 is stop-and-wait; may be changed at any time
+        void                SetWindow( UINT nWindow );
+
+        /*
+        ** Any thread, also from a transaction callback. The request is copied into a
+        ** buffer of the port's pool. The timeout runs from the call on, queued time
+        ** included. FALSE when nCapacity transactions are pending or there is no buffer.
+        */
+        BOOL                Submit( const void *pRequest, UINT nSize, UINT64 qwKey, DWORD dwTimeoutMs,
+                                    SERIAL_TRANSACTION_CALLBACK pfnCallback, void *pContext );
+        // ends every pending transaction, e.g. before the port is closed
+        void                CancelAll();
+
+        void                GetStats( SERIAL_TRANSACTION_STATS *pStats, BOOL bReset = FALSE );
+
+    private:
+        enum STATE
+        {
+            STATE_FREE,
+            STATE_QUEUED,
+            STATE_OUTSTANDING
+        };
+
+        typedef struct _TRANSACTION
+        {
+            STATE               State;
+            SERIAL_BUFFER       *pRequest;          // until it is sent
+            UINT64              qwKey;
+            UINT64              qwDeadline;
+            UINT64              qwSentAt;
+            UINT                nSlot;              // of the wheel
+            SERIAL_TRANSACTION_CALLBACK pfnCallback;
+            void                *pContext;
+            struct _TRANSACTION *pPrev;             // queued or outstanding list, free list
+            struct _TRANSACTION *pNext;
+            struct _TRANSACTION *pWheelPrev;        // slot of the deadline
+            struct _TRANSACTION *pWheelNext;
+        } TRANSACTION;
+
+        typedef struct _LIST
+        {
+            TRANSACTION         *pHead;
+            TRANSACTION         *pTail;
+            UINT                nCount;
+        } LIST;
+
+        CSerialTransactor( const CSerialTransactor & );
+        CSerialTransactor   &operator=( const CSerialTransactor & );
+
+        static void         OnFrame( void *pContext, const BYTE *pFrame, UINT nLength );
+        static void         OnNotify( void *pContext, UINT64 qwNow );
+
+        // with m_Lock held
+        static void         Append( LIST *pList, TRANSACTION *pTransaction );
+        static void         Remove( LIST *pList, TRANSACTION *pTransaction );
+        void                Unlink( TRANSACTION *pTransaction );    // from its list and the wheel, to the free list
+        void                Arm();                  // port deadline for the next occupied wheel slot
+        TRANSACTION         *Expired( UINT64 qwNow );
+
+        // with m_Lock held, released around the callbacks
+        void                Pump( std::unique_lock<std::mutex> &Lock );     // sends queued requests while the window has room
+        void                Complete( std::unique_lock<std::mutex> &Lock, TRANSACTION *pTransaction,
+                                      SERIAL_TRANSACTION_STATUS Status, const BYTE *pReply, UINT nLength, UINT64 qwLatency );
+
+        CSerialPort         *m_pPort;
+        CSerialFramer       *m_pFramer;
+        SERIAL_TRANSACTION_KEY m_pfnKey;
+        void                *m_pKeyContext;
+
+        std::mutex          m_Lock;
+        std::vector<TRANSACTION> m_Transactions;
+        TRANSACTION         *m_pFree;
+        LIST                m_Queued;
+        LIST                m_Outstanding;
+        TRANSACTION         *m_pWheel[SERIAL_TRANSACTION_SLOTS];
+        UINT64              m_qwWheelTick;          // the last tick the wheel was advanced to
+        UINT64              m_qwArmed;              // deadline given to the port, 0 for none
+        UINT                m_nWindow;
+
+        UINT64              m_qwSubmitted;
+        UINT64              m_qwCompleted;
+        UINT64              m_qwTimedOut;
+        UINT64              m_qwFailed;
+        UINT64              m_qwCancelled;
+        UINT64              m_qwUnmatched;
+        CSerialHistogram    m_Latency;
+};
+
+#endif // SERIAL_TRANSACTION_H
@@ -0,0 +1,122 @@
+/*
+**  FILENAME            SerialTxPacer.cpp
+**
+**  PURPOSE             Paces the hand-off of transmit data to the driver.
+**
+**  CREATION DATE       16-10-2026
+**  LAST MODIFICATION   16-10-2026
+*/
+
+#ifdef _WIN32
+#include "stdafx.h"
+#endif
+#include "SerialTxPacer.h"
+
+CSerialTxPacer::CSerialTxPacer()
+{
+    m_Pacing = SERIAL_TX_PACE_NONE;
+    m_nLeadUs = SERIAL_TX_LEAD_US;
+    m_qwByteNs = 0;
+    m_nBurst = 1;
+    m_qwCharNs = 0;
+    m_qwLineFree = 0;
+    m_qwTat = 0;
+}
+
+void CSerialTxPacer::SetPacing( SERIAL_TX_PACING Pacing, UINT nLeadUs )
+{
+    m_Pacing = Pacing;
+    m_nLeadUs = ( nLeadUs > 0 ) ? nLeadUs : SERIAL_TX_LEAD_US;
+}
+
+void CSerialTxPacer::SetRateLimit( UINT nBytesPerSecond, UINT nBurst )
+{
+    m_qwByteNs = ( nBytesPerSecond > 0 ) ? 1000000000ULL / nBytesPerSecond : 0;
+    m_nBurst = ( nBurst > 0 ) ? nBurst : 1;
+}
+
+void CSerialTxPacer::SetCharacterTime( UINT64 qwCharNs )
+{
+    m_qwCharNs.store( qwCharNs, std::memory_order_relaxed );
+}
+
+void CSerialTxPacer::Reset()
+{
+    m_qwLineFree = 0;
+    m_qwTat = 0;
+}
+
+UINT CSerialTxPacer::GetBacklog( UINT64 qwNow, UINT nReported )
+{
+    UINT64 qwCharNs = m_qwCharNs.load( std::memory_order_relaxed );
+    UINT64 qwLineFree = m_qwLineFree.load( std::memory_order_relaxed );
+
+    if ( ( m_Pacing == SERIAL_TX_PACE_MODEL ) && ( qwCharNs != 0 ) && ( qwLineFree > qwNow ) )
+    {
+        UINT nModel = ( UINT )( ( qwLineFree - qwNow + qwCharNs - 1 ) / qwCharNs );
+        return ( nModel > nReported ) ? nModel : nReported;
+    }
+
+    return nReported;
+}
+
+UINT CSerialTxPacer::GetBudget( UINT64 qwNow, UINT nReported, UINT nQueued, UINT64 *pqwReady )
+{
+    UINT64 qwCharNs = m_qwCharNs.load( std::memory_order_relaxed );
+    UINT nBudget = ~0U;
+
+    *pqwReady = 0;
+
+    if ( ( m_Pacing != SERIAL_TX_PACE_NONE ) && ( qwCharNs != 0 ) )
+    {
+        UINT64 qwLead = m_nLeadUs * 1000ULL / qwCharNs;
+        UINT nLead = ( qwLead > 2 ) ? ( UINT )qwLead : 2;
+        UINT nBacklog = GetBacklog( qwNow, nReported );
+
+        // topped up once half the lead went out, not after every character
+        if ( nBacklog > nLead / 2 )
+        {
+            *pqwReady = qwNow + ( nBacklog - nLead / 2 ) * qwCharNs;
+            return 0;
+        }
+
+        nBudget = nLead - nBacklog;
+    }
+
+    if ( m_qwByteNs != 0 )
+    {
+        UINT64 qwBurstNs = m_nBurst * m_qwByteNs;
+        UINT64 qwTat = ( m_qwTat > qwNow ) ? m_qwTat : qwNow;
+        UINT64 qwTokens = ( qwNow + qwBurstNs > qwTat ) ? ( qwNow + qwBurstNs - qwTat ) / m_qwByteNs : 0;
+        UINT nWant = ( nQueued < m_nBurst ) ? nQueued : m_nBurst;
+
+        nWant = ( nWant < nBudget ) ? nWant : nBudget;
+
+        // a burst is not started before it can go out whole
+        if ( qwTokens < nWant )
+        {
+            *pqwReady = qwTat - qwBurstNs + nWant * m_qwByteNs;
+            return 0;
+        }
+
+        nBudget = ( qwTokens < nBudget ) ? ( UINT )qwTokens : nBudget;
+    }
+
+    return nBudget;
+}
+
+void CSerialTxPacer::OnSent( UINT64 qwNow, UINT nBytes )
+{
+    UINT64 qwCharNs = m_qwCharNs.load( std::memory_order_relaxed );
+
+    if ( m_Pacing == SERIAL_TX_PACE_MODEL )
+    {
+        UINT64 qwLineFree = m_qwLineFree.load( std::memory_order_relaxed );
+        m_qwLineFree.store( ( ( qwLineFree > qwNow ) ? qwLineFree : qwNow ) + nBytes * qwCharNs, std::memory_order_relaxed );
+    }
+
+    if ( m_qwByteNs != 0 )
+    {
+        m_qwTat = ( ( m_qwTat > qwNow ) ? m_qwTat : qwNow ) + nBytes * m_qwByteNs;
+    }
+}
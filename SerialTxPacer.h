@@ -0,0 +1,79 @@
+/*
+**  FILENAME            SerialTxPacer.h
+**
+**  PURPOSE             Paces the hand-off of transmit data to the driver: the
+**                      driver's output queue is topped up to a lead of a few
+**                      milliseconds of line time whenever half of it went out, so
+**                      the line stays busy while later (more urgent) requests do
+**                      not wait behind a full kernel buffer. A token bucket limits
+**                      the rate for devices which need pauses between frames.
+**
+**  CREATION DATE       16-10-2026
+**  LAST MODIFICATION   16-10-2026
+*/
+
+#ifndef SERIAL_TX_PACER_H
+#define SERIAL_TX_PACER_H
+
+#ifndef _WIN32
+#include "SerialPortPosix.h"
+#endif
+#include <atomic>
+
+#define SERIAL_TX_LEAD_US           2000                    /* default lead, line time the driver holds */
+
+typedef enum _SERIAL_TX_PACING
+{
+    SERIAL_TX_PACE_NONE,                        // the driver takes all it can (the default)
+    SERIAL_TX_PACE_OUTQ,                        // by the output queue the driver reports, TIOCOUTQ or cbOutQue
+    SERIAL_TX_PACE_MODEL                        // also by the bytes handed over and the line rate, for drivers
+                                                // which report nothing (pseudo-terminals, some USB adapters)
+} SERIAL_TX_PACING;
+
+class CSerialTxPacer
+{
+    public:
+        CSerialTxPacer();
+
+        // before Open()
+        void                SetPacing( SERIAL_TX_PACING Pacing, UINT nLeadUs );
+        // bytes go out in bursts of up to nBurst, nBytesPerSecond on average; 0 for no limit
+        void                SetRateLimit( UINT nBytesPerSecond, UINT nBurst );
+
+        void                SetCharacterTime( UINT64 qwCharNs );            // any thread, from the DCB
+        void                Reset();                                        // Open()
+        BOOL                IsActive()
+        {
+            return ( m_Pacing != SERIAL_TX_PACE_NONE ) || ( m_qwByteNs != 0 );
+        }
+        SERIAL_TX_PACING    GetPacing()
+        {
+            return m_Pacing;
+        }
+
+        // any thread, bytes the driver still holds: nReported, with the model at least those the line has not sent yet
+        UINT                GetBacklog( UINT64 qwNow, UINT nReported );
+
+        /*
+        ** I/O thread. Bytes which may be handed to the driver now, nQueued are waiting
+        ** in the transmit queue; 0 sets *pqwReady to the SerialMetricsNow() time to ask
+        ** again.
+        */
+        UINT                GetBudget( UINT64 qwNow, UINT nReported, UINT nQueued, UINT64 *pqwReady );
+        void                OnSent( UINT64 qwNow, UINT nBytes );
+
+    private:
+        CSerialTxPacer( const CSerialTxPacer & );
+        CSerialTxPacer      &operator=( const CSerialTxPacer & );
+
+        SERIAL_TX_PACING    m_Pacing;
+        UINT                m_nLeadUs;
+        UINT64              m_qwByteNs;             // of the rate limit, 0 for none
+        UINT                m_nBurst;
+        std::atomic<UINT64> m_qwCharNs;
+
+        std::atomic<UINT64> m_qwLineFree;           // the model: when the line has sent all bytes handed over
+        UINT64              m_qwTat;                // the token bucket as theoretical arrival time, I/O thread only
+};
+
+#endif // SERIAL_TX_PACER_H
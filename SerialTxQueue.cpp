@@ -0,0 +1,433 @@
+/*
+**  FILENAME            SerialTxQueue.cpp
+**
+**  PURPOSE             Bounded queue of pending transmit requests.
+**
+**  CREATION DATE       16-10-2026
+**  LAST MODIFICATION   16-10-2026
+*/
+
+#ifdef _WIN32
+#include "stdafx.h"
+#endif
+#include "SerialTxQueue.h"
+#include <assert.h>
+#include <string.h>
+#include <chrono>
+
+#define TX_QUEUE_INITIAL_SEGMENTS   64
+
+template <class Predicate>
+static BOOL WaitUntil( std::unique_lock<std::mutex> &Lock, std::condition_variable &Cond, DWORD dwTimeout, Predicate Ready )
+{
+    if ( dwTimeout == INFINITE )
+    {
+        Cond.wait( Lock, Ready );
+        return TRUE;
+    }
+
+    return Cond.wait_for( Lock, std::chrono::milliseconds( dwTimeout ), Ready ) ? TRUE : FALSE;
+}
+
+CSerialTxQueue::CSerialTxQueue()
+{
+    m_nHead = 0;
+    m_nCount = 0;
+    m_nQueuedBytes = 0;
+    m_nRequestSent = 0;
+    m_nHighWaterMark = 0;
+    m_qwNextSequence = 1;
+    m_qwCompleted = 0;
+    m_bClosed = TRUE;
+    memset( &m_Stats, 0, sizeof( m_Stats ) );
+    m_pMetrics = NULL;
+    m_nLane = 0;
+    m_pPool = NULL;
+}
+
+CSerialTxQueue::~CSerialTxQueue()
+{
+    Close();
+}
+
+void CSerialTxQueue::Open( UINT nHighWaterMark )
+{
+    std::lock_guard<std::mutex> Lock( m_Lock );
+    assert( m_nCount == 0 );
+    memset( &m_Stats, 0, sizeof( m_Stats ) );
+    Reserve( TX_QUEUE_INITIAL_SEGMENTS );
+    m_nHighWaterMark = nHighWaterMark;
+    m_bClosed = FALSE;
+}
+
+void CSerialTxQueue::Close()
+{
+    std::unique_lock<std::mutex> Lock( m_Lock );
+    m_bClosed = TRUE;
+
+    while ( m_nCount > 0 )
+    {
+        PopFront( Lock, FALSE );
+    }
+
+    m_nQueuedBytes = 0;
+    m_cvSpace.notify_all();
+}
+
+void CSerialTxQueue::SetHighWaterMark( UINT nHighWaterMark )
+{
+    std::lock_guard<std::mutex> Lock( m_Lock );
+    m_nHighWaterMark = nHighWaterMark;
+    m_cvSpace.notify_all();
+}
+
+void CSerialTxQueue::SetMetrics( CSerialPortMetrics *pMetrics, UINT nLane )
+{
+    std::lock_guard<std::mutex> Lock( m_Lock );
+    assert( nLane < SERIAL_TX_LANES );
+    m_pMetrics = pMetrics;
+    m_nLane = nLane;
+}
+
+void CSerialTxQueue::SetPool( CSerialBufferPool *pPool )
+{
+    std::lock_guard<std::mutex> Lock( m_Lock );
+    m_pPool = pPool;
+}
+
+BOOL CSerialTxQueue::WaitSpace( std::unique_lock<std::mutex> &Lock, DWORD dwTimeout )
+{
+    // an empty queue takes a request of any size, otherwise wait below the high-water mark
+    return WaitUntil( Lock, m_cvSpace, dwTimeout, [this]() { return m_bClosed || ( m_nCount == 0 ) || ( m_nQueuedBytes < m_nHighWaterMark ); } ) &&
+           !m_bClosed;
+}
+
+BOOL CSerialTxQueue::Reserve( UINT nCount )
+{
+    size_t nCapacity = m_Segments.empty() ? TX_QUEUE_INITIAL_SEGMENTS : m_Segments.size();
+
+    if ( m_nCount + nCount <= m_Segments.size() )
+    {
+        return TRUE;
+    }
+
+    while ( nCapacity < m_nCount + nCount )
+    {
+        nCapacity <<= 1;
+    }
+
+    // grows only, a queue which reached its working size never allocates again
+    std::vector<SEGMENT> Segments( nCapacity );
+
+    for ( UINT i = 0; i < m_nCount; i++ )
+    {
+        Segments[i] = At( i );
+    }
+
+    m_Segments.swap( Segments );
+    m_nHead = 0;
+    m_Stats.qwAllocations++;
+    return TRUE;
+}
+
+UINT64 CSerialTxQueue::Push( const void *pData, UINT nSize, SERIAL_TX_CALLBACK pfnCallback, void *pContext, DWORD dwTimeout,
+                             const void *pTrailer, UINT nTrailer )
+{
+    std::unique_lock<std::mutex> Lock( m_Lock );
+    assert( ( pData != NULL ) && ( nSize > 0 ) );
+
+    if ( !WaitSpace( Lock, dwTimeout ) || !Reserve( 1 ) )
+    {
+        return 0;
+    }
+
+    // the trailer (a checksum, ...) goes into the same copy, one write for both
+    nSize += nTrailer;
+    SEGMENT &Segment = At( m_nCount );
+    BYTE *pCopy;
+
+    // a pool buffer when there is one, the heap for sizes the pool does not have
+    Segment.pBuffer = ( m_pPool != NULL ) ? m_pPool->Alloc( nSize ) : NULL;
+    Segment.pOwned = ( Segment.pBuffer == NULL ) ? new BYTE[nSize] : NULL;
+    pCopy = ( Segment.pBuffer != NULL ) ? Segment.pBuffer->pData : Segment.pOwned;
+
+    if ( pCopy == NULL )
+    {
+        return 0;
+    }
+
+    memcpy( pCopy, pData, nSize - nTrailer );
+
+    if ( nTrailer > 0 )
+    {
+        memcpy( pCopy + nSize - nTrailer, pTrailer, nTrailer );
+    }
+
+    ( ( Segment.pBuffer != NULL ) ? m_Stats.qwPooled : m_Stats.qwAllocations )++;
+    m_Stats.qwCopies++;
+    m_Stats.qwBytesCopied += nSize;
+    Segment.pData = pCopy;
+    Segment.nSize = nSize;
+    Segment.nOffset = 0;
+    Segment.pfnRelease = NULL;
+    Segment.pReleaseContext = NULL;
+    Segment.qwSequence = m_qwNextSequence++;
+    Segment.pfnCallback = pfnCallback;
+    Segment.pContext = pContext;
+    m_nCount++;
+    m_nQueuedBytes += nSize;
+
+    if ( m_pMetrics != NULL )
+    {
+        Segment.qwQueuedAt = SerialMetricsNow();
+        m_pMetrics->OnTxQueued( m_nQueuedBytes );
+    }
+
+    return Segment.qwSequence;
+}
+
+UINT64 CSerialTxQueue::PushV( const SERIAL_TX_BUFFER *pBuffers, UINT nCount, SERIAL_TX_CALLBACK pfnCallback, void *pContext, DWORD dwTimeout )
+{
+    std::unique_lock<std::mutex> Lock( m_Lock );
+    assert( ( pBuffers != NULL ) && ( nCount > 0 ) );
+
+    if ( !WaitSpace( Lock, dwTimeout ) || !Reserve( nCount ) )
+    {
+        return 0;
+    }
+
+    // the queue references the caller's buffers until their release callback
+    for ( UINT i = 0; i < nCount; i++ )
+    {
+        SEGMENT &Segment = At( m_nCount + i );
+        assert( ( pBuffers[i].pData != NULL ) && ( pBuffers[i].nSize > 0 ) );
+        Segment.pData = ( const BYTE * )pBuffers[i].pData;
+        Segment.nSize = pBuffers[i].nSize;
+        Segment.nOffset = 0;
+        Segment.pOwned = NULL;
+        Segment.pBuffer = NULL;
+        Segment.pfnRelease = pBuffers[i].pfnRelease;
+        Segment.pReleaseContext = pBuffers[i].pContext;
+        Segment.qwSequence = 0;
+        Segment.pfnCallback = NULL;
+        Segment.pContext = NULL;
+        m_nQueuedBytes += Segment.nSize;
+    }
+
+    SEGMENT &First = At( m_nCount );
+    SEGMENT &Last = At( m_nCount + nCount - 1 );
+    Last.qwSequence = m_qwNextSequence++;
+    Last.pfnCallback = pfnCallback;
+    Last.pContext = pContext;
+    m_nCount += nCount;
+
+    if ( m_pMetrics != NULL )
+    {
+        // the first segment for the wait until the request starts, the last one for its completion
+        Last.qwQueuedAt = First.qwQueuedAt = SerialMetricsNow();
+        m_pMetrics->OnTxQueued( m_nQueuedBytes );
+    }
+
+    return Last.qwSequence;
+}
+
+BOOL CSerialTxQueue::WaitComplete( UINT64 qwSequence, DWORD dwTimeout )
+{
+    std::unique_lock<std::mutex> Lock( m_Lock );
+    return WaitUntil( Lock, m_cvComplete, dwTimeout, [this, qwSequence]() { return m_qwCompleted >= qwSequence; } );
+}
+
+BOOL CSerialTxQueue::WaitEmpty( DWORD dwTimeout )
+{
+    std::unique_lock<std::mutex> Lock( m_Lock );
+    return WaitUntil( Lock, m_cvComplete, dwTimeout, [this]() { return m_qwCompleted + 1 == m_qwNextSequence; } );
+}
+
+BOOL CSerialTxQueue::IsEmpty()
+{
+    std::lock_guard<std::mutex> Lock( m_Lock );
+    return m_nCount == 0;
+}
+
+UINT CSerialTxQueue::GetFront( const BYTE **ppData )
+{
+    std::lock_guard<std::mutex> Lock( m_Lock );
+
+    if ( m_nCount == 0 )
+    {
+        *ppData = NULL;
+        return 0;
+    }
+
+    // only the I/O thread removes the head, the pointer stays valid without the lock
+    SEGMENT &Front = At( 0 );
+    *ppData = Front.pData + Front.nOffset;
+    return Front.nSize - Front.nOffset;
+}
+
+UINT CSerialTxQueue::GetFront( SERIAL_TX_SPAN *pSpans, UINT nMaxSpans, UINT *pnBytes )
+{
+    std::lock_guard<std::mutex> Lock( m_Lock );
+    UINT nSpans = ( m_nCount < nMaxSpans ) ? m_nCount : nMaxSpans;
+    *pnBytes = 0;
+
+    for ( UINT i = 0; i < nSpans; i++ )
+    {
+        SEGMENT &Segment = At( i );
+        pSpans[i].pData = Segment.pData + Segment.nOffset;
+        pSpans[i].nSize = Segment.nSize - Segment.nOffset;
+        *pnBytes += pSpans[i].nSize;
+    }
+
+    return nSpans;
+}
+
+UINT CSerialTxQueue::Advance( UINT nSent )
+{
+    UINT nCompleted = 0;
+    std::unique_lock<std::mutex> Lock( m_Lock );
+
+    while ( m_nCount > 0 )
+    {
+        SEGMENT &Front = At( 0 );
+        UINT nTake = Front.nSize - Front.nOffset;
+
+        if ( nTake > nSent )
+        {
+            nTake = nSent;
+        }
+
+        if ( ( m_nRequestSent == 0 ) && ( nTake > 0 ) && ( m_pMetrics != NULL ) )
+        {
+            UINT64 qwNow = SerialMetricsNow();
+            m_pMetrics->OnTxStarted( m_nLane, ( qwNow > Front.qwQueuedAt ) ? qwNow - Front.qwQueuedAt : 0 );
+        }
+
+        Front.nOffset += nTake;
+        m_nQueuedBytes -= nTake;
+        m_nRequestSent += nTake;
+        nSent -= nTake;
+
+        if ( Front.nOffset < Front.nSize )
+        {
+            break;
+        }
+
+        if ( Front.qwSequence != 0 )
+        {
+            nCompleted++;
+        }
+
+        PopFront( Lock, TRUE );
+    }
+
+    assert( nSent == 0 );
+    m_cvSpace.notify_all();
+    return nCompleted;
+}
+
+void CSerialTxQueue::FailFront()
+{
+    std::unique_lock<std::mutex> Lock( m_Lock );
+
+    // drop every segment of the head request
+    while ( m_nCount > 0 )
+    {
+        SEGMENT &Front = At( 0 );
+        BOOL bLast = ( Front.qwSequence != 0 );
+        m_nQueuedBytes -= Front.nSize - Front.nOffset;
+        PopFront( Lock, FALSE );
+
+        if ( bLast )
+        {
+            break;
+        }
+    }
+
+    m_cvSpace.notify_all();
+}
+
+UINT CSerialTxQueue::GetFrontSent()
+{
+    std::lock_guard<std::mutex> Lock( m_Lock );
+    return m_nRequestSent;
+}
+
+UINT CSerialTxQueue::GetFrontLeft()
+{
+    std::lock_guard<std::mutex> Lock( m_Lock );
+    UINT nLeft = 0;
+
+    for ( UINT i = 0; i < m_nCount; i++ )
+    {
+        SEGMENT &Segment = At( i );
+        nLeft += Segment.nSize - Segment.nOffset;
+
+        if ( Segment.qwSequence != 0 )
+        {
+            break;
+        }
+    }
+
+    return nLeft;
+}
+
+UINT CSerialTxQueue::GetQueuedBytes()
+{
+    std::lock_guard<std::mutex> Lock( m_Lock );
+    return m_nQueuedBytes;
+}
+
+void CSerialTxQueue::GetStats( SERIAL_TX_STATS *pStats )
+{
+    std::lock_guard<std::mutex> Lock( m_Lock );
+    *pStats = m_Stats;
+}
+
+void CSerialTxQueue::PopFront( std::unique_lock<std::mutex> &Lock, BOOL bSuccess )
+{
+    SEGMENT Segment = At( 0 );
+    UINT nRequestSent = m_nRequestSent;
+    m_nHead = ( m_nHead + 1 ) & ( UINT )( m_Segments.size() - 1 );
+    m_nCount--;
+
+    if ( Segment.qwSequence != 0 )
+    {
+        m_nRequestSent = 0;
+
+        if ( bSuccess && ( m_pMetrics != NULL ) )
+        {
+            UINT64 qwNow = SerialMetricsNow();
+            m_pMetrics->OnTxComplete( ( qwNow > Segment.qwQueuedAt ) ? qwNow - Segment.qwQueuedAt : 0 );
+        }
+    }
+
+    // the callbacks may queue the next request, never call them with the lock held
+    Lock.unlock();
+
+    if ( Segment.pBuffer != NULL )
+    {
+        SerialBufferRelease( Segment.pBuffer );
+    }
+    else if ( Segment.pOwned != NULL )
+    {
+        delete [] Segment.pOwned;
+    }
+    else if ( Segment.pfnRelease != NULL )
+    {
+        Segment.pfnRelease( Segment.pReleaseContext, Segment.pData, Segment.nSize );
+    }
+
+    if ( ( Segment.qwSequence != 0 ) && ( Segment.pfnCallback != NULL ) )
+    {
+        Segment.pfnCallback( Segment.pContext, nRequestSent, bSuccess );
+    }
+
+    Lock.lock();
+
+    if ( Segment.qwSequence != 0 )
+    {
+        m_qwCompleted = Segment.qwSequence;
+        m_cvComplete.notify_all();
+    }
+}
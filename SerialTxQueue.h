@@ -0,0 +1,134 @@
+/*
+**  FILENAME            SerialTxQueue.h
+**
+**  PURPOSE             Bounded queue of pending transmit requests. Producers queue
+**                      buffers from any thread, the I/O thread drains the head and
+**                      reports every finished request through its callback.
+**
+**  CREATION DATE       16-10-2026
+**  LAST MODIFICATION   16-10-2026
+*/
+
+#ifndef SERIAL_TX_QUEUE_H
+#define SERIAL_TX_QUEUE_H
+
+#ifndef _WIN32
+#include "SerialPortPosix.h"
+#endif
+#include "SerialBufferPool.h"
+#include "SerialMetrics.h"
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+
+/*
+** Called on the I/O thread once the request has been handed to the driver, or on
+** the thread calling Close() when the port is closed with the request pending.
+*/
+typedef void ( *SERIAL_TX_CALLBACK )( void *pContext, DWORD dwBytesWritten, BOOL bSuccess );
+
+/*
+** Called when the queue no longer references a caller owned buffer, i.e. its bytes
+** are with the driver or the request failed.
+*/
+typedef void ( *SERIAL_TX_RELEASE )( void *pContext, const void *pData, UINT nSize );
+
+typedef struct _SERIAL_TX_BUFFER
+{
+    const void          *pData;
+    UINT                nSize;
+    SERIAL_TX_RELEASE   pfnRelease;             // may be NULL
+    void                *pContext;
+} SERIAL_TX_BUFFER;
+
+typedef struct _SERIAL_TX_SPAN
+{
+    const BYTE          *pData;
+    UINT                nSize;
+} SERIAL_TX_SPAN;
+
+typedef struct _SERIAL_TX_STATS
+{
+    UINT64              qwAllocations;          // heap allocations made by the queue
+    UINT64              qwCopies;               // buffers copied into the queue
+    UINT64              qwPooled;               // copies which went into a pool buffer
+    UINT64              qwBytesCopied;
+} SERIAL_TX_STATS;
+
+class CSerialTxQueue
+{
+    public:
+        CSerialTxQueue();
+        ~CSerialTxQueue();
+
+        void                Open( UINT nHighWaterMark );
+        void                Close();                // fails every pending request
+        void                SetHighWaterMark( UINT nHighWaterMark );
+        void                SetMetrics( CSerialPortMetrics *pMetrics, UINT nLane = 0 );     // depth and wait times, may be NULL
+        void                SetPool( CSerialBufferPool *pPool );            // copies of Push(), NULL is the heap
+
+        // producers, returns 0 when the queue stayed above the high-water mark for dwTimeout
+        UINT64              Push( const void *pData, UINT nSize, SERIAL_TX_CALLBACK pfnCallback, void *pContext, DWORD dwTimeout,
+                                  const void *pTrailer = NULL, UINT nTrailer = 0 );
+        UINT64              PushV( const SERIAL_TX_BUFFER *pBuffers, UINT nCount, SERIAL_TX_CALLBACK pfnCallback, void *pContext, DWORD dwTimeout );
+        BOOL                WaitComplete( UINT64 qwSequence, DWORD dwTimeout );
+        BOOL                WaitEmpty( DWORD dwTimeout );
+
+        // I/O thread
+        BOOL                IsEmpty();
+        UINT                GetFront( const BYTE **ppData );
+        UINT                GetFront( SERIAL_TX_SPAN *pSpans, UINT nMaxSpans, UINT *pnBytes );
+        UINT                Advance( UINT nSent );  // number of requests completed
+        void                FailFront();
+        UINT                GetFrontSent();         // bytes of the head request written, 0 between requests
+        UINT                GetFrontLeft();         // bytes of the head request not written yet, all its segments
+
+        UINT                GetQueuedBytes();
+        void                GetStats( SERIAL_TX_STATS *pStats );
+
+    private:
+        struct SEGMENT
+        {
+            const BYTE          *pData;
+            UINT                nSize;
+            UINT                nOffset;
+            BYTE                *pOwned;            // copy made by Push()
+            SERIAL_BUFFER       *pBuffer;           // the same out of the pool
+            SERIAL_TX_RELEASE   pfnRelease;
+            void                *pReleaseContext;
+            UINT64              qwSequence;         // non-zero on the last segment of a request
+            UINT64              qwQueuedAt;         // SerialMetricsNow() of the request, with metrics only
+            SERIAL_TX_CALLBACK  pfnCallback;
+            void                *pContext;
+        };
+
+        CSerialTxQueue( const CSerialTxQueue & );
+        CSerialTxQueue      &operator=( const CSerialTxQueue & );
+
+        BOOL                WaitSpace( std::unique_lock<std::mutex> &Lock, DWORD dwTimeout );
+        BOOL                Reserve( UINT nCount );
+        SEGMENT             &At( UINT nIndex )
+        {
+            return m_Segments[( m_nHead + nIndex ) & ( m_Segments.size() - 1 )];
+        }
+        void                PopFront( std::unique_lock<std::mutex> &Lock, BOOL bSuccess );
+
+        std::mutex              m_Lock;
+        std::condition_variable m_cvSpace;          // producers waiting for the high-water mark
+        std::condition_variable m_cvComplete;       // Write() and WaitEmpty()
+        std::vector<SEGMENT>    m_Segments;         // circular, the size is a power of two
+        UINT                    m_nHead;
+        UINT                    m_nCount;
+        UINT                    m_nQueuedBytes;
+        UINT                    m_nRequestSent;     // bytes of the head request written so far
+        UINT                    m_nHighWaterMark;
+        UINT64                  m_qwNextSequence;
+        UINT64                  m_qwCompleted;
+        BOOL                    m_bClosed;
+        SERIAL_TX_STATS         m_Stats;
+        CSerialPortMetrics      *m_pMetrics;
+        UINT                    m_nLane;            // of the scheduler, for the metrics
+        CSerialBufferPool       *m_pPool;
+};
+
+#endif // SERIAL_TX_QUEUE_H
@@ -0,0 +1,333 @@
+/*
+**  FILENAME            SerialTxScheduler.cpp
+**
+**  PURPOSE             Transmit lanes of a port, one queue per priority.
+**
+**  CREATION DATE       16-10-2026
+**  LAST MODIFICATION   16-10-2026
+*/
+
+#ifdef _WIN32
+#include "stdafx.h"
+#endif
+#include "SerialTxScheduler.h"
+#include <assert.h>
+#include <string.h>
+#include <chrono>
+
+CSerialTxScheduler::CSerialTxScheduler()
+{
+    m_Scheduling = SERIAL_TX_STRICT;
+    m_nCurrent = -1;
+    m_nSliceSent = 0;
+
+    for ( UINT i = 0; i < SERIAL_TX_LANES; i++ )
+    {
+        m_nSlice[i] = 0;
+        m_nWeight[i] = 1;
+        m_nDeficit[i] = 0;
+    }
+}
+
+void CSerialTxScheduler::SetScheduling( SERIAL_TX_SCHEDULING Scheduling )
+{
+    m_Scheduling = Scheduling;
+}
+
+void CSerialTxScheduler::SetLane( UINT nLane, UINT nSlice, UINT nWeight )
+{
+    assert( nLane < SERIAL_TX_LANES );
+    m_nSlice[nLane] = nSlice;
+    m_nWeight[nLane] = ( nWeight > 0 ) ? nWeight : 1;
+}
+
+void CSerialTxScheduler::Open( UINT nHighWaterMark )
+{
+    m_nCurrent = -1;
+    m_nSliceSent = 0;
+
+    for ( UINT i = 0; i < SERIAL_TX_LANES; i++ )
+    {
+        m_nDeficit[i] = 0;
+        m_Lanes[i].Open( nHighWaterMark );
+    }
+}
+
+void CSerialTxScheduler::Close()
+{
+    for ( UINT i = 0; i < SERIAL_TX_LANES; i++ )
+    {
+        m_Lanes[i].Close();
+    }
+}
+
+void CSerialTxScheduler::SetHighWaterMark( UINT nHighWaterMark )
+{
+    for ( UINT i = 0; i < SERIAL_TX_LANES; i++ )
+    {
+        m_Lanes[i].SetHighWaterMark( nHighWaterMark );
+    }
+}
+
+void CSerialTxScheduler::SetMetrics( CSerialPortMetrics *pMetrics )
+{
+    for ( UINT i = 0; i < SERIAL_TX_LANES; i++ )
+    {
+        m_Lanes[i].SetMetrics( pMetrics, i );
+    }
+}
+
+void CSerialTxScheduler::SetPool( CSerialBufferPool *pPool )
+{
+    for ( UINT i = 0; i < SERIAL_TX_LANES; i++ )
+    {
+        m_Lanes[i].SetPool( pPool );
+    }
+}
+
+BOOL CSerialTxScheduler::WaitEmpty( DWORD dwTimeout )
+{
+    std::chrono::steady_clock::time_point Deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds( dwTimeout );
+
+    for ( UINT i = 0; i < SERIAL_TX_LANES; i++ )
+    {
+        DWORD dwLeft = dwTimeout;
+
+        if ( dwTimeout != INFINITE )
+        {
+            INT64 nLeft = std::chrono::duration_cast<std::chrono::milliseconds>( Deadline - std::chrono::steady_clock::now() ).count();
+            dwLeft = ( nLeft > 0 ) ? ( DWORD )nLeft : 0;
+        }
+
+        if ( !m_Lanes[i].WaitEmpty( dwLeft ) )
+        {
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+BOOL CSerialTxScheduler::IsEmpty()
+{
+    for ( UINT i = 0; i < SERIAL_TX_LANES; i++ )
+    {
+        if ( !m_Lanes[i].IsEmpty() )
+        {
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+UINT CSerialTxScheduler::GetFront( const BYTE **ppData )
+{
+    int nLane = Select();
+    UINT nSize;
+
+    if ( nLane < 0 )
+    {
+        *ppData = NULL;
+        return 0;
+    }
+
+    nSize = m_Lanes[nLane].GetFront( ppData );
+    return ( nSize < GetSliceLeft() ) ? nSize : GetSliceLeft();
+}
+
+UINT CSerialTxScheduler::GetFrontLeft()
+{
+    int nLane = Select();
+    return ( nLane < 0 ) ? 0 : m_Lanes[nLane].GetFrontLeft();
+}
+
+UINT CSerialTxScheduler::GetFront( SERIAL_TX_SPAN *pSpans, UINT nMaxSpans, UINT *pnBytes )
+{
+    int nLane = Select();
+    UINT nLeft = GetSliceLeft();
+    UINT nSpans;
+
+    if ( nLane < 0 )
+    {
+        *pnBytes = 0;
+        return 0;
+    }
+
+    nSpans = m_Lanes[nLane].GetFront( pSpans, nMaxSpans, pnBytes );
+
+    // without a slice a write ends with the request while another lane waits, or the
+    // next request would have started and kept the line
+    if ( ( nLeft == ~0U ) && ( nSpans > 1 ) && IsOtherWaiting( nLane ) )
+    {
+        nLeft = m_Lanes[nLane].GetFrontLeft();
+    }
+
+    // a write never reaches past the end of the slice
+    if ( *pnBytes > nLeft )
+    {
+        UINT nCount = 0;
+        *pnBytes = 0;
+
+        while ( ( nCount < nSpans ) && ( *pnBytes < nLeft ) )
+        {
+            pSpans[nCount].nSize = ( pSpans[nCount].nSize < nLeft - *pnBytes ) ? pSpans[nCount].nSize : nLeft - *pnBytes;
+            *pnBytes += pSpans[nCount++].nSize;
+        }
+
+        nSpans = nCount;
+    }
+
+    return nSpans;
+}
+
+UINT CSerialTxScheduler::Advance( UINT nSent )
+{
+    assert( ( m_nCurrent >= 0 ) || ( nSent == 0 ) );
+
+    if ( m_nCurrent < 0 )
+    {
+        return 0;
+    }
+
+    m_nSliceSent += nSent;
+    m_nDeficit[m_nCurrent] -= nSent;
+    return m_Lanes[m_nCurrent].Advance( nSent );
+}
+
+void CSerialTxScheduler::FailFront()
+{
+    int nLane = ( m_nCurrent >= 0 ) ? m_nCurrent : Select();
+
+    if ( nLane >= 0 )
+    {
+        m_Lanes[nLane].FailFront();
+        m_nSliceSent = 0;
+    }
+}
+
+UINT CSerialTxScheduler::GetQueuedBytes()
+{
+    UINT nBytes = 0;
+
+    for ( UINT i = 0; i < SERIAL_TX_LANES; i++ )
+    {
+        nBytes += m_Lanes[i].GetQueuedBytes();
+    }
+
+    return nBytes;
+}
+
+void CSerialTxScheduler::GetStats( SERIAL_TX_STATS *pStats )
+{
+    memset( pStats, 0, sizeof( *pStats ) );
+
+    for ( UINT i = 0; i < SERIAL_TX_LANES; i++ )
+    {
+        SERIAL_TX_STATS Lane;
+        m_Lanes[i].GetStats( &Lane );
+        pStats->qwAllocations += Lane.qwAllocations;
+        pStats->qwCopies += Lane.qwCopies;
+        pStats->qwPooled += Lane.qwPooled;
+        pStats->qwBytesCopied += Lane.qwBytesCopied;
+    }
+}
+
+int CSerialTxScheduler::Select()
+{
+    if ( ( m_nCurrent >= 0 ) && !m_Lanes[m_nCurrent].IsEmpty() )
+    {
+        UINT nSlice = m_nSlice[m_nCurrent];
+        BOOL bStarted = ( m_Lanes[m_nCurrent].GetFrontSent() > 0 );
+        BOOL bSliceLeft = ( nSlice == 0 ) || ( m_nSliceSent < nSlice );
+
+        // a started request goes on until it is done or its slice is used up
+        if ( bStarted && bSliceLeft )
+        {
+            return m_nCurrent;
+        }
+
+        // between requests a weighted lane keeps the line while its deficit lasts
+        if ( ( m_Scheduling == SERIAL_TX_WEIGHTED ) && ( m_nDeficit[m_nCurrent] > 0 ) && bSliceLeft )
+        {
+            return m_nCurrent;
+        }
+    }
+
+    m_nSliceSent = 0;
+
+    if ( m_Scheduling == SERIAL_TX_STRICT )
+    {
+        for ( UINT i = 0; i < SERIAL_TX_LANES; i++ )
+        {
+            if ( !m_Lanes[i].IsEmpty() )
+            {
+                return m_nCurrent = ( int )i;
+            }
+        }
+
+        return m_nCurrent = -1;
+    }
+
+    // the next lane after the current one which has data and credit, new rounds when none has credit
+    for ( ;; )
+    {
+        INT64 nRounds = 0;
+
+        for ( UINT k = 1; k <= SERIAL_TX_LANES; k++ )
+        {
+            UINT i = ( UINT )( m_nCurrent + ( int )k + SERIAL_TX_LANES ) % SERIAL_TX_LANES;
+            INT64 nQuantum = ( INT64 )m_nWeight[i] * SERIAL_TX_QUANTUM;
+
+            if ( m_Lanes[i].IsEmpty() )
+            {
+                continue;
+            }
+
+            if ( m_nDeficit[i] > 0 )
+            {
+                return m_nCurrent = ( int )i;
+            }
+
+            // as many rounds at once as the lane closest to credit needs
+            INT64 nNeeded = -m_nDeficit[i] / nQuantum + 1;
+            nRounds = ( ( nRounds == 0 ) || ( nNeeded < nRounds ) ) ? nNeeded : nRounds;
+        }
+
+        if ( nRounds == 0 )
+        {
+            return m_nCurrent = -1;
+        }
+
+        for ( UINT i = 0; i < SERIAL_TX_LANES; i++ )
+        {
+            // an idle lane does not save up credit
+            m_nDeficit[i] = m_Lanes[i].IsEmpty() ? 0 : m_nDeficit[i] + nRounds * ( INT64 )m_nWeight[i] * SERIAL_TX_QUANTUM;
+        }
+    }
+}
+
+BOOL CSerialTxScheduler::IsOtherWaiting( int nLane )
+{
+    for ( UINT i = 0; i < SERIAL_TX_LANES; i++ )
+    {
+        if ( ( ( int )i != nLane ) && !m_Lanes[i].IsEmpty() )
+        {
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+UINT CSerialTxScheduler::GetSliceLeft()
+{
+    UINT nSlice = ( m_nCurrent >= 0 ) ? m_nSlice[m_nCurrent] : 0;
+
+    if ( nSlice == 0 )
+    {
+        return ~0U;
+    }
+
+    return ( m_nSliceSent < nSlice ) ? nSlice - m_nSliceSent : 0;
+}
@@ -0,0 +1,84 @@
+/*
+**  FILENAME            SerialTxScheduler.h
+**
+**  PURPOSE             Transmit lanes of a port, one queue per priority. The I/O
+**                      thread takes the next bytes from the lane the scheduling
+**                      picks, strictly by priority or by weight, and switches lanes
+**                      only between requests or, for a lane with a slice size,
+**                      every slice, so a large bulk transfer holds up an urgent
+**                      frame for one slice at most.
+**
+**  CREATION DATE       16-10-2026
+**  LAST MODIFICATION   16-10-2026
+*/
+
+#ifndef SERIAL_TX_SCHEDULER_H
+#define SERIAL_TX_SCHEDULER_H
+
+#include "SerialTxQueue.h"
+
+#define SERIAL_TX_URGENT            0
+#define SERIAL_TX_NORMAL            1                       /* Write(), WriteAsync() and the others without a lane */
+#define SERIAL_TX_BULK              ( SERIAL_TX_LANES - 1 )
+#define SERIAL_TX_QUANTUM           256                     /* bytes per round and unit of weight */
+
+typedef enum _SERIAL_TX_SCHEDULING
+{
+    SERIAL_TX_STRICT,                           // the lowest non-empty lane goes first
+    SERIAL_TX_WEIGHTED                          // deficit round robin, weight * SERIAL_TX_QUANTUM bytes a round
+} SERIAL_TX_SCHEDULING;
+
+class CSerialTxScheduler
+{
+    public:
+        CSerialTxScheduler();
+
+        // before Open(); nSlice 0 never interrupts a request of the lane once it started
+        void                SetScheduling( SERIAL_TX_SCHEDULING Scheduling );
+        void                SetLane( UINT nLane, UINT nSlice, UINT nWeight );
+
+        // the same for every lane, the high-water mark applies to each on its own
+        void                Open( UINT nHighWaterMark );
+        void                Close();
+        void                SetHighWaterMark( UINT nHighWaterMark );
+        void                SetMetrics( CSerialPortMetrics *pMetrics );
+        void                SetPool( CSerialBufferPool *pPool );
+
+        // producers queue into a lane directly
+        CSerialTxQueue      &GetLane( UINT nLane )
+        {
+            return m_Lanes[nLane];
+        }
+        BOOL                WaitEmpty( DWORD dwTimeout );
+
+        // I/O thread, the bytes come from one lane at a time
+        BOOL                IsEmpty();
+        UINT                GetFront( const BYTE **ppData );
+        UINT                GetFront( SERIAL_TX_SPAN *pSpans, UINT nMaxSpans, UINT *pnBytes );
+        UINT                Advance( UINT nSent );
+        void                FailFront();
+        UINT                GetFrontLeft();         // of the head request of the lane sending, 0 when all are empty
+
+        UINT                GetQueuedBytes();
+        void                GetStats( SERIAL_TX_STATS *pStats );
+
+    private:
+        CSerialTxScheduler( const CSerialTxScheduler & );
+        CSerialTxScheduler  &operator=( const CSerialTxScheduler & );
+
+        int                 Select();               // the lane to send from, -1 when all are empty
+        UINT                GetSliceLeft();         // of the current lane, ~0 without a slice
+        BOOL                IsOtherWaiting( int nLane );
+
+        CSerialTxQueue      m_Lanes[SERIAL_TX_LANES];
+        SERIAL_TX_SCHEDULING m_Scheduling;
+        UINT                m_nSlice[SERIAL_TX_LANES];
+        UINT                m_nWeight[SERIAL_TX_LANES];
+
+        // I/O thread only
+        int                 m_nCurrent;
+        UINT                m_nSliceSent;           // by the current lane since it was picked
+        INT64               m_nDeficit[SERIAL_TX_LANES];
+};
+
+#endif // SERIAL_TX_SCHEDULER_H
@@ -0,0 +1,356 @@
+/*
+**  FILENAME            SerialBasicPortBench.cpp
+**
+**  PURPOSE             Compares the receive path of CSerialPort with CBasicSerialPort
+**                      with runtime policies (CSerialRuntimePort) and with inline
+**                      policies: a line decoder and a consumer known at compile time
+**                      and buffers inside the port. The master side of a pty streams
+**                      numbered lines, each port decodes and checks them; prints
+**                      MB/s, lines per second and the receiving CPU time per line.
+**                      A second pass feeds the same stream from memory to the three
+**                      decode paths to show their cost without system calls. Exits
+**                      with 1 when a line is lost or altered.
+**
+**                      g++ -O2 -std=c++11 -I.. SerialBasicPortBench.cpp ../Serial*.cpp -lpthread -lutil
+**                      ./a.out --frame 64 --seconds 2
+**
+**  CREATION DATE       16-10-2026
+**  LAST MODIFICATION   16-10-2026
+*/
+
+#ifndef _WIN32
+
+#include "SerialPort.h"
+#include "SerialBasicPort.h"
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#if defined( __APPLE__ ) || defined( __FreeBSD__ )
+#include <util.h>
+#else
+#include <pty.h>
+#endif
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#define BENCH_BLOCK_LINES   1024                /* lines the writer renumbers and writes at once */
+#define BENCH_READ_SIZE     4096
+#define BENCH_DECODE_BYTES  ( 256UL << 20 )     /* streamed through the decoders from memory */
+
+typedef enum _BENCH_PATH
+{
+    BENCH_SERIAL_PORT,                          // CSerialPort, CSerialLineFramer, frame callback
+    BENCH_RUNTIME,                              // CSerialRuntimePort, the same framer and callback
+    BENCH_INLINE                                // CBasicSerialPort, CSerialDelimiterFramer, BENCH_SINK
+} BENCH_PATH;
+
+static const char *s_pszPaths[] = { "CSerialPort", "runtime-policies", "inline-policies" };
+
+// a line is 8 hex digits of its number and filler up to the frame size with the '\n'
+typedef struct _BENCH_SINK
+{
+    UINT                nLength;                // without the '\n'
+    UINT64              qwNext;
+    UINT64              qwBytes;
+    UINT64              qwBroken;
+
+    void                OnFrame( const BYTE *pFrame, UINT nLength, UINT64 qwTimestamp )
+    {
+        UINT64 qwNumber = 0;
+        ( void )qwTimestamp;
+
+        for ( int i = 0; i < 8; i++ )
+        {
+            qwNumber = ( qwNumber << 4 ) | ( UINT64 )( ( pFrame[i] <= '9' ) ? pFrame[i] - '0' : pFrame[i] - 'a' + 10 );
+        }
+
+        if ( ( nLength != this->nLength ) || ( qwNumber != ( qwNext & 0xFFFFFFFFULL ) ) )
+        {
+            qwBroken++;
+        }
+
+        qwNext++;
+        qwBytes += nLength + 1;
+    }
+} BENCH_SINK;
+
+static void OnLine( void *pContext, const BYTE *pFrame, UINT nLength )
+{
+    ( ( BENCH_SINK * )pContext )->OnFrame( pFrame, nLength, 0 );
+}
+
+typedef CBasicSerialPort< BENCH_SINK, CSerialDelimiterFramer< '\n', false >, CSerialStaticAllocator< BENCH_READ_SIZE + SERIAL_FRAME_MAX_SIZE > >
+        CBenchInlinePort;
+
+static void Renumber( std::vector<BYTE> *pBlock, UINT nFrame, UINT64 qwFirst )
+{
+    static const char s_szHex[] = "0123456789abcdef";
+
+    for ( UINT i = 0; i < BENCH_BLOCK_LINES; i++ )
+    {
+        BYTE *pLine = &( *pBlock )[i * nFrame];
+        UINT64 qwNumber = qwFirst + i;
+
+        for ( int d = 7; d >= 0; d-- )
+        {
+            pLine[d] = ( BYTE )s_szHex[qwNumber & 0xF];
+            qwNumber >>= 4;
+        }
+    }
+}
+
+static void FillBlock( std::vector<BYTE> *pBlock, UINT nFrame )
+{
+    pBlock->assign( ( size_t )nFrame * BENCH_BLOCK_LINES, 'x' );
+
+    for ( UINT i = 0; i < BENCH_BLOCK_LINES; i++ )
+    {
+        ( *pBlock )[( i + 1 ) * nFrame - 1] = '\n';
+    }
+}
+
+static UINT64 CpuNow( clockid_t Clock )
+{
+    struct timespec ts;
+    clock_gettime( Clock, &ts );
+    return ( UINT64 )ts.tv_sec * 1000000000ULL + ( UINT64 )ts.tv_nsec;
+}
+
+// streams lines into the master as fast as the pty takes them, returns its own CPU time
+static void Writer( int nMaster, UINT nFrame, std::atomic<bool> *pbStop, UINT64 *pqwCpu )
+{
+    std::vector<BYTE> Block;
+    UINT64 qwFirst = 0;
+
+    FillBlock( &Block, nFrame );
+
+    while ( !*pbStop )
+    {
+        size_t nDone = 0;
+        Renumber( &Block, nFrame, qwFirst );
+        qwFirst += BENCH_BLOCK_LINES;
+
+        while ( ( nDone < Block.size() ) && !*pbStop )
+        {
+            ssize_t n = write( nMaster, &Block[nDone], Block.size() - nDone );
+
+            if ( n > 0 )
+            {
+                nDone += ( size_t )n;
+            }
+            else
+            {
+                struct pollfd Fd = { nMaster, POLLOUT, 0 };
+                poll( &Fd, 1, 10 );
+            }
+        }
+    }
+
+    *pqwCpu = CpuNow( CLOCK_THREAD_CPUTIME_ID );
+}
+
+static BOOL RunPty( BENCH_PATH Path, UINT nFrame, double dSeconds )
+{
+    CSerialPort Port;
+    CSerialLineFramer LineFramer( '\n', FALSE );
+    CSerialRuntimePort RuntimePort;
+    static CBenchInlinePort s_InlinePort;
+    BENCH_SINK Sink;
+    BENCH_SINK *pSink = &Sink;
+    std::atomic<bool> bStop( false );
+    struct termios tio;
+    char szName[128];
+    UINT64 qwWriterCpu = 0;
+    BOOL bOpen;
+    int nMaster;
+    int nSlave;
+
+    if ( openpty( &nMaster, &nSlave, szName, NULL, NULL ) != 0 )
+    {
+        perror( "openpty()" );
+        return FALSE;
+    }
+
+    tcgetattr( nMaster, &tio );
+    cfmakeraw( &tio );
+    tcsetattr( nMaster, TCSANOW, &tio );
+    fcntl( nMaster, F_SETFL, fcntl( nMaster, F_GETFL ) | O_NONBLOCK );
+
+    memset( &Sink, 0, sizeof( Sink ) );
+    Sink.nLength = nFrame - 1;
+    LineFramer.SetCallback( OnLine, &Sink );
+
+    if ( Path == BENCH_SERIAL_PORT )
+    {
+        Port.SetFramer( &LineFramer );
+        bOpen = Port.OpenDevice( NULL, szName, 921600 );
+    }
+    else if ( Path == BENCH_RUNTIME )
+    {
+        RuntimePort.SetReadSize( BENCH_READ_SIZE );
+        RuntimePort.GetNotifier().SetCallback( OnLine, &Sink );
+        RuntimePort.GetFramer().SetFramer( &LineFramer );
+        bOpen = RuntimePort.OpenDevice( szName, 921600 );
+    }
+    else
+    {
+        pSink = &s_InlinePort.GetNotifier();
+        memset( pSink, 0, sizeof( *pSink ) );
+        pSink->nLength = nFrame - 1;
+        s_InlinePort.SetReadSize( BENCH_READ_SIZE );
+        bOpen = s_InlinePort.OpenDevice( szName, 921600 );
+    }
+
+    if ( !bOpen )
+    {
+        fprintf( stderr, "%s could not be opened\n", szName );
+        return FALSE;
+    }
+
+    close( nSlave );
+
+    UINT64 qwCpuStart = CpuNow( CLOCK_PROCESS_CPUTIME_ID );
+    UINT64 qwStart = SerialMetricsNow();
+    std::thread WriterThread( Writer, nMaster, nFrame, &bStop, &qwWriterCpu );
+
+    usleep( ( useconds_t )( dSeconds * 1e6 ) );
+    bStop = true;
+    WriterThread.join();
+
+    // the little the pty still holds is read before the ports close
+    UINT64 qwElapsed = SerialMetricsNow() - qwStart;
+    UINT64 qwCpu = CpuNow( CLOCK_PROCESS_CPUTIME_ID ) - qwCpuStart - qwWriterCpu;
+
+    Port.Close();
+    RuntimePort.Close();
+    s_InlinePort.Close();
+    close( nMaster );
+
+    UINT64 qwLines = pSink->qwNext;
+    UINT64 qwBytes = pSink->qwBytes;
+
+    BOOL bOk = ( pSink->qwBroken == 0 ) && ( qwLines > 0 );
+
+    printf( "pty,%s,%u,%.1f,%.0f,%.1f,%llu,%s\n", s_pszPaths[Path], nFrame, ( double )qwBytes * 1e3 / ( double )qwElapsed,
+            ( double )qwLines * 1e9 / ( double )qwElapsed, ( qwLines > 0 ) ? ( double )qwCpu / ( double )qwLines : 0.0,
+            ( unsigned long long )pSink->qwBroken, bOk ? "ok" : "FAILED" );
+    return bOk;
+}
+
+// the decode and delivery path alone, from memory in reads of BENCH_READ_SIZE
+static BOOL RunDecode( BENCH_PATH Path, UINT nFrame )
+{
+    std::vector<BYTE> Block;
+    std::vector<BYTE> Storage( SERIAL_FRAME_MAX_SIZE );
+    CSerialLineFramer LineFramer( '\n', FALSE );
+    CSerialRuntimeFramer RuntimeFramer;
+    CSerialCallbackNotifier Callback;
+    CSerialDelimiterFramer< '\n', false > InlineFramer;
+    BENCH_SINK Sink;
+    UINT64 qwFirst = 0;
+
+    memset( &Sink, 0, sizeof( Sink ) );
+    Sink.nLength = nFrame - 1;
+    FillBlock( &Block, nFrame );
+    LineFramer.SetCallback( OnLine, &Sink );
+    Callback.SetCallback( OnLine, &Sink );
+    RuntimeFramer.SetFramer( &LineFramer );
+    RuntimeFramer.Attach( &Storage[0], SERIAL_FRAME_MAX_SIZE );
+    RuntimeFramer.Bind( &Callback );
+    InlineFramer.Attach( &Storage[0], SERIAL_FRAME_MAX_SIZE );
+
+    UINT64 qwStart = SerialMetricsNow();
+
+    while ( Sink.qwBytes < BENCH_DECODE_BYTES )
+    {
+        Renumber( &Block, nFrame, qwFirst );
+        qwFirst += BENCH_BLOCK_LINES;
+
+        for ( size_t nOffset = 0; nOffset < Block.size(); nOffset += BENCH_READ_SIZE )
+        {
+            UINT nRead = ( UINT )( ( Block.size() - nOffset < BENCH_READ_SIZE ) ? Block.size() - nOffset : BENCH_READ_SIZE );
+
+            if ( Path == BENCH_SERIAL_PORT )
+            {
+                LineFramer.Feed( &Block[nOffset], nRead, 0 );
+            }
+            else if ( Path == BENCH_RUNTIME )
+            {
+                RuntimeFramer.Feed( &Block[nOffset], nRead, 0, Callback );
+            }
+            else
+            {
+                InlineFramer.Feed( &Block[nOffset], nRead, 0, Sink );
+            }
+        }
+    }
+
+    UINT64 qwElapsed = SerialMetricsNow() - qwStart;
+    BOOL bOk = ( Sink.qwBroken == 0 );
+
+    printf( "decode,%s,%u,%.1f,%.0f,%.1f,%llu,%s\n", s_pszPaths[Path], nFrame, ( double )Sink.qwBytes * 1e3 / ( double )qwElapsed,
+            ( double )Sink.qwNext * 1e9 / ( double )qwElapsed, ( double )qwElapsed / ( double )Sink.qwNext,
+            ( unsigned long long )Sink.qwBroken, bOk ? "ok" : "FAILED" );
+    return bOk;
+}
+
+int main( int argc, char *argv[] )
+{
+    UINT nFrame = 64;
+    double dSeconds = 2.0;
+    int nResult = 0;
+
+    for ( int i = 1; i + 1 < argc; i += 2 )
+    {
+        if ( strcmp( argv[i], "--frame" ) == 0 )
+        {
+            nFrame = ( UINT )strtoul( argv[i + 1], NULL, 10 );
+        }
+        else if ( strcmp( argv[i], "--seconds" ) == 0 )
+        {
+            dSeconds = atof( argv[i + 1] );
+        }
+        else
+        {
+            fprintf( stderr, "usage: %s [--frame 64] [--seconds 2]\n", argv[0] );
+            return 2;
+        }
+    }
+
+    if ( ( nFrame < 9 ) || ( nFrame > SERIAL_FRAME_MAX_SIZE ) )
+    {
+        fprintf( stderr, "--frame is 9 to %lu bytes with the '\\n'\n", SERIAL_FRAME_MAX_SIZE );
+        return 2;
+    }
+
+    // ns_per_line: CPU time of the receiving side for pty, wall time for decode
+    printf( "workload,path,frame,mb_per_s,lines_per_s,ns_per_line,broken,result\n" );
+
+    for ( int p = BENCH_SERIAL_PORT; p <= BENCH_INLINE; p++ )
+    {
+        nResult = RunPty( ( BENCH_PATH )p, nFrame, dSeconds ) ? nResult : 1;
+    }
+
+    for ( int p = BENCH_SERIAL_PORT; p <= BENCH_INLINE; p++ )
+    {
+        nResult = RunDecode( ( BENCH_PATH )p, nFrame ) ? nResult : 1;
+    }
+
+    return nResult;
+}
+
+#else
+
+#include <stdio.h>
+
+int main()
+{
+    fprintf( stderr, "the basic port benchmark needs pseudo-terminals (POSIX)\n" );
+    return 1;
+}
+
+#endif
@@ -0,0 +1,482 @@
+/*
+**  FILENAME            SerialBridgeBench.cpp
+**
+**  PURPOSE             Bridges ports on pseudo-terminals to localhost TCP (splice
+**                      and copy) and UDP. The master side of every pty echoes what
+**                      it gets, one client per session keeps a window of numbered
+**                      messages in flight through socket, bridge, port, echo and
+**                      back. Prints the throughput, the round trip and the bridge's
+**                      per-direction latency and backlog for 1 to 64 sessions.
+**                      Exits with 1 when a message is lost, altered or reordered,
+**                      or a TCP session in splice mode copied.
+**
+**                      g++ -O2 -std=c++11 -I.. SerialBridgeBench.cpp ../Serial*.cpp -lpthread -lutil
+**                      ./a.out --sessions 1,16,64 --window 16 --seconds 1
+**
+**  CREATION DATE       16-10-2026
+**  LAST MODIFICATION   16-10-2026
+*/
+
+#ifndef _WIN32
+
+#include "SerialBridge.h"
+
+#ifdef SERIAL_PORT_REACTOR
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <pty.h>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define BENCH_MESSAGE_SIZE  256                 /* sequence, send time, pattern */
+#define BENCH_DRAIN_NS      2000000000ULL       /* for the window to come back after the run */
+#define BENCH_MAX_SESSIONS  256
+
+typedef enum _BENCH_MODE
+{
+    BENCH_TCP_SPLICE,
+    BENCH_TCP_COPY,
+    BENCH_UDP
+} BENCH_MODE;
+
+static const char *s_pszModes[] = { "tcp-splice", "tcp-copy", "udp" };
+
+// reused by every run, the ports are cache line aligned
+static CSerialPort s_Ports[BENCH_MAX_SESSIONS];
+
+typedef struct _BENCH_ECHO
+{
+    int                 nMaster;
+    std::string         Pending;                // read, not written back yet
+} BENCH_ECHO;
+
+typedef struct _BENCH_CLIENT
+{
+    int                 nSocket;
+    UINT64              qwSent;                 // messages
+    UINT64              qwReceived;
+    std::string         Out;                    // TCP, not taken by the socket yet
+    std::string         In;                     // a partial message
+} BENCH_CLIENT;
+
+// the pty is the far end of the line and sends everything back
+static void Echo( std::vector<BENCH_ECHO> *pEchoes, std::atomic<bool> *pbStop )
+{
+    std::vector<struct pollfd> Fds( pEchoes->size() );
+    static char Buffer[1 << 16];
+
+    while ( !*pbStop )
+    {
+        for ( size_t i = 0; i < pEchoes->size(); i++ )
+        {
+            Fds[i].fd = ( *pEchoes )[i].nMaster;
+            Fds[i].events = POLLIN | ( ( *pEchoes )[i].Pending.empty() ? 0 : POLLOUT );
+            Fds[i].revents = 0;
+        }
+
+        if ( poll( &Fds[0], Fds.size(), 10 ) <= 0 )
+        {
+            continue;
+        }
+
+        for ( size_t i = 0; i < pEchoes->size(); i++ )
+        {
+            BENCH_ECHO *pEcho = &( *pEchoes )[i];
+            ssize_t n;
+
+            if ( ( Fds[i].revents & POLLIN ) && ( ( n = read( pEcho->nMaster, Buffer, sizeof( Buffer ) ) ) > 0 ) )
+            {
+                pEcho->Pending.append( Buffer, ( size_t )n );
+            }
+
+            if ( !pEcho->Pending.empty() && ( ( n = write( pEcho->nMaster, pEcho->Pending.data(), pEcho->Pending.size() ) ) > 0 ) )
+            {
+                pEcho->Pending.erase( 0, ( size_t )n );
+            }
+        }
+    }
+}
+
+static void MakeMessage( UINT64 qwSequence, char *pMessage )
+{
+    UINT64 qwNow = SerialMetricsNow();
+
+    memcpy( pMessage, &qwSequence, sizeof( qwSequence ) );
+    memcpy( pMessage + 8, &qwNow, sizeof( qwNow ) );
+
+    for ( UINT i = 16; i < BENCH_MESSAGE_SIZE; i++ )
+    {
+        pMessage[i] = ( char )( qwSequence + i );
+    }
+}
+
+// the next message in order and intact, records the round trip
+static BOOL CheckMessage( BENCH_CLIENT *pClient, const char *pMessage, CSerialHistogram *pRtt )
+{
+    UINT64 qwSequence;
+    UINT64 qwSent;
+
+    memcpy( &qwSequence, pMessage, sizeof( qwSequence ) );
+    memcpy( &qwSent, pMessage + 8, sizeof( qwSent ) );
+
+    if ( qwSequence != pClient->qwReceived )
+    {
+        return FALSE;
+    }
+
+    for ( UINT i = 16; i < BENCH_MESSAGE_SIZE; i++ )
+    {
+        if ( pMessage[i] != ( char )( qwSequence + i ) )
+        {
+            return FALSE;
+        }
+    }
+
+    pClient->qwReceived++;
+    pRtt->Record( SerialMetricsNow() - qwSent );
+    return TRUE;
+}
+
+static void AddHistogram( SERIAL_HISTOGRAM *pTotal, const SERIAL_HISTOGRAM *pHistogram )
+{
+    if ( pHistogram->qwCount == 0 )
+    {
+        return;
+    }
+
+    pTotal->qwMin = ( ( pTotal->qwCount == 0 ) || ( pHistogram->qwMin < pTotal->qwMin ) ) ? pHistogram->qwMin : pTotal->qwMin;
+    pTotal->qwMax = ( pHistogram->qwMax > pTotal->qwMax ) ? pHistogram->qwMax : pTotal->qwMax;
+    pTotal->qwCount += pHistogram->qwCount;
+    pTotal->qwSum += pHistogram->qwSum;
+
+    for ( UINT i = 0; i < SERIAL_HISTOGRAM_BUCKETS; i++ )
+    {
+        pTotal->qwBuckets[i] += pHistogram->qwBuckets[i];
+    }
+}
+
+static int Connect( BENCH_MODE Mode, WORD nPort )
+{
+    struct sockaddr_in Address;
+    int nOn = 1;
+    int nSocket = socket( AF_INET, ( Mode == BENCH_UDP ) ? SOCK_DGRAM : SOCK_STREAM, 0 );
+
+    memset( &Address, 0, sizeof( Address ) );
+    Address.sin_family = AF_INET;
+    Address.sin_port = htons( nPort );
+    Address.sin_addr.s_addr = htonl( INADDR_LOOPBACK );
+
+    if ( ( nSocket < 0 ) || ( connect( nSocket, ( struct sockaddr * )&Address, sizeof( Address ) ) != 0 ) )
+    {
+        perror( "connect()" );
+        exit( 1 );
+    }
+
+    setsockopt( nSocket, IPPROTO_TCP, TCP_NODELAY, &nOn, sizeof( nOn ) );
+    fcntl( nSocket, F_SETFL, fcntl( nSocket, F_GETFL ) | O_NONBLOCK );
+    return nSocket;
+}
+
+// sends up to the window, returns FALSE on a broken message
+static BOOL Pump( BENCH_MODE Mode, BENCH_CLIENT *pClient, UINT nWindow, BOOL bSend, CSerialHistogram *pRtt )
+{
+    char Buffer[65536];
+    ssize_t n;
+
+    while ( bSend && ( pClient->qwSent - pClient->qwReceived < nWindow ) )
+    {
+        char Message[BENCH_MESSAGE_SIZE];
+        MakeMessage( pClient->qwSent, Message );
+
+        if ( Mode == BENCH_UDP )
+        {
+            if ( send( pClient->nSocket, Message, sizeof( Message ), 0 ) != sizeof( Message ) )
+            {
+                break;
+            }
+        }
+        else
+        {
+            pClient->Out.append( Message, sizeof( Message ) );
+        }
+
+        pClient->qwSent++;
+    }
+
+    if ( !pClient->Out.empty() && ( ( n = send( pClient->nSocket, pClient->Out.data(), pClient->Out.size(), MSG_NOSIGNAL ) ) > 0 ) )
+    {
+        pClient->Out.erase( 0, ( size_t )n );
+    }
+
+    // the port reads in its own pieces, UDP datagrams do not keep message bounds either
+    while ( ( n = recv( pClient->nSocket, Buffer, sizeof( Buffer ), 0 ) ) > 0 )
+    {
+        pClient->In.append( Buffer, ( size_t )n );
+    }
+
+    size_t nUsed = 0;
+
+    for ( ; nUsed + BENCH_MESSAGE_SIZE <= pClient->In.size(); nUsed += BENCH_MESSAGE_SIZE )
+    {
+        if ( !CheckMessage( pClient, pClient->In.data() + nUsed, pRtt ) )
+        {
+            return FALSE;
+        }
+    }
+
+    pClient->In.erase( 0, nUsed );
+    return TRUE;
+}
+
+int main( int argc, char *argv[] )
+{
+    std::vector<UINT> Sessions;
+    UINT nWindow = 16;
+    double dSeconds = 1.0;
+    int nResult = 0;
+
+    for ( int i = 1; i + 1 < argc; i += 2 )
+    {
+        if ( strcmp( argv[i], "--sessions" ) == 0 )
+        {
+            for ( char *p = argv[i + 1]; *p != '\0'; p += ( *p == ',' ) ? 1 : 0 )
+            {
+                Sessions.push_back( ( UINT )strtoul( p, &p, 10 ) );
+            }
+        }
+        else if ( strcmp( argv[i], "--window" ) == 0 )
+        {
+            nWindow = ( UINT )strtoul( argv[i + 1], NULL, 10 );
+        }
+        else if ( strcmp( argv[i], "--seconds" ) == 0 )
+        {
+            dSeconds = atof( argv[i + 1] );
+        }
+        else
+        {
+            fprintf( stderr, "usage: %s [--sessions 1,16,64] [--window 16] [--seconds 1]\n", argv[0] );
+            return 2;
+        }
+    }
+
+    for ( size_t s = 0; s < Sessions.size(); s++ )
+    {
+        if ( ( Sessions[s] == 0 ) || ( Sessions[s] > BENCH_MAX_SESSIONS ) )
+        {
+            fprintf( stderr, "1 to %u sessions\n", BENCH_MAX_SESSIONS );
+            return 2;
+        }
+    }
+
+    if ( Sessions.empty() )
+    {
+        Sessions.push_back( 1 );
+        Sessions.push_back( 16 );
+        Sessions.push_back( 64 );
+    }
+
+    printf( "mode,sessions,window,mb_per_s,rtt_p50_us,rtt_p99_us,to_port_p99_us,to_socket_p99_us,"
+            "port_backlog_max,socket_backlog_max,spliced_pct,dropped,broken,result\n" );
+
+    for ( int m = BENCH_TCP_SPLICE; m <= BENCH_UDP; m++ )
+    {
+        for ( size_t s = 0; s < Sessions.size(); s++ )
+        {
+            UINT nSessions = Sessions[s];
+            std::vector<BENCH_ECHO> Echoes( nSessions );
+            std::vector<BENCH_CLIENT> Clients( nSessions );
+            std::vector<struct pollfd> Fds( nSessions );
+            std::atomic<bool> bEchoStop( false );
+            CSerialHistogram Rtt;
+            SERIAL_HISTOGRAM RttTotal;
+            SERIAL_HISTOGRAM ToPort;
+            SERIAL_HISTOGRAM ToSocket;
+            CSerialBridge Bridge;
+            UINT64 qwPortBacklog = 0;
+            UINT64 qwSocketBacklog = 0;
+            UINT64 qwToPort = 0;
+            UINT64 qwSpliced = 0;
+            UINT64 qwDropped = 0;
+            UINT nBroken = 0;
+
+            memset( &ToPort, 0, sizeof( ToPort ) );
+            memset( &ToSocket, 0, sizeof( ToSocket ) );
+
+            if ( !Bridge.Start() )
+            {
+                perror( "CSerialBridge::Start()" );
+                return 1;
+            }
+
+            for ( UINT i = 0; i < nSessions; i++ )
+            {
+                struct termios tio;
+                char szName[128];
+                int nSlave;
+                int nSession;
+
+                if ( openpty( &Echoes[i].nMaster, &nSlave, szName, NULL, NULL ) != 0 )
+                {
+                    perror( "openpty()" );
+                    return 1;
+                }
+
+                tcgetattr( Echoes[i].nMaster, &tio );
+                cfmakeraw( &tio );
+                tcsetattr( Echoes[i].nMaster, TCSANOW, &tio );
+                fcntl( Echoes[i].nMaster, F_SETFL, fcntl( Echoes[i].nMaster, F_GETFL ) | O_NONBLOCK );
+
+                CSerialPort *pPort = &s_Ports[i];
+
+                if ( m == BENCH_UDP )
+                {
+                    nSession = Bridge.ConnectUdp( pPort, "127.0.0.1", 0 );
+                }
+                else
+                {
+                    nSession = Bridge.ListenTcp( pPort, "127.0.0.1", 0, ( m == BENCH_TCP_SPLICE ) ? SERIAL_BRIDGE_SPLICE : 0 );
+                }
+
+                // the write buffer holds what the bridge queues before it stops reading
+                if ( ( nSession < 0 ) ||
+                     !pPort->OpenDevice( NULL, szName, 921600, NOPARITY, 8, ONESTOPBIT, 0, 2 * SERIAL_BRIDGE_MAX_QUEUED ) )
+                {
+                    fprintf( stderr, "session %u could not be set up\n", i );
+                    return 1;
+                }
+
+                close( nSlave );
+                Clients[i].nSocket = Connect( ( BENCH_MODE )m, Bridge.GetLocalPort( nSession ) );
+                Clients[i].qwSent = 0;
+                Clients[i].qwReceived = 0;
+            }
+
+            std::thread EchoThread( Echo, &Echoes, &bEchoStop );
+            UINT64 qwStart = SerialMetricsNow();
+            UINT64 qwEnd = qwStart + ( UINT64 )( dSeconds * 1e9 );
+            UINT64 qwNow = qwStart;
+            UINT64 qwSent = 0;
+            UINT64 qwReceived = 0;
+
+            // after the run the window comes back without new messages
+            while ( ( qwNow < qwEnd ) || ( ( qwNow < qwEnd + BENCH_DRAIN_NS ) && ( qwReceived < qwSent ) ) )
+            {
+                BOOL bSend = ( qwNow < qwEnd );
+
+                for ( UINT i = 0; i < nSessions; i++ )
+                {
+                    if ( ( Clients[i].nSocket >= 0 ) && !Pump( ( BENCH_MODE )m, &Clients[i], nWindow, bSend, &Rtt ) )
+                    {
+                        nBroken++;
+                        close( Clients[i].nSocket );
+                        Clients[i].nSocket = -1;
+                    }
+
+                    Fds[i].fd = Clients[i].nSocket;
+                    Fds[i].events = POLLIN | ( Clients[i].Out.empty() ? 0 : POLLOUT );
+                }
+
+                poll( &Fds[0], Fds.size(), 1 );
+                qwNow = SerialMetricsNow();
+
+                qwSent = 0;
+                qwReceived = 0;
+
+                for ( UINT i = 0; i < nSessions; i++ )
+                {
+                    qwSent += Clients[i].qwSent;
+                    qwReceived += Clients[i].qwReceived;
+                }
+
+                for ( UINT i = 0; ( i < nSessions ) && bSend; i++ )
+                {
+                    SERIAL_BRIDGE_STATS Stats;
+                    Bridge.GetStats( ( int )i, &Stats );
+                    qwPortBacklog = ( Stats.nPortBacklog > qwPortBacklog ) ? Stats.nPortBacklog : qwPortBacklog;
+                    qwSocketBacklog = ( Stats.nSocketBacklog > qwSocketBacklog ) ? Stats.nSocketBacklog : qwSocketBacklog;
+                }
+            }
+
+            for ( UINT i = 0; i < nSessions; i++ )
+            {
+                SERIAL_BRIDGE_STATS Stats;
+                Bridge.GetStats( ( int )i, &Stats );
+                AddHistogram( &ToPort, &Stats.ToPort );
+                AddHistogram( &ToSocket, &Stats.ToSocket );
+                qwToPort += Stats.qwToPort;
+                qwSpliced += Stats.qwSpliced;
+                qwDropped += Stats.qwDropped;
+                // a message the window never got back
+                nBroken += ( Clients[i].qwReceived != Clients[i].qwSent ) ? 1 : 0;
+            }
+
+            for ( UINT i = 0; i < nSessions; i++ )
+            {
+                s_Ports[i].Close();
+
+                if ( Clients[i].nSocket >= 0 )
+                {
+                    close( Clients[i].nSocket );
+                }
+            }
+
+            Bridge.Stop();
+            bEchoStop = true;
+            EchoThread.join();
+
+            for ( UINT i = 0; i < nSessions; i++ )
+            {
+                close( Echoes[i].nMaster );
+            }
+
+            Rtt.Snapshot( &RttTotal, FALSE );
+            double dSpliced = ( qwToPort > 0 ) ? 100.0 * ( double )qwSpliced / ( double )qwToPort : 0.0;
+            BOOL bOk = ( nBroken == 0 ) && ( qwReceived > 0 ) && ( ( m != BENCH_TCP_SPLICE ) || ( qwSpliced == qwToPort ) );
+            nResult = bOk ? nResult : 1;
+
+            printf( "%s,%u,%u,%.2f,%.1f,%.1f,%.1f,%.1f,%llu,%llu,%.1f,%llu,%u,%s\n", s_pszModes[m], nSessions, nWindow,
+                    ( double )qwReceived * BENCH_MESSAGE_SIZE * 1e3 / ( double )( qwNow - qwStart ),
+                    SerialHistogramPercentile( &RttTotal, 0.5 ) / 1000.0, SerialHistogramPercentile( &RttTotal, 0.99 ) / 1000.0,
+                    SerialHistogramPercentile( &ToPort, 0.99 ) / 1000.0, SerialHistogramPercentile( &ToSocket, 0.99 ) / 1000.0,
+                    ( unsigned long long )qwPortBacklog, ( unsigned long long )qwSocketBacklog, dSpliced,
+                    ( unsigned long long )qwDropped, nBroken, bOk ? "ok" : "FAILED" );
+        }
+    }
+
+    return nResult;
+}
+
+#else
+
+#include <stdio.h>
+
+int main()
+{
+    fprintf( stderr, "the bridge benchmark needs epoll and splice (Linux)\n" );
+    return 1;
+}
+
+#endif // SERIAL_PORT_REACTOR
+
+#else
+
+#include <stdio.h>
+
+int main()
+{
+    fprintf( stderr, "the bridge benchmark needs pseudo-terminals (POSIX)\n" );
+    return 1;
+}
+
+#endif
@@ -0,0 +1,400 @@
+/*
+**  FILENAME            SerialBroadcastBench.cpp
+**
+**  PURPOSE             Fan-out of one received stream to 1 to 16 subscribers of a
+**                      CSerialBroadcast. A producer publishes a counting pattern from
+**                      memory, then a pty streams it into an attached port; every
+**                      subscriber runs on its own thread, checks each byte in place
+**                      and prints the stream and the delivered MB/s, the age of the
+**                      data when consumed, the largest lag and how long the
+**                      producer was held. A last run mixes the overflow policies
+**                      behind a fast subscriber: one which drops the oldest data
+**                      and one which is detached. Exits with 1 when a byte is lost
+**                      or altered where the policy does not allow it.
+**
+**                      g++ -O2 -std=c++11 -I.. SerialBroadcastBench.cpp ../Serial*.cpp -lpthread -lutil
+**                      ./a.out --subscribers 1,2,4,8,16 --mb 64 --seconds 2
+**
+**  CREATION DATE       16-10-2026
+**  LAST MODIFICATION   16-10-2026
+*/
+
+#ifndef _WIN32
+
+#include "SerialBroadcast.h"
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#if defined( __APPLE__ ) || defined( __FreeBSD__ )
+#include <util.h>
+#else
+#include <pty.h>
+#endif
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#define BENCH_PATTERN       251                 /* byte n of the stream is n % 251, not a divisor of any ring */
+#define BENCH_CHUNK         256                 /* bytes per Publish() from memory */
+#define BENCH_SLOW_US       2000                /* the dropping subscriber sleeps after every span */
+
+typedef struct _BENCH_SUBSCRIBER
+{
+    CSerialBroadcast    *pBroadcast;
+    int                 nId;
+    BOOL                bSlow;
+    BOOL                bStalled;               // does not read until it is detached
+    UINT64              qwExpected;             // stream offset of the next byte
+    UINT64              qwBytes;                // checked and intact
+    UINT64              qwBroken;               // altered although Consume() said intact
+    UINT64              qwGaps;                 // a blocking subscriber skipped data
+    UINT64              qwTorn;                 // Consume() said overwritten
+} BENCH_SUBSCRIBER;
+
+static void FillPattern( BYTE *pData, UINT nLength, UINT64 qwPosition )
+{
+    UINT nValue = ( UINT )( qwPosition % BENCH_PATTERN );
+
+    for ( UINT i = 0; i < nLength; i++ )
+    {
+        pData[i] = ( BYTE )nValue;
+        nValue = ( nValue + 1 == BENCH_PATTERN ) ? 0 : nValue + 1;
+    }
+}
+
+static UINT CheckPattern( const BYTE *pData, UINT nLength, UINT64 qwPosition )
+{
+    UINT nValue = ( UINT )( qwPosition % BENCH_PATTERN );
+    UINT nBad = 0;
+
+    for ( UINT i = 0; i < nLength; i++ )
+    {
+        nBad += ( pData[i] != ( BYTE )nValue );
+        nValue = ( nValue + 1 == BENCH_PATTERN ) ? 0 : nValue + 1;
+    }
+
+    return nBad;
+}
+
+static void Subscriber( BENCH_SUBSCRIBER *pSubscriber )
+{
+    CSerialBroadcast *pBroadcast = pSubscriber->pBroadcast;
+
+    for ( int i = 0; pSubscriber->bStalled && !pBroadcast->IsDetached( pSubscriber->nId ) && ( i < 5000 ); i++ )
+    {
+        usleep( 1000 );
+    }
+
+    // FALSE once detached, or closed with everything read
+    while ( pBroadcast->Wait( pSubscriber->nId ) )
+    {
+        const BYTE *pData;
+        UINT64 qwPosition;
+        UINT nSpan;
+
+        while ( ( nSpan = pBroadcast->Peek( pSubscriber->nId, &pData, &qwPosition ) ) > 0 )
+        {
+            UINT nBad = CheckPattern( pData, nSpan, qwPosition );
+
+            if ( qwPosition != pSubscriber->qwExpected )
+            {
+                pSubscriber->qwGaps++;
+            }
+
+            if ( pBroadcast->Consume( pSubscriber->nId, nSpan ) )
+            {
+                pSubscriber->qwBytes += nSpan;
+                pSubscriber->qwBroken += ( nBad != 0 );
+            }
+            else
+            {
+                pSubscriber->qwTorn++;
+            }
+
+            pSubscriber->qwExpected = qwPosition + nSpan;
+
+            if ( pSubscriber->bSlow )
+            {
+                usleep( BENCH_SLOW_US );
+            }
+        }
+    }
+}
+
+static double Us( const SERIAL_HISTOGRAM *pHistogram, double dFraction )
+{
+    return ( double )SerialHistogramPercentile( pHistogram, dFraction ) / 1e3;
+}
+
+// writes the pattern into the master until the time is up, returns the bytes written
+static UINT64 Writer( int nMaster, double dSeconds )
+{
+    std::vector<BYTE> Block( 4096 );
+    UINT64 qwPosition = 0;
+    UINT64 qwEnd = SerialMetricsNow() + ( UINT64 )( dSeconds * 1e9 );
+
+    while ( SerialMetricsNow() < qwEnd )
+    {
+        FillPattern( &Block[0], ( UINT )Block.size(), qwPosition );
+        size_t nDone = 0;
+
+        while ( nDone < Block.size() )
+        {
+            ssize_t n = write( nMaster, &Block[nDone], Block.size() - nDone );
+
+            if ( n > 0 )
+            {
+                nDone += ( size_t )n;
+            }
+            else
+            {
+                struct pollfd Fd = { nMaster, POLLOUT, 0 };
+                poll( &Fd, 1, 10 );
+            }
+        }
+
+        qwPosition += Block.size();
+    }
+
+    return qwPosition;
+}
+
+/*
+** pszSource "memory" or "pty"; Overflows NULL is nSubscribers blocking ones. Prints one
+** line per run, the age and the lag are the worst subscriber's.
+*/
+static BOOL Run( const char *pszSource, UINT nSubscribers, const SERIAL_BROADCAST_OVERFLOW *pOverflows,
+                 UINT nRing, UINT64 qwBytes, double dSeconds )
+{
+    static const char *s_pszPolicies[] = { "block", "drop-oldest", "detach" };
+    CSerialBroadcast Broadcast( nRing );
+    CSerialBroadcast *pBroadcast = &Broadcast;
+    std::vector<BENCH_SUBSCRIBER> Subscribers( nSubscribers );
+    std::vector<std::thread> Threads;
+    SERIAL_BROADCAST_STATS *pStats = new SERIAL_BROADCAST_STATS;
+    SERIAL_HISTOGRAM *pAge = new SERIAL_HISTOGRAM;
+    UINT64 qwPublished = 0;
+    BOOL bOk = TRUE;
+    CSerialPort Port;
+    int nMaster = -1;
+
+    for ( UINT i = 0; i < nSubscribers; i++ )
+    {
+        SERIAL_BROADCAST_OVERFLOW Overflow = ( pOverflows != NULL ) ? pOverflows[i] : SERIAL_BROADCAST_BLOCK;
+        memset( &Subscribers[i], 0, sizeof( Subscribers[i] ) );
+        Subscribers[i].pBroadcast = pBroadcast;
+        Subscribers[i].nId = pBroadcast->Subscribe( Overflow );
+        Subscribers[i].bSlow = ( Overflow == SERIAL_BROADCAST_DROP_OLDEST );
+        Subscribers[i].bStalled = ( Overflow == SERIAL_BROADCAST_DETACH );
+    }
+
+    if ( strcmp( pszSource, "pty" ) == 0 )
+    {
+        struct termios tio;
+        char szName[128];
+        int nSlave;
+
+        if ( openpty( &nMaster, &nSlave, szName, NULL, NULL ) != 0 )
+        {
+            perror( "openpty()" );
+            return FALSE;
+        }
+
+        tcgetattr( nMaster, &tio );
+        cfmakeraw( &tio );
+        tcsetattr( nMaster, TCSANOW, &tio );
+        fcntl( nMaster, F_SETFL, fcntl( nMaster, F_GETFL ) | O_NONBLOCK );
+        pBroadcast->Attach( &Port );
+
+        if ( !Port.OpenDevice( NULL, szName, 921600 ) )
+        {
+            fprintf( stderr, "%s could not be opened\n", szName );
+            return FALSE;
+        }
+
+        close( nSlave );
+    }
+
+    for ( UINT i = 0; i < nSubscribers; i++ )
+    {
+        Threads.push_back( std::thread( Subscriber, &Subscribers[i] ) );
+    }
+
+    UINT64 qwStart = SerialMetricsNow();
+
+    if ( nMaster >= 0 )
+    {
+        qwPublished = Writer( nMaster, dSeconds );
+
+        // what the pty still holds is read before the port closes
+        for ( int i = 0; ( i < 200 ) && ( pBroadcast->GetStats( Subscribers[0].nId, pStats ), pStats->qwPublished < qwPublished ); i++ )
+        {
+            usleep( 10000 );
+        }
+
+        Port.Close();
+        close( nMaster );
+    }
+    else
+    {
+        std::vector<BYTE> Chunk( BENCH_CHUNK );
+
+        while ( qwPublished < qwBytes )
+        {
+            FillPattern( &Chunk[0], BENCH_CHUNK, qwPublished );
+            pBroadcast->Publish( &Chunk[0], BENCH_CHUNK, SerialMetricsNow() );
+            qwPublished += BENCH_CHUNK;
+        }
+    }
+
+    pBroadcast->Close();
+
+    for ( size_t i = 0; i < Threads.size(); i++ )
+    {
+        Threads[i].join();
+    }
+
+    UINT64 qwElapsed = SerialMetricsNow() - qwStart;
+    UINT64 qwDelivered = 0;
+    UINT64 qwBlockedNs = 0;
+    UINT nMaxLag = 0;
+
+    memset( pAge, 0, sizeof( *pAge ) );
+
+    for ( UINT i = 0; i < nSubscribers; i++ )
+    {
+        BENCH_SUBSCRIBER &Subscriber = Subscribers[i];
+        SERIAL_BROADCAST_OVERFLOW Overflow = ( pOverflows != NULL ) ? pOverflows[i] : SERIAL_BROADCAST_BLOCK;
+        BOOL bSubscriberOk;
+
+        pBroadcast->GetStats( Subscriber.nId, pStats );
+        qwDelivered += Subscriber.qwBytes;
+        qwBlockedNs += pStats->qwBlockedNs;
+        nMaxLag = ( pStats->nMaxLag > nMaxLag ) ? pStats->nMaxLag : nMaxLag;
+
+        if ( Us( &pStats->Age, 0.99 ) >= Us( pAge, 0.99 ) )
+        {
+            *pAge = pStats->Age;
+        }
+
+        // an intact span is never altered; a blocking subscriber sees all, without gaps
+        bSubscriberOk = ( Subscriber.qwBroken == 0 ) && ( pStats->qwRead == Subscriber.qwBytes );
+
+        if ( Overflow == SERIAL_BROADCAST_BLOCK )
+        {
+            bSubscriberOk = bSubscriberOk && ( Subscriber.qwBytes == qwPublished ) && ( Subscriber.qwGaps == 0 ) &&
+                            ( Subscriber.qwTorn == 0 );
+        }
+        else if ( ( pOverflows != NULL ) && ( Overflow == SERIAL_BROADCAST_DROP_OLDEST ) )
+        {
+            bSubscriberOk = bSubscriberOk && ( pStats->qwDropped > 0 ) && ( Subscriber.qwBytes > 0 );
+        }
+        else if ( pOverflows != NULL )
+        {
+            bSubscriberOk = bSubscriberOk && pStats->bDetached;
+        }
+
+        if ( pOverflows != NULL )
+        {
+            printf( "%s,policies,%s,%llu,%llu,%llu,%s\n", pszSource, s_pszPolicies[Overflow],
+                    ( unsigned long long )Subscriber.qwBytes, ( unsigned long long )pStats->qwDropped,
+                    ( unsigned long long )Subscriber.qwTorn, bSubscriberOk ? "ok" : "FAILED" );
+        }
+
+        bOk = bOk && bSubscriberOk;
+    }
+
+    if ( pOverflows == NULL )
+    {
+        printf( "%s,%u,%.1f,%.1f,%.1f,%.1f,%.1f,%u,%.1f,%s\n", pszSource, nSubscribers,
+                ( double )qwPublished * 1e3 / ( double )qwElapsed, ( double )qwDelivered * 1e3 / ( double )qwElapsed,
+                Us( pAge, 0.5 ), Us( pAge, 0.99 ), ( double )pAge->qwMax / 1e3, nMaxLag, ( double )qwBlockedNs / 1e6,
+                bOk ? "ok" : "FAILED" );
+    }
+
+    delete pAge;
+    delete pStats;
+    return bOk;
+}
+
+int main( int argc, char *argv[] )
+{
+    std::vector<UINT> Counts;
+    UINT64 qwBytes = 64ULL << 20;
+    double dSeconds = 2.0;
+    int nResult = 0;
+
+    for ( int i = 1; i + 1 < argc; i += 2 )
+    {
+        if ( strcmp( argv[i], "--subscribers" ) == 0 )
+        {
+            for ( char *p = argv[i + 1]; *p != '\0'; p += ( *p == ',' ) ? 1 : 0 )
+            {
+                Counts.push_back( ( UINT )strtoul( p, &p, 10 ) );
+            }
+        }
+        else if ( strcmp( argv[i], "--mb" ) == 0 )
+        {
+            qwBytes = strtoull( argv[i + 1], NULL, 10 ) << 20;
+        }
+        else if ( strcmp( argv[i], "--seconds" ) == 0 )
+        {
+            dSeconds = atof( argv[i + 1] );
+        }
+        else
+        {
+            fprintf( stderr, "usage: %s [--subscribers 1,2,4,8,16] [--mb 64] [--seconds 2]\n", argv[0] );
+            return 2;
+        }
+    }
+
+    if ( Counts.empty() )
+    {
+        UINT nDefault[] = { 1, 2, 4, 8, 16 };
+        Counts.assign( nDefault, nDefault + 5 );
+    }
+
+    for ( size_t i = 0; i < Counts.size(); i++ )
+    {
+        if ( ( Counts[i] < 1 ) || ( Counts[i] > SERIAL_BROADCAST_SUBSCRIBERS ) )
+        {
+            fprintf( stderr, "--subscribers are 1 to %d\n", SERIAL_BROADCAST_SUBSCRIBERS );
+            return 2;
+        }
+    }
+
+    // age: publish until consumed, of the subscriber with the worst p99; lag and blocked of all
+    printf( "source,subscribers,stream_mb_per_s,delivered_mb_per_s,age_p50_us,age_p99_us,age_max_us,max_lag,blocked_ms,result\n" );
+
+    for ( size_t i = 0; i < Counts.size(); i++ )
+    {
+        nResult = Run( "memory", Counts[i], NULL, SERIAL_BROADCAST_SIZE, qwBytes, dSeconds ) ? nResult : 1;
+    }
+
+    for ( size_t i = 0; i < Counts.size(); i++ )
+    {
+        nResult = Run( "pty", Counts[i], NULL, SERIAL_BROADCAST_SIZE, qwBytes, dSeconds ) ? nResult : 1;
+    }
+
+    // a small ring, so the slow and the stalled subscriber fall behind
+    static const SERIAL_BROADCAST_OVERFLOW s_Mixed[] = { SERIAL_BROADCAST_BLOCK, SERIAL_BROADCAST_DROP_OLDEST, SERIAL_BROADCAST_DETACH };
+
+    printf( "source,policies,overflow,intact_bytes,dropped_bytes,torn_spans,result\n" );
+    nResult = Run( "memory", 3, s_Mixed, 65536, qwBytes / 4, dSeconds ) ? nResult : 1;
+    return nResult;
+}
+
+#else
+
+#include <stdio.h>
+
+int main()
+{
+    fprintf( stderr, "the broadcast benchmark needs pseudo-terminals (POSIX)\n" );
+    return 1;
+}
+
+#endif
@@ -0,0 +1,494 @@
+/*
+**  FILENAME            SerialBufferPoolBench.cpp
+**
+**  PURPOSE             Counts every operator new of the process while ports run a
+**                      loopback over pseudo-terminals: lines go out as pool buffers
+**                      (WriteBuffer()) and as copies (WriteAsync()), come back as
+**                      received buffers and as decoded frames which a consumer
+**                      thread releases later. After the warm-up the run has to get
+**                      by without a single heap allocation, the exit code says if it
+**                      did. Also times Alloc()/Release() against new/delete.
+**
+**                      g++ -O2 -std=c++11 -I.. SerialBufferPoolBench.cpp ../Serial*.cpp -lpthread -lutil
+**                      ./a.out --ports 4 --seconds 2
+**
+**  CREATION DATE       16-10-2026
+**  LAST MODIFICATION   16-10-2026
+*/
+
+#ifndef _WIN32
+
+#include "SerialPort.h"
+#include "SerialPortReactor.h"
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#if defined( __APPLE__ ) || defined( __FreeBSD__ )
+#include <util.h>
+#else
+#include <pty.h>
+#endif
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <vector>
+
+#define BENCH_WINDOW        8                   /* lines in flight per port */
+#define BENCH_HELD          1024                /* buffers the consumer may hold */
+// inlined, g++ pairs new[] with the free() inside and warns of a mismatch
+#define BENCH_NOINLINE      __attribute__(( noinline ))
+
+typedef std::chrono::steady_clock BenchClock;
+
+static std::atomic<UINT64>  s_qwHeapAllocs( 0 );
+
+BENCH_NOINLINE void *operator new( size_t nSize )
+{
+    void *p;
+    s_qwHeapAllocs.fetch_add( 1, std::memory_order_relaxed );
+
+    if ( ( p = malloc( nSize ? nSize : 1 ) ) == NULL )
+    {
+        throw std::bad_alloc();
+    }
+
+    return p;
+}
+
+BENCH_NOINLINE void *operator new[]( size_t nSize )
+{
+    return operator new( nSize );
+}
+
+BENCH_NOINLINE void *operator new( size_t nSize, const std::nothrow_t & ) noexcept
+{
+    s_qwHeapAllocs.fetch_add( 1, std::memory_order_relaxed );
+    return malloc( nSize ? nSize : 1 );
+}
+
+BENCH_NOINLINE void *operator new[]( size_t nSize, const std::nothrow_t &Tag ) noexcept
+{
+    return operator new( nSize, Tag );
+}
+
+BENCH_NOINLINE void operator delete( void *p ) noexcept
+{
+    free( p );
+}
+
+BENCH_NOINLINE void operator delete[]( void *p ) noexcept
+{
+    free( p );
+}
+
+BENCH_NOINLINE void operator delete( void *p, size_t ) noexcept
+{
+    free( p );
+}
+
+BENCH_NOINLINE void operator delete[]( void *p, size_t ) noexcept
+{
+    free( p );
+}
+
+// buffers handed over by the I/O threads, released later by the consumer thread
+typedef struct _BENCH_HELD_QUEUE
+{
+    std::mutex              Lock;
+    std::condition_variable cvReady;
+    SERIAL_BUFFER           *pBuffers[BENCH_HELD];
+    UINT                    nHead;
+    UINT                    nCount;
+    UINT64                  qwDropped;          // the queue was full, released at once
+} BENCH_HELD_QUEUE;
+
+struct BENCH_PORT
+{
+    CSerialPort             Port;
+    CSerialLineFramer       Framer;
+    int                     nMaster;
+    char                    szName[128];
+    std::mutex              Lock;
+    std::condition_variable cvLine;
+    UINT64                  qwLines;
+    std::atomic<UINT64>     qwRxBytes;
+};
+
+static BENCH_HELD_QUEUE     s_Held;
+
+static void Hold( SERIAL_BUFFER *pBuffer )
+{
+    std::lock_guard<std::mutex> Lock( s_Held.Lock );
+
+    if ( s_Held.nCount == BENCH_HELD )
+    {
+        s_Held.qwDropped++;
+        SerialBufferRelease( pBuffer );
+        return;
+    }
+
+    s_Held.pBuffers[( s_Held.nHead + s_Held.nCount++ ) % BENCH_HELD] = pBuffer;
+    s_Held.cvReady.notify_one();
+}
+
+static void Consume( std::atomic<bool> &bStop )
+{
+    std::unique_lock<std::mutex> Lock( s_Held.Lock );
+
+    while ( !bStop || ( s_Held.nCount > 0 ) )
+    {
+        if ( s_Held.nCount == 0 )
+        {
+            s_Held.cvReady.wait_for( Lock, std::chrono::milliseconds( 10 ) );
+            continue;
+        }
+
+        SERIAL_BUFFER *pBuffer = s_Held.pBuffers[s_Held.nHead];
+        s_Held.nHead = ( s_Held.nHead + 1 ) % BENCH_HELD;
+        s_Held.nCount--;
+        Lock.unlock();
+        SerialBufferRelease( pBuffer );
+        Lock.lock();
+    }
+}
+
+static void OnRxBuffer( void *pContext, SERIAL_BUFFER *pBuffer )
+{
+    ( ( BENCH_PORT * )pContext )->qwRxBytes += pBuffer->nSize;
+    Hold( pBuffer );
+}
+
+static void OnLine( void *pContext, SERIAL_BUFFER *pFrame )
+{
+    BENCH_PORT *pBench = ( BENCH_PORT * )pContext;
+    Hold( pFrame );
+    std::lock_guard<std::mutex> Lock( pBench->Lock );
+    pBench->qwLines++;
+    pBench->cvLine.notify_one();
+}
+
+// sends back whatever arrives
+static void EchoMasters( std::vector<BENCH_PORT *> &Ports, std::atomic<bool> &bStop )
+{
+    std::vector<struct pollfd> Fds( Ports.size() );
+    static BYTE Buffer[65536];
+
+    for ( size_t i = 0; i < Ports.size(); i++ )
+    {
+        Fds[i].fd = Ports[i]->nMaster;
+        Fds[i].events = POLLIN;
+    }
+
+    while ( !bStop )
+    {
+        if ( poll( Fds.data(), Fds.size(), 10 ) <= 0 )
+        {
+            continue;
+        }
+
+        for ( size_t i = 0; i < Fds.size(); i++ )
+        {
+            if ( Fds[i].revents & POLLIN )
+            {
+                ssize_t n = read( Fds[i].fd, Buffer, sizeof( Buffer ) );
+
+                for ( ssize_t nDone = 0; nDone < n; )
+                {
+                    ssize_t w = write( Fds[i].fd, Buffer + nDone, ( size_t )( n - nDone ) );
+                    nDone += ( w > 0 ) ? w : 0;
+                }
+            }
+        }
+    }
+}
+
+// lines of 16..1040 bytes, every other one out of the pool, never more than the window in flight
+static void SendLines( BENCH_PORT *pBench, std::atomic<bool> &bStop, std::atomic<UINT64> &qwLines )
+{
+    CSerialBufferPool *pPool = pBench->Port.GetBufferPool();
+    BYTE Line[1040];
+    UINT64 qwSent = 0;
+    UINT nSeed = ( UINT )( size_t )pBench;
+
+    while ( !bStop )
+    {
+        nSeed = nSeed * 1103515245 + 12345;
+        UINT nSize = 16 + ( nSeed >> 16 ) % 1024;
+        memset( Line, 'a' + ( int )( qwSent % 26 ), nSize - 1 );
+        Line[nSize - 1] = '\n';
+
+        if ( qwSent & 1 )
+        {
+            pBench->Port.WriteAsync( Line, nSize );
+        }
+        else
+        {
+            SERIAL_BUFFER *pBuffer = pPool->Alloc( nSize );
+
+            if ( pBuffer == NULL )
+            {
+                continue;
+            }
+
+            memcpy( pBuffer->pData, Line, nSize );
+            pBench->Port.WriteBuffer( pBuffer );
+            SerialBufferRelease( pBuffer );
+        }
+
+        qwSent++;
+        std::unique_lock<std::mutex> Lock( pBench->Lock );
+        pBench->cvLine.wait_for( Lock, std::chrono::milliseconds( 100 ), [&]() { return pBench->qwLines + BENCH_WINDOW > qwSent; } );
+    }
+
+    std::lock_guard<std::mutex> Lock( pBench->Lock );
+    qwLines += pBench->qwLines;
+}
+
+static double PoolNsPerOp( UINT nThreads, BOOL bPool )
+{
+    CSerialBufferPool Pool;
+    std::vector<std::thread> Threads;
+    const UINT nOps = 2000000;
+    BenchClock::time_point Start = BenchClock::now();
+
+    for ( UINT t = 0; t < nThreads; t++ )
+    {
+        Threads.push_back( std::thread( [&Pool, bPool, t]()
+        {
+            SERIAL_BUFFER *pHeld[4];
+            BYTE *pHeap[4];
+
+            for ( UINT i = 0; i < nOps; i++ )
+            {
+                UINT nSize = 32U << ( ( i + t ) % 6 );
+
+                if ( bPool )
+                {
+                    pHeld[i % 4] = Pool.Alloc( nSize );
+                    pHeld[i % 4]->pData[0] = ( BYTE )i;
+                    SerialBufferRelease( pHeld[i % 4] );
+                }
+                else
+                {
+                    pHeap[i % 4] = new BYTE[nSize];
+                    pHeap[i % 4][0] = ( BYTE )i;
+                    delete [] pHeap[i % 4];
+                }
+            }
+        } ) );
+    }
+
+    for ( size_t t = 0; t < Threads.size(); t++ )
+    {
+        Threads[t].join();
+    }
+
+    return std::chrono::duration<double, std::nano>( BenchClock::now() - Start ).count() / nOps;
+}
+
+int main( int argc, char *argv[] )
+{
+    UINT nPorts = 4;
+    UINT nReactorLoops = 0;
+    double dSeconds = 2.0;
+    double dWarmup = 0.5;
+
+    for ( int i = 1; i + 1 < argc; i += 2 )
+    {
+        if ( strcmp( argv[i], "--ports" ) == 0 )
+        {
+            nPorts = ( UINT )strtoul( argv[i + 1], NULL, 10 );
+        }
+        else if ( strcmp( argv[i], "--seconds" ) == 0 )
+        {
+            dSeconds = atof( argv[i + 1] );
+        }
+        else if ( strcmp( argv[i], "--reactor" ) == 0 )
+        {
+            nReactorLoops = ( UINT )strtoul( argv[i + 1], NULL, 10 );
+        }
+        else
+        {
+            fprintf( stderr, "usage: %s [--ports 4] [--seconds 2] [--reactor N]\n", argv[0] );
+            return 2;
+        }
+    }
+
+    printf( "threads,pool_ns_per_op,new_ns_per_op\n" );
+
+    for ( UINT nThreads = 1; nThreads <= 4; nThreads *= 2 )
+    {
+        printf( "%u,%.1f,%.1f\n", nThreads, PoolNsPerOp( nThreads, TRUE ), PoolNsPerOp( nThreads, FALSE ) );
+    }
+
+    CSerialPortReactor Reactor;
+    CSerialBufferPool Shared;
+    std::vector<BENCH_PORT *> Ports;
+    std::vector<std::thread> Threads;
+    std::atomic<bool> bStop( false );
+    std::atomic<bool> bPeerStop( false );
+    std::atomic<bool> bConsumerStop( false );
+    std::atomic<UINT64> qwLines( 0 );
+    BOOL bOk = TRUE;
+
+#ifdef SERIAL_PORT_REACTOR
+    if ( ( nReactorLoops > 0 ) && !Reactor.Start( nReactorLoops ) )
+    {
+        return 1;
+    }
+#else
+    ( void )nReactorLoops;
+#endif
+
+    for ( UINT i = 0; bOk && ( i < nPorts ); i++ )
+    {
+        void *pMemory = NULL;
+        struct termios tio;
+        int nSlave;
+
+        // the port holds cache line aligned members, plain new does not guarantee that before C++17
+        if ( posix_memalign( &pMemory, alignof( BENCH_PORT ), sizeof( BENCH_PORT ) ) != 0 )
+        {
+            return 1;
+        }
+
+        BENCH_PORT *pBench = new ( pMemory ) BENCH_PORT;
+        Ports.push_back( pBench );
+        pBench->qwLines = 0;
+        pBench->qwRxBytes = 0;
+
+        if ( openpty( &pBench->nMaster, &nSlave, pBench->szName, NULL, NULL ) != 0 )
+        {
+            perror( "openpty()" );
+            return 1;
+        }
+
+        tcgetattr( pBench->nMaster, &tio );
+        cfmakeraw( &tio );
+        tcsetattr( pBench->nMaster, TCSANOW, &tio );
+        fcntl( pBench->nMaster, F_SETFL, fcntl( pBench->nMaster, F_GETFL ) | O_NONBLOCK );
+
+        // every second port on a pool of its own, the others share one
+        pBench->Port.SetBufferPool( ( i & 1 ) ? NULL : &Shared );
+        pBench->Port.SetRxCallback( OnRxBuffer, pBench );
+        pBench->Framer.SetMaxFrameSize( 2048 );
+        pBench->Framer.SetCallback( OnLine, pBench, pBench->Port.GetBufferPool() );
+        pBench->Port.SetFramer( &pBench->Framer );
+#ifdef SERIAL_PORT_REACTOR
+        if ( nReactorLoops > 0 )
+        {
+            pBench->Port.SetReactor( &Reactor );
+        }
+#endif
+        bOk = pBench->Port.OpenDevice( NULL, pBench->szName, 115200, NOPARITY, 8, ONESTOPBIT, EV_RXCHAR, 65536 );
+        close( nSlave );
+    }
+
+    if ( !bOk )
+    {
+        fprintf( stderr, "%u ports could not be opened\n", nPorts );
+        return 1;
+    }
+
+    s_Held.nHead = 0;
+    s_Held.nCount = 0;
+    s_Held.qwDropped = 0;
+    std::thread Consumer( Consume, std::ref( bConsumerStop ) );
+    std::thread Peer( EchoMasters, std::ref( Ports ), std::ref( bPeerStop ) );
+
+    for ( size_t i = 0; i < Ports.size(); i++ )
+    {
+        Threads.push_back( std::thread( SendLines, Ports[i], std::ref( bStop ), std::ref( qwLines ) ) );
+    }
+
+    // the pools, the queues and the framers reach their working size
+    std::this_thread::sleep_for( std::chrono::duration<double>( dWarmup ) );
+    UINT64 qwAllocsStart = s_qwHeapAllocs.load();
+    UINT64 qwRxStart = 0;
+
+    for ( size_t i = 0; i < Ports.size(); i++ )
+    {
+        qwRxStart += Ports[i]->qwRxBytes;
+    }
+
+    std::this_thread::sleep_for( std::chrono::duration<double>( dSeconds ) );
+    UINT64 qwAllocs = s_qwHeapAllocs.load() - qwAllocsStart;
+    UINT64 qwRxBytes = 0;
+
+    for ( size_t i = 0; i < Ports.size(); i++ )
+    {
+        qwRxBytes += Ports[i]->qwRxBytes;
+    }
+
+    qwRxBytes -= qwRxStart;
+    bStop = true;
+
+    for ( size_t i = 0; i < Threads.size(); i++ )
+    {
+        Threads[i].join();
+    }
+
+    bPeerStop = true;
+    Peer.join();
+
+    SERIAL_TX_STATS TxStats;
+    SERIAL_FRAMER_STATS FramerStats;
+    SERIAL_BUFFER_POOL_STATS PoolStats;
+    UINT64 qwTxHeap = 0;
+    UINT64 qwNoBuffer = 0;
+
+    for ( size_t i = 0; i < Ports.size(); i++ )
+    {
+        Ports[i]->Port.Close();
+        Ports[i]->Port.GetTxStats( &TxStats );
+        Ports[i]->Framer.GetStats( &FramerStats );
+        qwTxHeap += TxStats.qwAllocations;
+        qwNoBuffer += FramerStats.qwNoBuffer;
+        close( Ports[i]->nMaster );
+    }
+
+    bConsumerStop = true;
+    Consumer.join();
+    Shared.GetStats( &PoolStats );
+
+    printf( "\nports,seconds,lines,rx_mb_per_s,heap_allocs_after_warmup,tx_heap_copies,no_buffer,held_dropped,ok\n" );
+    printf( "%u,%.1f,%llu,%.3f,%llu,%llu,%llu,%llu,%d\n", nPorts, dSeconds, ( unsigned long long )qwLines.load(),
+            ( double )qwRxBytes / dSeconds / 1e6, ( unsigned long long )qwAllocs, ( unsigned long long )qwTxHeap,
+            ( unsigned long long )qwNoBuffer, ( unsigned long long )s_Held.qwDropped, qwAllocs == 0 );
+
+    printf( "\nshared pool,capacity,buffers,in_use,peak,allocs,exhausted,failed\n" );
+
+    for ( UINT i = 0; i < SERIAL_BUFFER_CLASSES; i++ )
+    {
+        SERIAL_BUFFER_CLASS_STATS &Class = PoolStats.Classes[i];
+        printf( "class %u,%u,%u,%u,%u,%llu,%llu,%llu\n", i, Class.nCapacity, Class.nBuffers, Class.nInUse, Class.nPeakInUse,
+                ( unsigned long long )Class.qwAllocs, ( unsigned long long )Class.qwExhausted, ( unsigned long long )Class.qwFailed );
+    }
+
+    for ( size_t i = 0; i < Ports.size(); i++ )
+    {
+        Ports[i]->~BENCH_PORT();
+        free( Ports[i] );
+    }
+
+    Reactor.Stop();
+    return ( qwAllocs == 0 ) ? 0 : 1;
+}
+
+#else
+
+#include <stdio.h>
+
+int main()
+{
+    fprintf( stderr, "the allocation benchmark needs pseudo-terminals (POSIX)\n" );
+    return 1;
+}
+
+#endif
@@ -0,0 +1,188 @@
+/*
+**  FILENAME            SerialCaptureBench.cpp
+**
+**  PURPOSE             Records a synthetic receive stream into a capture log, then
+**                      replays it into a line decoder and a gap decoder. Prints the
+**                      record cost and the replay rate, and checks that both
+**                      decoders find every frame that was recorded.
+**
+**                      g++ -O2 -std=c++11 -I.. SerialCaptureBench.cpp ../SerialCapture.cpp ../SerialFramer.cpp
+**                          ../SerialChecksum.cpp ../SerialMetrics.cpp ../SerialTxQueue.cpp -lpthread
+**                      ./a.out --mb 1024 --chunk 64 --path /tmp/capture
+**
+**  CREATION DATE       16-10-2026
+**  LAST MODIFICATION   16-10-2026
+*/
+
+#ifdef _WIN32
+#include "stdafx.h"
+#endif
+#include "SerialCapture.h"
+#include "SerialMetrics.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <vector>
+
+#define BENCH_BAUD          115200
+#define BENCH_CHAR_NS       ( 10ULL * 1000000000ULL / BENCH_BAUD )
+#define BENCH_GAP_CHARS     8                   /* silence after each frame, the gap decoder waits 3.5 */
+
+typedef std::chrono::steady_clock BenchClock;
+
+static void OnFrame( void *pContext, const BYTE *pFrame, UINT nLength )
+{
+    ( void )pFrame;
+    ( void )nLength;
+    ( *( UINT64 * )pContext )++;
+}
+
+static UINT64 Replay( const char *szPath, CSerialFramer &Framer, double dSpeed, double *pdSeconds )
+{
+    CSerialReplay Replay;
+    UINT64 qwFrames = 0;
+    UINT64 qwBytes;
+
+    Framer.SetCallback( OnFrame, &qwFrames );
+    Framer.SetMaxFrameSize( 65536 );
+
+    if ( !Replay.Open( szPath ) )
+    {
+        fprintf( stderr, "%s.0000 cannot be opened\n", szPath );
+        return 0;
+    }
+
+    Replay.SetFramer( &Framer );
+    BenchClock::time_point Start = BenchClock::now();
+    qwBytes = Replay.Play( dSpeed > 0.0, dSpeed );
+    *pdSeconds = std::chrono::duration<double>( BenchClock::now() - Start ).count();
+
+    if ( Replay.IsDamaged() )
+    {
+        fprintf( stderr, "the capture is damaged after %llu bytes\n", ( unsigned long long )qwBytes );
+    }
+
+    return qwFrames;
+}
+
+int main( int argc, char *argv[] )
+{
+    const char *szPath = "serial-capture";
+    UINT64 qwTotal = 256ULL << 20;
+    UINT64 qwSegment = SERIAL_CAPTURE_SEGMENT_SIZE;
+    UINT nChunk = 64;
+    double dSpeed = 0.0;
+    BOOL bKeep = FALSE;
+
+    for ( int i = 1; i < argc; i++ )
+    {
+        if ( strcmp( argv[i], "--keep" ) == 0 )
+        {
+            bKeep = TRUE;
+        }
+        else if ( i + 1 >= argc )
+        {
+            fprintf( stderr, "usage: %s [--path file] [--mb 256] [--chunk 64] [--segment-mb 64] [--speed 0] [--keep]\n", argv[0] );
+            return 2;
+        }
+        else if ( strcmp( argv[i], "--path" ) == 0 )
+        {
+            szPath = argv[++i];
+        }
+        else if ( strcmp( argv[i], "--mb" ) == 0 )
+        {
+            qwTotal = strtoull( argv[++i], NULL, 10 ) << 20;
+        }
+        else if ( strcmp( argv[i], "--chunk" ) == 0 )
+        {
+            nChunk = ( UINT )strtoul( argv[++i], NULL, 10 );
+            nChunk = ( nChunk == 0 ) ? 1 : nChunk;
+        }
+        else if ( strcmp( argv[i], "--segment-mb" ) == 0 )
+        {
+            qwSegment = strtoull( argv[++i], NULL, 10 ) << 20;
+        }
+        else if ( strcmp( argv[i], "--speed" ) == 0 )
+        {
+            // replay at the recorded timing, times this factor; 0 is as fast as possible
+            dSpeed = atof( argv[++i] );
+        }
+        else
+        {
+            fprintf( stderr, "unknown option %s\n", argv[i] );
+            return 2;
+        }
+    }
+
+    // frames of 8..1024 bytes ending with '\n', received in chunks, silence after each
+    CSerialCapture Capture;
+    SERIAL_CAPTURE_STATS Stats;
+    std::vector<BYTE> Frame;
+    UINT64 qwCharTime = BENCH_CHAR_NS;
+    UINT64 qwTimestamp = SerialMetricsNow();
+    UINT64 qwFrames = 0;
+    UINT64 qwWritten = 0;
+    UINT nSeed = 1;
+
+    if ( !Capture.Open( szPath, qwSegment ) )
+    {
+        fprintf( stderr, "%s.0000 cannot be created\n", szPath );
+        return 1;
+    }
+
+    Capture.Record( 0, SERIAL_CAPTURE_LINE, qwTimestamp, ( const BYTE * )&qwCharTime, sizeof( qwCharTime ) );
+    BenchClock::time_point Start = BenchClock::now();
+
+    while ( qwWritten < qwTotal )
+    {
+        nSeed = nSeed * 1103515245 + 12345;
+        Frame.assign( 8 + ( nSeed >> 16 ) % 1017, 'a' + ( BYTE )( qwFrames % 26 ) );
+        Frame.back() = '\n';
+
+        for ( UINT nDone = 0; nDone < Frame.size(); )
+        {
+            UINT nTake = ( ( UINT )Frame.size() - nDone < nChunk ) ? ( UINT )Frame.size() - nDone : nChunk;
+            qwTimestamp += nTake * qwCharTime;
+            Capture.Record( 0, SERIAL_CAPTURE_RX, qwTimestamp, Frame.data() + nDone, nTake );
+            nDone += nTake;
+        }
+
+        qwTimestamp += BENCH_GAP_CHARS * qwCharTime;
+        qwWritten += Frame.size();
+        qwFrames++;
+    }
+
+    double dRecord = std::chrono::duration<double>( BenchClock::now() - Start ).count();
+    Capture.Close();
+    Capture.GetStats( &Stats );
+
+    printf( "phase,mb,seconds,mb_per_s,ns_per_record,frames,ok\n" );
+    printf( "record,%.1f,%.3f,%.1f,%.1f,%llu,%d\n", ( double )Stats.qwBytes / 1048576.0, dRecord,
+            ( double )Stats.qwBytes / dRecord / 1e6, dRecord * 1e9 / ( double )Stats.qwRecords,
+            ( unsigned long long )qwFrames, Stats.qwDropped == 0 );
+
+    CSerialLineFramer LineFramer;
+    CSerialGapFramer GapFramer;
+    double dSeconds = 0.0;
+    UINT64 qwFound;
+
+    qwFound = Replay( szPath, LineFramer, dSpeed, &dSeconds );
+    printf( "replay-line,%.1f,%.3f,%.1f,%.1f,%llu,%d\n", ( double )Stats.qwBytes / 1048576.0, dSeconds,
+            ( double )Stats.qwBytes / dSeconds / 1e6, dSeconds * 1e9 / ( double )Stats.qwRecords,
+            ( unsigned long long )qwFound, qwFound == qwFrames );
+
+    qwFound = Replay( szPath, GapFramer, dSpeed, &dSeconds );
+    printf( "replay-gap,%.1f,%.3f,%.1f,%.1f,%llu,%d\n", ( double )Stats.qwBytes / 1048576.0, dSeconds,
+            ( double )Stats.qwBytes / dSeconds / 1e6, dSeconds * 1e9 / ( double )Stats.qwRecords,
+            ( unsigned long long )qwFound, qwFound == qwFrames );
+
+    for ( UINT i = 0; !bKeep && ( i < Stats.qwSegments ); i++ )
+    {
+        char szFile[1024];
+        snprintf( szFile, sizeof( szFile ), "%s.%04u", szPath, i );
+        remove( szFile );
+    }
+
+    return 0;
+}
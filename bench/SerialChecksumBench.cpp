@@ -0,0 +1,216 @@
+/*
+**  FILENAME            SerialChecksumBench.cpp
+**
+**  PURPOSE             Cross-checks every CRC kernel against a bit-by-bit reference
+**                      and the published check values, then measures GB/s per
+**                      algorithm and kernel.
+**
+**                      g++ -O2 -std=c++11 -I.. SerialChecksumBench.cpp ../SerialChecksum.cpp
+**
+**  CREATION DATE       16-10-2026
+**  LAST MODIFICATION   16-10-2026
+*/
+
+#ifdef _WIN32
+#include "stdafx.h"
+#endif
+#include "SerialChecksum.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <vector>
+
+#define BENCH_BUFFER_SIZE   ( 1UL << 20 )
+#define BENCH_MIN_SECONDS   0.5
+
+static const struct
+{
+    SERIAL_CHECKSUM Type;
+    const char      *szName;
+    UINT32          dwCheck;                    // checksum of "123456789"
+} s_Algorithms[] =
+{
+    { SERIAL_CHECKSUM_CRC16_MODBUS, "crc16-modbus", 0x4B37 },
+    { SERIAL_CHECKSUM_CRC16_XMODEM, "crc16-xmodem", 0x31C3 },
+    { SERIAL_CHECKSUM_CRC32,        "crc32",        0xCBF43926 },
+};
+
+static const struct
+{
+    SERIAL_CRC_KERNEL   Kernel;
+    const char          *szName;
+} s_Kernels[] =
+{
+    { SERIAL_CRC_KERNEL_BYTEWISE,   "bytewise" },
+    { SERIAL_CRC_KERNEL_SLICE8,     "slice8" },
+    { SERIAL_CRC_KERNEL_PCLMUL,     "pclmul" },
+};
+
+// straight from the definitions, one bit at a time
+static UINT32 Reference( SERIAL_CHECKSUM Type, UINT32 dwCrc, const BYTE *p, size_t n )
+{
+    if ( Type == SERIAL_CHECKSUM_CRC32 )
+    {
+        dwCrc = ~dwCrc;
+    }
+
+    while ( n-- > 0 )
+    {
+        BYTE c = *p++;
+
+        for ( int k = 0; k < 8; k++ )
+        {
+            switch ( Type )
+            {
+                case SERIAL_CHECKSUM_CRC16_MODBUS:
+                    dwCrc = ( ( dwCrc ^ ( c >> k ) ) & 1 ) ? ( dwCrc >> 1 ) ^ 0xA001 : dwCrc >> 1;
+                    break;
+
+                case SERIAL_CHECKSUM_CRC16_XMODEM:
+                    dwCrc = ( ( ( dwCrc >> 15 ) ^ ( c >> ( 7 - k ) ) ) & 1 ) ? ( ( dwCrc << 1 ) ^ 0x1021 ) & 0xFFFF : ( dwCrc << 1 ) & 0xFFFF;
+                    break;
+
+                default:
+                    dwCrc = ( ( dwCrc ^ ( c >> k ) ) & 1 ) ? ( dwCrc >> 1 ) ^ 0xEDB88320UL : dwCrc >> 1;
+                    break;
+            }
+        }
+    }
+
+    return ( Type == SERIAL_CHECKSUM_CRC32 ) ? ~dwCrc : dwCrc;
+}
+
+static BOOL CrossCheck( std::vector<BYTE> &Data )
+{
+    BOOL bOk = TRUE;
+
+    for ( size_t a = 0; a < sizeof( s_Algorithms ) / sizeof( s_Algorithms[0] ); a++ )
+    {
+        SERIAL_CHECKSUM Type = s_Algorithms[a].Type;
+
+        for ( size_t k = 0; k < sizeof( s_Kernels ) / sizeof( s_Kernels[0] ); k++ )
+        {
+            SERIAL_CRC_KERNEL Kernel = s_Kernels[k].Kernel;
+            UINT32 dwCrc;
+
+            if ( !SerialCrcKernelAvailable( Type, Kernel ) )
+            {
+                continue;
+            }
+
+            dwCrc = SerialChecksumUpdate( Type, SerialChecksumInit( Type ), "123456789", 9, Kernel );
+
+            if ( dwCrc != s_Algorithms[a].dwCheck )
+            {
+                printf( "FAIL %s/%s check value %08X\n", s_Algorithms[a].szName, s_Kernels[k].szName, dwCrc );
+                bOk = FALSE;
+            }
+
+            // every length and alignment around the kernel block sizes, split in two chunks
+            for ( size_t nLength = 0; nLength < 600; nLength++ )
+            {
+                size_t nOffset = nLength % 7;
+                size_t nSplit = ( nLength * 13 ) % ( nLength + 1 );
+                UINT32 dwExpected = Reference( Type, SerialChecksumInit( Type ), &Data[nOffset], nLength );
+
+                dwCrc = SerialChecksumUpdate( Type, SerialChecksumInit( Type ), &Data[nOffset], nSplit, Kernel );
+                dwCrc = SerialChecksumUpdate( Type, dwCrc, &Data[nOffset + nSplit], nLength - nSplit, Kernel );
+
+                if ( dwCrc != dwExpected )
+                {
+                    printf( "FAIL %s/%s length %u split %u: %08X, expected %08X\n", s_Algorithms[a].szName,
+                            s_Kernels[k].szName, ( UINT )nLength, ( UINT )nSplit, dwCrc, dwExpected );
+                    bOk = FALSE;
+                    break;
+                }
+            }
+        }
+
+        // a frame with its checksum appended verifies, a flipped bit does not
+        BYTE Frame[64 + SERIAL_CHECKSUM_MAX_SIZE];
+        memcpy( Frame, &Data[0], 64 );
+        SerialChecksumStore( Type, SerialChecksumUpdate( Type, SerialChecksumInit( Type ), Frame, 64 ), Frame + 64 );
+
+        if ( !SerialChecksumVerify( Type, Frame, 64 + SerialChecksumSize( Type ) ) )
+        {
+            printf( "FAIL %s verify\n", s_Algorithms[a].szName );
+            bOk = FALSE;
+        }
+
+        Frame[10] ^= 0x04;
+
+        if ( SerialChecksumVerify( Type, Frame, 64 + SerialChecksumSize( Type ) ) )
+        {
+            printf( "FAIL %s verify accepted a corrupt frame\n", s_Algorithms[a].szName );
+            bOk = FALSE;
+        }
+    }
+
+    return bOk;
+}
+
+int main( int argc, char *argv[] )
+{
+    std::vector<BYTE> Data( BENCH_BUFFER_SIZE );
+    size_t nChunk = ( argc > 1 ) ? ( size_t )atol( argv[1] ) : BENCH_BUFFER_SIZE;
+
+    if ( ( nChunk == 0 ) || ( nChunk > BENCH_BUFFER_SIZE ) )
+    {
+        fprintf( stderr, "usage: %s [chunk size, 1..%lu]\n", argv[0], BENCH_BUFFER_SIZE );
+        return 2;
+    }
+
+    srand( 1 );
+
+    for ( size_t i = 0; i < Data.size(); i++ )
+    {
+        Data[i] = ( BYTE )rand();
+    }
+
+    if ( !CrossCheck( Data ) )
+    {
+        return 1;
+    }
+
+    printf( "algorithm,kernel,chunk,gbps\n" );
+
+    for ( size_t a = 0; a < sizeof( s_Algorithms ) / sizeof( s_Algorithms[0] ); a++ )
+    {
+        for ( size_t k = 0; k < sizeof( s_Kernels ) / sizeof( s_Kernels[0] ); k++ )
+        {
+            SERIAL_CHECKSUM Type = s_Algorithms[a].Type;
+            SERIAL_CRC_KERNEL Kernel = s_Kernels[k].Kernel;
+            volatile UINT32 dwSink = 0;
+            UINT64 qwBytes = 0;
+            double dSeconds;
+
+            if ( !SerialCrcKernelAvailable( Type, Kernel ) )
+            {
+                continue;
+            }
+
+            std::chrono::steady_clock::time_point Start = std::chrono::steady_clock::now();
+
+            do
+            {
+                UINT32 dwCrc = SerialChecksumInit( Type );
+
+                for ( size_t nOffset = 0; nOffset + nChunk <= Data.size(); nOffset += nChunk )
+                {
+                    dwCrc = SerialChecksumUpdate( Type, dwCrc, &Data[nOffset], nChunk, Kernel );
+                    qwBytes += nChunk;
+                }
+
+                dwSink = dwCrc;
+                dSeconds = std::chrono::duration<double>( std::chrono::steady_clock::now() - Start ).count();
+            }
+            while ( dSeconds < BENCH_MIN_SECONDS );
+
+            ( void )dwSink;
+            printf( "%s,%s,%u,%.2f\n", s_Algorithms[a].szName, s_Kernels[k].szName, ( UINT )nChunk, qwBytes / dSeconds / 1e9 );
+        }
+    }
+
+    return 0;
+}
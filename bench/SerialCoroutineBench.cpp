@@ -0,0 +1,418 @@
+/*
+**  FILENAME            SerialCoroutineBench.cpp
+**
+**  PURPOSE             Round trips over a pseudo-terminal whose master echoes,
+**                      driven by a coroutine resumed on the I/O thread, by one
+**                      resumed on an executor thread and by the callback path with
+**                      a condition variable. Also checks ReadUntil(), a read which
+**                      times out and WaitUntil(); the exit code says if they held.
+**
+**                      g++ -O2 -std=c++20 -I.. SerialCoroutineBench.cpp ../Serial*.cpp -lpthread -lutil
+**                      ./a.out --count 20000 --size 16
+**
+**  CREATION DATE       16-10-2026
+**  LAST MODIFICATION   16-10-2026
+*/
+
+#ifndef _WIN32
+
+#include "SerialPortCoroutine.h"
+
+#ifdef SERIAL_PORT_COROUTINE
+
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#if defined( __APPLE__ ) || defined( __FreeBSD__ )
+#include <util.h>
+#else
+#include <pty.h>
+#endif
+#include <algorithm>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#define BENCH_MAX_SIZE      4096
+
+typedef struct _BENCH_PTY
+{
+    int                 nMaster;
+    char                szName[128];
+} BENCH_PTY;
+
+// hands resumptions to a thread of its own, the queue never grows past one entry here
+typedef struct _BENCH_EXECUTOR
+{
+    std::mutex                          Lock;
+    std::condition_variable             cvReady;
+    std::vector<std::coroutine_handle<> > Queue;
+    BOOL                                bStop;
+} BENCH_EXECUTOR;
+
+// done flag of a coroutine the main thread waits for
+typedef struct _BENCH_DONE
+{
+    std::mutex              Lock;
+    std::condition_variable cvDone;
+    BOOL                    bDone;
+} BENCH_DONE;
+
+static BOOL OpenPty( BENCH_PTY *pPty )
+{
+    struct termios tio;
+    int nSlave;
+
+    if ( openpty( &pPty->nMaster, &nSlave, pPty->szName, NULL, NULL ) != 0 )
+    {
+        perror( "openpty()" );
+        return FALSE;
+    }
+
+    tcgetattr( pPty->nMaster, &tio );
+    cfmakeraw( &tio );
+    tcsetattr( pPty->nMaster, TCSANOW, &tio );
+    fcntl( pPty->nMaster, F_SETFL, fcntl( pPty->nMaster, F_GETFL ) | O_NONBLOCK );
+    close( nSlave );
+    return TRUE;
+}
+
+static BOOL OpenPort( CSerialPort &Port, BENCH_PTY *pPty )
+{
+    return Port.OpenDevice( NULL, pPty->szName, 115200, NOPARITY, 8, ONESTOPBIT, EV_RXCHAR, 65536 );
+}
+
+// sends back whatever arrives while bEcho is set
+static void EchoMaster( BENCH_PTY *pPty, std::atomic<bool> *pbEcho, std::atomic<bool> *pbStop )
+{
+    struct pollfd Fd;
+    BYTE Buffer[65536];
+
+    Fd.fd = pPty->nMaster;
+    Fd.events = POLLIN;
+
+    while ( !*pbStop )
+    {
+        if ( poll( &Fd, 1, 10 ) <= 0 )
+        {
+            continue;
+        }
+
+        ssize_t n = read( Fd.fd, Buffer, sizeof( Buffer ) );
+
+        for ( ssize_t nDone = 0; *pbEcho && ( nDone < n ); )
+        {
+            ssize_t w = write( Fd.fd, Buffer + nDone, ( size_t )( n - nDone ) );
+            nDone += ( w > 0 ) ? w : 0;
+        }
+    }
+}
+
+static void ExecutorPost( void *pContext, std::coroutine_handle<> hResume )
+{
+    BENCH_EXECUTOR *pExecutor = ( BENCH_EXECUTOR * )pContext;
+    std::lock_guard<std::mutex> Lock( pExecutor->Lock );
+    pExecutor->Queue.push_back( hResume );
+    pExecutor->cvReady.notify_one();
+}
+
+static void ExecutorRun( BENCH_EXECUTOR *pExecutor )
+{
+    std::unique_lock<std::mutex> Lock( pExecutor->Lock );
+
+    while ( !pExecutor->bStop || !pExecutor->Queue.empty() )
+    {
+        if ( pExecutor->Queue.empty() )
+        {
+            pExecutor->cvReady.wait( Lock );
+            continue;
+        }
+
+        std::coroutine_handle<> hResume = pExecutor->Queue.front();
+        pExecutor->Queue.erase( pExecutor->Queue.begin() );
+        Lock.unlock();
+        hResume.resume();
+        Lock.lock();
+    }
+}
+
+static void SetDone( BENCH_DONE *pDone )
+{
+    std::lock_guard<std::mutex> Lock( pDone->Lock );
+    pDone->bDone = TRUE;
+    pDone->cvDone.notify_one();
+}
+
+static void WaitDone( BENCH_DONE *pDone )
+{
+    std::unique_lock<std::mutex> Lock( pDone->Lock );
+    pDone->cvDone.wait( Lock, [pDone]() { return pDone->bDone; } );
+    pDone->bDone = FALSE;
+}
+
+static CSerialTask RoundTrips( CSerialCoPort *pCo, UINT nSize, UINT nCount, std::vector<double> *pRtt, BENCH_DONE *pDone )
+{
+    BYTE Out[BENCH_MAX_SIZE];
+    BYTE In[BENCH_MAX_SIZE];
+
+    memset( Out, 0x5a, nSize );
+
+    for ( UINT i = 0; i < nCount; i++ )
+    {
+        UINT64 qwStart = SerialMetricsNow();
+
+        if ( ( co_await pCo->Write( Out, nSize ) != nSize ) || ( co_await pCo->Read( In, nSize, SerialDeadlineUs( 1000000 ) ) != nSize ) )
+        {
+            break;
+        }
+
+        pRtt->push_back( ( double )( SerialMetricsNow() - qwStart ) / 1000.0 );
+    }
+
+    SetDone( pDone );
+}
+
+// three lines in one write, then one without its delimiter which has to time out
+static CSerialTask Checks( CSerialCoPort *pCo, std::atomic<bool> *pbEcho, BOOL *pbOk, BENCH_DONE *pDone )
+{
+    static const char szLines[] = "first\nsecond line\nthird\n";
+    const char *pszExpect[] = { "first\n", "second line\n", "third\n" };
+    char Line[64];
+    UINT n;
+
+    co_await pCo->Write( szLines, sizeof( szLines ) - 1 );
+
+    for ( UINT i = 0; i < 3; i++ )
+    {
+        n = co_await pCo->ReadUntil( '\n', Line, sizeof( Line ), SerialDeadlineUs( 1000000 ) );
+
+        if ( ( n != strlen( pszExpect[i] ) ) || ( memcmp( Line, pszExpect[i], n ) != 0 ) )
+        {
+            printf( "ReadUntil: line %u is %u bytes, expected \"%.*s\"\n", i, n, ( int )strlen( pszExpect[i] ) - 1, pszExpect[i] );
+            *pbOk = FALSE;
+        }
+    }
+
+    co_await pCo->Write( "partial", 7 );
+    UINT64 qwDeadline = SerialDeadlineUs( 50000 );
+    n = co_await pCo->ReadUntil( '\n', Line, sizeof( Line ), qwDeadline );
+    double dLateMs = ( double )( SerialMetricsNow() - qwDeadline ) / 1e6;
+    printf( "timeout: %u bytes, %.3f ms after the deadline\n", n, dLateMs );
+    *pbOk &= ( n == 7 ) && ( dLateMs >= 0.0 ) && ( dLateMs < 20.0 );
+
+    // nothing comes back, the read ends with the deadline and nothing else
+    *pbEcho = false;
+    qwDeadline = SerialDeadlineUs( 20000 );
+    n = co_await pCo->Read( Line, 1, qwDeadline );
+    dLateMs = ( double )( SerialMetricsNow() - qwDeadline ) / 1e6;
+    printf( "silent: %u bytes, %.3f ms after the deadline\n", n, dLateMs );
+    *pbOk &= ( n == 0 ) && ( dLateMs >= 0.0 ) && ( dLateMs < 20.0 );
+
+    qwDeadline = SerialDeadlineUs( 10000 );
+    co_await pCo->WaitUntil( qwDeadline );
+    dLateMs = ( double )( SerialMetricsNow() - qwDeadline ) / 1e6;
+    printf( "WaitUntil: %.3f ms after the deadline\n", dLateMs );
+    *pbOk &= ( dLateMs >= 0.0 ) && ( dLateMs < 20.0 );
+    *pbEcho = true;
+
+    SetDone( pDone );
+}
+
+// the callback path: the reader thread waits on a condition variable
+typedef struct _BENCH_CALLBACK
+{
+    std::mutex              Lock;
+    std::condition_variable cvData;
+    UINT                    nReceived;
+} BENCH_CALLBACK;
+
+static void OnRx( void *pContext, const BYTE *pData, UINT nLength )
+{
+    BENCH_CALLBACK *pCallback = ( BENCH_CALLBACK * )pContext;
+    ( void )pData;
+    std::lock_guard<std::mutex> Lock( pCallback->Lock );
+    pCallback->nReceived += nLength;
+    pCallback->cvData.notify_one();
+}
+
+static void CallbackRoundTrips( CSerialPort &Port, BENCH_CALLBACK *pCallback, UINT nSize, UINT nCount, std::vector<double> *pRtt )
+{
+    BYTE Out[BENCH_MAX_SIZE];
+
+    memset( Out, 0x5a, nSize );
+
+    for ( UINT i = 0; i < nCount; i++ )
+    {
+        UINT64 qwStart = SerialMetricsNow();
+        Port.WriteAsync( Out, nSize );
+        std::unique_lock<std::mutex> Lock( pCallback->Lock );
+
+        if ( !pCallback->cvData.wait_for( Lock, std::chrono::seconds( 1 ), [pCallback, nSize]() { return pCallback->nReceived >= nSize; } ) )
+        {
+            break;
+        }
+
+        pCallback->nReceived -= nSize;
+        pRtt->push_back( ( double )( SerialMetricsNow() - qwStart ) / 1000.0 );
+    }
+}
+
+static void Report( const char *pszPath, UINT nSize, std::vector<double> &Rtt, UINT nCount )
+{
+    std::sort( Rtt.begin(), Rtt.end() );
+
+    if ( Rtt.empty() )
+    {
+        printf( "%s,%u,0,0,0\n", pszPath, nSize );
+        return;
+    }
+
+    printf( "%s,%u,%zu,%.1f,%.1f\n", pszPath, nSize, Rtt.size(), Rtt[Rtt.size() / 2], Rtt[( Rtt.size() * 99 ) / 100] );
+
+    if ( Rtt.size() != nCount )
+    {
+        printf( "%s: %zu of %u round trips completed\n", pszPath, Rtt.size(), nCount );
+    }
+}
+
+int main( int argc, char *argv[] )
+{
+    UINT nCount = 20000;
+    UINT nSize = 16;
+
+    for ( int i = 1; i + 1 < argc; i += 2 )
+    {
+        if ( strcmp( argv[i], "--count" ) == 0 )
+        {
+            nCount = ( UINT )strtoul( argv[i + 1], NULL, 10 );
+        }
+        else if ( strcmp( argv[i], "--size" ) == 0 )
+        {
+            nSize = std::min( ( UINT )strtoul( argv[i + 1], NULL, 10 ), ( UINT )BENCH_MAX_SIZE );
+        }
+        else
+        {
+            fprintf( stderr, "usage: %s [--count 20000] [--size 16]\n", argv[0] );
+            return 2;
+        }
+    }
+
+    BENCH_PTY Pty;
+    std::atomic<bool> bEcho( true );
+    std::atomic<bool> bStop( false );
+    BENCH_EXECUTOR Executor;
+    SERIAL_EXECUTOR ExecutorHook = { ExecutorPost, &Executor };
+    BENCH_DONE Done;
+    BOOL bOk = TRUE;
+    std::vector<double> Rtt;
+
+    Executor.bStop = FALSE;
+    Done.bDone = FALSE;
+    Rtt.reserve( nCount );
+
+    if ( !OpenPty( &Pty ) )
+    {
+        return 1;
+    }
+
+    std::thread Echo( EchoMaster, &Pty, &bEcho, &bStop );
+    std::thread ExecutorThread( ExecutorRun, &Executor );
+
+    // one port per path, each opened on the same slave in turn
+    {
+        CSerialPort Port;
+        CSerialCoPort Co( Port );
+
+        if ( !OpenPort( Port, &Pty ) )
+        {
+            return 1;
+        }
+
+        Checks( &Co, &bEcho, &bOk, &Done );
+        WaitDone( &Done );
+        printf( "path,size,round_trips,rtt_p50_us,rtt_p99_us\n" );
+        RoundTrips( &Co, nSize, nCount, &Rtt, &Done );
+        WaitDone( &Done );
+        Report( "coroutine_io_thread", nSize, Rtt, nCount );
+        bOk &= ( Rtt.size() == nCount );
+        Port.Close();
+    }
+
+    {
+        CSerialPort Port;
+        CSerialCoPort Co( Port, &ExecutorHook );
+
+        if ( !OpenPort( Port, &Pty ) )
+        {
+            return 1;
+        }
+
+        Rtt.clear();
+        RoundTrips( &Co, nSize, nCount, &Rtt, &Done );
+        WaitDone( &Done );
+        Report( "coroutine_executor", nSize, Rtt, nCount );
+        bOk &= ( Rtt.size() == nCount );
+        Port.Close();
+    }
+
+    {
+        CSerialPort Port;
+        BENCH_CALLBACK Callback;
+
+        Callback.nReceived = 0;
+        Port.SetRxCallback( OnRx, &Callback );
+
+        if ( !OpenPort( Port, &Pty ) )
+        {
+            return 1;
+        }
+
+        Rtt.clear();
+        CallbackRoundTrips( Port, &Callback, nSize, nCount, &Rtt );
+        Report( "callback", nSize, Rtt, nCount );
+        bOk &= ( Rtt.size() == nCount );
+        Port.Close();
+    }
+
+    {
+        std::lock_guard<std::mutex> Lock( Executor.Lock );
+        Executor.bStop = TRUE;
+        Executor.cvReady.notify_one();
+    }
+
+    ExecutorThread.join();
+    bStop = true;
+    Echo.join();
+    close( Pty.nMaster );
+
+    printf( "%s\n", bOk ? "checks passed" : "checks FAILED" );
+    return bOk ? 0 : 1;
+}
+
+#else
+
+#include <stdio.h>
+
+int main()
+{
+    fprintf( stderr, "needs a C++20 compiler, -std=c++20\n" );
+    return 2;
+}
+
+#endif
+
+#else
+
+#include <stdio.h>
+
+int main()
+{
+    fprintf( stderr, "the coroutine benchmark needs pseudo-terminals (POSIX)\n" );
+    return 1;
+}
+
+#endif
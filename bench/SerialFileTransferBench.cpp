@@ -0,0 +1,449 @@
+/*
+**  FILENAME            SerialFileTransferBench.cpp
+**
+**  PURPOSE             Sends a file from one port to the reference receiver on
+**                      another. The two ports sit on pseudo-terminals joined by a
+**                      relay which models the line: each byte takes its character
+**                      time at the baud rate in both directions, every chunk a
+**                      fixed adapter latency, and bytes may be flipped on the way.
+**                      Runs stop-and-wait and windows of 4 and 16, a window of 16
+**                      with line errors and a transfer cancelled half way and
+**                      resumed. Prints the time, the payload rate and its share
+**                      of the line rate, and the retransmissions. Exits with 1 when
+**                      a file arrives different, a transfer fails, a resume starts
+**                      over, or an error free window of 8 or more uses less than
+**                      90% of the line.
+**
+**                      g++ -O2 -std=c++11 -I.. SerialFileTransferBench.cpp ../Serial*.cpp -lpthread -lutil
+**                      ./a.out --baud 921600 --latency-us 2000 --size 262144 --errors 32
+**
+**  CREATION DATE       16-10-2026
+**  LAST MODIFICATION   16-10-2026
+*/
+
+#ifndef _WIN32
+
+#include "SerialFileTransfer.h"
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#if defined( __APPLE__ ) || defined( __FreeBSD__ )
+#include <util.h>
+#else
+#include <pty.h>
+#endif
+#include <atomic>
+#include <deque>
+#include <thread>
+#include <vector>
+
+#define BENCH_READ_SIZE     256                 /* read from the pty at a time, the delivery granularity */
+#define BENCH_TX_LEAD_US    10000               /* line time the sender hands to the driver */
+#define BENCH_MIN_LINE_USE  0.9
+
+typedef struct _BENCH_CHUNK
+{
+    UINT64              qwDue;
+    std::vector<BYTE>   Data;
+} BENCH_CHUNK;
+
+// one direction of the line, master to master
+typedef struct _BENCH_LINE
+{
+    int                 nIn;
+    int                 nOut;
+    UINT64              qwFree;                 // the line is busy until then
+    UINT                nInFlight;              // read, not delivered yet
+    std::deque<BENCH_CHUNK> Chunks;
+    UINT64              qwBytes;
+    UINT64              qwNextError;            // byte number of the next flip, 0 for none
+    UINT64              qwErrors;
+} BENCH_LINE;
+
+typedef struct _BENCH_CONFIG
+{
+    UINT                nBaud;
+    UINT64              qwLatencyNs;
+    UINT                nSize;
+    UINT                nWindow;
+    UINT                nErrorsPerMb;           // flipped bytes per MB and direction, 0 for none
+    BOOL                bResume;
+} BENCH_CONFIG;
+
+typedef struct _BENCH_CANCEL
+{
+    CSerialFileSender   *pSender;
+    UINT64              qwAt;
+} BENCH_CANCEL;
+
+static UINT32 s_dwRandom = 12345;
+
+static UINT32 Random()
+{
+    s_dwRandom = s_dwRandom * 1103515245 + 12345;
+    return s_dwRandom >> 8;
+}
+
+static UINT64 NextError( UINT64 qwBytes, UINT nErrorsPerMb )
+{
+    return ( nErrorsPerMb == 0 ) ? 0 : qwBytes + 1 + Random() % ( 2 * ( 1048576 / nErrorsPerMb ) );
+}
+
+// the slow part is simulated, the ptys themselves deliver at once
+static void Relay( BENCH_LINE *pLines, const BENCH_CONFIG *pConfig, std::atomic<bool> *pbStop )
+{
+    UINT64 qwCharNs = 10000000000ULL / pConfig->nBaud;
+    UINT nMaxInFlight = ( UINT )( pConfig->qwLatencyNs / qwCharNs ) + 2 * BENCH_READ_SIZE;
+
+    while ( !*pbStop )
+    {
+        struct pollfd Fds[2];
+        UINT64 qwNow = SerialMetricsNow();
+        UINT64 qwWake = qwNow + 10000000;
+
+        for ( int i = 0; i < 2; i++ )
+        {
+            Fds[i].fd = pLines[i].nIn;
+            Fds[i].events = ( pLines[i].nInFlight < nMaxInFlight ) ? POLLIN : 0;
+            Fds[i].revents = 0;
+
+            if ( !pLines[i].Chunks.empty() && ( pLines[i].Chunks.front().qwDue < qwWake ) )
+            {
+                qwWake = pLines[i].Chunks.front().qwDue;
+            }
+        }
+
+        poll( Fds, 2, ( qwWake > qwNow ) ? ( int )( ( qwWake - qwNow + 999999 ) / 1000000 ) : 0 );
+        qwNow = SerialMetricsNow();
+
+        for ( int i = 0; i < 2; i++ )
+        {
+            BENCH_LINE *pLine = &pLines[i];
+
+            if ( Fds[i].revents & POLLIN )
+            {
+                BYTE Buffer[BENCH_READ_SIZE];
+                UINT nRoom = nMaxInFlight - pLine->nInFlight;
+                ssize_t n = read( pLine->nIn, Buffer, ( nRoom < sizeof( Buffer ) ) ? nRoom : sizeof( Buffer ) );
+
+                if ( n > 0 )
+                {
+                    BENCH_CHUNK Chunk;
+
+                    // the chunk leaves when the line had time for its bytes, and arrives after the adapter
+                    pLine->qwFree = ( ( qwNow > pLine->qwFree ) ? qwNow : pLine->qwFree ) + ( UINT64 )n * qwCharNs;
+                    Chunk.qwDue = pLine->qwFree + pConfig->qwLatencyNs;
+                    Chunk.Data.assign( Buffer, Buffer + n );
+
+                    for ( ssize_t j = 0; j < n; j++ )
+                    {
+                        if ( ++pLine->qwBytes == pLine->qwNextError )
+                        {
+                            Chunk.Data[j] ^= 0x5A;
+                            pLine->qwErrors++;
+                            pLine->qwNextError = NextError( pLine->qwBytes, pConfig->nErrorsPerMb );
+                        }
+                    }
+
+                    pLine->nInFlight += ( UINT )n;
+                    pLine->Chunks.push_back( Chunk );
+                }
+            }
+
+            while ( !pLine->Chunks.empty() && ( pLine->Chunks.front().qwDue <= qwNow ) )
+            {
+                BENCH_CHUNK &Chunk = pLine->Chunks.front();
+                ssize_t n = write( pLine->nOut, &Chunk.Data[0], Chunk.Data.size() );
+
+                // the receiving side is full, the rest is tried again later
+                if ( n <= 0 )
+                {
+                    break;
+                }
+
+                pLine->nInFlight -= ( UINT )n;
+
+                if ( ( size_t )n < Chunk.Data.size() )
+                {
+                    Chunk.Data.erase( Chunk.Data.begin(), Chunk.Data.begin() + n );
+                    break;
+                }
+
+                pLine->Chunks.pop_front();
+            }
+        }
+    }
+}
+
+static BOOL OpenPty( int *pnMaster, char *pszName )
+{
+    struct termios tio;
+    int nSlave;
+
+    if ( openpty( pnMaster, &nSlave, pszName, NULL, NULL ) != 0 )
+    {
+        perror( "openpty()" );
+        return FALSE;
+    }
+
+    tcgetattr( *pnMaster, &tio );
+    cfmakeraw( &tio );
+    tcsetattr( *pnMaster, TCSANOW, &tio );
+    fcntl( *pnMaster, F_SETFL, fcntl( *pnMaster, F_GETFL ) | O_NONBLOCK );
+
+    // the port opens the slave by its name
+    close( nSlave );
+    return TRUE;
+}
+
+static BOOL SameFiles( const char *pszA, const char *pszB )
+{
+    FILE *pA = fopen( pszA, "rb" );
+    FILE *pB = fopen( pszB, "rb" );
+    BOOL bSame = ( pA != NULL ) && ( pB != NULL );
+    static BYTE s_A[65536];
+    static BYTE s_B[65536];
+
+    while ( bSame )
+    {
+        size_t nA = fread( s_A, 1, sizeof( s_A ), pA );
+        size_t nB = fread( s_B, 1, sizeof( s_B ), pB );
+        bSame = ( nA == nB ) && ( memcmp( s_A, s_B, nA ) == 0 );
+
+        if ( nA == 0 )
+        {
+            break;
+        }
+    }
+
+    if ( pA != NULL )
+    {
+        fclose( pA );
+    }
+
+    if ( pB != NULL )
+    {
+        fclose( pB );
+    }
+
+    return bSame;
+}
+
+static void OnProgress( void *pContext, const SERIAL_TRANSFER_PROGRESS *pProgress )
+{
+    BENCH_CANCEL *pCancel = ( BENCH_CANCEL * )pContext;
+
+    if ( ( pCancel->qwAt != 0 ) && ( pProgress->qwDone >= pCancel->qwAt ) )
+    {
+        pCancel->qwAt = 0;
+        pCancel->pSender->Cancel();
+    }
+}
+
+static BOOL Run( const BENCH_CONFIG *pConfig, const char *pszSource, const char *pszTarget )
+{
+    CSerialPort SenderPort;
+    CSerialPort ReceiverPort;
+    CSerialFileSender Sender;
+    CSerialFileReceiver Receiver;
+    SERIAL_TRANSFER_PROGRESS Progress;
+    SERIAL_TRANSFER_STATS SenderStats;
+    SERIAL_TRANSFER_STATS ReceiverStats;
+    BENCH_CANCEL Cancel;
+    BENCH_LINE Lines[2];
+    std::atomic<bool> bStop( false );
+    char szSender[128];
+    char szReceiver[128];
+    int nSenderMaster;
+    int nReceiverMaster;
+    DWORD dwWaitMs = ( DWORD )( ( UINT64 )pConfig->nSize * 10 * 1000 * 4 / pConfig->nBaud ) + 10000;
+
+    if ( !OpenPty( &nSenderMaster, szSender ) || !OpenPty( &nReceiverMaster, szReceiver ) )
+    {
+        return FALSE;
+    }
+
+    for ( int i = 0; i < 2; i++ )
+    {
+        Lines[i].nIn = ( i == 0 ) ? nSenderMaster : nReceiverMaster;
+        Lines[i].nOut = ( i == 0 ) ? nReceiverMaster : nSenderMaster;
+        Lines[i].qwFree = 0;
+        Lines[i].nInFlight = 0;
+        Lines[i].qwBytes = 0;
+        Lines[i].qwNextError = NextError( 0, pConfig->nErrorsPerMb );
+        Lines[i].qwErrors = 0;
+    }
+
+    // a go-back-N resend waits behind what the driver holds, keep that short
+    SenderPort.SetTxPacing( SERIAL_TX_PACE_MODEL, BENCH_TX_LEAD_US );
+    Sender.Attach( &SenderPort );
+    Sender.SetWindow( pConfig->nWindow );
+    Receiver.Attach( &ReceiverPort );
+    Cancel.pSender = &Sender;
+    Cancel.qwAt = pConfig->bResume ? pConfig->nSize / 2 : 0;
+    Sender.SetProgressCallback( OnProgress, &Cancel, 0 );
+
+    if ( !SenderPort.OpenDevice( NULL, szSender, pConfig->nBaud ) || !ReceiverPort.OpenDevice( NULL, szReceiver, pConfig->nBaud ) )
+    {
+        fprintf( stderr, "%s or %s could not be opened\n", szSender, szReceiver );
+        SenderPort.Close();
+        close( nSenderMaster );
+        close( nReceiverMaster );
+        return FALSE;
+    }
+
+    std::thread RelayThread( Relay, Lines, pConfig, &bStop );
+    BOOL bOk = TRUE;
+
+    // the first part, cancelled half way; what arrived stays for the resume
+    if ( pConfig->bResume )
+    {
+        bOk = Receiver.Receive( pszTarget ) && Sender.Send( pszSource ) && Sender.Wait( dwWaitMs ) && Receiver.Wait( dwWaitMs ) &&
+              ( Sender.GetStatus() == SERIAL_TRANSFER_CANCELLED ) && ( Receiver.GetStatus() == SERIAL_TRANSFER_CANCELLED );
+        Sender.GetStats( &SenderStats, TRUE );
+        Receiver.GetStats( &ReceiverStats, TRUE );
+    }
+
+    UINT64 qwStart = SerialMetricsNow();
+
+    bOk = bOk && Receiver.Receive( pszTarget, pConfig->bResume ) && Sender.Send( pszSource ) &&
+          Sender.Wait( dwWaitMs ) && Receiver.Wait( dwWaitMs );
+
+    UINT64 qwElapsed = SerialMetricsNow() - qwStart;
+
+    SenderPort.Close();
+    ReceiverPort.Close();
+    bStop = true;
+    RelayThread.join();
+    close( nSenderMaster );
+    close( nReceiverMaster );
+
+    Sender.GetProgress( &Progress );
+    Sender.GetStats( &SenderStats );
+    Receiver.GetStats( &ReceiverStats );
+
+    double dSeconds = ( double )qwElapsed / 1e9;
+    double dRate = ( double )( Progress.qwDone - Progress.qwStart ) / dSeconds;
+    double dLineUse = dRate / ( pConfig->nBaud / 10.0 );
+
+    bOk = bOk && ( Sender.GetStatus() == SERIAL_TRANSFER_OK ) && ( Receiver.GetStatus() == SERIAL_TRANSFER_OK ) &&
+          SameFiles( pszSource, pszTarget ) && ( Receiver.GetName() == "source.bin" );
+
+    if ( pConfig->bResume )
+    {
+        bOk = bOk && ( Progress.qwStart > 0 ) && ( Progress.qwStart < pConfig->nSize );
+    }
+    else if ( ( pConfig->nErrorsPerMb == 0 ) && ( pConfig->nWindow >= 8 ) )
+    {
+        bOk = bOk && ( dLineUse >= BENCH_MIN_LINE_USE );
+    }
+
+    printf( "%s,%u,%u,%llu,%u,%llu,%u,%llu,%.2f,%.1f,%.3f,%.1f,%llu,%llu,%llu,%s\n",
+            pConfig->bResume ? "resume" : ( pConfig->nErrorsPerMb != 0 ) ? "errors" : "clean", pConfig->nWindow, pConfig->nBaud,
+            ( unsigned long long )( pConfig->qwLatencyNs / 1000 ), pConfig->nErrorsPerMb,
+            ( unsigned long long )( Lines[0].qwErrors + Lines[1].qwErrors ), pConfig->nSize, ( unsigned long long )Progress.qwStart,
+            dSeconds, dRate / 1024.0, dLineUse, ( double )SenderStats.qwResent / 1024.0,
+            ( unsigned long long )SenderStats.qwNaks, ( unsigned long long )( SenderStats.qwTimeouts + ReceiverStats.qwTimeouts ),
+            ( unsigned long long )( SenderStats.qwCrcErrors + ReceiverStats.qwCrcErrors ), bOk ? "ok" : "FAILED" );
+    return bOk;
+}
+
+int main( int argc, char *argv[] )
+{
+    BENCH_CONFIG Config;
+    UINT nErrorsPerMb = 32;
+    int nResult = 0;
+    char szDirectory[] = "/tmp/SerialFileTransferXXXXXX";
+    char szSource[256];
+    char szTarget[256];
+    static const UINT s_Windows[] = { 1, 4, 16 };
+
+    memset( &Config, 0, sizeof( Config ) );
+    Config.nBaud = 921600;
+    Config.qwLatencyNs = 2000000;
+    Config.nSize = 262144;
+
+    for ( int i = 1; i + 1 < argc; i += 2 )
+    {
+        if ( strcmp( argv[i], "--baud" ) == 0 )
+        {
+            Config.nBaud = ( UINT )strtoul( argv[i + 1], NULL, 10 );
+        }
+        else if ( strcmp( argv[i], "--latency-us" ) == 0 )
+        {
+            Config.qwLatencyNs = strtoull( argv[i + 1], NULL, 10 ) * 1000;
+        }
+        else if ( strcmp( argv[i], "--size" ) == 0 )
+        {
+            Config.nSize = ( UINT )strtoul( argv[i + 1], NULL, 10 );
+        }
+        else if ( strcmp( argv[i], "--errors" ) == 0 )
+        {
+            nErrorsPerMb = ( UINT )strtoul( argv[i + 1], NULL, 10 );
+        }
+        else
+        {
+            fprintf( stderr, "usage: %s [--baud 921600] [--latency-us 2000] [--size 262144] [--errors 32]\n", argv[0] );
+            return 2;
+        }
+    }
+
+    if ( ( Config.nBaud == 0 ) || ( mkdtemp( szDirectory ) == NULL ) )
+    {
+        perror( "mkdtemp()" );
+        return 2;
+    }
+
+    snprintf( szSource, sizeof( szSource ), "%s/source.bin", szDirectory );
+    snprintf( szTarget, sizeof( szTarget ), "%s/target.bin", szDirectory );
+
+    FILE *pSource = fopen( szSource, "wb" );
+
+    for ( UINT i = 0; ( pSource != NULL ) && ( i < Config.nSize ); i++ )
+    {
+        fputc( ( int )( Random() & 0xFF ), pSource );
+    }
+
+    if ( ( pSource == NULL ) || ( fclose( pSource ) != 0 ) )
+    {
+        perror( szSource );
+        return 2;
+    }
+
+    printf( "run,window,baud,latency_us,errors_per_mb,flipped,size,start,seconds,payload_kbps,line_use,"
+            "resent_kb,naks,timeouts,crc_errors,result\n" );
+
+    for ( size_t i = 0; i < sizeof( s_Windows ) / sizeof( s_Windows[0] ); i++ )
+    {
+        Config.nWindow = s_Windows[i];
+        nResult = Run( &Config, szSource, szTarget ) ? nResult : 1;
+    }
+
+    Config.nWindow = SERIAL_TRANSFER_WINDOW;
+    Config.nErrorsPerMb = nErrorsPerMb;
+    nResult = ( ( nErrorsPerMb == 0 ) || Run( &Config, szSource, szTarget ) ) ? nResult : 1;
+
+    Config.nErrorsPerMb = 0;
+    Config.bResume = TRUE;
+    nResult = Run( &Config, szSource, szTarget ) ? nResult : 1;
+
+    unlink( szSource );
+    unlink( szTarget );
+    rmdir( szDirectory );
+    return nResult;
+}
+
+#else
+
+#include <stdio.h>
+
+int main()
+{
+    fprintf( stderr, "the file transfer benchmark needs pseudo-terminals (POSIX)\n" );
+    return 1;
+}
+
+#endif
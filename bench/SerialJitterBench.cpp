@@ -0,0 +1,327 @@
+/*
+**  FILENAME            SerialJitterBench.cpp
+**
+**  PURPOSE             Wakeup jitter of the I/O thread of a port and of a reactor loop,
+**                      left as created and pinned to one CPU with SCHED_FIFO and locked
+**                      memory, each idle and under a synthetic CPU load of spinning
+**                      threads. The jitter probe of the port ticks every millisecond,
+**                      and a sender stamps a message into the master side of a pty
+**                      as often; prints the probe lateness and the time from the
+**                      stamp until the read completed, p50/p99/max in microseconds.
+**                      Exits with 1 when a message is lost or the probe does not run.
+**                      A refused realtime policy is reported in the granted column.
+**
+**                      g++ -O2 -std=c++11 -I.. SerialJitterBench.cpp ../Serial*.cpp -lpthread -lutil
+**                      ./a.out --load 4 --seconds 2 --priority 80
+**
+**  CREATION DATE       16-10-2026
+**  LAST MODIFICATION   16-10-2026
+*/
+
+#ifndef _WIN32
+
+#include "SerialPort.h"
+#include "SerialPortReactor.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#if defined( __APPLE__ ) || defined( __FreeBSD__ )
+#include <util.h>
+#else
+#include <pty.h>
+#endif
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#define BENCH_PROBE_US      1000
+#define BENCH_SENDER_PRIORITY 90                /* above the port, the sender should not be the one delayed */
+
+typedef struct _BENCH_RECEIVER
+{
+    BYTE                Partial[sizeof( UINT64 )];
+    UINT                nPartial;
+    UINT64              qwReceived;
+    CSerialHistogram    Latency;
+} BENCH_RECEIVER;
+
+typedef struct _BENCH_CONFIG
+{
+    BOOL                bReactor;
+    BOOL                bRealtime;
+    UINT                nLoad;                  // spinning threads, 0 is idle
+    int                 nPriority;
+    double              dSeconds;
+} BENCH_CONFIG;
+
+// messages are the 8 byte SerialMetricsNow() of their write, reads may split them
+static void OnRx( void *pContext, const BYTE *pData, UINT nLength, UINT64 qwTimestamp )
+{
+    BENCH_RECEIVER *pReceiver = ( BENCH_RECEIVER * )pContext;
+
+    for ( UINT i = 0; i < nLength; i++ )
+    {
+        pReceiver->Partial[pReceiver->nPartial++] = pData[i];
+
+        if ( pReceiver->nPartial == sizeof( UINT64 ) )
+        {
+            UINT64 qwSent;
+            memcpy( &qwSent, pReceiver->Partial, sizeof( qwSent ) );
+            pReceiver->Latency.Record( ( qwTimestamp > qwSent ) ? qwTimestamp - qwSent : 0 );
+            pReceiver->qwReceived++;
+            pReceiver->nPartial = 0;
+        }
+    }
+}
+
+static void Burner( std::atomic<bool> *pbStop )
+{
+    volatile UINT64 qwSpin = 0;
+
+    while ( !*pbStop )
+    {
+        qwSpin++;
+    }
+}
+
+static void Sender( int nMaster, std::atomic<bool> *pbStop, UINT64 *pqwSent )
+{
+    SERIAL_THREAD_OPTIONS Options;
+    const char *pszFailed;
+    UINT64 qwNext = SerialMetricsNow();
+
+    SerialThreadDefaults( &Options );
+    Options.Policy = SERIAL_THREAD_FIFO;
+    Options.nPriority = BENCH_SENDER_PRIORITY;
+    SerialThreadApply( &Options, &pszFailed );
+
+    while ( !*pbStop )
+    {
+        struct timespec ts;
+        qwNext += ( UINT64 )BENCH_PROBE_US * 1000;
+        ts.tv_sec = ( time_t )( qwNext / 1000000000 );
+        ts.tv_nsec = ( long )( qwNext % 1000000000 );
+        clock_nanosleep( CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL );
+
+        UINT64 qwNow = SerialMetricsNow();
+
+        if ( write( nMaster, &qwNow, sizeof( qwNow ) ) == ( ssize_t )sizeof( qwNow ) )
+        {
+            ( *pqwSent )++;
+        }
+    }
+}
+
+static double Us( const SERIAL_HISTOGRAM *pHistogram, double dFraction )
+{
+    return ( double )SerialHistogramPercentile( pHistogram, dFraction ) / 1e3;
+}
+
+static const char *Granted( DWORD dwState )
+{
+    static char s_szGranted[64];
+
+    snprintf( s_szGranted, sizeof( s_szGranted ), "%s%s%s%s", ( dwState & SERIAL_THREAD_PINNED ) ? "pinned " : "",
+              ( dwState & SERIAL_THREAD_REALTIME ) ? "fifo " : "", ( dwState & SERIAL_THREAD_LOCKED ) ? "locked " : "",
+              ( dwState == 0 ) ? "none " : "" );
+    s_szGranted[strlen( s_szGranted ) - 1] = '\0';
+    return s_szGranted;
+}
+
+static BOOL Run( const BENCH_CONFIG *pConfig )
+{
+    CSerialPort Port;
+    CSerialPortReactor Reactor;
+    static BENCH_RECEIVER s_Receiver;
+    SERIAL_THREAD_OPTIONS Options;
+    SERIAL_PORT_METRICS *pMetrics = new SERIAL_PORT_METRICS;
+    SERIAL_HISTOGRAM Probe;
+    SERIAL_HISTOGRAM Latency;
+    std::vector<std::thread> Burners;
+    std::atomic<bool> bStop( false );
+    std::atomic<bool> bStopLoad( false );
+    struct termios tio;
+    char szName[128];
+    UINT64 qwSent = 0;
+    DWORD dwState;
+    int nMaster;
+    int nSlave;
+
+    if ( openpty( &nMaster, &nSlave, szName, NULL, NULL ) != 0 )
+    {
+        perror( "openpty()" );
+        delete pMetrics;
+        return FALSE;
+    }
+
+    tcgetattr( nMaster, &tio );
+    cfmakeraw( &tio );
+    tcsetattr( nMaster, TCSANOW, &tio );
+
+    s_Receiver.nPartial = 0;
+    s_Receiver.qwReceived = 0;
+    s_Receiver.Latency.Snapshot( &Latency, TRUE );
+
+    SerialThreadDefaults( &Options );
+    Options.nProbeUs = BENCH_PROBE_US;
+
+    if ( pConfig->bRealtime )
+    {
+        Options.qwCpuMask = 1;
+        Options.Policy = SERIAL_THREAD_FIFO;
+        Options.nPriority = pConfig->nPriority;
+        Options.bLockMemory = TRUE;
+    }
+
+    if ( pConfig->bReactor )
+    {
+        Reactor.SetThreadOptions( &Options );
+
+        if ( !Reactor.Start( 1 ) )
+        {
+            perror( "Start()" );
+            delete pMetrics;
+            return FALSE;
+        }
+
+        Port.SetReactor( &Reactor );
+        Options.qwCpuMask = 0;
+        Options.Policy = SERIAL_THREAD_NORMAL;
+        Options.nProbeUs = 0;
+    }
+
+    Port.SetThreadOptions( &Options );
+    Port.SetRxCallback( OnRx, &s_Receiver );
+
+    if ( !Port.OpenDevice( NULL, szName, 115200 ) )
+    {
+        fprintf( stderr, "%s could not be opened\n", szName );
+        delete pMetrics;
+        return FALSE;
+    }
+
+    close( nSlave );
+
+    for ( UINT i = 0; i < pConfig->nLoad; i++ )
+    {
+        Burners.push_back( std::thread( Burner, &bStopLoad ) );
+    }
+
+    // the load settles and the first ticks are not counted
+    usleep( 100000 );
+    Port.GetMetrics( pMetrics, TRUE );
+    Reactor.GetWakeupJitter( &Probe, TRUE );
+
+    UINT64 qwStart = SerialMetricsNow();
+    std::thread SenderThread( Sender, nMaster, &bStop, &qwSent );
+
+    usleep( ( useconds_t )( pConfig->dSeconds * 1e6 ) );
+    bStop = true;
+    SenderThread.join();
+    UINT64 qwElapsed = SerialMetricsNow() - qwStart;
+
+    // the last messages are read before the load stops
+    usleep( 50000 );
+
+    if ( pConfig->bReactor )
+    {
+        Reactor.GetWakeupJitter( &Probe, FALSE );
+        dwState = Reactor.GetThreadState() | ( Port.GetThreadState() & SERIAL_THREAD_LOCKED );
+    }
+    else
+    {
+        Port.GetMetrics( pMetrics, FALSE );
+        Probe = pMetrics->Wakeup;
+        dwState = Port.GetThreadState();
+    }
+
+    bStopLoad = true;
+
+    for ( size_t i = 0; i < Burners.size(); i++ )
+    {
+        Burners[i].join();
+    }
+
+    Port.Close();
+    Reactor.Stop();
+    close( nMaster );
+
+    s_Receiver.Latency.Snapshot( &Latency, FALSE );
+
+    UINT64 qwTicks = qwElapsed / ( ( UINT64 )BENCH_PROBE_US * 1000 );
+    UINT64 qwLost = ( qwSent > s_Receiver.qwReceived ) ? qwSent - s_Receiver.qwReceived : 0;
+    BOOL bOk = ( qwLost == 0 ) && ( qwSent > 0 ) && ( Probe.qwCount * 2 >= qwTicks );
+
+    printf( "%s,%s,%u,%s,%llu,%.1f,%.1f,%.1f,%llu,%.1f,%.1f,%.1f,%llu,%s\n", pConfig->bReactor ? "reactor" : "thread",
+            pConfig->bRealtime ? "pinned-fifo" : "default", pConfig->nLoad, Granted( dwState ),
+            ( unsigned long long )Probe.qwCount, Us( &Probe, 0.5 ), Us( &Probe, 0.99 ), ( double )Probe.qwMax / 1e3,
+            ( unsigned long long )Latency.qwCount, Us( &Latency, 0.5 ), Us( &Latency, 0.99 ), ( double )Latency.qwMax / 1e3,
+            ( unsigned long long )qwLost, bOk ? "ok" : "FAILED" );
+    delete pMetrics;
+    return bOk;
+}
+
+int main( int argc, char *argv[] )
+{
+    BENCH_CONFIG Config;
+    UINT nLoad = 2 * ( UINT )std::thread::hardware_concurrency();
+    int nResult = 0;
+
+    memset( &Config, 0, sizeof( Config ) );
+    Config.nPriority = 80;
+    Config.dSeconds = 2.0;
+
+    for ( int i = 1; i + 1 < argc; i += 2 )
+    {
+        if ( strcmp( argv[i], "--load" ) == 0 )
+        {
+            nLoad = ( UINT )strtoul( argv[i + 1], NULL, 10 );
+        }
+        else if ( strcmp( argv[i], "--seconds" ) == 0 )
+        {
+            Config.dSeconds = atof( argv[i + 1] );
+        }
+        else if ( strcmp( argv[i], "--priority" ) == 0 )
+        {
+            Config.nPriority = atoi( argv[i + 1] );
+        }
+        else
+        {
+            fprintf( stderr, "usage: %s [--load threads] [--seconds 2] [--priority 80]\n", argv[0] );
+            return 2;
+        }
+    }
+
+    printf( "io,sched,load,granted,probe_wakeups,probe_p50_us,probe_p99_us,probe_max_us,"
+            "messages,rx_p50_us,rx_p99_us,rx_max_us,lost,result\n" );
+
+    for ( int r = 0; r < 2; r++ )
+    {
+        for ( int l = 0; l < 2; l++ )
+        {
+            for ( int s = 0; s < 2; s++ )
+            {
+                Config.bReactor = ( r == 1 );
+                Config.nLoad = ( l == 0 ) ? 0 : nLoad;
+                Config.bRealtime = ( s == 1 );
+                nResult = Run( &Config ) ? nResult : 1;
+            }
+        }
+    }
+
+    return nResult;
+}
+
+#else
+
+#include <stdio.h>
+
+int main()
+{
+    fprintf( stderr, "the jitter benchmark needs pseudo-terminals (POSIX)\n" );
+    return 1;
+}
+
+#endif
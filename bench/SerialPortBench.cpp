@@ -0,0 +1,972 @@
+/*
+**  FILENAME            SerialPortBench.cpp
+**
+**  PURPOSE             Loopback benchmark of the CSerialPort I/O paths over
+**                      pseudo-terminal pairs. The port under test opens the slave
+**                      side through the public API, the benchmark drives the
+**                      master side. One CSV (or JSON) line per configuration:
+**
+**                      tx      WriteAsync() to the port, drained from the master
+**                      write   blocking Write(), including its transmit time sleep
+**                      rx      written into the master, taken by the RX callback
+**                      rxpull  the same taken with Read() when SetRxNotify() signals data
+**                      rxbyte  the same read by the benchmark from the slave the way the
+**                              port received before its ring buffer: one read() and one
+**                              owner notification per byte, for a before/after comparison
+**                      rtt     echoed by the master, round-trip time per message
+**                      duplex  tx and rx at the same time on every port, the master
+**                              drains and feeds it; tx_mb_per_s and rx_mb_per_s give
+**                              each direction, mb_per_s their sum
+**                      cycle   Close() and OpenDevice() again, the time per cycle
+**                      idle    open ports without traffic, only the CPU time counts
+**                      gap     pairs of frames written into the master two gaps apart,
+**                              split by a CSerialGapFramer with the Modbus RTU minimum
+**                              gap; the latency is the delivery of the second frame after
+**                              its last byte minus the gap, a frame of another size than
+**                              written fails the run, also with --rx-bytes
+**
+**                      syscalls_per_kb counts the read and write class system calls
+**                      of the port (/proc/self/io minus those of the benchmark side),
+**                      cpu_ms_per_mb and cpu_ms_per_s the CPU time of the process
+**                      minus the master side threads. --capture records the traffic
+**                      of all ports into a CSerialCapture log while they run.
+**
+**                      --rx-bytes sweeps the RX delivery policy of the ports (see
+**                      SetRxPolicy(), --rx-delay sets its delay), rx shows the
+**                      throughput side, rtt the latency side and deliveries_per_kb
+**                      how many callbacks a KB of received data took.
+**
+**                      g++ -O2 -std=c++11 -I.. SerialPortBench.cpp ../Serial*.cpp -lpthread -lutil
+**                      ./a.out --modes tx,rx,rtt --sizes 16,256,4096 --ports 1,8 --seconds 1
+**                      ./a.out --modes rx,rtt --sizes 16 --rx-bytes 1,64,512,4096
+**                      ./a.out --modes rxbyte,rxpull,rx --sizes 4096 --bauds 921600
+**                      ./a.out --modes tx,rx,duplex --sizes 4096 --ports 1,8 --reactor 1
+**
+**  CREATION DATE       16-10-2026
+**  LAST MODIFICATION   16-10-2026
+*/
+
+#ifndef _WIN32
+
+#include "SerialPort.h"
+#include "SerialPortReactor.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#if defined( __APPLE__ ) || defined( __FreeBSD__ )
+#include <util.h>
+#else
+#include <pty.h>
+#endif
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define BENCH_MAX_MESSAGE   65536
+
+typedef std::chrono::steady_clock BenchClock;
+
+typedef struct _BENCH_CONFIG
+{
+    std::string         strMode;
+    UINT                nSize;
+    UINT                nBaud;
+    UINT                nPorts;
+    double              dSeconds;
+    UINT                nReactorLoops;          // 0, one thread per port
+    UINT                nRxMinBytes;            // SetRxPolicy() of the ports
+    UINT                nRxDelayUs;
+} BENCH_CONFIG;
+
+typedef struct _BENCH_RESULT
+{
+    UINT64              qwBytes;
+    UINT64              qwTxBytes;              // of the port, 0 for modes which do not send
+    UINT64              qwRxBytes;
+    UINT64              qwMessages;
+    double              dSeconds;
+    UINT64              qwSyscalls;
+    UINT64              qwDeliveries;
+    UINT64              qwBadFrames;            // gap, frames split or merged
+    double              dCpuSeconds;
+    std::vector<double> Latency;                // microseconds
+} BENCH_RESULT;
+
+struct BENCH_PORT
+{
+    CSerialPort             Port;
+    int                     nMaster;
+    int                     nSlave;             // rxbyte reads it itself, -1 otherwise
+    char                    szName[128];        // slave side
+    std::atomic<UINT64>     qwRxBytes;
+    std::atomic<UINT64>     qwRxCalls;
+    std::mutex              Lock;
+    std::condition_variable cvEcho;
+    CSerialGapFramer        Framer{ SERIAL_GAP_MODBUS_CHARS, SERIAL_GAP_MODBUS_MIN_NS };
+    std::atomic<UINT64>     qwFrames;
+    std::atomic<UINT64>     qwBadFrames;        // not the size written
+    UINT64                  qwFrameAt;          // SerialMetricsNow() of the last delivery
+    UINT                    nFrameSize;
+};
+
+// system calls and CPU time spent on the master side, not part of the result
+static std::atomic<UINT64>  s_qwPeerSyscalls;
+static std::atomic<UINT64>  s_qwPeerCpuUs;
+static CSerialCapture       s_Capture;
+
+static UINT64 ReadIoSyscalls()
+{
+    char szLine[128];
+    UINT64 qwTotal = 0;
+    FILE *pFile = fopen( "/proc/self/io", "r" );
+
+    if ( pFile == NULL )
+    {
+        return 0;
+    }
+
+    while ( fgets( szLine, sizeof( szLine ), pFile ) != NULL )
+    {
+        unsigned long long qwValue;
+
+        if ( ( sscanf( szLine, "syscr: %llu", &qwValue ) == 1 ) || ( sscanf( szLine, "syscw: %llu", &qwValue ) == 1 ) )
+        {
+            qwTotal += qwValue;
+        }
+    }
+
+    fclose( pFile );
+    return qwTotal;
+}
+
+static UINT64 CpuUs( int nWho )
+{
+    struct rusage ru;
+    getrusage( nWho, &ru );
+    return ( UINT64 )( ru.ru_utime.tv_sec + ru.ru_stime.tv_sec ) * 1000000 + ru.ru_utime.tv_usec + ru.ru_stime.tv_usec;
+}
+
+static void PeerThreadDone( UINT64 qwStartUs )
+{
+#ifdef RUSAGE_THREAD
+    s_qwPeerCpuUs += CpuUs( RUSAGE_THREAD ) - qwStartUs;
+#else
+    ( void )qwStartUs;
+#endif
+}
+
+static UINT64 PeerThreadStart()
+{
+#ifdef RUSAGE_THREAD
+    return CpuUs( RUSAGE_THREAD );
+#else
+    return 0;
+#endif
+}
+
+static void OnRx( void *pContext, const BYTE *pData, UINT nLength )
+{
+    BENCH_PORT *pBench = ( BENCH_PORT * )pContext;
+    ( void )pData;
+    pBench->qwRxBytes += nLength;
+    pBench->qwRxCalls++;
+    pBench->cvEcho.notify_one();
+}
+
+static void OnRxNotify( void *pContext, UINT64 qwNow )
+{
+    BENCH_PORT *pBench = ( BENCH_PORT * )pContext;
+    ( void )qwNow;
+    std::lock_guard<std::mutex> Lock( pBench->Lock );
+    pBench->cvEcho.notify_one();
+}
+
+static void OnFrame( void *pContext, const BYTE *pFrame, UINT nLength )
+{
+    BENCH_PORT *pBench = ( BENCH_PORT * )pContext;
+    std::lock_guard<std::mutex> Lock( pBench->Lock );
+    ( void )pFrame;
+    pBench->qwFrameAt = SerialMetricsNow();
+    pBench->qwBadFrames += ( nLength != pBench->nFrameSize ) ? 1 : 0;
+    pBench->qwFrames++;
+    pBench->cvEcho.notify_one();
+}
+
+static void WriteFrame( BENCH_PORT *pBench, const BYTE *pFrame, UINT nSize )
+{
+    UINT nDone = 0;
+
+    while ( nDone < nSize )
+    {
+        ssize_t w = write( pBench->nMaster, pFrame + nDone, nSize - nDone );
+        s_qwPeerSyscalls++;
+        nDone += ( w > 0 ) ? ( UINT )w : 0;
+    }
+}
+
+static BOOL OpenPort( const BENCH_CONFIG &Config, BENCH_PORT *pBench )
+{
+    return pBench->Port.OpenDevice( NULL, pBench->szName, Config.nBaud, NOPARITY, 8, ONESTOPBIT, EV_RXCHAR, 1UL << 20 );
+}
+
+static BOOL OpenPorts( const BENCH_CONFIG &Config, CSerialPortReactor &Reactor, std::vector<BENCH_PORT *> &Ports )
+{
+    for ( UINT i = 0; i < Config.nPorts; i++ )
+    {
+        void *pMemory = NULL;
+        struct termios tio;
+        int nSlave;
+
+        // the port holds cache line aligned members, plain new does not guarantee that before C++17
+        if ( posix_memalign( &pMemory, alignof( BENCH_PORT ), sizeof( BENCH_PORT ) ) != 0 )
+        {
+            return FALSE;
+        }
+
+        BENCH_PORT *pBench = new ( pMemory ) BENCH_PORT;
+        Ports.push_back( pBench );
+        pBench->qwRxBytes = 0;
+        pBench->qwRxCalls = 0;
+        pBench->qwFrames = 0;
+        pBench->qwBadFrames = 0;
+        pBench->qwFrameAt = 0;
+        pBench->nFrameSize = Config.nSize;
+
+        if ( openpty( &pBench->nMaster, &nSlave, pBench->szName, NULL, NULL ) != 0 )
+        {
+            perror( "openpty()" );
+            return FALSE;
+        }
+
+        // raw on the master too, or the line discipline rewrites the data
+        tcgetattr( pBench->nMaster, &tio );
+        cfmakeraw( &tio );
+        tcsetattr( pBench->nMaster, TCSANOW, &tio );
+        fcntl( pBench->nMaster, F_SETFL, fcntl( pBench->nMaster, F_GETFL ) | O_NONBLOCK );
+        pBench->nSlave = -1;
+
+        if ( Config.strMode == "rxbyte" )
+        {
+            // the port stays closed, the benchmark receives on the slave
+            tcgetattr( nSlave, &tio );
+            cfmakeraw( &tio );
+            tcsetattr( nSlave, TCSANOW, &tio );
+            fcntl( nSlave, F_SETFL, fcntl( nSlave, F_GETFL ) | O_NONBLOCK );
+            pBench->nSlave = nSlave;
+            continue;
+        }
+
+        if ( Config.strMode == "rxpull" )
+        {
+            pBench->Port.SetRxNotify( OnRxNotify, pBench );
+        }
+        else
+        {
+            pBench->Port.SetRxCallback( OnRx, pBench );
+        }
+
+        pBench->Port.SetRxPolicy( Config.nRxMinBytes, Config.nRxDelayUs );
+
+        if ( s_Capture.IsOpen() )
+        {
+            pBench->Port.SetCapture( &s_Capture, i );
+        }
+
+        if ( Config.strMode == "gap" )
+        {
+            pBench->Framer.SetMaxFrameSize( BENCH_MAX_MESSAGE );
+            pBench->Framer.SetCallback( OnFrame, pBench );
+            pBench->Port.SetFramer( &pBench->Framer );
+        }
+#ifdef SERIAL_PORT_REACTOR
+        if ( Config.nReactorLoops > 0 )
+        {
+            pBench->Port.SetReactor( &Reactor );
+        }
+#else
+        ( void )Reactor;
+#endif
+
+        BOOL bOpen = OpenPort( Config, pBench );
+        close( nSlave );
+
+        if ( !bOpen )
+        {
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+// reads everything the ports send until bStop, the master side of tx and write
+static void DrainMasters( std::vector<BENCH_PORT *> &Ports, std::atomic<bool> &bStop, std::atomic<UINT64> &qwBytes )
+{
+    UINT64 qwStart = PeerThreadStart();
+    std::vector<struct pollfd> Fds( Ports.size() );
+    static BYTE Buffer[BENCH_MAX_MESSAGE];
+
+    for ( size_t i = 0; i < Ports.size(); i++ )
+    {
+        Fds[i].fd = Ports[i]->nMaster;
+        Fds[i].events = POLLIN;
+    }
+
+    while ( !bStop )
+    {
+        if ( poll( Fds.data(), Fds.size(), 10 ) <= 0 )
+        {
+            continue;
+        }
+
+        for ( size_t i = 0; i < Fds.size(); i++ )
+        {
+            if ( Fds[i].revents & POLLIN )
+            {
+                ssize_t n = read( Fds[i].fd, Buffer, sizeof( Buffer ) );
+                s_qwPeerSyscalls++;
+
+                if ( n > 0 )
+                {
+                    qwBytes += ( UINT64 )n;
+                }
+            }
+        }
+    }
+
+    PeerThreadDone( qwStart );
+}
+
+// writes into every master as fast as the ports take it, the master side of rx
+static void FeedMasters( std::vector<BENCH_PORT *> &Ports, UINT nSize, std::atomic<bool> &bStop )
+{
+    UINT64 qwStart = PeerThreadStart();
+    std::vector<struct pollfd> Fds( Ports.size() );
+    std::vector<BYTE> Message( nSize, 0x55 );
+
+    for ( size_t i = 0; i < Ports.size(); i++ )
+    {
+        Fds[i].fd = Ports[i]->nMaster;
+        Fds[i].events = POLLOUT;
+    }
+
+    while ( !bStop )
+    {
+        if ( poll( Fds.data(), Fds.size(), 10 ) <= 0 )
+        {
+            continue;
+        }
+
+        for ( size_t i = 0; i < Fds.size(); i++ )
+        {
+            if ( Fds[i].revents & POLLOUT )
+            {
+                ( void )write( Fds[i].fd, Message.data(), nSize );
+                s_qwPeerSyscalls++;
+            }
+        }
+    }
+
+    PeerThreadDone( qwStart );
+}
+
+// drains and feeds every master at once, the master side of duplex
+static void DuplexMasters( std::vector<BENCH_PORT *> &Ports, UINT nSize, std::atomic<bool> &bStop, std::atomic<UINT64> &qwBytes )
+{
+    UINT64 qwStart = PeerThreadStart();
+    std::vector<struct pollfd> Fds( Ports.size() );
+    std::vector<BYTE> Message( nSize, 0x55 );
+    static BYTE Buffer[BENCH_MAX_MESSAGE];
+
+    for ( size_t i = 0; i < Ports.size(); i++ )
+    {
+        Fds[i].fd = Ports[i]->nMaster;
+        Fds[i].events = POLLIN | POLLOUT;
+    }
+
+    while ( !bStop )
+    {
+        if ( poll( Fds.data(), Fds.size(), 10 ) <= 0 )
+        {
+            continue;
+        }
+
+        for ( size_t i = 0; i < Fds.size(); i++ )
+        {
+            if ( Fds[i].revents & POLLIN )
+            {
+                ssize_t n = read( Fds[i].fd, Buffer, sizeof( Buffer ) );
+                s_qwPeerSyscalls++;
+
+                if ( n > 0 )
+                {
+                    qwBytes += ( UINT64 )n;
+                }
+            }
+
+            if ( Fds[i].revents & POLLOUT )
+            {
+                ( void )write( Fds[i].fd, Message.data(), nSize );
+                s_qwPeerSyscalls++;
+            }
+        }
+    }
+
+    PeerThreadDone( qwStart );
+}
+
+// sends back whatever arrives, the master side of rtt
+static void EchoMasters( std::vector<BENCH_PORT *> &Ports, std::atomic<bool> &bStop )
+{
+    UINT64 qwStart = PeerThreadStart();
+    std::vector<struct pollfd> Fds( Ports.size() );
+    static BYTE Buffer[BENCH_MAX_MESSAGE];
+
+    for ( size_t i = 0; i < Ports.size(); i++ )
+    {
+        Fds[i].fd = Ports[i]->nMaster;
+        Fds[i].events = POLLIN;
+    }
+
+    while ( !bStop )
+    {
+        if ( poll( Fds.data(), Fds.size(), 10 ) <= 0 )
+        {
+            continue;
+        }
+
+        for ( size_t i = 0; i < Fds.size(); i++ )
+        {
+            if ( Fds[i].revents & POLLIN )
+            {
+                ssize_t n = read( Fds[i].fd, Buffer, sizeof( Buffer ) );
+                ssize_t nDone = 0;
+                s_qwPeerSyscalls++;
+
+                while ( nDone < n )
+                {
+                    ssize_t w = write( Fds[i].fd, Buffer + nDone, ( size_t )( n - nDone ) );
+                    s_qwPeerSyscalls++;
+                    nDone += ( w > 0 ) ? w : 0;
+                }
+            }
+        }
+    }
+
+    PeerThreadDone( qwStart );
+}
+
+static BOOL RunOne( const BENCH_CONFIG &Config, BENCH_RESULT &Result )
+{
+    CSerialPortReactor Reactor;
+    std::vector<BENCH_PORT *> Ports;
+    std::vector<std::thread> Threads;
+    std::vector<BYTE> Message( Config.nSize, 0xA5 );
+    std::atomic<bool> bStop( false );
+    std::atomic<bool> bPeerStop( false );
+    std::atomic<UINT64> qwDrained( 0 );
+    std::atomic<UINT64> qwMessages( 0 );
+    std::mutex LatencyLock;
+    std::thread Peer;
+    BOOL bOk;
+
+#ifdef SERIAL_PORT_REACTOR
+    if ( ( Config.nReactorLoops > 0 ) && !Reactor.Start( Config.nReactorLoops ) )
+    {
+        return FALSE;
+    }
+#endif
+
+    bOk = OpenPorts( Config, Reactor, Ports );
+
+    if ( bOk )
+    {
+        if ( ( Config.strMode == "tx" ) || ( Config.strMode == "write" ) )
+        {
+            Peer = std::thread( DrainMasters, std::ref( Ports ), std::ref( bPeerStop ), std::ref( qwDrained ) );
+        }
+        else if ( ( Config.strMode == "rx" ) || ( Config.strMode == "rxpull" ) || ( Config.strMode == "rxbyte" ) )
+        {
+            Peer = std::thread( FeedMasters, std::ref( Ports ), Config.nSize, std::ref( bPeerStop ) );
+        }
+        else if ( Config.strMode == "duplex" )
+        {
+            Peer = std::thread( DuplexMasters, std::ref( Ports ), Config.nSize, std::ref( bPeerStop ), std::ref( qwDrained ) );
+        }
+        else
+        {
+            Peer = std::thread( EchoMasters, std::ref( Ports ), std::ref( bPeerStop ) );
+        }
+
+        s_qwPeerSyscalls = 0;
+        s_qwPeerCpuUs = 0;
+        UINT64 qwSyscalls = ReadIoSyscalls();
+        UINT64 qwCpuUs = CpuUs( RUSAGE_SELF );
+        UINT64 qwRxStart = 0;
+        UINT64 qwCallsStart = 0;
+        BenchClock::time_point Start = BenchClock::now();
+
+        for ( size_t i = 0; i < Ports.size(); i++ )
+        {
+            qwRxStart += Ports[i]->qwRxBytes;
+            qwCallsStart += Ports[i]->qwRxCalls;
+        }
+
+        for ( size_t i = 0; i < Ports.size(); i++ )
+        {
+            BENCH_PORT *pBench = Ports[i];
+
+            Threads.push_back( std::thread( [&, pBench]()
+            {
+                std::vector<double> Latency;
+
+                while ( !bStop )
+                {
+                    if ( ( Config.strMode == "tx" ) || ( Config.strMode == "duplex" ) )
+                    {
+                        // bounded by the high-water mark of the queue
+                        if ( pBench->Port.WriteAsync( Message.data(), Config.nSize, NULL, NULL, 100 ) )
+                        {
+                            qwMessages++;
+                        }
+                    }
+                    else if ( Config.strMode == "write" )
+                    {
+                        pBench->Port.Write( Message.data(), ( int )Config.nSize );
+                        qwMessages++;
+                    }
+                    else if ( Config.strMode == "rxpull" )
+                    {
+                        static thread_local BYTE Buffer[BENCH_MAX_MESSAGE];
+                        UINT n = pBench->Port.Read( Buffer, sizeof( Buffer ) );
+
+                        if ( n > 0 )
+                        {
+                            pBench->qwRxBytes += n;
+                            pBench->qwRxCalls++;
+                            continue;
+                        }
+
+                        // woken by the notify of the next read
+                        std::unique_lock<std::mutex> Lock( pBench->Lock );
+                        pBench->cvEcho.wait_for( Lock, std::chrono::milliseconds( 10 ), [&]() { return pBench->Port.GetRxCount() > 0; } );
+                    }
+                    else if ( Config.strMode == "rxbyte" )
+                    {
+                        struct pollfd Fd = { pBench->nSlave, POLLIN, 0 };
+                        BYTE Byte;
+
+                        if ( poll( &Fd, 1, 10 ) <= 0 )
+                        {
+                            continue;
+                        }
+
+                        // one ReadFile() and one PostMessage() per byte, as CommThread did
+                        while ( !bStop && ( read( pBench->nSlave, &Byte, 1 ) == 1 ) )
+                        {
+                            OnRx( pBench, &Byte, 1 );
+                        }
+                    }
+                    else if ( Config.strMode == "cycle" )
+                    {
+                        BenchClock::time_point Begin = BenchClock::now();
+                        pBench->Port.Close();
+
+                        if ( OpenPort( Config, pBench ) )
+                        {
+                            Latency.push_back( std::chrono::duration<double, std::micro>( BenchClock::now() - Begin ).count() );
+                            qwMessages++;
+                        }
+                    }
+                    else if ( Config.strMode == "gap" )
+                    {
+                        // two frames a gap apart, a receive policy which held them together merges them
+                        std::unique_lock<std::mutex> Lock( pBench->Lock );
+                        UINT64 qwTarget = pBench->qwFrames + 2;
+                        UINT64 qwLine = pBench->Port.GetCharacterTime() * Config.nSize;
+                        UINT64 qwSent;
+
+                        Lock.unlock();
+                        WriteFrame( pBench, Message.data(), Config.nSize );
+                        std::this_thread::sleep_for( std::chrono::nanoseconds( qwLine + 2 * pBench->Framer.GetGap() ) );
+                        Lock.lock();
+                        WriteFrame( pBench, Message.data(), Config.nSize );
+                        qwSent = SerialMetricsNow();
+
+                        if ( pBench->cvEcho.wait_for( Lock, std::chrono::seconds( 1 ), [&]() { return pBench->qwFrames >= qwTarget; } ) )
+                        {
+                            double dLate = ( double )pBench->qwFrameAt - ( double )qwSent - ( double )pBench->Framer.GetGap();
+                            Latency.push_back( dLate / 1000.0 );
+                            qwMessages += 2;
+                        }
+
+                        // the framer takes a read to have arrived at line rate, the pause
+                        // covers the time the frame would have taken on a real line
+                        Lock.unlock();
+                        std::this_thread::sleep_for( std::chrono::nanoseconds( qwLine ) );
+                    }
+                    else if ( Config.strMode == "rtt" )
+                    {
+                        std::unique_lock<std::mutex> Lock( pBench->Lock );
+                        UINT64 qwTarget = pBench->qwRxBytes + Config.nSize;
+                        BenchClock::time_point Sent = BenchClock::now();
+                        pBench->Port.WriteAsync( Message.data(), Config.nSize );
+
+                        if ( pBench->cvEcho.wait_for( Lock, std::chrono::seconds( 1 ), [&]() { return pBench->qwRxBytes >= qwTarget; } ) )
+                        {
+                            Latency.push_back( std::chrono::duration<double, std::micro>( BenchClock::now() - Sent ).count() );
+                            qwMessages++;
+                        }
+                    }
+                    else
+                    {
+                        // idle, the ports are left alone
+                        std::this_thread::sleep_for( std::chrono::milliseconds( 100 ) );
+                    }
+                }
+
+                std::lock_guard<std::mutex> Lock( LatencyLock );
+                Result.Latency.insert( Result.Latency.end(), Latency.begin(), Latency.end() );
+            } ) );
+        }
+
+        std::this_thread::sleep_for( std::chrono::duration<double>( Config.dSeconds ) );
+        bStop = true;
+
+        for ( size_t i = 0; i < Threads.size(); i++ )
+        {
+            Threads[i].join();
+        }
+
+        Result.dSeconds = std::chrono::duration<double>( BenchClock::now() - Start ).count();
+        bPeerStop = true;
+        Peer.join();
+        Result.qwSyscalls = ReadIoSyscalls() - qwSyscalls - s_qwPeerSyscalls;
+        Result.dCpuSeconds = ( double )( CpuUs( RUSAGE_SELF ) - qwCpuUs - s_qwPeerCpuUs ) / 1e6;
+        Result.qwMessages = qwMessages;
+        Result.qwDeliveries = 0;
+
+        for ( size_t i = 0; i < Ports.size(); i++ )
+        {
+            Result.qwDeliveries += Ports[i]->qwRxCalls;
+        }
+
+        Result.qwDeliveries -= qwCallsStart;
+        Result.qwTxBytes = 0;
+        Result.qwRxBytes = 0;
+        Result.qwBadFrames = 0;
+
+        for ( size_t i = 0; i < Ports.size(); i++ )
+        {
+            Result.qwRxBytes += Ports[i]->qwRxBytes;
+        }
+
+        Result.qwRxBytes -= qwRxStart;
+
+        if ( ( Config.strMode == "rx" ) || ( Config.strMode == "rxpull" ) || ( Config.strMode == "rxbyte" ) )
+        {
+            Result.qwBytes = Result.qwRxBytes;
+            Result.qwMessages = Result.qwBytes / Config.nSize;
+        }
+        else if ( Config.strMode == "duplex" )
+        {
+            // both directions share the line of each port
+            Result.qwTxBytes = qwDrained;
+            Result.qwBytes = Result.qwTxBytes + Result.qwRxBytes;
+        }
+        else if ( Config.strMode == "rtt" )
+        {
+            Result.qwBytes = Result.qwMessages * Config.nSize * 2;
+            Result.qwTxBytes = Result.qwBytes / 2;
+            Result.qwRxBytes = Result.qwBytes / 2;
+        }
+        else if ( Config.strMode == "gap" )
+        {
+            for ( size_t i = 0; i < Ports.size(); i++ )
+            {
+                Result.qwBadFrames += Ports[i]->qwBadFrames;
+            }
+
+            Result.qwBytes = Result.qwMessages * Config.nSize;
+            Result.qwRxBytes = Result.qwBytes;
+        }
+        else
+        {
+            Result.qwBytes = qwDrained;
+            Result.qwTxBytes = qwDrained;
+            Result.qwRxBytes = 0;
+        }
+    }
+
+    for ( size_t i = 0; i < Ports.size(); i++ )
+    {
+        Ports[i]->Port.Close();
+        close( Ports[i]->nMaster );
+
+        if ( Ports[i]->nSlave >= 0 )
+        {
+            close( Ports[i]->nSlave );
+        }
+
+        Ports[i]->~BENCH_PORT();
+        free( Ports[i] );
+    }
+
+    Reactor.Stop();
+    return bOk;
+}
+
+static double Percentile( std::vector<double> &Sorted, double dFraction )
+{
+    if ( Sorted.empty() )
+    {
+        return 0.0;
+    }
+
+    size_t nIndex = ( size_t )( dFraction * ( double )( Sorted.size() - 1 ) + 0.5 );
+    return Sorted[nIndex];
+}
+
+static void Report( const BENCH_CONFIG &Config, BENCH_RESULT &Result, BOOL bJson )
+{
+    double dKb = ( double )Result.qwBytes / 1024.0;
+    double dMb = ( double )Result.qwBytes / ( 1024.0 * 1024.0 );
+    std::sort( Result.Latency.begin(), Result.Latency.end() );
+    double p50 = Percentile( Result.Latency, 0.50 );
+    double p99 = Percentile( Result.Latency, 0.99 );
+    double p999 = Percentile( Result.Latency, 0.999 );
+    double dMbps = Result.qwBytes / Result.dSeconds / 1e6;
+    double dSyscalls = ( dKb > 0 ) ? Result.qwSyscalls / dKb : 0.0;
+    double dCpu = ( dMb > 0 ) ? Result.dCpuSeconds * 1000.0 / dMb : 0.0;
+    double dCpuRate = Result.dCpuSeconds * 1000.0 / Result.dSeconds;
+    double dDeliveries = ( dKb > 0 ) ? Result.qwDeliveries / dKb : 0.0;
+    double dTxMbps = Result.qwTxBytes / Result.dSeconds / 1e6;
+    double dRxMbps = Result.qwRxBytes / Result.dSeconds / 1e6;
+
+    if ( bJson )
+    {
+        printf( "{\"mode\":\"%s\",\"ports\":%u,\"size\":%u,\"baud\":%u,\"reactor\":%u,\"seconds\":%.3f,\"messages\":%llu,"
+                "\"mb_per_s\":%.3f,\"p50_us\":%.1f,\"p99_us\":%.1f,\"p999_us\":%.1f,\"syscalls_per_kb\":%.3f,\"cpu_ms_per_mb\":%.3f,\"cpu_ms_per_s\":%.3f,"
+                "\"rx_bytes\":%u,\"rx_delay_us\":%u,\"deliveries_per_kb\":%.3f,\"tx_mb_per_s\":%.3f,\"rx_mb_per_s\":%.3f}\n",
+                Config.strMode.c_str(), Config.nPorts, Config.nSize, Config.nBaud, Config.nReactorLoops, Result.dSeconds,
+                ( unsigned long long )Result.qwMessages, dMbps, p50, p99, p999, dSyscalls, dCpu, dCpuRate,
+                Config.nRxMinBytes, Config.nRxDelayUs, dDeliveries, dTxMbps, dRxMbps );
+    }
+    else
+    {
+        printf( "%s,%u,%u,%u,%u,%.3f,%llu,%.3f,%.1f,%.1f,%.1f,%.3f,%.3f,%.3f,%u,%u,%.3f,%.3f,%.3f\n",
+                Config.strMode.c_str(), Config.nPorts, Config.nSize, Config.nBaud, Config.nReactorLoops, Result.dSeconds,
+                ( unsigned long long )Result.qwMessages, dMbps, p50, p99, p999, dSyscalls, dCpu, dCpuRate,
+                Config.nRxMinBytes, Config.nRxDelayUs, dDeliveries, dTxMbps, dRxMbps );
+    }
+
+    fflush( stdout );
+}
+
+static std::vector<std::string> Split( const char *szList )
+{
+    std::vector<std::string> Items;
+    std::string strItem;
+
+    for ( const char *p = szList; ; p++ )
+    {
+        if ( ( *p == ',' ) || ( *p == '\0' ) )
+        {
+            if ( !strItem.empty() )
+            {
+                Items.push_back( strItem );
+            }
+
+            strItem.clear();
+
+            if ( *p == '\0' )
+            {
+                break;
+            }
+        }
+        else
+        {
+            strItem += *p;
+        }
+    }
+
+    return Items;
+}
+
+static std::vector<UINT> SplitUint( const char *szList )
+{
+    std::vector<std::string> Items = Split( szList );
+    std::vector<UINT> Values;
+
+    for ( size_t i = 0; i < Items.size(); i++ )
+    {
+        Values.push_back( ( UINT )strtoul( Items[i].c_str(), NULL, 10 ) );
+    }
+
+    return Values;
+}
+
+static void Usage( const char *szName )
+{
+    fprintf( stderr,
+             "usage: %s [--modes tx,write,rx,rxpull,rxbyte,rtt,duplex,cycle,idle,gap] [--sizes 16,256,4096] [--bauds 115200]\n"
+             "          [--ports 1,4] [--reactor N] [--seconds 1] [--capture file] [--rx-bytes 1,64,512]\n"
+             "          [--rx-delay us] [--json]\n", szName );
+}
+
+int main( int argc, char *argv[] )
+{
+    std::vector<std::string> Modes = Split( "tx,rx,rtt" );
+    std::vector<UINT> Sizes = SplitUint( "16,256,4096" );
+    std::vector<UINT> Bauds = SplitUint( "115200" );
+    std::vector<UINT> PortCounts = SplitUint( "1,4" );
+    std::vector<UINT> RxPolicies = SplitUint( "1" );
+    UINT nRxDelayUs = 0;
+    UINT nReactorLoops = 0;
+    double dSeconds = 1.0;
+    BOOL bJson = FALSE;
+    int nResult = 0;
+
+    for ( int i = 1; i < argc; i++ )
+    {
+        const char *szArg = argv[i];
+        const char *szValue = ( i + 1 < argc ) ? argv[i + 1] : NULL;
+
+        if ( strcmp( szArg, "--json" ) == 0 )
+        {
+            bJson = TRUE;
+            continue;
+        }
+
+        if ( szValue == NULL )
+        {
+            Usage( argv[0] );
+            return 2;
+        }
+
+        if ( strcmp( szArg, "--modes" ) == 0 )
+        {
+            Modes = Split( szValue );
+        }
+        else if ( strcmp( szArg, "--sizes" ) == 0 )
+        {
+            Sizes = SplitUint( szValue );
+        }
+        else if ( strcmp( szArg, "--bauds" ) == 0 )
+        {
+            Bauds = SplitUint( szValue );
+        }
+        else if ( strcmp( szArg, "--ports" ) == 0 )
+        {
+            PortCounts = SplitUint( szValue );
+        }
+        else if ( strcmp( szArg, "--reactor" ) == 0 )
+        {
+            nReactorLoops = ( UINT )strtoul( szValue, NULL, 10 );
+        }
+        else if ( strcmp( szArg, "--rx-bytes" ) == 0 )
+        {
+            RxPolicies = SplitUint( szValue );
+        }
+        else if ( strcmp( szArg, "--rx-delay" ) == 0 )
+        {
+            nRxDelayUs = ( UINT )strtoul( szValue, NULL, 10 );
+        }
+        else if ( strcmp( szArg, "--seconds" ) == 0 )
+        {
+            dSeconds = atof( szValue );
+        }
+        else if ( strcmp( szArg, "--capture" ) == 0 )
+        {
+            if ( !s_Capture.Open( szValue ) )
+            {
+                fprintf( stderr, "%s.0000 cannot be created\n", szValue );
+                return 1;
+            }
+        }
+        else
+        {
+            Usage( argv[0] );
+            return 2;
+        }
+
+        i++;
+    }
+
+    if ( !bJson )
+    {
+        printf( "mode,ports,size,baud,reactor,seconds,messages,mb_per_s,p50_us,p99_us,p999_us,syscalls_per_kb,cpu_ms_per_mb,cpu_ms_per_s,"
+                "rx_bytes,rx_delay_us,deliveries_per_kb,tx_mb_per_s,rx_mb_per_s\n" );
+    }
+
+    for ( size_t m = 0; m < Modes.size(); m++ )
+    {
+        for ( size_t p = 0; p < PortCounts.size(); p++ )
+        {
+            for ( size_t s = 0; s < Sizes.size(); s++ )
+            {
+                for ( size_t b = 0; b < Bauds.size() * RxPolicies.size(); b++ )
+                {
+                    BENCH_CONFIG Config;
+                    BENCH_RESULT Result;
+                    Config.strMode = Modes[m];
+                    Config.nSize = std::min<UINT>( std::max<UINT>( Sizes[s], 1 ), BENCH_MAX_MESSAGE );
+                    Config.nBaud = Bauds[b / RxPolicies.size()];
+                    Config.nPorts = std::max<UINT>( PortCounts[p], 1 );
+                    Config.dSeconds = dSeconds;
+                    Config.nReactorLoops = nReactorLoops;
+                    Config.nRxMinBytes = RxPolicies[b % RxPolicies.size()];
+                    Config.nRxDelayUs = nRxDelayUs;
+
+                    if ( !RunOne( Config, Result ) )
+                    {
+                        fprintf( stderr, "%s: %u ports could not be opened\n", Modes[m].c_str(), Config.nPorts );
+                        return 1;
+                    }
+
+                    Report( Config, Result, bJson );
+
+                    if ( Result.qwBadFrames != 0 )
+                    {
+                        fprintf( stderr, "gap: %llu frames were split or merged\n", ( unsigned long long )Result.qwBadFrames );
+                        nResult = 1;
+                    }
+                }
+            }
+        }
+    }
+
+    if ( s_Capture.IsOpen() )
+    {
+        SERIAL_CAPTURE_STATS Stats;
+        s_Capture.Close();
+        s_Capture.GetStats( &Stats );
+        fprintf( stderr, "capture: %llu records, %llu bytes, %llu segments, %llu dropped\n", ( unsigned long long )Stats.qwRecords,
+                 ( unsigned long long )Stats.qwBytes, ( unsigned long long )Stats.qwSegments, ( unsigned long long )Stats.qwDropped );
+    }
+
+    return nResult;
+}
+
+#else
+
+#include <stdio.h>
+
+int main()
+{
+    fprintf( stderr, "the loopback benchmark needs pseudo-terminals (POSIX)\n" );
+    return 1;
+}
+
+#endif
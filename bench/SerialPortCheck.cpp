@@ -0,0 +1,1012 @@
+/*
+**  FILENAME            SerialPortCheck.cpp
+**
+**  PURPOSE             Self-checking run of the POSIX backend against pseudo-terminal
+**                      pairs, no hardware attached. The port opens the slave side
+**                      through the public API, the checks drive the master side and
+**                      read the termios of the slave back:
+**
+**                      open        OpenDevice() maps baud, parity, data and stop bits
+**                      dcb         SetDCB() maps them again with flow control, an
+**                                  unsupported baud rate fails and changes nothing,
+**                                  neither the DCB nor the character time
+**                      tx          every byte value written arrives unchanged
+**                      rx          every byte value received arrives unchanged
+**                      roundtrip   echoed by the master while the port sends
+**                      backpressure WriteAsync() fails or waits above the high-water
+**                                  mark and goes on once the line drains, an empty
+**                                  queue takes a request of any size
+**                      order       producer threads queue numbered requests, they
+**                                  complete in the order they arrive at the master
+**                      pending     Close() fails the requests still queued
+**                      zerocopy    header + payload + CRC WriteV() requests arrive
+**                                  intact, every buffer is released once and the
+**                                  queue neither copies nor allocates once warm
+**                      close       Close() releases the device, it opens again, and
+**                                  a hangup of the master goes to the error queue
+**                      hangup      a Write() blocked on a full line returns once the
+**                                  master hangs up, so does a later one, the queue is
+**                                  empty and refuses more, with an own thread and
+**                                  with the reactor
+**                      rxclose     a receive callback closes its port on the I/O
+**                                  thread, the port opens again and receives, with
+**                                  an own thread and with the reactor
+**
+**                      One CSV line per check, exits with 1 when one failed.
+**
+**                      g++ -O2 -std=c++11 -I.. SerialPortCheck.cpp ../Serial*.cpp -lpthread -lutil
+**                      ./a.out
+**
+**  CREATION DATE       16-10-2026
+**  LAST MODIFICATION   16-10-2026
+*/
+
+#ifndef _WIN32
+
+#include "SerialPort.h"
+#include "SerialPortReactor.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#if defined( __APPLE__ ) || defined( __FreeBSD__ )
+#include <util.h>
+#else
+#include <pty.h>
+#endif
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define CHECK_TIMEOUT_MS    2000
+#define CHECK_PATTERN_SIZE  4096                /* every byte value 16 times */
+#define CHECK_ROUNDTRIP     ( 256 * 1024 )
+#define CHECK_HIGH_WATER    16384
+#define CHECK_PRODUCERS     4
+#define CHECK_REQUESTS      200                 /* per producer */
+#define CHECK_REQUEST_SIZE  64                  /* producer, sequence number, filler */
+#define CHECK_FRAMES        2000                /* WriteV() requests counted by zerocopy */
+#define CHECK_FRAME_PAYLOAD 256
+
+typedef struct _CHECK_PTY
+{
+    int                 nMaster;
+    int                 nSlave;                 // kept open to read the termios of the slave back
+    char                szName[128];
+} CHECK_PTY;
+
+typedef struct _CHECK_RX
+{
+    std::mutex          Lock;
+    std::vector<BYTE>   Data;
+} CHECK_RX;
+
+typedef struct _CHECK_TX
+{
+    std::mutex          Lock;
+    std::vector<UINT>   Completed;              // request numbers in completion order
+    UINT                nFailed;
+    UINT                nShort;                 // completed with fewer bytes than queued
+} CHECK_TX;
+
+typedef struct _CHECK_RELEASE
+{
+    std::atomic<UINT>   nBuffers;
+    std::atomic<UINT64> qwBytes;
+} CHECK_RELEASE;
+
+typedef struct _CHECK_CLOSER
+{
+    CSerialPort         *pPort;
+    std::atomic<UINT>   nCalls;
+    std::atomic<bool>   bClosed;                // IsOpen() was FALSE after the Close() of the callback
+} CHECK_CLOSER;
+
+typedef struct _CHECK_REQUEST
+{
+    CHECK_TX            *pTx;
+    UINT                nNumber;                // producer * CHECK_REQUESTS + sequence
+    UINT                nSize;
+} CHECK_REQUEST;
+
+static BOOL OpenPty( CHECK_PTY *pPty )
+{
+    struct termios tio;
+    pPty->nMaster = -1;
+    pPty->nSlave = -1;
+
+    if ( openpty( &pPty->nMaster, &pPty->nSlave, pPty->szName, NULL, NULL ) != 0 )
+    {
+        perror( "openpty()" );
+        return FALSE;
+    }
+
+    // raw on the master too, or the line discipline rewrites the data
+    tcgetattr( pPty->nMaster, &tio );
+    cfmakeraw( &tio );
+    tcsetattr( pPty->nMaster, TCSANOW, &tio );
+    fcntl( pPty->nMaster, F_SETFL, fcntl( pPty->nMaster, F_GETFL ) | O_NONBLOCK );
+    return TRUE;
+}
+
+static void ClosePty( CHECK_PTY *pPty )
+{
+    if ( pPty->nSlave >= 0 )
+    {
+        close( pPty->nSlave );
+    }
+
+    if ( pPty->nMaster >= 0 )
+    {
+        close( pPty->nMaster );
+    }
+}
+
+static void Pattern( std::vector<BYTE> &Data, UINT nSize, UINT nSeed )
+{
+    Data.resize( nSize );
+
+    for ( UINT i = 0; i < nSize; i++ )
+    {
+        Data[i] = ( BYTE )( i * 7 + nSeed );
+    }
+}
+
+// reads nSize bytes from the master, fewer when they do not come in time
+static UINT ReadMaster( int nMaster, BYTE *pData, UINT nSize, DWORD dwTimeoutMs )
+{
+    UINT64 qwDeadline = SerialMetricsNow() + ( UINT64 )dwTimeoutMs * 1000000;
+    UINT nDone = 0;
+
+    while ( ( nDone < nSize ) && ( SerialMetricsNow() < qwDeadline ) )
+    {
+        struct pollfd Fd = { nMaster, POLLIN, 0 };
+
+        if ( poll( &Fd, 1, 10 ) > 0 )
+        {
+            ssize_t n = read( nMaster, pData + nDone, nSize - nDone );
+            nDone += ( n > 0 ) ? ( UINT )n : 0;
+        }
+    }
+
+    return nDone;
+}
+
+static BOOL WriteMaster( int nMaster, const BYTE *pData, UINT nSize )
+{
+    UINT nDone = 0;
+
+    while ( nDone < nSize )
+    {
+        struct pollfd Fd = { nMaster, POLLOUT, 0 };
+        ssize_t n;
+
+        if ( poll( &Fd, 1, CHECK_TIMEOUT_MS ) <= 0 )
+        {
+            return FALSE;
+        }
+
+        n = write( nMaster, pData + nDone, nSize - nDone );
+        nDone += ( n > 0 ) ? ( UINT )n : 0;
+    }
+
+    return TRUE;
+}
+
+static void OnRx( void *pContext, const BYTE *pData, UINT nLength )
+{
+    CHECK_RX *pRx = ( CHECK_RX * )pContext;
+    std::lock_guard<std::mutex> Lock( pRx->Lock );
+    pRx->Data.insert( pRx->Data.end(), pData, pData + nLength );
+}
+
+static void OnRxClose( void *pContext, const BYTE *pData, UINT nLength )
+{
+    CHECK_CLOSER *pCloser = ( CHECK_CLOSER * )pContext;
+    ( void )pData;
+    ( void )nLength;
+
+    if ( pCloser->nCalls++ == 0 )
+    {
+        pCloser->pPort->Close();
+        pCloser->bClosed = !pCloser->pPort->IsOpen();
+    }
+}
+
+static void OnTxDone( void *pContext, DWORD dwBytesWritten, BOOL bSuccess )
+{
+    CHECK_REQUEST *pRequest = ( CHECK_REQUEST * )pContext;
+    std::lock_guard<std::mutex> Lock( pRequest->pTx->Lock );
+    pRequest->pTx->Completed.push_back( pRequest->nNumber );
+    pRequest->pTx->nFailed += bSuccess ? 0 : 1;
+    pRequest->pTx->nShort += ( bSuccess && ( dwBytesWritten != pRequest->nSize ) ) ? 1 : 0;
+}
+
+static void OnRelease( void *pContext, const void *pData, UINT nSize )
+{
+    CHECK_RELEASE *pRelease = ( CHECK_RELEASE * )pContext;
+    ( void )pData;
+    pRelease->nBuffers++;
+    pRelease->qwBytes += nSize;
+}
+
+// reads the master until bStop, the drained line of the transmit checks
+static void DrainMaster( int nMaster, std::vector<BYTE> *pData, std::atomic<bool> *pbStop )
+{
+    BYTE Buffer[4096];
+
+    while ( !*pbStop )
+    {
+        UINT n = ReadMaster( nMaster, Buffer, sizeof( Buffer ), 10 );
+        pData->insert( pData->end(), Buffer, Buffer + n );
+    }
+}
+
+static void Report( const char *pszCheck, const std::string &strDetail, BOOL bOk, int *pnResult )
+{
+    printf( "%s,%s,%s\n", pszCheck, strDetail.c_str(), bOk ? "ok" : "FAILED" );
+    fflush( stdout );
+    *pnResult = bOk ? *pnResult : 1;
+}
+
+// the framing bits the driver stores, a Linux pty forces CS8 without parity
+static tcflag_t KeptFraming( int nSlave )
+{
+    struct termios Saved;
+    struct termios tio;
+    tcflag_t Kept = CSIZE | PARENB | PARODD;
+
+    tcgetattr( nSlave, &Saved );
+    tio = Saved;
+    tio.c_cflag = ( tio.c_cflag & ~CSIZE ) | CS7 | PARENB | PARODD;
+    tcsetattr( nSlave, TCSANOW, &tio );
+    tcgetattr( nSlave, &tio );
+    Kept &= ( ( tio.c_cflag & CSIZE ) == CS7 ) ? ( tcflag_t )~0 : ~( tcflag_t )CSIZE;
+    Kept &= ( tio.c_cflag & PARENB ) ? ( tcflag_t )~0 : ~( tcflag_t )PARENB;
+    Kept &= ( tio.c_cflag & PARODD ) ? ( tcflag_t )~0 : ~( tcflag_t )PARODD;
+    tcsetattr( nSlave, TCSANOW, &Saved );
+    return Kept;
+}
+
+// the termios of the slave against what the DCB asked for, as far as the driver keeps it
+static BOOL TermiosIs( int nSlave, speed_t Speed, tcflag_t Framing, BOOL bTwoStop, std::string *pstrDetail )
+{
+    tcflag_t Kept = KeptFraming( nSlave );
+    struct termios tio;
+    char szDetail[160];
+
+    if ( tcgetattr( nSlave, &tio ) != 0 )
+    {
+        *pstrDetail = "tcgetattr() failed";
+        return FALSE;
+    }
+
+    BOOL bSpeed = ( cfgetospeed( &tio ) == Speed ) && ( cfgetispeed( &tio ) == Speed );
+    BOOL bFraming = ( ( tio.c_cflag & Kept ) == ( Framing & Kept ) );
+    BOOL bStop = ( ( tio.c_cflag & CSTOPB ) != 0 ) == ( bTwoStop != FALSE );
+    BOOL bRaw = ( ( tio.c_lflag & ( ICANON | ECHO | ISIG ) ) == 0 ) && ( ( tio.c_oflag & OPOST ) == 0 ) &&
+                ( ( tio.c_iflag & ( ICRNL | INLCR | ISTRIP ) ) == 0 ) && ( ( tio.c_cflag & ( CREAD | CLOCAL ) ) == ( CREAD | CLOCAL ) );
+
+    snprintf( szDetail, sizeof( szDetail ), "speed %s framing %s%s stop %s raw %s", bSpeed ? "ok" : "wrong",
+              bFraming ? "ok" : "wrong", ( Kept != ( CSIZE | PARENB | PARODD ) ) ? " (partly forced by the driver)" : "",
+              bStop ? "ok" : "wrong", bRaw ? "ok" : "wrong" );
+    *pstrDetail = szDetail;
+    return bSpeed && bFraming && bStop && bRaw;
+}
+
+static void CheckOpen( int *pnResult )
+{
+    CSerialPort Port;
+    CHECK_PTY Pty;
+    std::string strDetail = "openpty() failed";
+    BOOL bOk = OpenPty( &Pty );
+
+    if ( bOk )
+    {
+        bOk = Port.OpenDevice( NULL, Pty.szName, 19200, EVENPARITY, 7, TWOSTOPBITS );
+        strDetail = "OpenDevice() failed";
+    }
+
+    if ( bOk )
+    {
+        DCB *pDcb = Port.GetDCB();
+        bOk = Port.IsOpen() && TermiosIs( Pty.nSlave, B19200, CS7 | PARENB, TRUE, &strDetail );
+        bOk = bOk && ( pDcb->BaudRate == 19200 ) && ( pDcb->ByteSize == 7 ) && ( pDcb->Parity == EVENPARITY ) &&
+              ( pDcb->StopBits == TWOSTOPBITS );
+        Port.Close();
+    }
+
+    ClosePty( &Pty );
+    Report( "open", strDetail, bOk, pnResult );
+}
+
+static void CheckDcb( int *pnResult )
+{
+    CSerialPort Port;
+    CSerialPort Invalid;
+    CHECK_PTY Pty;
+    std::string strDetail = "openpty() failed";
+    BOOL bOk = OpenPty( &Pty ) && Port.OpenDevice( NULL, Pty.szName, 9600 );
+
+    if ( bOk )
+    {
+        DCB Dcb = *Port.GetDCB();
+        struct termios tio;
+
+        Dcb.BaudRate = 115200;
+        Dcb.ByteSize = 8;
+        Dcb.Parity = ODDPARITY;
+        Dcb.StopBits = ONESTOPBIT;
+        Dcb.fOutxCtsFlow = TRUE;
+        Dcb.fOutX = TRUE;
+        Dcb.fInX = TRUE;
+        bOk = Port.SetDCB( &Dcb ) && TermiosIs( Pty.nSlave, B115200, CS8 | PARENB | PARODD, FALSE, &strDetail );
+        tcgetattr( Pty.nSlave, &tio );
+        bOk = bOk && ( ( tio.c_iflag & ( IXON | IXOFF ) ) == ( IXON | IXOFF ) );
+#ifdef CRTSCTS
+        bOk = bOk && ( ( tio.c_cflag & CRTSCTS ) != 0 );
+#endif
+
+        // termios has no 12345 baud, the call fails and leaves the line, the DCB and the
+        // character time as they were
+        UINT64 qwCharTime = Port.GetCharacterTime();
+        Dcb.BaudRate = 12345;
+        BOOL bRefused = !Port.SetDCB( &Dcb ) && ( Port.GetErrorCount() > 0 ) &&
+                        TermiosIs( Pty.nSlave, B115200, CS8 | PARENB | PARODD, FALSE, &strDetail ) &&
+                        ( Port.GetDCB()->BaudRate == 115200 ) && ( Port.GetCharacterTime() == qwCharTime ) &&
+                        ( qwCharTime == 11 * 1000000000ULL / 115200 );
+        bRefused = bRefused && !Invalid.OpenDevice( NULL, Pty.szName, 12345 ) && !Invalid.IsOpen();
+        strDetail += bRefused ? "; invalid baud refused" : "; invalid baud accepted";
+        bOk = bOk && bRefused && Port.IsOpen();
+        Port.Close();
+    }
+
+    ClosePty( &Pty );
+    Report( "dcb", strDetail, bOk, pnResult );
+}
+
+static void CheckTx( int *pnResult )
+{
+    CSerialPort Port;
+    CHECK_PTY Pty;
+    std::vector<BYTE> Sent;
+    std::vector<BYTE> Received( 2 * CHECK_PATTERN_SIZE );
+    UINT nReceived = 0;
+    BOOL bOk = OpenPty( &Pty ) && Port.OpenDevice( NULL, Pty.szName, 115200 );
+
+    if ( bOk )
+    {
+        // the blocking and the queued write, each with every byte value
+        Pattern( Sent, 2 * CHECK_PATTERN_SIZE, 0 );
+        Port.Write( &Sent[0], CHECK_PATTERN_SIZE );
+        bOk = Port.WriteAsync( &Sent[CHECK_PATTERN_SIZE], CHECK_PATTERN_SIZE, NULL, NULL, CHECK_TIMEOUT_MS );
+        nReceived = ReadMaster( Pty.nMaster, &Received[0], ( UINT )Received.size(), CHECK_TIMEOUT_MS );
+        bOk = bOk && ( nReceived == Sent.size() ) && ( memcmp( &Sent[0], &Received[0], Sent.size() ) == 0 );
+        Port.Close();
+    }
+
+    ClosePty( &Pty );
+    Report( "tx", std::to_string( nReceived ) + " of " + std::to_string( 2 * CHECK_PATTERN_SIZE ) + " bytes", bOk, pnResult );
+}
+
+static void CheckRx( int *pnResult )
+{
+    CSerialPort Port;
+    CHECK_PTY Pty;
+    std::vector<BYTE> Sent;
+    std::vector<BYTE> Received( CHECK_PATTERN_SIZE );
+    UINT nReceived = 0;
+    BOOL bOk = OpenPty( &Pty ) && Port.OpenDevice( NULL, Pty.szName, 115200 );
+
+    if ( bOk )
+    {
+        UINT64 qwDeadline = SerialMetricsNow() + ( UINT64 )CHECK_TIMEOUT_MS * 1000000;
+        Pattern( Sent, CHECK_PATTERN_SIZE, 3 );
+        bOk = WriteMaster( Pty.nMaster, &Sent[0], CHECK_PATTERN_SIZE );
+
+        // pulled, no callback is set
+        while ( bOk && ( nReceived < CHECK_PATTERN_SIZE ) && ( SerialMetricsNow() < qwDeadline ) )
+        {
+            UINT n = Port.Read( &Received[nReceived], CHECK_PATTERN_SIZE - nReceived );
+            nReceived += n;
+
+            if ( n == 0 )
+            {
+                usleep( 1000 );
+            }
+        }
+
+        bOk = bOk && ( nReceived == CHECK_PATTERN_SIZE ) && ( memcmp( &Sent[0], &Received[0], CHECK_PATTERN_SIZE ) == 0 ) &&
+              ( Port.GetRxOverrun() == 0 );
+        Port.Close();
+    }
+
+    ClosePty( &Pty );
+    Report( "rx", std::to_string( nReceived ) + " of " + std::to_string( CHECK_PATTERN_SIZE ) + " bytes", bOk, pnResult );
+}
+
+// the master echoes while the port keeps sending, both directions at once
+static void CheckRoundTrip( int *pnResult )
+{
+    CSerialPort Port;
+    CHECK_PTY Pty;
+    CHECK_RX Rx;
+    std::vector<BYTE> Sent;
+    std::atomic<bool> bStop( false );
+    std::thread Echo;
+    size_t nReceived = 0;
+    BOOL bOk = OpenPty( &Pty );
+
+    if ( bOk )
+    {
+        Port.SetRxCallback( OnRx, &Rx );
+        bOk = Port.OpenDevice( NULL, Pty.szName, 921600 );
+    }
+
+    if ( bOk )
+    {
+        UINT64 qwDeadline = SerialMetricsNow() + ( UINT64 )CHECK_TIMEOUT_MS * 1000000;
+        Pattern( Sent, CHECK_ROUNDTRIP, 5 );
+
+        Echo = std::thread( [&]()
+        {
+            BYTE Buffer[4096];
+
+            while ( !bStop )
+            {
+                UINT n = ReadMaster( Pty.nMaster, Buffer, sizeof( Buffer ), 10 );
+
+                if ( ( n > 0 ) && !WriteMaster( Pty.nMaster, Buffer, n ) )
+                {
+                    break;
+                }
+            }
+        } );
+
+        for ( UINT nDone = 0; bOk && ( nDone < CHECK_ROUNDTRIP ); nDone += 1024 )
+        {
+            bOk = Port.WriteAsync( &Sent[nDone], 1024, NULL, NULL, CHECK_TIMEOUT_MS );
+        }
+
+        while ( SerialMetricsNow() < qwDeadline )
+        {
+            {
+                std::lock_guard<std::mutex> Lock( Rx.Lock );
+                nReceived = Rx.Data.size();
+            }
+
+            if ( nReceived >= CHECK_ROUNDTRIP )
+            {
+                break;
+            }
+
+            usleep( 1000 );
+        }
+
+        bStop = true;
+        Echo.join();
+        Port.Close();
+        bOk = bOk && ( Rx.Data.size() == Sent.size() ) && ( memcmp( &Sent[0], &Rx.Data[0], Sent.size() ) == 0 );
+    }
+
+    ClosePty( &Pty );
+    Report( "roundtrip", std::to_string( nReceived ) + " of " + std::to_string( CHECK_ROUNDTRIP ) + " bytes", bOk, pnResult );
+}
+
+static void CheckBackpressure( int *pnResult )
+{
+    CSerialPort Port;
+    CHECK_PTY Pty;
+    std::vector<BYTE> Chunk( 1024, 0x5A );
+    std::vector<BYTE> Large( 8 * CHECK_HIGH_WATER, 0xA5 );
+    std::vector<BYTE> Drained;
+    std::atomic<bool> bStop( false );
+    std::atomic<bool> bBlockedDone( false );
+    std::string strDetail = "OpenDevice() failed";
+    UINT nAccepted = 0;
+    BOOL bOk = OpenPty( &Pty ) && Port.OpenDevice( NULL, Pty.szName, 921600, NOPARITY, 8, ONESTOPBIT, EV_RXCHAR, CHECK_HIGH_WATER );
+
+    if ( bOk )
+    {
+        // nobody reads the master, the pty fills and then the queue
+        while ( ( nAccepted < 4096 ) && Port.WriteAsync( &Chunk[0], ( UINT )Chunk.size(), NULL, NULL, 0 ) )
+        {
+            nAccepted++;
+            usleep( 100 );
+        }
+
+        BOOL bRefused = ( nAccepted < 4096 ) && ( Port.GetTxQueued() >= CHECK_HIGH_WATER );
+        UINT64 qwStart = SerialMetricsNow();
+        BOOL bTimedOut = !Port.WriteAsync( &Chunk[0], ( UINT )Chunk.size(), NULL, NULL, 200 );
+        UINT64 qwWaited = ( SerialMetricsNow() - qwStart ) / 1000000;
+        bTimedOut = bTimedOut && ( qwWaited >= 150 ) && ( qwWaited < 1000 );
+
+        // a producer without a timeout waits until the line drains
+        std::thread Blocked( [&]()
+        {
+            bBlockedDone = ( Port.WriteAsync( &Chunk[0], ( UINT )Chunk.size() ) != FALSE );
+        } );
+
+        usleep( 100000 );
+        BOOL bWaited = !bBlockedDone;
+        std::thread Drain( DrainMaster, Pty.nMaster, &Drained, &bStop );
+
+        Blocked.join();
+        BOOL bResumed = bBlockedDone && Port.WaitTxEmpty( CHECK_TIMEOUT_MS );
+        BOOL bLarge = Port.WriteAsync( &Large[0], ( UINT )Large.size(), NULL, NULL, 0 ) && Port.WaitTxEmpty( CHECK_TIMEOUT_MS );
+        usleep( 50000 );
+        bStop = true;
+        Drain.join();
+
+        bOk = bRefused && bTimedOut && bWaited && bResumed && bLarge &&
+              ( Drained.size() == ( nAccepted + 1 ) * Chunk.size() + Large.size() );
+        strDetail = std::to_string( nAccepted ) + " KB taken with no timeout; " +
+                    ( bRefused ? "refused above the mark; " : "never refused; " ) +
+                    ( bTimedOut ? "timed out after " : "did not time out after " ) + std::to_string( qwWaited ) + " ms; " +
+                    ( bWaited ? "blocked until drained; " : "did not block; " ) + ( bResumed ? "resumed; " : "did not resume; " ) +
+                    ( bLarge ? "oversized request taken when empty" : "oversized request refused" );
+        Port.Close();
+    }
+
+    ClosePty( &Pty );
+    Report( "backpressure", strDetail, bOk, pnResult );
+}
+
+static void CheckOrder( int *pnResult )
+{
+    CSerialPort Port;
+    CHECK_PTY Pty;
+    CHECK_TX Tx;
+    std::vector<CHECK_REQUEST> Requests( CHECK_PRODUCERS * CHECK_REQUESTS );
+    std::vector<std::thread> Producers;
+    std::vector<BYTE> Drained;
+    std::atomic<bool> bStop( false );
+    std::thread Drain;
+    UINT nArrived = 0;
+    BOOL bOk = OpenPty( &Pty ) && Port.OpenDevice( NULL, Pty.szName, 921600, NOPARITY, 8, ONESTOPBIT, EV_RXCHAR, 1024 );
+
+    Tx.nFailed = 0;
+    Tx.nShort = 0;
+
+    if ( bOk )
+    {
+        Drain = std::thread( DrainMaster, Pty.nMaster, &Drained, &bStop );
+
+        // a small high-water mark, the producers keep waiting for each other
+        for ( UINT p = 0; p < CHECK_PRODUCERS; p++ )
+        {
+            Producers.push_back( std::thread( [&, p]()
+            {
+                BYTE Message[CHECK_REQUEST_SIZE];
+
+                for ( UINT i = 0; i < CHECK_REQUESTS; i++ )
+                {
+                    CHECK_REQUEST *pRequest = &Requests[p * CHECK_REQUESTS + i];
+                    pRequest->pTx = &Tx;
+                    pRequest->nNumber = p * CHECK_REQUESTS + i;
+                    pRequest->nSize = CHECK_REQUEST_SIZE;
+                    memset( Message, ( int )( 0x80 | p ), sizeof( Message ) );
+                    Message[0] = ( BYTE )p;
+                    Message[1] = ( BYTE )( i >> 8 );
+                    Message[2] = ( BYTE )i;
+                    Port.WriteAsync( Message, sizeof( Message ), OnTxDone, pRequest );
+                }
+            } ) );
+        }
+
+        for ( size_t i = 0; i < Producers.size(); i++ )
+        {
+            Producers[i].join();
+        }
+
+        Port.WaitTxEmpty( CHECK_TIMEOUT_MS );
+        usleep( 50000 );
+        bStop = true;
+        Drain.join();
+        Port.Close();
+
+        // the wire order, every request whole, in order per producer and as completed
+        std::vector<UINT> Next( CHECK_PRODUCERS, 0 );
+        bOk = ( Drained.size() == Requests.size() * CHECK_REQUEST_SIZE ) && ( Tx.Completed.size() == Requests.size() ) &&
+              ( Tx.nFailed == 0 ) && ( Tx.nShort == 0 );
+
+        for ( size_t r = 0; bOk && ( r < Requests.size() ); r++ )
+        {
+            const BYTE *pMessage = &Drained[r * CHECK_REQUEST_SIZE];
+            UINT p = pMessage[0];
+            UINT i = ( ( UINT )pMessage[1] << 8 ) | pMessage[2];
+
+            bOk = ( p < CHECK_PRODUCERS ) && ( i == Next[p]++ ) && ( Tx.Completed[r] == p * CHECK_REQUESTS + i );
+
+            for ( UINT b = 3; bOk && ( b < CHECK_REQUEST_SIZE ); b++ )
+            {
+                bOk = ( pMessage[b] == ( BYTE )( 0x80 | p ) );
+            }
+
+            nArrived += bOk ? 1 : 0;
+        }
+    }
+
+    ClosePty( &Pty );
+    Report( "order", std::to_string( nArrived ) + " of " + std::to_string( Requests.size() ) + " requests in order", bOk, pnResult );
+}
+
+static void CheckPending( int *pnResult )
+{
+    CSerialPort Port;
+    CHECK_PTY Pty;
+    CHECK_TX Tx;
+    std::vector<CHECK_REQUEST> Requests( 256 );
+    std::vector<BYTE> Chunk( 1024, 0x5A );
+    UINT nQueued = 0;
+    BOOL bOk = OpenPty( &Pty ) && Port.OpenDevice( NULL, Pty.szName, 921600, NOPARITY, 8, ONESTOPBIT, EV_RXCHAR, CHECK_HIGH_WATER );
+
+    Tx.nFailed = 0;
+    Tx.nShort = 0;
+
+    if ( bOk )
+    {
+        // the master is not read, the pty fills and the rest waits in the queue
+        while ( nQueued < Requests.size() )
+        {
+            CHECK_REQUEST *pRequest = &Requests[nQueued];
+            pRequest->pTx = &Tx;
+            pRequest->nNumber = nQueued;
+            pRequest->nSize = ( UINT )Chunk.size();
+
+            if ( !Port.WriteAsync( &Chunk[0], ( UINT )Chunk.size(), OnTxDone, pRequest, 0 ) )
+            {
+                break;
+            }
+
+            nQueued++;
+            usleep( 100 );
+        }
+
+        usleep( 50000 );
+        Port.Close();
+        // every callback came back, the ones still queued failed
+        bOk = ( Tx.Completed.size() == nQueued ) && ( Tx.nFailed > 0 ) && ( Port.GetTxQueued() == 0 );
+    }
+
+    ClosePty( &Pty );
+    Report( "pending", std::to_string( Tx.Completed.size() ) + " of " + std::to_string( nQueued ) + " callbacks; " +
+            std::to_string( Tx.nFailed ) + " failed by Close()", bOk, pnResult );
+}
+
+static void CheckZeroCopy( int *pnResult )
+{
+    CSerialPort Port;
+    CHECK_PTY Pty;
+    CHECK_RELEASE Release;
+    SERIAL_TX_STATS Warm;
+    SERIAL_TX_STATS Stats;
+    // every request keeps its own header and CRC until released, the payload is shared
+    UINT nFrames = 0;
+    std::vector<BYTE> Headers( 4 * ( CHECK_FRAMES + 4096 ) );
+    std::vector<BYTE> Crcs( 2 * ( CHECK_FRAMES + 4096 ) );
+    std::vector<BYTE> Payload;
+    std::vector<BYTE> Expected;
+    std::vector<BYTE> Drained;
+    std::atomic<bool> bStop( false );
+    std::thread Drain;
+    std::string strDetail = "OpenDevice() failed";
+    BOOL bOk = OpenPty( &Pty ) && Port.OpenDevice( NULL, Pty.szName, 921600 );
+
+    Release.nBuffers = 0;
+    Release.qwBytes = 0;
+    Pattern( Payload, CHECK_FRAME_PAYLOAD, 11 );
+
+    // queues frame nFrames, FALSE when the queue did not take it within dwTimeout
+    auto Queue = [&]( DWORD dwTimeout ) -> BOOL
+    {
+        BYTE *pHeader = &Headers[4 * nFrames];
+        BYTE *pCrc = &Crcs[2 * nFrames];
+        UINT16 wCrc;
+
+        pHeader[0] = 0xC0;
+        pHeader[1] = ( BYTE )( nFrames >> 8 );
+        pHeader[2] = ( BYTE )nFrames;
+        pHeader[3] = ( BYTE )( CHECK_FRAME_PAYLOAD / 16 );
+        wCrc = SerialCrc16Xmodem( &Payload[0], CHECK_FRAME_PAYLOAD, SerialCrc16Xmodem( pHeader, 4 ) );
+        pCrc[0] = ( BYTE )( wCrc >> 8 );
+        pCrc[1] = ( BYTE )wCrc;
+
+        SERIAL_TX_BUFFER Buffers[3] =
+        {
+            { pHeader, 4, OnRelease, &Release },
+            { &Payload[0], CHECK_FRAME_PAYLOAD, OnRelease, &Release },
+            { pCrc, 2, OnRelease, &Release }
+        };
+
+        if ( !Port.WriteV( Buffers, 3, NULL, NULL, dwTimeout ) )
+        {
+            return FALSE;
+        }
+
+        Expected.insert( Expected.end(), pHeader, pHeader + 4 );
+        Expected.insert( Expected.end(), Payload.begin(), Payload.end() );
+        Expected.insert( Expected.end(), pCrc, pCrc + 2 );
+        nFrames++;
+        return TRUE;
+    };
+
+    if ( bOk )
+    {
+        // warm up: with the master not read the queue grows to the high-water mark once
+        while ( ( nFrames < 4096 ) && Queue( 0 ) )
+        {
+            usleep( 100 );
+        }
+
+        Drain = std::thread( DrainMaster, Pty.nMaster, &Drained, &bStop );
+        Port.WaitTxEmpty( CHECK_TIMEOUT_MS );
+        Port.GetTxStats( &Warm );
+        UINT nWarm = nFrames;
+
+        while ( bOk && ( nFrames < nWarm + CHECK_FRAMES ) )
+        {
+            bOk = Queue( CHECK_TIMEOUT_MS );
+        }
+
+        Port.WaitTxEmpty( CHECK_TIMEOUT_MS );
+        Port.GetTxStats( &Stats );
+        UINT64 qwCopies = Stats.qwCopies - Warm.qwCopies;
+        UINT64 qwAllocations = Stats.qwAllocations - Warm.qwAllocations;
+
+        // the counters do count: WriteAsync() copies
+        Port.WriteAsync( &Payload[0], CHECK_FRAME_PAYLOAD );
+        Expected.insert( Expected.end(), Payload.begin(), Payload.end() );
+        Port.WaitTxEmpty( CHECK_TIMEOUT_MS );
+        Port.GetTxStats( &Warm );
+        usleep( 50000 );
+        bStop = true;
+        Drain.join();
+        Port.Close();
+
+        BOOL bIntact = ( Drained == Expected );
+        BOOL bReleased = ( Release.nBuffers == 3 * nFrames ) && ( Release.qwBytes == ( UINT64 )nFrames * ( 4 + CHECK_FRAME_PAYLOAD + 2 ) );
+        BOOL bCounted = ( Warm.qwCopies == Stats.qwCopies + 1 );
+        bOk = bOk && bIntact && bReleased && bCounted && ( qwCopies == 0 ) && ( qwAllocations == 0 );
+        strDetail = std::to_string( nFrames - nWarm ) + " frames after " + std::to_string( nWarm ) + " warm; " +
+                    std::to_string( qwCopies ) + " copies; " + std::to_string( qwAllocations ) + " allocations; " +
+                    ( bIntact ? "intact; " : "damaged; " ) + std::to_string( Release.nBuffers ) + " releases" +
+                    ( bCounted ? "" : "; WriteAsync() copy not counted" );
+    }
+
+    ClosePty( &Pty );
+    Report( "zerocopy", strDetail, bOk, pnResult );
+}
+
+static void CheckClose( int *pnResult )
+{
+    CSerialPort Port;
+    CHECK_PTY Pty;
+    SERIAL_PORT_ERROR Error;
+    std::string strDetail = "OpenDevice() failed";
+    BOOL bOk = OpenPty( &Pty ) && Port.OpenDevice( NULL, Pty.szName, 115200 );
+
+    if ( bOk )
+    {
+        BYTE Byte;
+
+        // with the slave closed by the port as well the master reads EIO
+        Port.Close();
+        close( Pty.nSlave );
+        Pty.nSlave = -1;
+        usleep( 10000 );
+        bOk = !Port.IsOpen() && ( read( Pty.nMaster, &Byte, 1 ) < 0 ) && ( errno == EIO );
+        strDetail = bOk ? "released" : "still open";
+        Port.Close();
+    }
+
+    if ( bOk )
+    {
+        // the same device again, then the other side goes away while it is open
+        bOk = Port.OpenDevice( NULL, Pty.szName, 115200 ) && Port.IsOpen();
+        strDetail += bOk ? "; reopened" : "; not reopened";
+        close( Pty.nMaster );
+        Pty.nMaster = -1;
+
+        for ( UINT i = 0; bOk && ( i < CHECK_TIMEOUT_MS ) && ( Port.GetErrorCount() == 0 ); i++ )
+        {
+            usleep( 1000 );
+        }
+
+        BOOL bHangup = Port.GetError( &Error ) && ( Error.dwError == EIO );
+        strDetail += bHangup ? "; hangup reported" : "; hangup not reported";
+        bOk = bOk && bHangup;
+        Port.Close();
+        bOk = bOk && !Port.IsOpen();
+    }
+
+    ClosePty( &Pty );
+    Report( "close", strDetail, bOk, pnResult );
+}
+
+// runs Write() on its own thread, TRUE when it returned within the check timeout
+static BOOL WriteReturns( CSerialPort *pPort, std::vector<BYTE> *pData, DWORD dwDelayMs, int nHangup )
+{
+    std::atomic<bool> bReturned( false );
+    std::thread Writer( [pPort, pData, &bReturned]()
+    {
+        pPort->Write( &( *pData )[0], ( int )pData->size() );
+        bReturned = true;
+    } );
+
+    usleep( dwDelayMs * 1000 );
+
+    if ( nHangup >= 0 )
+    {
+        close( nHangup );
+    }
+
+    for ( UINT i = 0; ( i < CHECK_TIMEOUT_MS ) && !bReturned; i++ )
+    {
+        usleep( 1000 );
+    }
+
+    BOOL bOk = bReturned;
+
+    if ( !bOk )
+    {
+        // Close() fails the request, the writer can be joined
+        pPort->Close();
+    }
+
+    Writer.join();
+    return bOk;
+}
+
+// the line of a blocked Write() goes away, the port stops its I/O and fails the queue
+static void CheckHangup( int *pnResult, CSerialPortReactor *pReactor )
+{
+    CSerialPort Port;
+    CHECK_PTY Pty;
+    std::vector<BYTE> Chunk( 65536, 0xA5 );
+    std::vector<BYTE> Small( 16, 0x5A );
+    std::string strDetail = "OpenDevice() failed";
+    BOOL bOk = OpenPty( &Pty );
+
+    if ( bOk && ( pReactor != NULL ) )
+    {
+        Port.SetReactor( pReactor );
+    }
+
+    bOk = bOk && Port.OpenDevice( NULL, Pty.szName, 115200 );
+
+    if ( bOk )
+    {
+        // the master is not read, the pty fills and the Write() waits until it hangs up
+        BOOL bBlocked = WriteReturns( &Port, &Chunk, 50, Pty.nMaster );
+        Pty.nMaster = -1;
+        usleep( 10000 );
+        BOOL bAfter = WriteReturns( &Port, &Small, 0, -1 );
+        BOOL bEmpty = Port.WaitTxEmpty( 500 );
+        BOOL bRefused = !Port.WriteAsync( &Small[0], ( UINT )Small.size(), NULL, NULL, 0 );
+        bOk = bBlocked && bAfter && bEmpty && bRefused;
+        strDetail = std::string( bBlocked ? "blocked write returned" : "blocked write still waiting" ) +
+                    ( bAfter ? "; later write returned" : "; later write still waiting" ) +
+                    ( bEmpty ? "; empty" : "; not empty" ) + ( bRefused ? "; refused" : "; accepted" );
+        Port.Close();
+    }
+
+    ClosePty( &Pty );
+    Report( ( pReactor != NULL ) ? "hangup reactor" : "hangup thread", strDetail, bOk, pnResult );
+}
+
+// closed from its own receive callback while the I/O thread still has the buffer in hand
+static void CheckRxClose( int *pnResult, CSerialPortReactor *pReactor )
+{
+    CSerialPort Port;
+    CHECK_PTY Pty;
+    CHECK_CLOSER Closer;
+    CHECK_RX Rx;
+    std::vector<BYTE> Sent;
+    std::string strDetail = "OpenDevice() failed";
+    BOOL bOk = OpenPty( &Pty );
+
+    Closer.pPort = &Port;
+    Closer.nCalls = 0;
+    Closer.bClosed = false;
+
+    if ( bOk && ( pReactor != NULL ) )
+    {
+        Port.SetReactor( pReactor );
+    }
+
+    Port.SetRxCallback( OnRxClose, &Closer );
+    bOk = bOk && Port.OpenDevice( NULL, Pty.szName, 115200 );
+
+    if ( bOk )
+    {
+        // more than one read, the loop would go on with the next span
+        Pattern( Sent, CHECK_PATTERN_SIZE, 5 );
+        bOk = WriteMaster( Pty.nMaster, &Sent[0], CHECK_PATTERN_SIZE );
+
+        for ( UINT i = 0; bOk && ( i < CHECK_TIMEOUT_MS ) && !Closer.bClosed; i++ )
+        {
+            usleep( 1000 );
+        }
+
+        usleep( 20000 );
+        bOk = bOk && Closer.bClosed && ( Closer.nCalls == 1 ) && !Port.IsOpen();
+        strDetail = std::string( Closer.bClosed ? "closed by the callback" : "not closed" ) + "; " +
+                    std::to_string( Closer.nCalls ) + " calls";
+        Port.Close();
+    }
+
+    if ( bOk )
+    {
+        UINT64 qwDeadline = SerialMetricsNow() + ( UINT64 )CHECK_TIMEOUT_MS * 1000000;
+        size_t nReceived = 0;
+
+        // the I/O went on for nothing else, the port takes up its own again
+        tcflush( Pty.nMaster, TCIOFLUSH );
+        Port.SetRxCallback( OnRx, &Rx );
+        bOk = Port.OpenDevice( NULL, Pty.szName, 115200 ) && WriteMaster( Pty.nMaster, &Sent[0], CHECK_PATTERN_SIZE );
+
+        while ( bOk && ( nReceived < CHECK_PATTERN_SIZE ) && ( SerialMetricsNow() < qwDeadline ) )
+        {
+            usleep( 1000 );
+            std::lock_guard<std::mutex> Lock( Rx.Lock );
+            nReceived = Rx.Data.size();
+        }
+
+        bOk = bOk && ( nReceived == CHECK_PATTERN_SIZE ) && ( memcmp( &Sent[0], &Rx.Data[0], CHECK_PATTERN_SIZE ) == 0 );
+        strDetail += "; reopened, " + std::to_string( nReceived ) + " of " + std::to_string( CHECK_PATTERN_SIZE ) + " bytes";
+        Port.Close();
+    }
+
+    ClosePty( &Pty );
+    Report( ( pReactor != NULL ) ? "rxclose reactor" : "rxclose thread", strDetail, bOk, pnResult );
+}
+
+int main()
+{
+    int nResult = 0;
+    CSerialPortReactor Reactor;
+
+    printf( "check,detail,result\n" );
+    CheckOpen( &nResult );
+    CheckDcb( &nResult );
+    CheckTx( &nResult );
+    CheckRx( &nResult );
+    CheckRoundTrip( &nResult );
+    CheckBackpressure( &nResult );
+    CheckOrder( &nResult );
+    CheckPending( &nResult );
+    CheckZeroCopy( &nResult );
+    CheckClose( &nResult );
+    CheckHangup( &nResult, NULL );
+    CheckRxClose( &nResult, NULL );
+
+    if ( Reactor.Start() )
+    {
+        CheckHangup( &nResult, &Reactor );
+        CheckRxClose( &nResult, &Reactor );
+        Reactor.Stop();
+    }
+    else
+    {
+        Report( "hangup reactor", "Start() failed", FALSE, &nResult );
+    }
+
+    return nResult;
+}
+
+#else
+
+#include <stdio.h>
+
+int main()
+{
+    fprintf( stderr, "the port checks need pseudo-terminals (POSIX)\n" );
+    return 1;
+}
+
+#endif
@@ -0,0 +1,280 @@
+/*
+**  FILENAME            SerialPortListBench.cpp
+**
+**  PURPOSE             Builds a fake sysfs and /dev tree with USB, ACM, 8250 and
+**                      virtual ttys, then times the first scan of CSerialPortList,
+**                      a rescan, and the hotplug updates while ports come and go.
+**                      Checks that exactly the real ports are listed with their
+**                      USB attributes. With --real the scan of this machine is
+**                      timed as well.
+**
+**                      g++ -O2 -std=c++11 -I.. SerialPortListBench.cpp ../SerialPortList.cpp -lpthread
+**                      ./a.out --ports 1000 --hotplug 100
+**
+**  CREATION DATE       16-10-2026
+**  LAST MODIFICATION   16-10-2026
+*/
+
+#ifdef __linux__
+
+#include "SerialPortList.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+
+typedef std::chrono::steady_clock BenchClock;
+
+typedef struct _BENCH_EVENTS
+{
+    std::mutex              Lock;
+    std::condition_variable cvChanged;
+    UINT                    nArrived;
+    UINT                    nLeft;
+} BENCH_EVENTS;
+
+static void OnChange( void *pContext, const SERIAL_PORT_INFO *pInfo, BOOL bArrived )
+{
+    BENCH_EVENTS *pEvents = ( BENCH_EVENTS * )pContext;
+    std::lock_guard<std::mutex> Lock( pEvents->Lock );
+    ( void )pInfo;
+    ( bArrived ? pEvents->nArrived : pEvents->nLeft )++;
+    pEvents->cvChanged.notify_all();
+}
+
+static void WriteFile( const std::string &strPath, const char *szValue )
+{
+    FILE *pFile = fopen( strPath.c_str(), "w" );
+
+    if ( pFile != NULL )
+    {
+        fputs( szValue, pFile );
+        fputc( '\n', pFile );
+        fclose( pFile );
+    }
+}
+
+static void MakeDirs( const std::string &strPath )
+{
+    for ( size_t i = 1; i <= strPath.length(); i++ )
+    {
+        if ( ( i == strPath.length() ) || ( strPath[i] == '/' ) )
+        {
+            mkdir( strPath.substr( 0, i ).c_str(), 0755 );
+        }
+    }
+}
+
+/*
+** Kind 0: ttyUSB behind a usb-serial port device, 1: ttyACM on a USB interface,
+** 2: 8250 line with a UART, 3: 8250 line without one, 4: virtual terminal.
+** Only kinds 0..2 are serial ports.
+*/
+static void AddTty( const std::string &strRoot, UINT nIndex, UINT nKind, BOOL bNode )
+{
+    static const char *s_szPrefix[] = { "ttyUSB", "ttyACM", "ttyS", "ttyS", "tty" };
+    char szName[32];
+    char szText[64];
+    std::string strSys = strRoot + "/sys";
+    std::string strDevice;
+    std::string strUsb;
+
+    snprintf( szName, sizeof( szName ), "%s%u", s_szPrefix[nKind], nIndex );
+
+    if ( nKind <= 1 )
+    {
+        snprintf( szText, sizeof( szText ), "/devices/pci0000:00/usb1/1-%u", nIndex );
+        strUsb = strSys + szText;
+        strDevice = strUsb + "/1-" + std::to_string( nIndex ) + ":1.0";
+        strDevice += ( nKind == 0 ) ? std::string( "/" ) + szName : std::string();
+        MakeDirs( strDevice );
+        snprintf( szText, sizeof( szText ), "%04x", ( nKind == 0 ) ? 0x0403 : 0x2341 );
+        WriteFile( strUsb + "/idVendor", szText );
+        snprintf( szText, sizeof( szText ), "%04x", ( nKind == 0 ) ? 0x6001 : 0x0043 );
+        WriteFile( strUsb + "/idProduct", szText );
+        snprintf( szText, sizeof( szText ), "SN%06u", nIndex );
+        WriteFile( strUsb + "/serial", szText );
+        WriteFile( strUsb + "/manufacturer", ( nKind == 0 ) ? "FTDI" : "Arduino" );
+        WriteFile( strUsb + "/product", ( nKind == 0 ) ? "FT232R USB UART" : "Uno" );
+        MakeDirs( strSys + "/bus/usb-serial/drivers/ftdi_sio" );
+        MakeDirs( strSys + "/bus/usb/drivers/cdc_acm" );
+        symlink( ( strSys + ( ( nKind == 0 ) ? "/bus/usb-serial/drivers/ftdi_sio" : "/bus/usb/drivers/cdc_acm" ) ).c_str(),
+                 ( strDevice + "/driver" ).c_str() );
+    }
+    else if ( nKind <= 3 )
+    {
+        strDevice = strSys + "/devices/platform/serial8250";
+        MakeDirs( strDevice );
+        MakeDirs( strSys + "/bus/platform/drivers/serial8250" );
+        symlink( ( strSys + "/bus/platform/drivers/serial8250" ).c_str(), ( strDevice + "/driver" ).c_str() );
+    }
+
+    // the class entry is a directory here, sysfs makes it a link into /devices
+    std::string strClass = strSys + "/class/tty/" + szName;
+    MakeDirs( strClass );
+
+    if ( !strDevice.empty() )
+    {
+        symlink( strDevice.c_str(), ( strClass + "/device" ).c_str() );
+    }
+
+    if ( nKind >= 2 )
+    {
+        WriteFile( strClass + "/type", ( nKind == 2 ) ? "4" : "0" );
+    }
+
+    if ( bNode )
+    {
+        WriteFile( strRoot + "/dev/" + szName, "" );
+    }
+}
+
+static void RemoveTty( const std::string &strRoot, const char *szName )
+{
+    std::string strClass = strRoot + "/sys/class/tty/" + szName;
+
+    // the node goes first, as when a USB adapter is pulled
+    unlink( ( strRoot + "/dev/" + szName ).c_str() );
+    unlink( ( strClass + "/device" ).c_str() );
+    unlink( ( strClass + "/type" ).c_str() );
+    rmdir( strClass.c_str() );
+}
+
+static double Seconds( BenchClock::time_point Start )
+{
+    return std::chrono::duration<double>( BenchClock::now() - Start ).count();
+}
+
+static BOOL WaitEvents( BENCH_EVENTS &Events, UINT nArrived, UINT nLeft )
+{
+    std::unique_lock<std::mutex> Lock( Events.Lock );
+    return Events.cvChanged.wait_for( Lock, std::chrono::seconds( 10 ), [&]()
+    {
+        return ( Events.nArrived >= nArrived ) && ( Events.nLeft >= nLeft );
+    } );
+}
+
+int main( int argc, char *argv[] )
+{
+    UINT nPorts = 1000;
+    UINT nHotplug = 100;
+    BOOL bReal = FALSE;
+    char szRoot[] = "/tmp/serial-sysfs-XXXXXX";
+
+    for ( int i = 1; i < argc; i++ )
+    {
+        if ( strcmp( argv[i], "--real" ) == 0 )
+        {
+            bReal = TRUE;
+        }
+        else if ( ( strcmp( argv[i], "--ports" ) == 0 ) && ( i + 1 < argc ) )
+        {
+            nPorts = ( UINT )strtoul( argv[++i], NULL, 10 );
+        }
+        else if ( ( strcmp( argv[i], "--hotplug" ) == 0 ) && ( i + 1 < argc ) )
+        {
+            nHotplug = ( UINT )strtoul( argv[++i], NULL, 10 );
+        }
+        else
+        {
+            fprintf( stderr, "usage: %s [--ports 1000] [--hotplug 100] [--real]\n", argv[0] );
+            return 2;
+        }
+    }
+
+    if ( mkdtemp( szRoot ) == NULL )
+    {
+        perror( "mkdtemp()" );
+        return 1;
+    }
+
+    std::string strRoot = szRoot;
+    UINT nExpected = 0;
+    MakeDirs( strRoot + "/dev" );
+    MakeDirs( strRoot + "/sys/class/tty" );
+
+    // tty entries of all kinds, a few ports whose node udev has not made yet
+    for ( UINT i = 0; i < nPorts; i++ )
+    {
+        UINT nKind = i % 5;
+        BOOL bNode = ( i % 50 ) != 7;
+        AddTty( strRoot, i, nKind, bNode );
+        nExpected += ( ( nKind <= 2 ) && bNode ) ? 1 : 0;
+    }
+
+    BENCH_EVENTS Events;
+    Events.nArrived = 0;
+    Events.nLeft = 0;
+
+    CSerialPortList List( ( strRoot + "/sys" ).c_str(), ( strRoot + "/dev" ).c_str() );
+    List.SetCallback( OnChange, &Events );
+
+    printf( "step,entries,ports,ms,ok\n" );
+
+    BenchClock::time_point Start = BenchClock::now();
+    BOOL bOk = List.Start();
+    double dStart = Seconds( Start );
+    SERIAL_PORT_INFO Info;
+    BOOL bUsb = List.Find( "ttyUSB0", &Info ) && ( Info.wVendorId == 0x0403 ) && ( Info.wProductId == 0x6001 ) &&
+                ( strcmp( Info.szSerial, "SN000000" ) == 0 ) && ( strcmp( Info.szDriver, "ftdi_sio" ) == 0 ) &&
+                ( strcmp( Info.szLocation, "1-0" ) == 0 );
+    printf( "start,%u,%u,%.3f,%d\n", nPorts, List.GetCount(), dStart * 1e3, bOk && bUsb && ( List.GetCount() == nExpected ) );
+
+    Start = BenchClock::now();
+    bOk = List.Refresh();
+    printf( "refresh,%u,%u,%.3f,%d\n", nPorts, List.GetCount(), Seconds( Start ) * 1e3, bOk && ( List.GetCount() == nExpected ) );
+
+    // hotplug: USB adapters appear and go away again, the watcher follows
+    UINT nArrived = Events.nArrived;
+    UINT nLeft = Events.nLeft;
+    Start = BenchClock::now();
+
+    for ( UINT i = 0; i < nHotplug; i++ )
+    {
+        AddTty( strRoot, nPorts * 5 + i * 5, 0, TRUE );
+    }
+
+    bOk = WaitEvents( Events, nArrived + nHotplug, nLeft );
+    printf( "arrive,%u,%u,%.3f,%d\n", nHotplug, List.GetCount(), Seconds( Start ) * 1e3, bOk && ( List.GetCount() == nExpected + nHotplug ) );
+
+    Start = BenchClock::now();
+
+    for ( UINT i = 0; i < nHotplug; i++ )
+    {
+        char szName[32];
+        snprintf( szName, sizeof( szName ), "ttyUSB%u", nPorts * 5 + i * 5 );
+        RemoveTty( strRoot, szName );
+    }
+
+    bOk = WaitEvents( Events, nArrived + nHotplug, nLeft + nHotplug );
+    printf( "leave,%u,%u,%.3f,%d\n", nHotplug, List.GetCount(), Seconds( Start ) * 1e3, bOk && ( List.GetCount() == nExpected ) );
+    List.Stop();
+
+    if ( bReal )
+    {
+        CSerialPortList Real;
+        Start = BenchClock::now();
+        bOk = Real.Refresh();
+        printf( "real,-,%u,%.3f,%d\n", Real.GetCount(), Seconds( Start ) * 1e3, bOk );
+    }
+
+    std::string strRemove = "rm -rf " + strRoot;
+    return ( system( strRemove.c_str() ) == 0 ) ? 0 : 1;
+}
+
+#else
+
+#include <stdio.h>
+
+int main()
+{
+    fprintf( stderr, "the enumeration benchmark builds a fake sysfs (Linux)\n" );
+    return 1;
+}
+
+#endif
@@ -0,0 +1,356 @@
+/*
+**  FILENAME            SerialTransactionBench.cpp
+**
+**  PURPOSE             Polls a simulated device on the master side of a pseudo-
+**                      terminal through CSerialTransactor with windows of 1 to 16
+**                      outstanding requests. The device models a slow link: each
+**                      byte takes its character time at the given baud rate in
+**                      both directions, every chunk a fixed adapter latency, and
+**                      the device answers one request after the other. Every Nth
+**                      request goes unanswered and has to time out.
+**
+**                      g++ -O2 -std=c++11 -I.. SerialTransactionBench.cpp ../Serial*.cpp -lpthread -lutil
+**                      ./a.out --baud 9600 --latency-us 2000 --seconds 2
+**
+**  CREATION DATE       16-10-2026
+**  LAST MODIFICATION   16-10-2026
+*/
+
+#ifndef _WIN32
+
+#include "SerialTransaction.h"
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#if defined( __APPLE__ ) || defined( __FreeBSD__ )
+#include <util.h>
+#else
+#include <pty.h>
+#endif
+#include <atomic>
+#include <deque>
+#include <thread>
+#include <vector>
+
+#define BENCH_REQUEST_SIZE  16                  /* "XXXXXXXX:POLL..\n" */
+#define BENCH_REPLY_SIZE    32
+
+typedef struct _BENCH_LINK
+{
+    UINT64              qwCharNs;               // one character at the simulated baud rate
+    UINT64              qwLatencyNs;            // of the adapter, per direction
+    UINT64              qwTurnaroundNs;         // the device thinking about a request
+    UINT                nDropEvery;             // 0 answers every request
+} BENCH_LINK;
+
+typedef struct _BENCH_REPLY
+{
+    UINT64              qwDue;
+    char                szReply[BENCH_REPLY_SIZE + 1];
+} BENCH_REPLY;
+
+typedef struct _BENCH_CLIENT
+{
+    CSerialTransactor   *pTransactor;
+    std::atomic<bool>   bStop;
+    std::atomic<UINT>   nPending;
+    std::atomic<UINT64> qwOk;
+    std::atomic<UINT64> qwTimeouts;
+    DWORD               dwTimeoutMs;
+} BENCH_CLIENT;
+
+// the device: a request arrives after its bytes went over the line, the reply leaves once the device is free
+static void Device( int nMaster, const BENCH_LINK *pLink, std::atomic<bool> *pbStop )
+{
+    std::deque<BENCH_REPLY> Replies;
+    char Line[256];
+    UINT nLine = 0;
+    UINT64 qwLineFree = 0;                      // host to device direction
+    UINT64 qwDeviceFree = 0;                    // device to host direction
+    UINT64 qwRequests = 0;
+    BYTE Buffer[4096];
+
+    while ( !*pbStop )
+    {
+        struct pollfd Fd;
+        UINT64 qwNow = SerialMetricsNow();
+        int nWaitMs = 10;
+
+        if ( !Replies.empty() )
+        {
+            nWaitMs = ( Replies.front().qwDue > qwNow ) ? ( int )( ( Replies.front().qwDue - qwNow ) / 1000000 ) : 0;
+        }
+
+        Fd.fd = nMaster;
+        Fd.events = POLLIN;
+
+        if ( poll( &Fd, 1, nWaitMs ) > 0 )
+        {
+            ssize_t n = read( nMaster, Buffer, sizeof( Buffer ) );
+            qwNow = SerialMetricsNow();
+
+            for ( ssize_t i = 0; i < n; i++ )
+            {
+                if ( nLine < sizeof( Line ) )
+                {
+                    Line[nLine++] = ( char )Buffer[i];
+                }
+
+                if ( Buffer[i] != '\n' )
+                {
+                    continue;
+                }
+
+                UINT64 qwArrived = ( ( qwNow > qwLineFree ) ? qwNow : qwLineFree ) + nLine * pLink->qwCharNs;
+                qwLineFree = qwArrived;
+                qwArrived += pLink->qwLatencyNs;
+
+                if ( ( pLink->nDropEvery == 0 ) || ( ++qwRequests % pLink->nDropEvery != 0 ) )
+                {
+                    BENCH_REPLY Reply;
+                    UINT64 qwStart = qwArrived + pLink->qwTurnaroundNs;
+                    qwStart = ( qwStart > qwDeviceFree ) ? qwStart : qwDeviceFree;
+                    qwDeviceFree = qwStart + BENCH_REPLY_SIZE * pLink->qwCharNs;
+                    Reply.qwDue = qwDeviceFree + pLink->qwLatencyNs;
+                    snprintf( Reply.szReply, sizeof( Reply.szReply ), "%.8s:REPLY.................\n", Line );
+                    Replies.push_back( Reply );
+                }
+
+                nLine = 0;
+            }
+        }
+
+        // the slow part is simulated, the pty itself delivers at once
+        for ( qwNow = SerialMetricsNow(); !Replies.empty() && ( Replies.front().qwDue <= qwNow ); Replies.pop_front() )
+        {
+            if ( write( nMaster, Replies.front().szReply, BENCH_REPLY_SIZE ) != BENCH_REPLY_SIZE )
+            {
+                break;
+            }
+        }
+    }
+}
+
+static BOOL ReplyKey( void *pContext, const BYTE *pFrame, UINT nLength, UINT64 *pqwKey )
+{
+    char szKey[9];
+    char *pEnd;
+    ( void )pContext;
+
+    if ( ( nLength < 9 ) || ( pFrame[8] != ':' ) )
+    {
+        return FALSE;
+    }
+
+    memcpy( szKey, pFrame, 8 );
+    szKey[8] = 0;
+    *pqwKey = strtoull( szKey, &pEnd, 16 );
+    return ( *pEnd == 0 ) ? TRUE : FALSE;
+}
+
+static BOOL SubmitPoll( BENCH_CLIENT *pClient );
+
+static void OnReply( void *pContext, SERIAL_TRANSACTION_STATUS Status, const BYTE *pReply, UINT nLength, UINT64 qwLatency )
+{
+    BENCH_CLIENT *pClient = ( BENCH_CLIENT * )pContext;
+    ( void )pReply;
+    ( void )nLength;
+    ( void )qwLatency;
+
+    if ( Status == SERIAL_TRANSACTION_OK )
+    {
+        pClient->qwOk++;
+    }
+    else if ( Status == SERIAL_TRANSACTION_TIMEOUT )
+    {
+        pClient->qwTimeouts++;
+    }
+
+    // keeps the window full until the run ends
+    if ( pClient->bStop || ( Status == SERIAL_TRANSACTION_CANCELLED ) || !SubmitPoll( pClient ) )
+    {
+        pClient->nPending--;
+    }
+}
+
+static std::atomic<UINT64> s_qwNextId( 1 );
+
+static BOOL SubmitPoll( BENCH_CLIENT *pClient )
+{
+    char szRequest[BENCH_REQUEST_SIZE + 1];
+    UINT64 qwId = s_qwNextId++ & 0xffffffffULL;
+
+    snprintf( szRequest, sizeof( szRequest ), "%08llX:POLL..\n", ( unsigned long long )qwId );
+    return pClient->pTransactor->Submit( szRequest, BENCH_REQUEST_SIZE, qwId, pClient->dwTimeoutMs, OnReply, pClient );
+}
+
+int main( int argc, char *argv[] )
+{
+    BENCH_LINK Link;
+    UINT nBaud = 9600;
+    double dSeconds = 2.0;
+    std::vector<UINT> Windows;
+    DWORD dwTimeoutMs = 0;
+
+    Link.qwLatencyNs = 2000000;
+    Link.qwTurnaroundNs = 200000;
+    Link.nDropEvery = 25;
+
+    for ( int i = 1; i + 1 < argc; i += 2 )
+    {
+        if ( strcmp( argv[i], "--baud" ) == 0 )
+        {
+            nBaud = ( UINT )strtoul( argv[i + 1], NULL, 10 );
+        }
+        else if ( strcmp( argv[i], "--latency-us" ) == 0 )
+        {
+            Link.qwLatencyNs = strtoull( argv[i + 1], NULL, 10 ) * 1000;
+        }
+        else if ( strcmp( argv[i], "--turnaround-us" ) == 0 )
+        {
+            Link.qwTurnaroundNs = strtoull( argv[i + 1], NULL, 10 ) * 1000;
+        }
+        else if ( strcmp( argv[i], "--drop" ) == 0 )
+        {
+            Link.nDropEvery = ( UINT )strtoul( argv[i + 1], NULL, 10 );
+        }
+        else if ( strcmp( argv[i], "--timeout-ms" ) == 0 )
+        {
+            dwTimeoutMs = ( DWORD )strtoul( argv[i + 1], NULL, 10 );
+        }
+        else if ( strcmp( argv[i], "--seconds" ) == 0 )
+        {
+            dSeconds = atof( argv[i + 1] );
+        }
+        else if ( strcmp( argv[i], "--windows" ) == 0 )
+        {
+            for ( char *p = argv[i + 1]; *p; p += ( *p == ',' ) ? 1 : 0 )
+            {
+                Windows.push_back( ( UINT )strtoul( p, &p, 10 ) );
+            }
+        }
+        else
+        {
+            fprintf( stderr, "usage: %s [--baud 9600] [--latency-us 2000] [--turnaround-us 200] [--drop 25] "
+                     "[--timeout-ms T] [--seconds 2] [--windows 1,2,4,8,16]\n", argv[0] );
+            return 2;
+        }
+    }
+
+    if ( Windows.empty() )
+    {
+        UINT nDefault[] = { 1, 2, 4, 8, 16 };
+        Windows.assign( nDefault, nDefault + 5 );
+    }
+
+    // 10 bits a character, 8N1
+    Link.qwCharNs = 10000000000ULL / nBaud;
+
+    printf( "window,baud,latency_us,polls_per_s,rtt_p50_us,rtt_p99_us,timed_out,unmatched,line_use\n" );
+
+    for ( size_t w = 0; w < Windows.size(); w++ )
+    {
+        CSerialPort Port;
+        CSerialLineFramer Framer;
+        CSerialTransactor Transactor;
+        BENCH_CLIENT Client;
+        SERIAL_TRANSACTION_STATS Stats;
+        std::atomic<bool> bDeviceStop( false );
+        struct termios tio;
+        char szName[128];
+        int nMaster;
+        int nSlave;
+
+        if ( openpty( &nMaster, &nSlave, szName, NULL, NULL ) != 0 )
+        {
+            perror( "openpty()" );
+            return 1;
+        }
+
+        tcgetattr( nMaster, &tio );
+        cfmakeraw( &tio );
+        tcsetattr( nMaster, TCSANOW, &tio );
+        fcntl( nMaster, F_SETFL, fcntl( nMaster, F_GETFL ) | O_NONBLOCK );
+
+        Transactor.Attach( &Port, &Framer );
+        Transactor.SetKeyExtractor( ReplyKey, NULL );
+        Transactor.SetWindow( Windows[w] );
+
+        if ( !Port.OpenDevice( NULL, szName, nBaud, NOPARITY, 8, ONESTOPBIT, EV_RXCHAR, 65536 ) )
+        {
+            fprintf( stderr, "%s could not be opened\n", szName );
+            return 1;
+        }
+
+        close( nSlave );
+        std::thread DeviceThread( Device, nMaster, &Link, &bDeviceStop );
+
+        Client.pTransactor = &Transactor;
+        Client.bStop = false;
+        Client.nPending = 0;
+        Client.qwOk = 0;
+        Client.qwTimeouts = 0;
+        Client.dwTimeoutMs = dwTimeoutMs;
+
+        // the longest a reply may take with twice the window ahead of it, plus slack
+        if ( Client.dwTimeoutMs == 0 )
+        {
+            UINT64 qwCycle = ( BENCH_REQUEST_SIZE + BENCH_REPLY_SIZE ) * Link.qwCharNs + Link.qwTurnaroundNs;
+            Client.dwTimeoutMs = ( DWORD )( ( 2 * Link.qwLatencyNs + ( 2 * Windows[w] + 2 ) * qwCycle ) / 1000000 ) + 20;
+        }
+
+        // twice the window submitted, the rest waits in the queue of the transactor
+        for ( UINT i = 0; i < 2 * Windows[w]; i++ )
+        {
+            Client.nPending++;
+
+            if ( !SubmitPoll( &Client ) )
+            {
+                Client.nPending--;
+            }
+        }
+
+        UINT64 qwStart = SerialMetricsNow();
+        usleep( ( useconds_t )( dSeconds * 1e6 ) );
+        UINT64 qwOk = Client.qwOk;
+        UINT64 qwElapsed = SerialMetricsNow() - qwStart;
+        Transactor.GetStats( &Stats );
+
+        Client.bStop = true;
+
+        while ( Client.nPending > 0 )
+        {
+            usleep( 1000 );
+        }
+
+        Port.Close();
+        bDeviceStop = true;
+        DeviceThread.join();
+        close( nMaster );
+
+        double dPolls = ( double )qwOk * 1e9 / ( double )qwElapsed;
+        // of the busier direction, device to host
+        double dLineUse = dPolls * BENCH_REPLY_SIZE * ( double )Link.qwCharNs / 1e9;
+
+        printf( "%u,%u,%llu,%.1f,%.1f,%.1f,%llu,%llu,%.2f\n", Windows[w], nBaud, ( unsigned long long )( Link.qwLatencyNs / 1000 ),
+                dPolls, SerialHistogramPercentile( &Stats.Latency, 0.5 ) / 1000.0, SerialHistogramPercentile( &Stats.Latency, 0.99 ) / 1000.0,
+                ( unsigned long long )Stats.qwTimedOut, ( unsigned long long )Stats.qwUnmatched, dLineUse );
+    }
+
+    return 0;
+}
+
+#else
+
+#include <stdio.h>
+
+int main()
+{
+    fprintf( stderr, "the transaction benchmark needs pseudo-terminals (POSIX)\n" );
+    return 1;
+}
+
+#endif
@@ -0,0 +1,274 @@
+/*
+**  FILENAME            SerialTxPacerBench.cpp
+**
+**  PURPOSE             Streams frames through one port to the master side of a
+**                      pseudo-terminal which is read at the simulated baud rate,
+**                      and prints how busy the line was and how much data the
+**                      driver held ahead of it for: blocking Write() followed by
+**                      the sleep it used to compute from the DCB, Write() waiting
+**                      for the driver's queue, WriteAsync() unpaced, paced and
+**                      paced with a rate limit. A pty reports no output queue, so
+**                      the pacer runs on its line model. Exits with 1 when the paced
+**                      line is not kept busy, its backlog exceeds the lead or the
+**                      rate limit is missed.
+**
+**                      g++ -O2 -std=c++11 -I.. SerialTxPacerBench.cpp ../Serial*.cpp -lpthread -lutil
+**                      ./a.out --baud 115200 --frame 256 --seconds 2
+**
+**  CREATION DATE       16-10-2026
+**  LAST MODIFICATION   16-10-2026
+*/
+
+#ifndef _WIN32
+
+#include "SerialPort.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#if defined( __APPLE__ ) || defined( __FreeBSD__ )
+#include <util.h>
+#else
+#include <pty.h>
+#endif
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#define BENCH_TICK_US       500                 /* the line reader drains twice a millisecond */
+#define BENCH_SAMPLE_US     5000                /* backlog samples */
+#define BENCH_BURST_US      10000               /* bursts of the rate limit, a frame at least */
+
+typedef enum _BENCH_MODE
+{
+    BENCH_SLEEP,                                // Write() and the sleep of the former implementation
+    BENCH_WRITE,                                // Write(), paced
+    BENCH_ASYNC,                                // WriteAsync(), unpaced
+    BENCH_PACED,                                // WriteAsync(), paced
+    BENCH_LIMITED                               // WriteAsync(), paced and rate limited
+} BENCH_MODE;
+
+static const char *s_pszModes[] = { "sleep", "write", "async", "paced", "limited" };
+
+typedef struct _BENCH_RUN
+{
+    CSerialPort         *pPort;
+    BENCH_MODE          Mode;
+    UINT                nFrame;
+    UINT                nBaud;
+    std::atomic<bool>   bStop;
+} BENCH_RUN;
+
+// reads no faster than the line would carry the bytes
+static void Line( int nMaster, UINT64 qwCharNs, std::atomic<UINT64> *pqwRead, std::atomic<bool> *pbStop )
+{
+    static BYTE Buffer[1 << 16];
+    UINT64 qwStart = SerialMetricsNow();
+    UINT64 qwRead = 0;
+
+    while ( !*pbStop )
+    {
+        UINT64 qwAllowed = ( SerialMetricsNow() - qwStart ) / qwCharNs;
+        size_t nWant = ( size_t )( qwAllowed - qwRead );
+        ssize_t n;
+
+        nWant = ( nWant < sizeof( Buffer ) ) ? nWant : sizeof( Buffer );
+        n = ( nWant > 0 ) ? read( nMaster, Buffer, nWant ) : 0;
+
+        if ( n > 0 )
+        {
+            qwRead += ( UINT64 )n;
+            *pqwRead = qwRead;
+        }
+
+        if ( ( size_t )( ( n > 0 ) ? n : 0 ) < nWant )
+        {
+            // the line ran dry, it does not save up time
+            qwStart = SerialMetricsNow() - qwRead * qwCharNs;
+        }
+
+        usleep( BENCH_TICK_US );
+    }
+}
+
+static void Producer( BENCH_RUN *pRun )
+{
+    std::vector<BYTE> Frame( pRun->nFrame, 0x55 );
+
+    while ( !pRun->bStop )
+    {
+        if ( ( pRun->Mode == BENCH_SLEEP ) || ( pRun->Mode == BENCH_WRITE ) )
+        {
+            pRun->pPort->Write( &Frame[0], ( int )pRun->nFrame );
+
+            if ( pRun->Mode == BENCH_SLEEP )
+            {
+                // 8N1: ByteSize 8, StopBits ONESTOPBIT (0)
+                ::Sleep( ( ( 1000UL * ( 8 + ONESTOPBIT + 1 ) * pRun->nFrame ) / pRun->nBaud ) + 1 );
+            }
+        }
+        else
+        {
+            pRun->pPort->WriteAsync( &Frame[0], pRun->nFrame, NULL, NULL, 100 );
+        }
+    }
+}
+
+int main( int argc, char *argv[] )
+{
+    UINT nBaud = 115200;
+    UINT nFrame = 256;
+    UINT nLeadUs = SERIAL_TX_LEAD_US;
+    double dSeconds = 2.0;
+    double dLimit = 0.5;                        // of the line rate
+    int nResult = 0;
+
+    for ( int i = 1; i + 1 < argc; i += 2 )
+    {
+        if ( strcmp( argv[i], "--baud" ) == 0 )
+        {
+            nBaud = ( UINT )strtoul( argv[i + 1], NULL, 10 );
+        }
+        else if ( strcmp( argv[i], "--frame" ) == 0 )
+        {
+            nFrame = ( UINT )strtoul( argv[i + 1], NULL, 10 );
+        }
+        else if ( strcmp( argv[i], "--lead-us" ) == 0 )
+        {
+            nLeadUs = ( UINT )strtoul( argv[i + 1], NULL, 10 );
+        }
+        else if ( strcmp( argv[i], "--limit" ) == 0 )
+        {
+            dLimit = atof( argv[i + 1] );
+        }
+        else if ( strcmp( argv[i], "--seconds" ) == 0 )
+        {
+            dSeconds = atof( argv[i + 1] );
+        }
+        else
+        {
+            fprintf( stderr, "usage: %s [--baud 115200] [--frame 256] [--lead-us 2000] [--limit 0.5] [--seconds 2]\n", argv[0] );
+            return 2;
+        }
+    }
+
+    // 10 bits a character, 8N1
+    UINT64 qwCharNs = 10000000000ULL / nBaud;
+
+    printf( "mode,baud,frame,line_kb_per_s,line_use,backlog_avg_ms,backlog_max_ms,result\n" );
+
+    for ( int m = BENCH_SLEEP; m <= BENCH_LIMITED; m++ )
+    {
+        CSerialPort Port;
+        SERIAL_PORT_METRICS Metrics;
+        BENCH_RUN Run;
+        std::atomic<UINT64> qwRead( 0 );
+        std::atomic<bool> bLineStop( false );
+        struct termios tio;
+        char szName[128];
+        int nMaster;
+        int nSlave;
+
+        if ( openpty( &nMaster, &nSlave, szName, NULL, NULL ) != 0 )
+        {
+            perror( "openpty()" );
+            return 1;
+        }
+
+        tcgetattr( nMaster, &tio );
+        cfmakeraw( &tio );
+        tcsetattr( nMaster, TCSANOW, &tio );
+        fcntl( nMaster, F_SETFL, fcntl( nMaster, F_GETFL ) | O_NONBLOCK );
+
+        if ( ( m == BENCH_WRITE ) || ( m == BENCH_PACED ) || ( m == BENCH_LIMITED ) )
+        {
+            Port.SetTxPacing( SERIAL_TX_PACE_MODEL, nLeadUs );
+        }
+
+        if ( m == BENCH_LIMITED )
+        {
+            UINT nBurst = ( UINT )( BENCH_BURST_US * 1000ULL / qwCharNs );
+            Port.SetTxRateLimit( ( UINT )( dLimit * 1e9 / ( double )qwCharNs ), ( nBurst > nFrame ) ? nBurst : nFrame );
+        }
+
+        if ( !Port.OpenDevice( NULL, szName, nBaud, NOPARITY, 8, ONESTOPBIT, 0, 16 * nFrame ) )
+        {
+            fprintf( stderr, "%s could not be opened\n", szName );
+            return 1;
+        }
+
+        close( nSlave );
+        Run.pPort = &Port;
+        Run.Mode = ( BENCH_MODE )m;
+        Run.nFrame = nFrame;
+        Run.nBaud = nBaud;
+        Run.bStop = false;
+
+        std::thread LineThread( Line, nMaster, qwCharNs, &qwRead, &bLineStop );
+        std::thread ProducerThread( Producer, &Run );
+
+        usleep( 200000 );
+        UINT64 qwReadStart = qwRead;
+        UINT64 qwStart = SerialMetricsNow();
+        UINT64 qwBacklogSum = 0;
+        UINT64 qwBacklogMax = 0;
+        UINT nSamples = 0;
+
+        // the bytes the driver took and the line did not carry yet
+        while ( SerialMetricsNow() - qwStart < ( UINT64 )( dSeconds * 1e9 ) )
+        {
+            usleep( BENCH_SAMPLE_US );
+            Port.GetMetrics( &Metrics );
+            UINT64 qwLine = qwRead;
+            UINT64 qwBacklog = ( Metrics.qwTxBytes > qwLine ) ? Metrics.qwTxBytes - qwLine : 0;
+            qwBacklogSum += qwBacklog;
+            qwBacklogMax = ( qwBacklog > qwBacklogMax ) ? qwBacklog : qwBacklogMax;
+            nSamples++;
+        }
+
+        UINT64 qwElapsed = SerialMetricsNow() - qwStart;
+        UINT64 qwBytes = qwRead - qwReadStart;
+
+        Run.bStop = true;
+        ProducerThread.join();
+        Port.Close();
+        bLineStop = true;
+        LineThread.join();
+        close( nMaster );
+
+        double dUse = ( double )qwBytes * ( double )qwCharNs / ( double )qwElapsed;
+        double dBacklogAvg = ( double )qwBacklogSum / nSamples * ( double )qwCharNs / 1e6;
+        double dBacklogMax = ( double )qwBacklogMax * ( double )qwCharNs / 1e6;
+        // the lead, the top-up at half of it, a frame in the reader's hands and its ticks
+        double dBacklogBound = ( 1.5 * nLeadUs + 2 * BENCH_TICK_US ) / 1000.0 + nFrame * ( double )qwCharNs / 1e6;
+        BOOL bOk = TRUE;
+
+        if ( m == BENCH_PACED )
+        {
+            bOk = ( dUse >= 0.95 ) && ( dBacklogAvg <= dBacklogBound );
+        }
+        else if ( m == BENCH_LIMITED )
+        {
+            bOk = ( dUse >= dLimit * 0.95 ) && ( dUse <= dLimit * 1.05 );
+        }
+
+        nResult = bOk ? nResult : 1;
+        printf( "%s,%u,%u,%.1f,%.3f,%.2f,%.2f,%s\n", s_pszModes[m], nBaud, nFrame, ( double )qwBytes * 1e6 / ( double )qwElapsed,
+                dUse, dBacklogAvg, dBacklogMax, bOk ? "ok" : "FAILED" );
+    }
+
+    return nResult;
+}
+
+#else
+
+#include <stdio.h>
+
+int main()
+{
+    fprintf( stderr, "the transmit pacer benchmark needs pseudo-terminals (POSIX)\n" );
+    return 1;
+}
+
+#endif
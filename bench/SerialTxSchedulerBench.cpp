@@ -0,0 +1,283 @@
+/*
+**  FILENAME            SerialTxSchedulerBench.cpp
+**
+**  PURPOSE             Sends a bulk transfer and short urgent frames over one port
+**                      to the master side of a pseudo-terminal, which is read at
+**                      the simulated baud rate so the bulk lane always has data
+**                      waiting. The port paces its writes by the line model, the
+**                      pty never fills and gives room back in its own steps of a
+**                      few KB. Reports how long the urgent frames waited for the
+**                      lane to be picked (TxStart of the metrics) with different
+**                      slice sizes of the bulk lane and checks that the worst case
+**                      stays within two slice times plus the pacing lead (a whole
+**                      chunk without a slice), that urgent frames only come between
+**                      slices (between chunks without a slice), and that both
+**                      streams arrive intact. Exits with 1 on a failed check.
+**
+**                      g++ -O2 -std=c++11 -I.. SerialTxSchedulerBench.cpp ../Serial*.cpp -lpthread -lutil
+**                      ./a.out --baud 921600 --seconds 2
+**
+**  CREATION DATE       16-10-2026
+**  LAST MODIFICATION   16-10-2026
+*/
+
+#ifndef _WIN32
+
+#include "SerialPort.h"
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#if defined( __APPLE__ ) || defined( __FreeBSD__ )
+#include <util.h>
+#else
+#include <pty.h>
+#endif
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#define BENCH_CHUNK_SIZE    16384
+#define BENCH_URGENT_SIZE   16                  /* "!U00000000.....\n", '!' never occurs in the bulk stream */
+#define BENCH_BULK_MODULO   127                 /* bulk byte n is n % 127 + 128 */
+#define BENCH_TICK_NS       1000000ULL          /* the line reader drains once a millisecond */
+
+typedef struct _BENCH_CONFIG
+{
+    const char          *pszName;
+    SERIAL_TX_SCHEDULING Scheduling;
+    UINT                nSlice;                 // of the bulk lane, 0 sends a chunk in one piece
+} BENCH_CONFIG;
+
+typedef struct _BENCH_LINE
+{
+    UINT64              qwCharNs;
+    UINT64              qwBroken;               // urgent frames split by bulk data, or bulk bytes out of order
+    UINT64              qwBulk;
+    UINT                nBoundary;              // bulk bytes between the points an urgent frame may come in
+    UINT64              qwMisplaced;            // urgent frames inside a slice, or inside a chunk without one
+} BENCH_LINE;
+
+// reads no faster than the line would carry the bytes and checks both streams
+static void Line( int nMaster, BENCH_LINE *pLine, std::atomic<bool> *pbStop )
+{
+    static BYTE Buffer[1 << 20];
+    UINT nFrame = 0;
+    UINT64 qwStart = SerialMetricsNow();
+    UINT64 qwRead = 0;
+
+    while ( !*pbStop )
+    {
+        UINT64 qwAllowed = ( SerialMetricsNow() - qwStart ) / pLine->qwCharNs;
+        size_t nWant = ( size_t )( qwAllowed - qwRead );
+        ssize_t n;
+
+        nWant = ( nWant < sizeof( Buffer ) ) ? nWant : sizeof( Buffer );
+        n = ( nWant > 0 ) ? read( nMaster, Buffer, nWant ) : 0;
+
+        if ( n <= 0 )
+        {
+            // nothing waiting, the line does not save up time
+            qwStart = SerialMetricsNow() - qwRead * pLine->qwCharNs;
+            usleep( BENCH_TICK_NS / 1000 );
+            continue;
+        }
+
+        qwRead += ( UINT64 )n;
+
+        for ( ssize_t i = 0; i < n; i++ )
+        {
+            if ( ( nFrame == 0 ) && ( Buffer[i] != '!' ) )
+            {
+                if ( Buffer[i] != ( BYTE )( pLine->qwBulk++ % BENCH_BULK_MODULO + 128 ) )
+                {
+                    pLine->qwBroken++;
+                    pLine->qwBulk = Buffer[i] - 128 + 1;
+                }
+
+                continue;
+            }
+
+            if ( ( nFrame == 0 ) && ( pLine->qwBulk % pLine->nBoundary != 0 ) )
+            {
+                pLine->qwMisplaced++;
+            }
+
+            // an urgent frame is printable up to its newline, a bulk byte inside it splits it
+            nFrame++;
+
+            if ( ( Buffer[i] >= 128 ) || ( ( nFrame == BENCH_URGENT_SIZE ) && ( Buffer[i] != '\n' ) ) )
+            {
+                pLine->qwBroken++;
+                nFrame = 0;
+            }
+            else if ( nFrame == BENCH_URGENT_SIZE )
+            {
+                nFrame = 0;
+            }
+        }
+
+        usleep( BENCH_TICK_NS / 1000 );
+    }
+}
+
+// keeps the bulk lane above its high-water mark
+static void Bulk( CSerialPort *pPort, std::atomic<bool> *pbStop )
+{
+    std::vector<BYTE> Chunk( BENCH_CHUNK_SIZE );
+    UINT64 qwNext = 0;
+
+    while ( !*pbStop )
+    {
+        for ( UINT i = 0; i < BENCH_CHUNK_SIZE; i++ )
+        {
+            Chunk[i] = ( BYTE )( ( qwNext + i ) % BENCH_BULK_MODULO + 128 );
+        }
+
+        if ( pPort->WriteLane( SERIAL_TX_BULK, &Chunk[0], BENCH_CHUNK_SIZE, NULL, NULL, 100 ) )
+        {
+            qwNext += BENCH_CHUNK_SIZE;
+        }
+    }
+}
+
+int main( int argc, char *argv[] )
+{
+    UINT nBaud = 921600;
+    double dSeconds = 2.0;
+    UINT nPeriodMs = 20;
+    int nResult = 0;
+    BENCH_CONFIG Configs[] =
+    {
+        { "strict", SERIAL_TX_STRICT, 0 },
+        { "strict", SERIAL_TX_STRICT, 1024 },
+        { "strict", SERIAL_TX_STRICT, 256 },
+        { "strict", SERIAL_TX_STRICT, 64 },
+        { "weighted", SERIAL_TX_WEIGHTED, 256 }
+    };
+
+    for ( int i = 1; i + 1 < argc; i += 2 )
+    {
+        if ( strcmp( argv[i], "--baud" ) == 0 )
+        {
+            nBaud = ( UINT )strtoul( argv[i + 1], NULL, 10 );
+        }
+        else if ( strcmp( argv[i], "--seconds" ) == 0 )
+        {
+            dSeconds = atof( argv[i + 1] );
+        }
+        else if ( strcmp( argv[i], "--period-ms" ) == 0 )
+        {
+            nPeriodMs = ( UINT )strtoul( argv[i + 1], NULL, 10 );
+        }
+        else
+        {
+            fprintf( stderr, "usage: %s [--baud 921600] [--seconds 2] [--period-ms 20]\n", argv[0] );
+            return 2;
+        }
+    }
+
+    printf( "scheduling,slice,baud,urgent_frames,wait_p50_us,wait_p99_us,wait_max_us,bound_us,bulk_kb_per_s,broken,misplaced,result\n" );
+
+    for ( size_t c = 0; c < sizeof( Configs ) / sizeof( Configs[0] ); c++ )
+    {
+        CSerialPort Port;
+        SERIAL_PORT_METRICS Metrics;
+        BENCH_LINE Link;
+        std::atomic<bool> bLineStop( false );
+        std::atomic<bool> bBulkStop( false );
+        struct termios tio;
+        char szName[128];
+        UINT nUrgent = 0;
+        int nMaster;
+        int nSlave;
+
+        if ( openpty( &nMaster, &nSlave, szName, NULL, NULL ) != 0 )
+        {
+            perror( "openpty()" );
+            return 1;
+        }
+
+        tcgetattr( nMaster, &tio );
+        cfmakeraw( &tio );
+        tcsetattr( nMaster, TCSANOW, &tio );
+        fcntl( nMaster, F_SETFL, fcntl( nMaster, F_GETFL ) | O_NONBLOCK );
+
+        Port.SetTxScheduling( Configs[c].Scheduling );
+        Port.SetTxLane( SERIAL_TX_BULK, Configs[c].nSlice, 1 );
+        Port.SetTxPacing( SERIAL_TX_PACE_MODEL );
+
+        if ( !Port.OpenDevice( NULL, szName, nBaud, NOPARITY, 8, ONESTOPBIT, 0, 65536 ) )
+        {
+            fprintf( stderr, "%s could not be opened\n", szName );
+            return 1;
+        }
+
+        close( nSlave );
+        memset( &Link, 0, sizeof( Link ) );
+        // 10 bits a character, 8N1
+        Link.qwCharNs = 10000000000ULL / nBaud;
+        Link.nBoundary = ( Configs[c].nSlice > 0 ) ? Configs[c].nSlice : BENCH_CHUNK_SIZE;
+        // the rest of a slice, or of the chunk which started without one, goes before the lane
+        // switches; the driver holds no more than the lead of the pacing
+        UINT64 qwBound = 2 * Link.nBoundary * Link.qwCharNs + SERIAL_TX_LEAD_US * 1000ULL + 2 * BENCH_TICK_NS;
+        Port.SetTxHighWaterMark( 2 * BENCH_CHUNK_SIZE );
+
+        std::thread LineThread( Line, nMaster, &Link, &bLineStop );
+        std::thread BulkThread( Bulk, &Port, &bBulkStop );
+
+        // the bulk transfer fills the pty first, then every frame meets a busy bulk lane
+        usleep( 200000 );
+        Port.ResetMetrics();
+        UINT64 qwBulkStart = Link.qwBulk;
+        UINT64 qwStart = SerialMetricsNow();
+
+        while ( SerialMetricsNow() - qwStart < ( UINT64 )( dSeconds * 1e9 ) )
+        {
+            char szFrame[BENCH_URGENT_SIZE + 1];
+            snprintf( szFrame, sizeof( szFrame ), "!U%08X.....\n", nUrgent++ );
+            Port.WriteLane( SERIAL_TX_URGENT, szFrame, BENCH_URGENT_SIZE );
+            usleep( nPeriodMs * 1000 );
+        }
+
+        UINT64 qwElapsed = SerialMetricsNow() - qwStart;
+        UINT64 qwBulk = Link.qwBulk - qwBulkStart;
+        // the last frames start within the bound as well
+        usleep( ( useconds_t )( qwBound / 1000 ) );
+        Port.GetMetrics( &Metrics );
+
+        bBulkStop = true;
+        BulkThread.join();
+        Port.Close();
+        bLineStop = true;
+        LineThread.join();
+        close( nMaster );
+
+        const SERIAL_HISTOGRAM *pWait = &Metrics.TxStart[SERIAL_TX_URGENT];
+        BOOL bOk = ( Link.qwBroken == 0 ) && ( Link.qwMisplaced == 0 );
+        bOk = bOk && ( pWait->qwMax <= qwBound ) && ( pWait->qwCount == nUrgent );
+        nResult = bOk ? nResult : 1;
+
+        printf( "%s,%u,%u,%llu,%.1f,%.1f,%.1f,%.1f,%.1f,%llu,%llu,%s\n", Configs[c].pszName, Configs[c].nSlice, nBaud,
+                ( unsigned long long )pWait->qwCount, SerialHistogramPercentile( pWait, 0.5 ) / 1000.0,
+                SerialHistogramPercentile( pWait, 0.99 ) / 1000.0, pWait->qwMax / 1000.0, qwBound / 1000.0,
+                ( double )qwBulk * 1e6 / ( double )qwElapsed, ( unsigned long long )Link.qwBroken,
+                ( unsigned long long )Link.qwMisplaced, bOk ? "ok" : "FAILED" );
+    }
+
+    return nResult;
+}
+
+#else
+
+#include <stdio.h>
+
+int main()
+{
+    fprintf( stderr, "the transmit scheduler benchmark needs pseudo-terminals (POSIX)\n" );
+    return 1;
+}
+
+#endif